@@ -0,0 +1,1167 @@
+/// @file recording_tests.cpp
+///
+/// Tests of the continuous recording without the hardware and the GUI (make test, or make test-sanitize with
+/// the address and undefined behaviour sanitizers): the encoding of the chunks, the opening of a recording with
+/// a missing, trimmed or stale time index, the search of the chunks (also after the clock was set back), the pyramid
+/// of summaries (also joined across the recordings of the directory), the layout of the exported .csv/.npy/.npz files, the reports of the disk writer, the recorder (also
+/// with a file that cannot be written), the retention and the detection of the changes of the derived data of a cup
+/// between the frames. The files are made in a temporary directory, which is
+/// deleted at the end. The program returns 0 if all the checks have passed.
+
+#include <algorithm>
+#include <ctime>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <zlib.h>
+
+#include "../source/config.h"
+#include "../source/recording_format.h"
+#include "../source/chunk_codec.h"
+#include "../source/recording_reader.h"
+#include "../source/summary_pyramid.h"
+#include "../source/recording_export.h"
+#include "../source/current_conversion.h"
+#include "../source/settings_file.h"
+#include "../source/history_buffer.h"
+#include "../source/disk_writer.h"
+#include "../source/recorder.h"
+#include "../source/retention.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define TEST_DIRECTORY_TEMPLATE			"/tmp/recording_tests_XXXXXX"
+#define TEST_FRAME_PERIOD				10000000LL	// ns
+#define TEST_CHUNK_FRAMES				100
+#define TEST_CHUNKS_NUMBER				10
+#define TEST_EXPORT_FRAMES				1500
+#define TEST_EXPORT_START_TEXT			"2026-01-01_00:00:10"	// the first frame of the exported recording
+#define TEST_EXPORT_END_TEXT			"2026-01-01_01:00:00"
+#define TEST_DIRECTIONAL_COEFFICIENT	0.5
+#define TEST_OFFSET_FOR_ZERO_CURRENT	(-1000)
+#define TEST_DIAGNOSTIC_GAIN			2.0
+#define TEST_DIAGNOSTIC_OFFSET			1.0
+#define TEST_CANARY_BYTE				0xA5
+#define TEST_IDLE_TIMEOUT				5000		// milliseconds; the longest wait for the disk writer
+#define TEST_RECORDER_FRAMES			3000
+#define TEST_HISTORY_CAPACITY			8192		// more than the frames of both runs of the recorder
+#define TEST_FILE_SIZE_LIMIT			30000		// bytes; the failing run of the recorder
+#define TEST_OLD_RECORDING_AGE			(40*86400)	// s
+
+//.................................................................................................
+// Global variables
+//.................................................................................................
+
+/// The variables of main.cpp used by the tested modules
+bool VerboseMode;
+bool VeryVerboseMode;
+int StatusLevelForGui;
+bool ShowStatisticsInDiscs;
+int ShownStatisticsWindow;
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+static int ChecksNumber;
+static int FailuresNumber;
+
+static std::string TestDirectory;
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static void check( bool Condition, const char * DescriptionPtr );
+
+static void makeFrames( std::vector<RecordedFrame> * FramesPtr, int FramesNumber, int64_t FirstTime );
+
+static size_t buildChunk( const RecordedFrame * FramesPtr, int FramesNumber, std::vector<uint8_t> * ChunkPtr );
+
+static void writeRecording( const std::string & FilePath, const std::vector<RecordedFrame> & Frames,
+		std::vector<ChunkIndexEntry> * EntriesPtr );
+
+static void writeFile( const std::string & FilePath, const void * DataPtr, size_t Size );
+
+static std::vector<uint8_t> readFile( const std::string & FilePath );
+
+static uint64_t getLittleEndian( const uint8_t * BytesPtr, int BytesNumber );
+
+static bool countFrames( const RecordedFrame * FramesPtr, int FramesNumber, void * ContextPtr );
+
+static bool waitForIdleDiskWriter(void);
+
+static std::vector<std::string> listRecordingFiles( const std::string & DirectoryPath );
+
+static uint64_t countSummaryReadouts( const std::string & RecordingFilePath );
+
+static bool isFilePresent( const std::string & FilePath );
+
+static void testChunkCodec(void);
+
+static void testRecordingIndex(void);
+
+static void testFindRecordingChunk(void);
+
+static void testClockSetBack(void);
+
+static void testSummaryPyramid(void);
+
+static void testRecordingSummaries(void);
+
+static void testExportLayout(void);
+
+static void testDiskWriter(void);
+
+static void testRecorder(void);
+
+static void runRecorder( uint64_t * FirstFrameNumberPtr );
+
+static void testRetention(void);
+
+static void testChangeDetection(void);
+
+static void deleteTestDirectory(void);
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+int main(void){
+	char DirectoryName[] = TEST_DIRECTORY_TEMPLATE;
+	if (nullptr == mkdtemp( DirectoryName )){
+		printf( "Nie można utworzyć katalogu testów\n" );
+		return 1;
+	}
+	TestDirectory = DirectoryName;
+	for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+		snprintf( CupDescriptionPtr[Cup], sizeof(CupDescriptionPtr[Cup]), "Kubek %d", Cup+1 );
+		CalibrationModel[Cup] = CalibrationModels::LINEAR;
+		DirectionalCoefficient[Cup] = TEST_DIRECTIONAL_COEFFICIENT;
+		OffsetForZeroCurrent[Cup] = TEST_OFFSET_FOR_ZERO_CURRENT;
+		ZeroShift[Cup] = 0.0;
+		for (int Channel=0; Channel < DIAGNOSTIC_VALUES_PER_DISC; Channel++){
+			DiagnosticGain[Cup][Channel] = TEST_DIAGNOSTIC_GAIN;
+			DiagnosticOffset[Cup][Channel] = TEST_DIAGNOSTIC_OFFSET;
+		}
+	}
+	TransmissionSmoothing = TRANSMISSION_SMOOTHING_DEFAULT;
+	buildConversionTables();
+
+	testChunkCodec();
+	testRecordingIndex();
+	testFindRecordingChunk();
+	testClockSetBack();
+	testSummaryPyramid();
+	testRecordingSummaries();
+	testExportLayout();
+	testDiskWriter();
+	diskWriterStart();
+	testRecorder();
+	testRetention();
+	diskWriterExit();
+	testChangeDetection();
+
+	deleteTestDirectory();
+	printf( "Sprawdzeń: %d, błędów: %d\n", ChecksNumber, FailuresNumber );
+	return (0 == FailuresNumber)? 0 : 1;
+}
+
+static void check( bool Condition, const char * DescriptionPtr ){
+	ChecksNumber++;
+	if (!Condition){
+		FailuresNumber++;
+		printf( "BŁĄD: %s\n", DescriptionPtr );
+	}
+}
+
+/// The frames change as the acquired ones do: small steps of the registers with an occasional jump and "N/A",
+/// the coils and the quality flags in runs
+static void makeFrames( std::vector<RecordedFrame> * FramesPtr, int FramesNumber, int64_t FirstTime ){
+	FramesPtr->resize( FramesNumber );
+	for (int J=0; J < FramesNumber; J++){
+		RecordedFrame * FramePtr = &(*FramesPtr)[J];
+		memset( FramePtr, 0, sizeof(RecordedFrame) );
+		FramePtr->RegistersTime = FirstTime + J*TEST_FRAME_PERIOD + (J % 3)*1000;
+		FramePtr->CoilsTime = FramePtr->RegistersTime + 2000000;
+		FramePtr->FrameNumber = 1 + J;
+		for (int K=0; K < MODBUS_INPUTS_NUMBER; K++){
+			FramePtr->InputRegisters[K] = (uint16_t)(1000 + 10*K + J % 50);
+		}
+		if (0 == J % 97){
+			FramePtr->InputRegisters[0] = 0x8000;
+			FramePtr->InputRegisters[1] = 0xFFFF;
+		}
+		FramePtr->Coils = (uint16_t)((J / 40) & ((1u << MODBUS_COILS_NUMBER) - 1));
+		FramePtr->QualityFlags = (0 == J % 4)? 0x1F : 0x0F;
+	}
+}
+
+/// The chunk is made as by the recorder: COMPRESSED, unless the encoding is not shorter than the RAW frames
+/// @return the size of the chunk (the header and the payload)
+static size_t buildChunk( const RecordedFrame * FramesPtr, int FramesNumber, std::vector<uint8_t> * ChunkPtr ){
+	ChunkPtr->assign( sizeof(RecordingChunkHeader) + CHUNK_ENCODED_SIZE_MAX, 0 );
+	uint8_t * PayloadPtr = ChunkPtr->data() + sizeof(RecordingChunkHeader);
+	uint32_t StreamSizes[CHUNK_STREAMS_NUMBER];
+	size_t RawSize = FramesNumber * sizeof(RecordedFrame);
+	size_t EncodedSize = encodeChunk( FramesPtr, FramesNumber, FramesPtr[0].RegistersTime, PayloadPtr, StreamSizes );
+	bool IsCompressed = (EncodedSize < RawSize);
+	if (!IsCompressed){
+		memcpy( PayloadPtr, FramesPtr, RawSize );
+	}
+
+	RecordingChunkHeader Header;
+	memset( &Header, 0, sizeof(Header) );
+	Header.Magic = RECORDING_CHUNK_MAGIC;
+	Header.Encoding = IsCompressed? ChunkEncodings::COMPRESSED : ChunkEncodings::RAW;
+	Header.FramesNumber = (uint16_t)FramesNumber;
+	Header.PayloadSize = (uint32_t)(IsCompressed? EncodedSize : RawSize);
+	Header.PayloadChecksum = computeRecordingChecksum( PayloadPtr, Header.PayloadSize );
+	Header.FirstTime = FramesPtr[0].RegistersTime;
+	Header.LastTime = FramesPtr[FramesNumber-1].RegistersTime;
+	Header.FirstFrameNumber = FramesPtr[0].FrameNumber;
+	Header.HeaderChecksum = computeRecordingChecksum( &Header, offsetof(RecordingChunkHeader, HeaderChecksum) );
+	memcpy( ChunkPtr->data(), &Header, sizeof(Header) );
+	ChunkPtr->resize( sizeof(RecordingChunkHeader) + Header.PayloadSize );
+	return ChunkPtr->size();
+}
+
+/// The frames are written in chunks of TEST_CHUNK_FRAMES; the index is not written
+/// @param EntriesPtr the index entries of the chunks
+static void writeRecording( const std::string & FilePath, const std::vector<RecordedFrame> & Frames,
+		std::vector<ChunkIndexEntry> * EntriesPtr )
+{
+	std::vector<uint8_t> Data( sizeof(RecordingFileHeader) );
+	initializeRecordingFileHeader( reinterpret_cast<RecordingFileHeader *>(Data.data()), Frames[0].RegistersTime );
+	EntriesPtr->clear();
+	for (size_t First=0; First < Frames.size(); First += TEST_CHUNK_FRAMES){
+		int FramesNumber = (int)std::min<size_t>( TEST_CHUNK_FRAMES, Frames.size() - First );
+		std::vector<uint8_t> Chunk;
+		buildChunk( &Frames[First], FramesNumber, &Chunk );
+		ChunkIndexEntry Entry;
+		Entry.FirstTime = Frames[First].RegistersTime;
+		Entry.LastTime = Frames[First + FramesNumber - 1].RegistersTime;
+		Entry.Offset = Data.size();
+		EntriesPtr->push_back( Entry );
+		Data.insert( Data.end(), Chunk.begin(), Chunk.end() );
+	}
+	writeFile( FilePath, Data.data(), Data.size() );
+}
+
+static void writeFile( const std::string & FilePath, const void * DataPtr, size_t Size ){
+	FILE * FilePtr = fopen( FilePath.c_str(), "wb" );
+	if (nullptr == FilePtr){
+		check( false, ("nie można utworzyć pliku " + FilePath).c_str() );
+		return;
+	}
+	fwrite( DataPtr, 1, Size, FilePtr );
+	fclose( FilePtr );
+}
+
+/// @return empty if the file cannot be read
+static std::vector<uint8_t> readFile( const std::string & FilePath ){
+	std::vector<uint8_t> Data;
+	FILE * FilePtr = fopen( FilePath.c_str(), "rb" );
+	if (nullptr == FilePtr){
+		return Data;
+	}
+	uint8_t Buffer[65536];
+	size_t Size;
+	while ((Size = fread( Buffer, 1, sizeof(Buffer), FilePtr )) > 0){
+		Data.insert( Data.end(), Buffer, Buffer + Size );
+	}
+	fclose( FilePtr );
+	return Data;
+}
+
+static uint64_t getLittleEndian( const uint8_t * BytesPtr, int BytesNumber ){
+	uint64_t Value = 0;
+	for (int J = BytesNumber-1; J >= 0; J--){
+		Value = (Value << 8) | BytesPtr[J];
+	}
+	return Value;
+}
+
+static bool countFrames( const RecordedFrame * FramesPtr, int FramesNumber, void * ContextPtr ){
+	(void)FramesPtr; // intentionally unused
+	*static_cast<uint64_t *>(ContextPtr) += FramesNumber;
+	return true;
+}
+
+/// @return false if the disk writer has not finished its requests within TEST_IDLE_TIMEOUT
+static bool waitForIdleDiskWriter(void){
+	for (int J=0; J < TEST_IDLE_TIMEOUT / PERIPHERAL_THREAD_LOOP_DURATION; J++){
+		if (isDiskWriterIdle()){
+			return true;
+		}
+		std::this_thread::sleep_for( std::chrono::milliseconds( PERIPHERAL_THREAD_LOOP_DURATION ));
+	}
+	return false;
+}
+
+/// @return the paths of the .rec files, in the order of time
+static std::vector<std::string> listRecordingFiles( const std::string & DirectoryPath ){
+	std::vector<std::string> FilePaths;
+	DIR * DirectoryPtr = opendir( DirectoryPath.c_str() );
+	if (nullptr == DirectoryPtr){
+		return FilePaths;
+	}
+	size_t ExtensionLength = sizeof(RECORDING_FILE_EXTENSION) - 1;
+	while (struct dirent * EntryPtr = readdir( DirectoryPtr )){
+		std::string Name = EntryPtr->d_name;
+		if ((Name.size() > ExtensionLength) && (0 == Name.compare( Name.size() - ExtensionLength, ExtensionLength,
+				RECORDING_FILE_EXTENSION )))
+		{
+			FilePaths.push_back( DirectoryPath + "/" + Name );
+		}
+	}
+	closedir( DirectoryPtr );
+	std::sort( FilePaths.begin(), FilePaths.end() );
+	return FilePaths;
+}
+
+/// @return the readouts of the registers in the 1 s tiles of the recording
+static uint64_t countSummaryReadouts( const std::string & RecordingFilePath ){
+	std::vector<uint8_t> Data = readFile( getSummaryFilePath( RecordingFilePath, 0 ) );
+	const SummaryTile * TilesPtr = reinterpret_cast<const SummaryTile *>(Data.data());
+	uint64_t ReadoutsNumber = 0;
+	for (size_t J=0; J < Data.size() / sizeof(SummaryTile); J++){
+		ReadoutsNumber += TilesPtr[J].ReadoutsNumber;
+	}
+	return ReadoutsNumber;
+}
+
+static bool isFilePresent( const std::string & FilePath ){
+	struct stat Status;
+	return (0 == stat( FilePath.c_str(), &Status ));
+}
+
+/// The decoded frames must equal the encoded ones byte for byte (the padding is zeroed by both sides);
+/// a damaged payload must be rejected, neither read nor decoded out of its bounds (see also make test-sanitize)
+static void testChunkCodec(void){
+	std::vector<RecordedFrame> Frames;
+	std::vector<RecordedFrame> Decoded( RECORDING_CHUNK_FRAMES_MAX );
+	std::vector<uint8_t> Chunk;
+	RecordingChunkHeader Header;
+	const int FramesNumbers[] = { 1, 2, 333, RECORDING_CHUNK_FRAMES_MAX };
+	for (int FramesNumber : FramesNumbers){
+		makeFrames( &Frames, FramesNumber, 1767222000000000000LL );
+		if (FramesNumber > 2){
+			Frames[FramesNumber/2].RegistersTime -= 3000000000LL;	// the clock set back
+			Frames[FramesNumber/2].FrameNumber += 1000000;
+		}
+		buildChunk( Frames.data(), FramesNumber, &Chunk );
+		memcpy( &Header, Chunk.data(), sizeof(Header) );
+		check( isChunkHeaderValid( &Header ), "nagłówek porcji jest niepoprawny" );
+		check( decodeChunk( &Header, Chunk.data() + sizeof(Header), Decoded.data() ) &&
+				(0 == memcmp( Frames.data(), Decoded.data(), FramesNumber*sizeof(RecordedFrame) )),
+				"odczytane ramki różnią się od zapisanych" );
+	}
+
+	makeFrames( &Frames, 500, 1767222000000000000LL );
+	buildChunk( Frames.data(), 500, &Chunk );
+	memcpy( &Header, Chunk.data(), sizeof(Header) );
+	check( ChunkEncodings::COMPRESSED == Header.Encoding, "porcja nie została skompresowana" );
+	uint8_t * PayloadPtr = Chunk.data() + sizeof(Header);
+
+	RecordingChunkHeader DamagedHeader = Header;
+	DamagedHeader.PayloadSize--;
+	check( !decodeChunk( &DamagedHeader, PayloadPtr, Decoded.data() ), "przyjęto skróconą porcję" );
+
+	std::vector<uint8_t> Payload( PayloadPtr, PayloadPtr + Header.PayloadSize );
+	uint32_t StreamSize;
+	memcpy( &StreamSize, Payload.data(), sizeof(StreamSize) );
+	StreamSize++;
+	memcpy( Payload.data(), &StreamSize, sizeof(StreamSize) );
+	check( !decodeChunk( &Header, Payload.data(), Decoded.data() ), "przyjęto niezgodne rozmiary strumieni" );
+
+	// the last byte of the stream of the times continues the varint beyond the stream
+	Payload.assign( PayloadPtr, PayloadPtr + Header.PayloadSize );
+	Payload[CHUNK_STREAMS_NUMBER*sizeof(uint32_t) + StreamSize - 2] |= 0x80;
+	check( !decodeChunk( &Header, Payload.data(), Decoded.data() ), "przyjęto urwaną liczbę strumienia czasu" );
+
+	DamagedHeader = Header;
+	DamagedHeader.Encoding = ChunkEncodings::RAW;
+	check( !decodeChunk( &DamagedHeader, PayloadPtr, Decoded.data() ), "przyjęto porcję RAW o złym rozmiarze" );
+
+	DamagedHeader = Header;
+	DamagedHeader.FramesNumber = RECORDING_CHUNK_FRAMES_MAX + 1;
+	DamagedHeader.HeaderChecksum = computeRecordingChecksum( &DamagedHeader, offsetof(RecordingChunkHeader, HeaderChecksum) );
+	check( !isChunkHeaderValid( &DamagedHeader ), "przyjęto porcję o zbyt wielu ramkach" );
+
+	// the fuzzed payload ends at a page without access, and the frames beyond the chunk hold a pattern:
+	// a read beyond the payload stops the tests, a write beyond the frames of the chunk changes the pattern
+	size_t PageSize = (size_t)sysconf( _SC_PAGESIZE );
+	size_t PayloadPagesSize = (Header.PayloadSize + PageSize - 1) / PageSize * PageSize;
+	void * MappingPtr = mmap( nullptr, PayloadPagesSize + PageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if (MAP_FAILED == MappingPtr){
+		check( false, "nie można przygotować pamięci porcji" );
+		return;
+	}
+	mprotect( static_cast<uint8_t *>(MappingPtr) + PayloadPagesSize, PageSize, PROT_NONE );
+	uint8_t * FuzzedPtr = static_cast<uint8_t *>(MappingPtr) + PayloadPagesSize - Header.PayloadSize;
+	size_t TailSize = (RECORDING_CHUNK_FRAMES_MAX - Header.FramesNumber)*sizeof(RecordedFrame);
+	memset( &Decoded[Header.FramesNumber], TEST_CANARY_BYTE, TailSize );
+	srand( 1 );
+	int AcceptedNumber = 0;
+	for (int J=0; J < 2000; J++){
+		memcpy( FuzzedPtr, PayloadPtr, Header.PayloadSize );
+		for (int K = 1 + rand() % 4; K > 0; K--){
+			FuzzedPtr[rand() % Header.PayloadSize] ^= (uint8_t)(1 + rand() % 255);
+		}
+		if (decodeChunk( &Header, FuzzedPtr, Decoded.data() )){
+			AcceptedNumber++;
+		}
+	}
+	const uint8_t * TailPtr = reinterpret_cast<const uint8_t *>(&Decoded[Header.FramesNumber]);
+	bool IsTailIntact = true;
+	for (size_t J=0; J < TailSize; J++){
+		IsTailIntact = IsTailIntact && (TEST_CANARY_BYTE == TailPtr[J]);
+	}
+	check( IsTailIntact, "uszkodzona porcja zapisała ramki poza swoją liczbą ramek" );
+	check( AcceptedNumber < 2000, "przyjęto wszystkie uszkodzone porcje" );
+	munmap( MappingPtr, PayloadPagesSize + PageSize );
+}
+
+/// The index is trusted only as far as it matches the file; the rest of the chunks are found by reading the file
+static void testRecordingIndex(void){
+	std::string FilePath = TestDirectory + "/" RECORDING_FILE_PREFIX "2026-01-01_00-00-00" RECORDING_FILE_EXTENSION;
+	std::string IndexFilePath = getRecordingSidecarPath( FilePath, RECORDING_INDEX_EXTENSION );
+	std::vector<RecordedFrame> Frames;
+	std::vector<ChunkIndexEntry> Entries;
+	makeFrames( &Frames, TEST_CHUNKS_NUMBER*TEST_CHUNK_FRAMES, 1767222000000000000LL );
+	writeRecording( FilePath, Frames, &Entries );
+	RecordingReader Reader{};
+	uint64_t FramesNumber;
+
+	writeFile( IndexFilePath, Entries.data(), Entries.size()*sizeof(ChunkIndexEntry) );
+	check( openRecording( FilePath, &Reader ), "nie można otworzyć zapisu" );
+	check( (TEST_CHUNKS_NUMBER == getRecordingChunksNumber( &Reader )) && (TEST_CHUNKS_NUMBER == Reader.IndexEntriesNumber),
+			"pełny indeks: zła liczba porcji" );
+	closeRecording( &Reader );
+
+	writeFile( IndexFilePath, Entries.data(), 4*sizeof(ChunkIndexEntry) + sizeof(ChunkIndexEntry)/2 );
+	check( openRecording( FilePath, &Reader ), "nie można otworzyć zapisu" );
+	check( (TEST_CHUNKS_NUMBER == getRecordingChunksNumber( &Reader )) && (4 == Reader.IndexEntriesNumber),
+			"skrócony indeks: zła liczba porcji" );
+	FramesNumber = 0;
+	readRecordingRange( &Reader, INT64_MIN, INT64_MAX, countFrames, &FramesNumber );
+	check( Frames.size() == FramesNumber, "skrócony indeks: zła liczba ramek" );
+	closeRecording( &Reader );
+
+	// an entry in the middle of the index points back; the index is trusted up to it
+	std::vector<ChunkIndexEntry> BrokenEntries = Entries;
+	BrokenEntries[3].Offset = BrokenEntries[1].Offset;
+	writeFile( IndexFilePath, BrokenEntries.data(), BrokenEntries.size()*sizeof(ChunkIndexEntry) );
+	check( openRecording( FilePath, &Reader ), "nie można otworzyć zapisu" );
+	check( (TEST_CHUNKS_NUMBER == getRecordingChunksNumber( &Reader )) && (3 == Reader.IndexEntriesNumber),
+			"błędny wpis indeksu: zła liczba porcji" );
+	closeRecording( &Reader );
+
+	unlink( IndexFilePath.c_str() );
+	check( openRecording( FilePath, &Reader ), "nie można otworzyć zapisu bez indeksu" );
+	check( (TEST_CHUNKS_NUMBER == getRecordingChunksNumber( &Reader )) && (nullptr == Reader.IndexPtr),
+			"brak indeksu: zła liczba porcji" );
+	closeRecording( &Reader );
+
+	// the index of the whole file, the file cut in the middle of the chunk 6 (e.g. a crash before the synchronisation)
+	std::vector<ChunkIndexEntry> StaleEntries = Entries;
+	StaleEntries.push_back( Entries.back() );		// out of the order
+	writeFile( IndexFilePath, StaleEntries.data(), StaleEntries.size()*sizeof(ChunkIndexEntry) );
+	std::vector<uint8_t> Data = readFile( FilePath );
+	writeFile( FilePath, Data.data(), Entries[6].Offset + 40 );
+	check( openRecording( FilePath, &Reader ), "nie można otworzyć uciętego zapisu" );
+	check( (6 == getRecordingChunksNumber( &Reader )) && (6 == Reader.IndexEntriesNumber) && Reader.TailEntries.empty(),
+			"nieaktualny indeks: zła liczba porcji" );
+	FramesNumber = 0;
+	readRecordingRange( &Reader, INT64_MIN, INT64_MAX, countFrames, &FramesNumber );
+	check( (6*TEST_CHUNK_FRAMES == FramesNumber) && (0 == Reader.DamagedChunksNumber), "nieaktualny indeks: zła liczba ramek" );
+	closeRecording( &Reader );
+
+	// a damaged payload: the chunk is skipped, the next ones are read
+	Data[Entries[3].Offset + sizeof(RecordingChunkHeader) + 5] ^= 0x55;
+	writeFile( FilePath, Data.data(), Data.size() );
+	check( openRecording( FilePath, &Reader ), "nie można otworzyć uszkodzonego zapisu" );
+	check( -1 == readRecordingChunk( &Reader, 3 ), "przyjęto uszkodzoną porcję" );
+	FramesNumber = 0;
+	readRecordingRange( &Reader, INT64_MIN, INT64_MAX, countFrames, &FramesNumber );
+	check( (Frames.size() - TEST_CHUNK_FRAMES == FramesNumber) && (2 == Reader.DamagedChunksNumber),
+			"uszkodzona porcja: zła liczba ramek" );
+	closeRecording( &Reader );
+
+	Data[0] ^= 0x01;
+	writeFile( FilePath, Data.data(), Data.size() );
+	check( !openRecording( FilePath, &Reader ), "przyjęto plik o złym nagłówku" );
+	unlink( FilePath.c_str() );
+	unlink( IndexFilePath.c_str() );
+}
+
+/// The first chunk ending at or after the time; the range [start; end) of readRecordingRange()
+static void testFindRecordingChunk(void){
+	std::string FilePath = TestDirectory + "/" RECORDING_FILE_PREFIX "2026-01-01_00-00-01" RECORDING_FILE_EXTENSION;
+	std::vector<RecordedFrame> Frames;
+	std::vector<ChunkIndexEntry> Entries;
+	makeFrames( &Frames, TEST_CHUNKS_NUMBER*TEST_CHUNK_FRAMES, 1767222000000000000LL );
+	writeRecording( FilePath, Frames, &Entries );
+	writeFile( getRecordingSidecarPath( FilePath, RECORDING_INDEX_EXTENSION ), Entries.data(), 5*sizeof(ChunkIndexEntry) );
+	RecordingReader Reader{};
+	check( openRecording( FilePath, &Reader ), "nie można otworzyć zapisu" );
+
+	check( 0 == findRecordingChunk( &Reader, INT64_MIN ), "czas przed zapisem: zła porcja" );
+	check( 0 == findRecordingChunk( &Reader, Entries[0].FirstTime ), "początek zapisu: zła porcja" );
+	bool IsFound = true;
+	for (int J=0; J < TEST_CHUNKS_NUMBER; J++){
+		IsFound = IsFound && ((size_t)J == findRecordingChunk( &Reader, Entries[J].LastTime )) &&
+				((size_t)J+1 == findRecordingChunk( &Reader, Entries[J].LastTime + 1 ));
+	}
+	check( IsFound, "koniec porcji: zła porcja (w indeksie i poza nim)" );
+	check( TEST_CHUNKS_NUMBER == findRecordingChunk( &Reader, INT64_MAX ), "czas po zapisie: zła porcja" );
+
+	uint64_t FramesNumber = 0;
+	readRecordingRange( &Reader, Frames[150].RegistersTime, Frames[250].RegistersTime, countFrames, &FramesNumber );
+	check( 100 == FramesNumber, "przedział [początek; koniec): zła liczba ramek" );
+	FramesNumber = 0;
+	readRecordingRange( &Reader, Frames[150].RegistersTime, Frames[150].RegistersTime, countFrames, &FramesNumber );
+	check( 0 == FramesNumber, "pusty przedział: ramki" );
+	closeRecording( &Reader );
+
+	// a recording without chunks
+	writeRecording( FilePath, std::vector<RecordedFrame>( 1, Frames[0] ), &Entries );
+	std::vector<uint8_t> Data = readFile( FilePath );
+	writeFile( FilePath, Data.data(), sizeof(RecordingFileHeader) );
+	unlink( getRecordingSidecarPath( FilePath, RECORDING_INDEX_EXTENSION ).c_str() );
+	check( openRecording( FilePath, &Reader ), "nie można otworzyć pustego zapisu" );
+	check( (0 == getRecordingChunksNumber( &Reader )) && (0 == findRecordingChunk( &Reader, 0 )), "pusty zapis: porcje" );
+	closeRecording( &Reader );
+	unlink( FilePath.c_str() );
+}
+
+/// The clock set back by 3 s in the middle of the chunk 5: the chunks are scanned one by one and a range gets
+/// the frames from before and after the change of the clock
+static void testClockSetBack(void){
+	std::string FilePath = TestDirectory + "/" RECORDING_FILE_PREFIX "2026-01-01_00-00-03" RECORDING_FILE_EXTENSION;
+	std::string IndexFilePath = getRecordingSidecarPath( FilePath, RECORDING_INDEX_EXTENSION );
+	std::vector<RecordedFrame> Frames;
+	std::vector<ChunkIndexEntry> Entries;
+	makeFrames( &Frames, TEST_CHUNKS_NUMBER*TEST_CHUNK_FRAMES, 1767222000000000000LL );
+	for (size_t J=550; J < Frames.size(); J++){
+		Frames[J].RegistersTime -= 3000000000LL;
+		Frames[J].CoilsTime -= 3000000000LL;
+	}
+	writeRecording( FilePath, Frames, &Entries );
+	writeFile( IndexFilePath, Entries.data(), Entries.size()*sizeof(ChunkIndexEntry) );
+	RecordingReader Reader{};
+	check( openRecording( FilePath, &Reader ), "nie można otworzyć zapisu" );
+	check( !Reader.IsTimeOrdered, "cofnięty zegar: przyjęto porządek czasu porcji" );
+	check( 4 == findRecordingChunk( &Reader, Frames[700].RegistersTime ), "cofnięty zegar: zła porcja" );
+
+	// [4 s; 5 s): the frames 400 ... 499 and, after the change of the clock, 700 ... 799
+	std::vector<uint64_t> FrameNumbers;
+	readRecordingRange( &Reader, Frames[700].RegistersTime, Frames[800].RegistersTime,
+			[]( const RecordedFrame * FramesPtr, int FramesNumber, void * ContextPtr ){
+				for (int J=0; J < FramesNumber; J++){
+					static_cast<std::vector<uint64_t> *>(ContextPtr)->push_back( FramesPtr[J].FrameNumber );
+				}
+				return true;
+			}, &FrameNumbers );
+	bool IsRangeValid = (200 == FrameNumbers.size());
+	for (size_t J=0; IsRangeValid && (J < FrameNumbers.size()); J++){
+		IsRangeValid = (FrameNumbers[J] == ((J < 100)? 401 + J : 601 + J));
+	}
+	check( IsRangeValid, "cofnięty zegar: złe ramki przedziału" );
+
+	uint64_t FramesNumber = 0;
+	readRecordingRange( &Reader, INT64_MIN, INT64_MAX, countFrames, &FramesNumber );
+	check( Frames.size() == FramesNumber, "cofnięty zegar: zła liczba ramek" );
+	closeRecording( &Reader );
+	unlink( FilePath.c_str() );
+	unlink( IndexFilePath.c_str() );
+}
+
+/// The merges of the tiles, the levels built from the frames and the levels made up from the level below
+static void testSummaryPyramid(void){
+	SummaryTile Tiles[2];
+	memset( Tiles, 0, sizeof(Tiles) );
+	for (int K=0; K < MODBUS_INPUTS_NUMBER; K++){
+		Tiles[0].Minimum[K] = 5;
+		Tiles[0].Maximum[K] = 10;
+		Tiles[0].Mean[K] = 7.0f;
+		Tiles[1].Minimum[K] = 3;
+		Tiles[1].Maximum[K] = 8;
+		Tiles[1].Mean[K] = 3.0f;
+	}
+	Tiles[0].ReadoutsNumber = 2;
+	Tiles[1].ReadoutsNumber = 6;
+	Tiles[0].CoilsReadoutsNumber = 1;
+	Tiles[0].CoilsAny = 0x3;
+	Tiles[0].CoilsAll = 0x1;
+	Tiles[1].CoilsReadoutsNumber = 3;
+	Tiles[1].CoilsAny = 0x4;
+	Tiles[1].CoilsAll = 0x4;
+	SummaryTile Merged = Tiles[0];
+	mergeSummaryTile( &Merged, &Tiles[1] );
+	check( (3 == Merged.Minimum[0]) && (10 == Merged.Maximum[0]) && (4.0f == Merged.Mean[0]) && (8 == Merged.ReadoutsNumber),
+			"łączenie kafli: rejestry" );
+	check( (0x7 == Merged.CoilsAny) && (0 == Merged.CoilsAll) && (4 == Merged.CoilsReadoutsNumber), "łączenie kafli: cewki" );
+	SummaryTile Empty;
+	memset( &Empty, 0, sizeof(Empty) );
+	Merged = Tiles[1];
+	mergeSummaryTile( &Merged, &Empty );
+	check( 0 == memcmp( &Merged, &Tiles[1], sizeof(SummaryTile) ), "łączenie z pustym kaflem zmienia kafel" );
+	mergeSummaryTile( &Empty, &Tiles[1] );
+	check( (3 == Empty.Minimum[0]) && (3.0f == Empty.Mean[0]) && (6 == Empty.ReadoutsNumber) && (0x4 == Empty.CoilsAll),
+			"łączenie do pustego kafla" );
+
+	// 20 s of frames from a multiple of the width of the level 2; the registers of each second are 0 ... 99 + second
+	std::string FilePath = TestDirectory + "/" RECORDING_FILE_PREFIX "2026-01-01_00-00-02" RECORDING_FILE_EXTENSION;
+	int64_t StartTime = 1767222000000000000LL - 1767222000000000000LL % getSummaryTileWidth( 2 );
+	SummaryPyramid * PyramidPtr = new SummaryPyramid();
+	PyramidPtr->IsWrittenDirectly = true;
+	check( openSummaryPyramid( PyramidPtr, FilePath ), "nie można utworzyć podsumowań" );
+	RecordedFrame Frame;
+	memset( &Frame, 0, sizeof(Frame) );
+	for (int J=0; J < 2000; J++){
+		Frame.RegistersTime = StartTime + J*TEST_FRAME_PERIOD;
+		Frame.FrameNumber = J;
+		for (int K=0; K < MODBUS_INPUTS_NUMBER; K++){
+			Frame.InputRegisters[K] = (uint16_t)(J % 100 + J / 100);
+		}
+		Frame.Coils = (uint16_t)((J / 100) & 1);
+		Frame.QualityFlags = 0x0F;
+		addFrameToSummaryPyramid( PyramidPtr, &Frame );
+		if (99 == J % 100){
+			flushSummaryPyramid( PyramidPtr, false );
+		}
+	}
+	flushSummaryPyramid( PyramidPtr, true );
+	check( commitSummaryPyramid( PyramidPtr, FilePath ), "nie można zatwierdzić podsumowań" );
+
+	SummaryTile Read[20];
+	int64_t TileWidth;
+	int TilesNumber = readSummaryTiles( FilePath, StartTime, StartTime + 20*SUMMARY_BASE_TILE_WIDTH, 20, Read, &TileWidth );
+	bool IsCorrect = (20 == TilesNumber) && (SUMMARY_BASE_TILE_WIDTH == TileWidth);
+	for (int J=0; IsCorrect && (J < TilesNumber); J++){
+		IsCorrect = (100 == Read[J].ReadoutsNumber) && (J == Read[J].Minimum[0]) && (99 + J == Read[J].Maximum[0]) &&
+				(49.5f + J == Read[J].Mean[0]) && ((J & 1) == Read[J].CoilsAll) && (StartTime + J*TileWidth == Read[J].StartTime);
+	}
+	check( IsCorrect, "poziom 0: złe kafle" );
+
+	// the level 1: the last tile (16 ... 20 s) is made up by the closing of the file
+	for (int Pass=0; Pass < 2; Pass++){
+		TilesNumber = readSummaryTiles( FilePath, StartTime, StartTime + 20*SUMMARY_BASE_TILE_WIDTH, 3, Read, &TileWidth );
+		IsCorrect = (3 == TilesNumber) && (getSummaryTileWidth( 1 ) == TileWidth) && (800 == Read[0].ReadoutsNumber) &&
+				(800 == Read[1].ReadoutsNumber) && (400 == Read[2].ReadoutsNumber) && (0 == Read[0].Minimum[0]) &&
+				(118 == Read[2].Maximum[0]) && (fabsf( Read[1].Mean[0] - (49.5f + 11.5f) ) < 1.0e-4f) && (0 == Read[0].CoilsAll) &&
+				(1 == Read[0].CoilsAny);
+		check( IsCorrect, (0 == Pass)? "poziom 1: złe kafle" : "poziom 1 odtworzony z poziomu 0: złe kafle" );
+		unlink( getSummaryFilePath( FilePath, 1 ).c_str() );
+	}
+	delete PyramidPtr;
+
+	// the clock set back by 3 s: the start times in the files must grow, and no frame may be lost
+	PyramidPtr = new SummaryPyramid();
+	PyramidPtr->IsWrittenDirectly = true;
+	check( openSummaryPyramid( PyramidPtr, FilePath ), "nie można utworzyć podsumowań" );
+	for (int J=0; J < 2000; J++){
+		Frame.RegistersTime = StartTime + J*TEST_FRAME_PERIOD - ((J >= 1000)? 3000000000LL : 0);
+		addFrameToSummaryPyramid( PyramidPtr, &Frame );
+	}
+	flushSummaryPyramid( PyramidPtr, true );
+	check( commitSummaryPyramid( PyramidPtr, FilePath ), "nie można zatwierdzić podsumowań" );
+	delete PyramidPtr;
+	for (int Level=0; Level < SUMMARY_LEVELS_NUMBER; Level++){
+		std::vector<uint8_t> Data = readFile( getSummaryFilePath( FilePath, Level ) );
+		const SummaryTile * FileTilesPtr = reinterpret_cast<const SummaryTile *>(Data.data());
+		size_t FileTilesNumber = Data.size() / sizeof(SummaryTile);
+		uint64_t ReadoutsNumber = 0;
+		IsCorrect = (0 == Data.size() % sizeof(SummaryTile));
+		for (size_t J=0; J < FileTilesNumber; J++){
+			IsCorrect = IsCorrect && ((0 == J) || (FileTilesPtr[J].StartTime > FileTilesPtr[J-1].StartTime));
+			ReadoutsNumber += FileTilesPtr[J].ReadoutsNumber;
+		}
+		check( IsCorrect && (2000 == ReadoutsNumber), "cofnięty zegar: kafle poziomu nie rosną albo zgubiono ramki" );
+		unlink( getSummaryFilePath( FilePath, Level ).c_str() );
+	}
+}
+
+/// Two recordings of 10 s each, the second one named a second after the last frame of the first one: the query
+/// of the directory joins the tiles that begin in one and end in the other, at the levels of the files and above them,
+/// and so does the export of the summaries
+static void testRecordingSummaries(void){
+	RecordingDirectory = TestDirectory + "/podsumowania";
+	mkdir( RecordingDirectory.c_str(), 0775 );
+	struct tm LocalTime;
+	memset( &LocalTime, 0, sizeof(LocalTime) );
+	strptime( TEST_EXPORT_START_TEXT, "%Y-%m-%d_%H:%M:%S", &LocalTime );
+	LocalTime.tm_isdst = -1;
+	int64_t StartTime = (int64_t)mktime( &LocalTime ) * 1000000000;
+	StartTime -= StartTime % getSummaryTileWidth( 2 );
+	RecordedFrame Frame;
+	memset( &Frame, 0, sizeof(Frame) );
+	Frame.QualityFlags = 0x0F;
+	for (int File=0; File < 2; File++){
+		int64_t FileStartTime = StartTime + File*10*SUMMARY_BASE_TILE_WIDTH;
+		time_t Seconds = (time_t)(FileStartTime / 1000000000);
+		localtime_r( &Seconds, &LocalTime );
+		char TimeText[40];
+		strftime( TimeText, sizeof(TimeText), "%Y-%m-%d_%H-%M-%S", &LocalTime );
+		std::string FilePath = RecordingDirectory + "/" RECORDING_FILE_PREFIX + TimeText + RECORDING_FILE_EXTENSION;
+		SummaryPyramid * PyramidPtr = new SummaryPyramid();
+		PyramidPtr->IsWrittenDirectly = true;
+		check( openSummaryPyramid( PyramidPtr, FilePath ), "nie można utworzyć podsumowań" );
+		for (int J=0; J < 1000; J++){
+			Frame.RegistersTime = FileStartTime + J*TEST_FRAME_PERIOD;
+			for (int K=0; K < MODBUS_INPUTS_NUMBER; K++){
+				Frame.InputRegisters[K] = (uint16_t)(1000*File + J % 100);
+			}
+			addFrameToSummaryPyramid( PyramidPtr, &Frame );
+		}
+		flushSummaryPyramid( PyramidPtr, true );
+		check( commitSummaryPyramid( PyramidPtr, FilePath ), "nie można zatwierdzić podsumowań" );
+		delete PyramidPtr;
+	}
+
+	SummaryTile Tiles[20];
+	int64_t TileWidth;
+	int TilesNumber = readRecordingSummaries( RecordingDirectory, StartTime, StartTime + 20*SUMMARY_BASE_TILE_WIDTH, 20, Tiles,
+			&TileWidth );
+	bool IsCorrect = (20 == TilesNumber) && (SUMMARY_BASE_TILE_WIDTH == TileWidth);
+	for (int J=0; IsCorrect && (J < TilesNumber); J++){
+		IsCorrect = (100 == Tiles[J].ReadoutsNumber) && ((J < 10)? 0 : 1000) == Tiles[J].Minimum[0];
+	}
+	check( IsCorrect, "podsumowanie katalogu: złe kafle poziomu 0" );
+	TilesNumber = readRecordingSummaries( RecordingDirectory, StartTime, StartTime + 20*SUMMARY_BASE_TILE_WIDTH, 3, Tiles,
+			&TileWidth );
+	check( (3 == TilesNumber) && (800 == Tiles[0].ReadoutsNumber) && (800 == Tiles[1].ReadoutsNumber) &&
+			(0 == Tiles[1].Minimum[0]) && (1099 == Tiles[1].Maximum[0]) && (fabsf( Tiles[1].Mean[0] - 799.5f ) < 1.0e-3f),
+			"podsumowanie katalogu: kafel z dwóch zapisów" );
+	int64_t YearWidth = 365*86400*SUMMARY_BASE_TILE_WIDTH;
+	TilesNumber = readRecordingSummaries( RecordingDirectory, StartTime - YearWidth, StartTime + YearWidth, 4, Tiles, &TileWidth );
+	uint64_t ReadoutsNumber = 0;
+	for (int J=0; J < TilesNumber; J++){
+		ReadoutsNumber += Tiles[J].ReadoutsNumber;
+	}
+	check( (TilesNumber <= 4) && (TileWidth > getSummaryTileWidth( SUMMARY_LEVELS_NUMBER-1 )) && (2000 == ReadoutsNumber),
+			"podsumowanie katalogu: kafle szersze od najwyższego poziomu" );
+
+	std::string CsvFilePath = TestDirectory + "/podsumowanie.csv";
+	check( FailureCodes::NO_FAILURE == runSummaryExport( TEST_EXPORT_START_TEXT, "2026-01-01_01:00:00", "3",
+			CsvFilePath.c_str() ), "eksport podsumowania nie powiódł się" );
+	std::vector<uint8_t> Data = readFile( CsvFilePath );
+	std::string Text( Data.begin(), Data.end() );
+	size_t LinesNumber = 0;
+	size_t FieldsNumber = 1;
+	for (char Character : Text){
+		if ('\n' == Character){
+			LinesNumber++;
+		}
+		else if ((2 == LinesNumber) && (';' == Character)){
+			FieldsNumber++;
+		}
+	}
+	size_t Position = Text.find( "\n", Text.find( "\n", Text.find( "\n" ) + 1 ) + 1 ) + 1;
+	int64_t RowTime = 0;
+	long RowReadoutsNumber = 0;
+	if (Position < Text.size()){
+		char * EndPtr;
+		RowTime = strtoll( Text.c_str() + Position, &EndPtr, 10 );
+		RowReadoutsNumber = strtol( EndPtr + 1, nullptr, 10 );
+	}
+	int64_t RowWidth = getSummaryTileWidth( 4 ) / 1000000000;	// at most 3 tiles in an hour: 4096 s
+	check( (3 + 1 == LinesNumber) && ((size_t)(2 + 3*PHYSICALLY_INSTALLED_CUPS*VALUES_PER_DISC) == FieldsNumber) &&
+			(RowTime == StartTime / 1000000000 / RowWidth * RowWidth) && (2000 == RowReadoutsNumber),
+			"podsumowanie .csv: zła liczba wierszy lub kolumn" );
+	check( FailureCodes::ERROR_COMMAND_SYNTAX == runSummaryExport( TEST_EXPORT_START_TEXT, TEST_EXPORT_END_TEXT, "0",
+			CsvFilePath.c_str() ), "przyjęto zerową liczbę kafli" );
+	unlink( CsvFilePath.c_str() );
+}
+
+/// The columns of the capture files, the structured array of the .npy file and the arrays of the .npz archive,
+/// all with the same values; the currents with the recorded zero shift
+static void testExportLayout(void){
+	RecordingDirectory = TestDirectory + "/eksport";
+	mkdir( RecordingDirectory.c_str(), 0775 );
+	struct tm LocalTime;
+	memset( &LocalTime, 0, sizeof(LocalTime) );
+	strptime( TEST_EXPORT_START_TEXT, "%Y-%m-%d_%H:%M:%S", &LocalTime );
+	LocalTime.tm_isdst = -1;
+	int64_t StartTime = (int64_t)mktime( &LocalTime ) * 1000000000;
+	std::string FilePath = RecordingDirectory + "/" RECORDING_FILE_PREFIX "2026-01-01_00-00-10" RECORDING_FILE_EXTENSION;
+	std::vector<RecordedFrame> Frames;
+	std::vector<ChunkIndexEntry> Entries;
+	makeFrames( &Frames, TEST_EXPORT_FRAMES, StartTime );
+	writeRecording( FilePath, Frames, &Entries );
+	writeFile( getRecordingSidecarPath( FilePath, RECORDING_INDEX_EXTENSION ), Entries.data(), Entries.size()*sizeof(ChunkIndexEntry) );
+
+	// the cup 1 gets the zero shift 100 from the frame 1000
+	std::vector<ZeroShiftEntry> Shifts( CUPS_NUMBER + 1 );
+	memset( Shifts.data(), 0, Shifts.size()*sizeof(ZeroShiftEntry) );
+	for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+		Shifts[Cup].Time = StartTime - 1000000000LL;
+		Shifts[Cup].CupIndex = (uint32_t)Cup;
+	}
+	Shifts[CUPS_NUMBER].Time = Frames[1000].RegistersTime;
+	Shifts[CUPS_NUMBER].ZeroShift = 100.0;
+	writeFile( getRecordingSidecarPath( FilePath, RECORDING_ZERO_SHIFT_EXTENSION ), Shifts.data(), Shifts.size()*sizeof(ZeroShiftEntry) );
+
+	int ColumnsNumber = 3 + PHYSICALLY_INSTALLED_CUPS*(VALUES_PER_DISC + MODBUS_COILS_PER_CUP);
+	size_t RecordSize = 8 + 8 + 1 + PHYSICALLY_INSTALLED_CUPS*(VALUES_PER_DISC*4 + MODBUS_COILS_PER_CUP);
+	size_t CurrentOffset = 8 + 8 + 1;		// the first current of the cup 1 in the record
+	int Row = 1001;
+	float ExpectedCurrent = (float)(TEST_DIRECTIONAL_COEFFICIENT *
+			(Frames[Row].InputRegisters[0] - 100.0 + TEST_OFFSET_FOR_ZERO_CURRENT));
+	float ExpectedDiagnostic = (float)(TEST_DIAGNOSTIC_GAIN * Frames[Row].InputRegisters[VISIBLE_VALUES_PER_DISC] +
+			TEST_DIAGNOSTIC_OFFSET);
+
+	std::string CsvFilePath = TestDirectory + "/eksport.csv";
+	check( FailureCodes::NO_FAILURE == runRecordingExport( TEST_EXPORT_START_TEXT, TEST_EXPORT_END_TEXT, CsvFilePath.c_str() ),
+			"eksport .csv nie powiódł się" );
+	std::vector<uint8_t> Data = readFile( CsvFilePath );
+	std::string Text( Data.begin(), Data.end() );
+	size_t LinesNumber = 0;
+	size_t FieldsNumber = 1;
+	size_t Position = 0;
+	for (size_t J=0; J < Text.size(); J++){
+		if ('\n' == Text[J]){
+			LinesNumber++;
+			if ((size_t)(3 + Row) == LinesNumber){
+				Position = J + 1;
+			}
+		}
+		else if ((3 == LinesNumber) && (';' == Text[J])){
+			FieldsNumber++;
+		}
+	}
+	check( (3 + TEST_EXPORT_FRAMES == LinesNumber) && ((size_t)ColumnsNumber == FieldsNumber), ".csv: zła liczba wierszy lub kolumn" );
+	double Time;
+	unsigned long long FrameNumber;
+	unsigned Quality;
+	float Current;
+	check( (4 == sscanf( Text.c_str() + Position, "%lf;%llu;%u;%f", &Time, &FrameNumber, &Quality, &Current )) &&
+			(Frames[Row].FrameNumber == FrameNumber) && (Frames[Row].QualityFlags == Quality) && (ExpectedCurrent == Current),
+			".csv: zły wiersz" );
+
+	std::string NpyFilePath = TestDirectory + "/eksport.npy";
+	check( FailureCodes::NO_FAILURE == runRecordingExport( TEST_EXPORT_START_TEXT, TEST_EXPORT_END_TEXT, NpyFilePath.c_str() ),
+			"eksport .npy nie powiódł się" );
+	Data = readFile( NpyFilePath );
+	size_t HeaderSize = (Data.size() > 10)? 10 + getLittleEndian( &Data[8], 2 ) : 0;
+	std::string HeaderText( Data.begin() + std::min<size_t>( 10, Data.size() ), Data.begin() + std::min( HeaderSize, Data.size() ) );
+	check( (HeaderSize > 10) && (0 == memcmp( Data.data(), "\x93NUMPY\x01\x00", 8 )) && (0 == HeaderSize % 64) &&
+			('\n' == HeaderText.back()) && (std::string::npos != HeaderText.find( "'shape': (1500,)" )) &&
+			(Data.size() == HeaderSize + TEST_EXPORT_FRAMES*RecordSize), ".npy: zły nagłówek albo rozmiar" );
+	if (Data.size() == HeaderSize + TEST_EXPORT_FRAMES*RecordSize){
+		const uint8_t * RecordPtr = &Data[HeaderSize + Row*RecordSize];
+		float Diagnostic;
+		memcpy( &Time, RecordPtr, sizeof(Time) );
+		memcpy( &Current, RecordPtr + CurrentOffset, sizeof(Current) );
+		memcpy( &Diagnostic, RecordPtr + CurrentOffset + VISIBLE_VALUES_PER_DISC*4, sizeof(Diagnostic) );
+		check( (fabs( Time - 1.0e-9*Frames[Row].RegistersTime ) < 1.0e-6) && (Frames[Row].FrameNumber == getLittleEndian( RecordPtr + 8, 8 )) &&
+				(ExpectedCurrent == Current) && (ExpectedDiagnostic == Diagnostic), ".npy: zły rekord" );
+		memcpy( &Current, &Data[HeaderSize + 999*RecordSize + CurrentOffset], sizeof(Current) );
+		check( (float)(TEST_DIRECTIONAL_COEFFICIENT * (Frames[999].InputRegisters[0] + TEST_OFFSET_FOR_ZERO_CURRENT)) == Current,
+				".npy: korekta zera przed jej zmianą" );
+	}
+
+	std::string NpzFilePath = TestDirectory + "/eksport.npz";
+	check( FailureCodes::NO_FAILURE == runRecordingExport( TEST_EXPORT_START_TEXT, TEST_EXPORT_END_TEXT, NpzFilePath.c_str() ),
+			"eksport .npz nie powiódł się" );
+	Data = readFile( NpzFilePath );
+	bool IsCorrect = (Data.size() > 22) && (0x06054B50 == getLittleEndian( &Data[Data.size()-22], 4 )) &&
+			((uint64_t)ColumnsNumber == getLittleEndian( &Data[Data.size()-22+10], 2 ));
+	uint64_t DirectoryOffset = IsCorrect? getLittleEndian( &Data[Data.size()-22+16], 4 ) : Data.size();
+	int MembersNumber = 0;
+	for (uint64_t Offset = DirectoryOffset; IsCorrect && (Offset + 46 <= Data.size() - 22); MembersNumber++){
+		const uint8_t * EntryPtr = &Data[Offset];
+		uint64_t MemberSize = getLittleEndian( EntryPtr + 20, 4 );
+		uint64_t NameLength = getLittleEndian( EntryPtr + 28, 2 );
+		uint64_t MemberOffset = getLittleEndian( EntryPtr + 42, 4 );
+		std::string Name( EntryPtr + 46, EntryPtr + 46 + NameLength );
+		IsCorrect = (0x02014B50 == getLittleEndian( EntryPtr, 4 )) && (MemberOffset + 30 + NameLength + MemberSize <= DirectoryOffset) &&
+				(0x04034B50 == getLittleEndian( &Data[MemberOffset], 4 )) && (NameLength == getLittleEndian( &Data[MemberOffset+26], 2 ));
+		if (!IsCorrect){
+			break;
+		}
+		const uint8_t * MemberPtr = &Data[MemberOffset + 30 + NameLength];
+		size_t MemberHeaderSize = 10 + getLittleEndian( MemberPtr + 8, 2 );
+		IsCorrect = (getLittleEndian( EntryPtr + 16, 4 ) == crc32( 0, MemberPtr, (uInt)MemberSize )) &&
+				(0 == memcmp( MemberPtr, "\x93NUMPY\x01\x00", 8 )) && (0 == MemberHeaderSize % 64) &&
+				(0 == (MemberSize - MemberHeaderSize) % TEST_EXPORT_FRAMES);
+		if (IsCorrect && ("K1_ch1.npy" == Name)){
+			memcpy( &Current, MemberPtr + MemberHeaderSize + Row*sizeof(float), sizeof(Current) );
+			IsCorrect = (MemberSize == MemberHeaderSize + TEST_EXPORT_FRAMES*sizeof(float)) && (ExpectedCurrent == Current);
+		}
+		Offset += 46 + NameLength;
+	}
+	check( IsCorrect && (ColumnsNumber == MembersNumber), ".npz: złe archiwum" );
+
+	// [start; end): a second of frames
+	check( FailureCodes::NO_FAILURE == runRecordingExport( "2026-01-01_00:00:11", "2026-01-01_00:00:12", NpyFilePath.c_str() ),
+			"eksport .npy nie powiódł się" );
+	Data = readFile( NpyFilePath );
+	HeaderSize = (Data.size() > 10)? 10 + getLittleEndian( &Data[8], 2 ) : 0;
+	check( Data.size() == HeaderSize + 100*RecordSize, ".npy: zła liczba ramek przedziału" );
+
+	std::string MissingFilePath = TestDirectory + "/brak/eksport.npz";
+	check( FailureCodes::ERROR_EXPORT_FILE == runRecordingExport( TEST_EXPORT_START_TEXT, TEST_EXPORT_END_TEXT,
+			MissingFilePath.c_str() ), "eksport do niedostępnego pliku nie zgłosił błędu" );
+	unlink( CsvFilePath.c_str() );
+	unlink( NpyFilePath.c_str() );
+	unlink( NpzFilePath.c_str() );
+}
+
+/// The outcomes of the writes come back in the order of the requests; after a failed write the later writes to the file
+/// are dropped until it is closed; the writer is idle only when the closing queued last has been done
+static void testDiskWriter(void){
+	diskWriterStart();
+	std::string FilePath = TestDirectory + "/dysk.bin";
+	int File = open( FilePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644 );
+	uint8_t Data[3][1000];
+	for (int J=0; J < 3; J++){
+		memset( Data[J], 'a' + J, sizeof(Data[J]) );
+		check( copyToDisk( File, Data[J], sizeof(Data[J]), (2 == J)? DISK_WRITE_SYNC : 0, 1 + J ), "zapis nie przyjęty" );
+	}
+	closeDiskFile( File );
+	check( waitForIdleDiskWriter(), "zapis na dysk nie zakończył się" );
+	int ReportTag;
+	bool IsWritten;
+	bool IsCorrect = true;
+	for (int J=0; J < 3; J++){
+		IsCorrect = IsCorrect && takeDiskWriteReport( &ReportTag, &IsWritten ) && (1 + J == ReportTag) && IsWritten;
+	}
+	check( IsCorrect && !takeDiskWriteReport( &ReportTag, &IsWritten ), "złe raporty zapisu" );
+	std::vector<uint8_t> Written = readFile( FilePath );
+	check( (sizeof(Data) == Written.size()) && (0 == memcmp( Written.data(), Data, sizeof(Data) )), "zapisano złe dane" );
+
+	// the file cannot be written: both requests are reported as dropped, with a single error
+	uint64_t DroppedWritesNumber;
+	uint64_t ErrorsNumber;
+	uint64_t PreviousErrorsNumber;
+	getDiskWriterStatus( &DroppedWritesNumber, &PreviousErrorsNumber );
+	File = open( FilePath.c_str(), O_RDONLY | O_CLOEXEC );
+	copyToDisk( File, Data[0], sizeof(Data[0]), 0, 4 );
+	copyToDisk( File, Data[1], sizeof(Data[1]), 0, 5 );
+	closeDiskFile( File );
+	check( waitForIdleDiskWriter(), "zapis na dysk nie zakończył się" );
+	getDiskWriterStatus( &DroppedWritesNumber, &ErrorsNumber );
+	IsCorrect = (PreviousErrorsNumber + 1 == ErrorsNumber);
+	for (int J=0; J < 2; J++){
+		IsCorrect = IsCorrect && takeDiskWriteReport( &ReportTag, &IsWritten ) && (4 + J == ReportTag) && !IsWritten;
+	}
+	check( IsCorrect, "nieudany zapis nie został zgłoszony" );
+
+	// the descriptor of the failed file, reused after its closing, is written again
+	File = open( FilePath.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC );
+	copyToDisk( File, Data[0], sizeof(Data[0]), 0, 6 );
+	closeDiskFile( File );
+	check( waitForIdleDiskWriter(), "zapis na dysk nie zakończył się" );
+	check( takeDiskWriteReport( &ReportTag, &IsWritten ) && (6 == ReportTag) && IsWritten &&
+			(sizeof(Data) + sizeof(Data[0]) == readFile( FilePath ).size()), "nie zapisano do ponownie otwartego pliku" );
+
+	// a closing request without data is in flight too
+	diskWriterExit();
+	File = open( FilePath.c_str(), O_RDONLY | O_CLOEXEC );
+	closeDiskFile( File );
+	check( !isDiskWriterIdle(), "zapis na dysk bezczynny przed zamknięciem pliku" );
+	diskWriterStart();
+	check( waitForIdleDiskWriter() && (-1 == fcntl( File, F_GETFD )), "plik nie został zamknięty" );
+	diskWriterExit();
+	unlink( FilePath.c_str() );
+}
+
+/// All the frames of the history reach the recording, its summaries and the counters; when the file cannot be written,
+/// the frames missing in the file are counted as lost and are not in the summaries
+static void testRecorder(void){
+	RecordingDirectory = TestDirectory + "/zapis";
+	initializeHistoryBuffer( TEST_HISTORY_CAPACITY );
+	uint64_t FrameNumber = 0;
+	runRecorder( &FrameNumber );
+	uint64_t BytesWritten;
+	uint64_t LostFramesNumber;
+	bool IsFailed;
+	getRecordingStatus( &BytesWritten, &LostFramesNumber, &IsFailed );
+	uint64_t FilesSize = 0;
+	uint64_t FramesNumber = 0;
+	uint64_t ReadoutsNumber = 0;
+	std::vector<std::string> FilePaths = listRecordingFiles( RecordingDirectory );
+	for (const std::string & FilePath : FilePaths){
+		RecordingReader Reader{};
+		if (openRecording( FilePath, &Reader )){
+			readRecordingRange( &Reader, INT64_MIN, INT64_MAX, countFrames, &FramesNumber );
+			closeRecording( &Reader );
+		}
+		FilesSize += readFile( FilePath ).size();
+		ReadoutsNumber += countSummaryReadouts( FilePath );
+	}
+	check( !FilePaths.empty() && !IsFailed && (0 == LostFramesNumber), "zapis ciągły nie powiódł się" );
+	check( (TEST_RECORDER_FRAMES == FramesNumber) && (TEST_RECORDER_FRAMES == ReadoutsNumber),
+			"zapis ciągły: zła liczba ramek w zapisie lub w podsumowaniach" );
+	check( FilesSize == BytesWritten, "zapis ciągły: zła liczba zapisanych bajtów" );
+
+	// the file size limit makes the writes fail (with EFBIG instead of the signal)
+	RecordingDirectory = TestDirectory + "/zapis_blad";
+	uint64_t PreviousBytesWritten = BytesWritten;
+	uint64_t PreviousLostFramesNumber = LostFramesNumber;
+	struct rlimit PreviousLimit;
+	getrlimit( RLIMIT_FSIZE, &PreviousLimit );
+	struct rlimit Limit = PreviousLimit;
+	Limit.rlim_cur = TEST_FILE_SIZE_LIMIT;
+	signal( SIGXFSZ, SIG_IGN );
+	setrlimit( RLIMIT_FSIZE, &Limit );
+	runRecorder( &FrameNumber );
+	setrlimit( RLIMIT_FSIZE, &PreviousLimit );
+	signal( SIGXFSZ, SIG_DFL );
+	getRecordingStatus( &BytesWritten, &LostFramesNumber, &IsFailed );
+	FilesSize = 0;
+	FramesNumber = 0;
+	ReadoutsNumber = 0;
+	for (const std::string & FilePath : listRecordingFiles( RecordingDirectory )){
+		RecordingReader Reader{};
+		if (openRecording( FilePath, &Reader )){
+			readRecordingRange( &Reader, INT64_MIN, INT64_MAX, countFrames, &FramesNumber );
+			closeRecording( &Reader );
+		}
+		FilesSize += readFile( FilePath ).size();
+		ReadoutsNumber += countSummaryReadouts( FilePath );
+	}
+	LostFramesNumber -= PreviousLostFramesNumber;
+	check( IsFailed && (LostFramesNumber > 0), "błąd zapisu ciągłego nie został zgłoszony" );
+	check( (TEST_RECORDER_FRAMES == FramesNumber + LostFramesNumber) && (FramesNumber == ReadoutsNumber),
+			"błąd zapisu ciągłego: ramki w zapisie, w podsumowaniach i utracone nie zgadzają się" );
+	check( BytesWritten - PreviousBytesWritten <= FilesSize, "błąd zapisu ciągłego: zła liczba zapisanych bajtów" );
+}
+
+/// The recorder is given TEST_RECORDER_FRAMES frames, 10 ms apart, and closed after it has taken them all
+static void runRecorder( uint64_t * FirstFrameNumberPtr ){
+	recorderStart();
+	std::this_thread::sleep_for( std::chrono::milliseconds( PERIPHERAL_THREAD_LOOP_DURATION ));	// its cursor is set
+	AcquisitionFrame Frame{};
+	std::chrono::high_resolution_clock::time_point StartTime = std::chrono::high_resolution_clock::now();
+	for (int J=0; J < TEST_RECORDER_FRAMES; J++){
+		Frame.FrameNumber = (*FirstFrameNumberPtr)++;
+		Frame.RegistersTime = StartTime + std::chrono::nanoseconds( J*TEST_FRAME_PERIOD );
+		Frame.CoilsTime = Frame.RegistersTime;
+		for (int K=0; K < MODBUS_INPUTS_NUMBER; K++){
+			Frame.InputRegisters[K] = (uint16_t)(1000 + K + J % 7);
+		}
+		Frame.Coils[J % MODBUS_COILS_NUMBER] = !Frame.Coils[J % MODBUS_COILS_NUMBER];
+		Frame.QualityFlags = 0x1F;
+		appendToHistory( &Frame );
+	}
+	std::this_thread::sleep_for( std::chrono::milliseconds( 8*PERIPHERAL_THREAD_LOOP_DURATION ));
+	recorderExit();
+	check( waitForIdleDiskWriter(), "zapis na dysk nie zakończył się" );		// the last summaries are queued
+}
+
+/// The recordings older than RecordingFullDataDays are reduced to their summaries; over RecordingSizeLimit, the oldest
+/// recording with the full data is reduced as well and then the oldest summaries are deleted
+static void testRetention(void){
+	RecordingDirectory = TestDirectory + "/retencja";
+	mkdir( RecordingDirectory.c_str(), 0775 );
+	std::string OldFilePath = RecordingDirectory + "/" RECORDING_FILE_PREFIX "2026-01-01_00-00-30" RECORDING_FILE_EXTENSION;
+	std::string NewFilePath = RecordingDirectory + "/" RECORDING_FILE_PREFIX "2026-01-01_00-00-40" RECORDING_FILE_EXTENSION;
+	std::string OldestFilePath = RecordingDirectory + "/" RECORDING_FILE_PREFIX "2026-01-01_00-00-20" RECORDING_FILE_EXTENSION;
+	int64_t Now = (int64_t)time( nullptr );
+	std::vector<RecordedFrame> Frames;
+	std::vector<ChunkIndexEntry> Entries;
+	makeFrames( &Frames, TEST_EXPORT_FRAMES, (Now - TEST_OLD_RECORDING_AGE) * 1000000000 );
+	writeRecording( OldFilePath, Frames, &Entries );
+	writeFile( getRecordingSidecarPath( OldFilePath, RECORDING_INDEX_EXTENSION ), Entries.data(), Entries.size()*sizeof(ChunkIndexEntry) );
+	struct timeval Times[2] = { { (time_t)(Now - TEST_OLD_RECORDING_AGE), 0 }, { (time_t)(Now - TEST_OLD_RECORDING_AGE), 0 } };
+	utimes( OldFilePath.c_str(), Times );
+	makeFrames( &Frames, TEST_EXPORT_FRAMES, (Now - 60) * 1000000000 );
+	writeRecording( NewFilePath, Frames, &Entries );
+	writeFile( getRecordingSidecarPath( NewFilePath, RECORDING_INDEX_EXTENSION ), Entries.data(), Entries.size()*sizeof(ChunkIndexEntry) );
+
+	RecordingFullDataDays = 30;
+	RecordingSizeLimit = 0;
+	applyRetention();
+	check( !isFilePresent( OldFilePath ) && !isFilePresent( getRecordingSidecarPath( OldFilePath, RECORDING_INDEX_EXTENSION )) &&
+			(TEST_EXPORT_FRAMES == countSummaryReadouts( OldFilePath )), "retencja: stary zapis nie został zredukowany" );
+	check( isFilePresent( NewFilePath ) && isFilePresent( getRecordingSidecarPath( NewFilePath, RECORDING_INDEX_EXTENSION )),
+			"retencja: zredukowano nowy zapis" );
+
+	// the summaries of the oldest recording alone exceed the limit
+	std::vector<uint8_t> Summaries( 2000000, 0 );
+	writeFile( getSummaryFilePath( OldestFilePath, 0 ), Summaries.data(), Summaries.size() );
+	RecordingSizeLimit = 1;
+	applyRetention();
+	check( !isFilePresent( getSummaryFilePath( OldestFilePath, 0 )), "retencja: nie usunięto najstarszych podsumowań" );
+	check( TEST_EXPORT_FRAMES == countSummaryReadouts( OldFilePath ), "retencja: usunięto zbyt wiele podsumowań" );
+	check( !isFilePresent( NewFilePath ) && (TEST_EXPORT_FRAMES == countSummaryReadouts( NewFilePath )),
+			"retencja: nowy zapis nie został zredukowany ponad limit miejsca" );
+	RecordingFullDataDays = 0;
+	RecordingSizeLimit = 0;
+}
+
+/// The frames with the same registers do not change the derived data, although the charge is integrated and the trip
+/// rate of the shift falls all the time; a change of the displayed charge, integration time or trip rate does
+static void testChangeDetection(void){
+	initializeSharedData();
+	AcquisitionWorkingFrame.QualityFlags = FRAME_QUALITY_REGISTERS_VALID | FRAME_QUALITY_REGISTERS_UPDATED;
+	for (int K=0; K < MODBUS_INPUTS_NUMBER; K++){
+		AcquisitionWorkingFrame.InputRegisters[K] = (uint16_t)(1000 + K);
+	}
+	CupDerivedData * DerivedPtr = &AcquisitionWorkingFrame.Derived[0];
+	DerivedPtr->Charge = 0.5f;
+	DerivedPtr->ChargeIntegrationTime = 10.0f;
+	DerivedPtr->ShiftBeamTripRate = 2.0f;
+	publishAcquisitionFrame();
+	AcquisitionFrame Frame;
+	bool IsUnchanged = true;
+	for (int J=0; J < 8; J++){
+		DerivedPtr->Charge += 1.0e-6f;
+		DerivedPtr->ChargeIntegrationTime += 0.05f;
+		DerivedPtr->ShiftBeamTripRate -= 0.001f;
+		publishAcquisitionFrame();
+		readAcquisitionFrame( &Frame );
+		IsUnchanged = IsUnchanged && (0 == Frame.CupChangeMask[0]);
+	}
+	check( IsUnchanged, "te same rejestry zmieniły dane pochodne kubka" );
+	DerivedPtr->ChargeIntegrationTime += 0.2f;
+	publishAcquisitionFrame();
+	readAcquisitionFrame( &Frame );
+	check( CHANGE_MASK_DERIVED == Frame.CupChangeMask[0], "nie wykryto zmiany czasu całkowania" );
+	DerivedPtr->Charge += 1.0e-4f;
+	publishAcquisitionFrame();
+	readAcquisitionFrame( &Frame );
+	check( CHANGE_MASK_DERIVED == Frame.CupChangeMask[0], "nie wykryto zmiany ładunku" );
+	DerivedPtr->ShiftBeamTripRate -= 0.1f;
+	publishAcquisitionFrame();
+	readAcquisitionFrame( &Frame );
+	check( CHANGE_MASK_DERIVED == Frame.CupChangeMask[0], "nie wykryto zmiany częstości wyłączeń" );
+}
+
+/// The files of the tests are in the directory and its subdirectories
+static void deleteTestDirectory(void){
+	const std::string DirectoryPaths[] = { TestDirectory + "/eksport", TestDirectory + "/podsumowania", TestDirectory + "/zapis", TestDirectory + "/zapis_blad",
+			TestDirectory + "/retencja", TestDirectory };
+	for (const std::string & DirectoryPath : DirectoryPaths){
+		DIR * DirectoryPtr = opendir( DirectoryPath.c_str() );
+		if (nullptr == DirectoryPtr){
+			continue;
+		}
+		while (struct dirent * EntryPtr = readdir( DirectoryPtr )){
+			if ('.' != EntryPtr->d_name[0]){
+				unlink( (DirectoryPath + "/" + EntryPtr->d_name).c_str() );
+			}
+		}
+		closedir( DirectoryPtr );
+		rmdir( DirectoryPath.c_str() );
+	}
+}
@@ -0,0 +1,276 @@
+/// @file actuator_timing.cpp
+///
+/// Travel times of the cup actuators. Every insertion and removal is measured by the peripheral thread in two
+/// phases: from the command (the click of the button or the interlock of an alarm; CupInsertionOrRemovalStartTime)
+/// to the coil written to the slave, and from the coil written to the limit switch reporting the new position.
+/// The limit switch is known only when the coils are read, so its moment is taken in the middle between the last
+/// readout of the old position and the first readout of the new one. The times are collected in histograms per cup
+/// and direction (percentiles on request, menu Narzędzia/Czasy przesuwu kubków) and logged to PrzesuwKubków.log,
+/// so a slowly degrading actuator shows up as a trend long before MaximumPropagationTime is exceeded. A movement
+/// interrupted by an interlock is not measured.
+
+#include <cstdio>
+#include <atomic>
+
+#include "actuator_timing.h"
+#include "event_log.h"
+#include "settings_file.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define ACTUATOR_LOG_FILE_NAME			"PrzesuwKubków.log"
+
+#define ACTUATOR_HISTOGRAM_BIN			10		// milliseconds
+#define ACTUATOR_HISTOGRAM_BINS			1000	// the last bin collects the longer times
+#define ACTUATOR_TRAVEL_TIMEOUT			30000	// milliseconds; the movement is abandoned without the limit switch
+
+#define ACTUATOR_QUEUE_SIZE				32		// power of 2
+static_assert( 0 == (ACTUATOR_QUEUE_SIZE & (ACTUATOR_QUEUE_SIZE-1)) );
+
+#define ACTUATOR_REPORT_SIZE			1200
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+enum class TravelPhases
+{
+	COMMAND_TO_WIRE,
+	WIRE_TO_SWITCH,
+	TOTAL,
+	NUMBER,
+};
+
+struct TravelHistogram {
+	uint32_t Bins[ACTUATOR_HISTOGRAM_BINS];
+	uint32_t SamplesNumber;
+	double Sum;
+	double Maximum;
+};
+
+struct TravelMeasurement {
+	bool IsWaitingForSwitch;
+	bool IsInsertion;
+	std::chrono::high_resolution_clock::time_point CommandTime;
+	std::chrono::high_resolution_clock::time_point WireTime;
+	std::chrono::high_resolution_clock::time_point LastOldPositionTime;	// the last readout of the old position
+};
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static void addToHistogram( TravelHistogram * HistogramPtr, double Milliseconds );
+
+static double getPercentile( const TravelHistogram * HistogramPtr, double Fraction );
+
+static void prepareActuatorReport(void);
+
+static std::chrono::high_resolution_clock::time_point formatActuatorEvent( const void * EventPtr, char * TextPtr, size_t TextSize );
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+/// These variables are used by the peripheral thread only; [cup][0 - removal, 1 - insertion][phase]
+static TravelHistogram TravelHistograms[CUPS_NUMBER][2][(int)TravelPhases::NUMBER];
+static TravelMeasurement TravelMeasurements[CUPS_NUMBER];
+static uint32_t AbandonedTravels[CUPS_NUMBER][2];
+
+/// The queue of the measured movements; written by the peripheral thread, read by the GUI thread
+static ActuatorTravelEvent ActuatorQueue[ACTUATOR_QUEUE_SIZE];
+static EventLog ActuatorLog = { ACTUATOR_LOG_FILE_NAME, "Przesuw kubka", ActuatorQueue, sizeof(ActuatorTravelEvent),
+		ACTUATOR_QUEUE_SIZE, formatActuatorEvent, {0}, {0}, {0} };
+
+/// The report is requested by the GUI thread and prepared by the peripheral thread, which owns the histograms
+static std::atomic<bool> ActuatorReportRequest;
+static std::atomic<bool> IsActuatorReportReady;
+static char ActuatorReport[ACTUATOR_REPORT_SIZE];
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+void initializeActuatorTiming(void){
+	for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+		TravelMeasurements[Cup].IsWaitingForSwitch = false;
+		for (int Direction=0; Direction < 2; Direction++){
+			AbandonedTravels[Cup][Direction] = 0;
+			for (int Phase=0; Phase < (int)TravelPhases::NUMBER; Phase++){
+				TravelHistogram * HistogramPtr = &TravelHistograms[Cup][Direction][Phase];
+				for (int J=0; J < ACTUATOR_HISTOGRAM_BINS; J++){
+					HistogramPtr->Bins[J] = 0;
+				}
+				HistogramPtr->SamplesNumber = 0;
+				HistogramPtr->Sum = 0.0;
+				HistogramPtr->Maximum = 0.0;
+			}
+		}
+	}
+}
+
+/// This function is called by the peripheral thread after each write of the coil that inserts or removes a cup
+void noteActuatorCommandWritten( int CupIndex, bool Value, FailureCodes Result ){
+	TravelMeasurement * MeasurementPtr = &TravelMeasurements[CupIndex];
+	if (MeasurementPtr->IsWaitingForSwitch){
+		AbandonedTravels[CupIndex][MeasurementPtr->IsInsertion? 1 : 0]++;	// superseded by the new command
+		MeasurementPtr->IsWaitingForSwitch = false;
+	}
+	if (FailureCodes::NO_FAILURE != Result){
+		return;
+	}
+	MeasurementPtr->IsWaitingForSwitch = true;
+	MeasurementPtr->IsInsertion = Value;
+	MeasurementPtr->WireTime = std::chrono::high_resolution_clock::now();
+	MeasurementPtr->CommandTime = atomic_load_explicit( &CupInsertionOrRemovalStartTime[CupIndex], std::memory_order_acquire );
+	if (MeasurementPtr->CommandTime > MeasurementPtr->WireTime){
+		MeasurementPtr->CommandTime = MeasurementPtr->WireTime;
+	}
+	MeasurementPtr->LastOldPositionTime = MeasurementPtr->WireTime;
+}
+
+/// This function is called by the peripheral thread when an alarm removes the cup; the movement in progress is
+/// not measured, since it has been interrupted
+void abandonActuatorTravel( int CupIndex ){
+	TravelMeasurement * MeasurementPtr = &TravelMeasurements[CupIndex];
+	if (MeasurementPtr->IsWaitingForSwitch){
+		AbandonedTravels[CupIndex][MeasurementPtr->IsInsertion? 1 : 0]++;
+		MeasurementPtr->IsWaitingForSwitch = false;
+	}
+}
+
+/// This function is called by the peripheral thread for each frame
+void measureActuatorTravel( const AcquisitionFrame * FramePtr ){
+	if (atomic_exchange_explicit( &ActuatorReportRequest, false, std::memory_order_acquire )){
+		prepareActuatorReport();
+		atomic_store_explicit( &IsActuatorReportReady, true, std::memory_order_release );
+	}
+	if (0 == (FramePtr->QualityFlags & FRAME_QUALITY_COILS_UPDATED)){
+		return;
+	}
+
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		TravelMeasurement * MeasurementPtr = &TravelMeasurements[Cup];
+		if (!MeasurementPtr->IsWaitingForSwitch || (FramePtr->CoilsTime <= MeasurementPtr->WireTime)){
+			continue;
+		}
+		int Direction = MeasurementPtr->IsInsertion? 1 : 0;
+		bool IsSwitchPressed = FramePtr->Coils[COIL_OFFSET_IS_SWITCH_PRESSED + Cup*MODBUS_COILS_PER_CUP];
+		if (IsSwitchPressed != MeasurementPtr->IsInsertion){
+			MeasurementPtr->LastOldPositionTime = FramePtr->CoilsTime;
+			if (std::chrono::duration_cast<std::chrono::milliseconds>(FramePtr->CoilsTime - MeasurementPtr->WireTime).count() > ACTUATOR_TRAVEL_TIMEOUT){
+				AbandonedTravels[Cup][Direction]++;
+				MeasurementPtr->IsWaitingForSwitch = false;
+			}
+			continue;
+		}
+
+		std::chrono::high_resolution_clock::time_point SwitchTime = MeasurementPtr->LastOldPositionTime +
+				(FramePtr->CoilsTime - MeasurementPtr->LastOldPositionTime) / 2;
+		ActuatorTravelEvent Event;
+		Event.CupIndex = Cup;
+		Event.IsInsertion = MeasurementPtr->IsInsertion;
+		Event.CommandTime = MeasurementPtr->CommandTime;
+		Event.CommandToWire = (float)std::chrono::duration<double, std::milli>(MeasurementPtr->WireTime - MeasurementPtr->CommandTime).count();
+		Event.WireToSwitch = (float)std::chrono::duration<double, std::milli>(SwitchTime - MeasurementPtr->WireTime).count();
+		addToHistogram( &TravelHistograms[Cup][Direction][(int)TravelPhases::COMMAND_TO_WIRE], Event.CommandToWire );
+		addToHistogram( &TravelHistograms[Cup][Direction][(int)TravelPhases::WIRE_TO_SWITCH], Event.WireToSwitch );
+		addToHistogram( &TravelHistograms[Cup][Direction][(int)TravelPhases::TOTAL], Event.CommandToWire + Event.WireToSwitch );
+		pushLogEvent( &ActuatorLog, &Event );
+		MeasurementPtr->IsWaitingForSwitch = false;
+	}
+}
+
+/// This function is called by the GUI thread (menu)
+void requestActuatorReport(void){
+	atomic_store_explicit( &ActuatorReportRequest, true, std::memory_order_release );
+}
+
+/// This function is called by the GUI thread in each refresh
+/// @return true if the report has just been prepared; it is copied to ReportPtr
+bool finishActuatorReport( char * ReportPtr, size_t ReportSize ){
+	if (!atomic_load_explicit( &IsActuatorReportReady, std::memory_order_acquire )){
+		return false;
+	}
+	snprintf( ReportPtr, ReportSize, "%s", ActuatorReport );
+	atomic_store_explicit( &IsActuatorReportReady, false, std::memory_order_release );
+	return true;
+}
+
+/// This function is called by the GUI thread; the movements measured since the previous call are appended to the log file
+void writeActuatorTravelLog(void){
+	writeEventLog( &ActuatorLog );
+}
+
+static void addToHistogram( TravelHistogram * HistogramPtr, double Milliseconds ){
+	int Bin = (int)(Milliseconds / ACTUATOR_HISTOGRAM_BIN);
+	if (Bin < 0){
+		Bin = 0;
+	}
+	if (Bin >= ACTUATOR_HISTOGRAM_BINS){
+		Bin = ACTUATOR_HISTOGRAM_BINS-1;
+	}
+	HistogramPtr->Bins[Bin]++;
+	HistogramPtr->SamplesNumber++;
+	HistogramPtr->Sum += Milliseconds;
+	if (Milliseconds > HistogramPtr->Maximum){
+		HistogramPtr->Maximum = Milliseconds;
+	}
+}
+
+/// The percentile is interpolated linearly within its bin; the last bin is represented by the maximum
+static double getPercentile( const TravelHistogram * HistogramPtr, double Fraction ){
+	double Rank = Fraction * HistogramPtr->SamplesNumber;
+	uint32_t Cumulative = 0;
+	for (int J=0; J < ACTUATOR_HISTOGRAM_BINS-1; J++){
+		if ((Cumulative + HistogramPtr->Bins[J] >= Rank) && (0 != HistogramPtr->Bins[J])){
+			double Percentile = ACTUATOR_HISTOGRAM_BIN * (J + (Rank - Cumulative) / HistogramPtr->Bins[J]);
+			return (Percentile < HistogramPtr->Maximum)? Percentile : HistogramPtr->Maximum;
+		}
+		Cumulative += HistogramPtr->Bins[J];
+	}
+	return HistogramPtr->Maximum;
+}
+
+/// The report contains the percentiles of the total time and of both phases for each cup and direction
+static void prepareActuatorReport(void){
+	int Position = snprintf( ActuatorReport, sizeof(ActuatorReport), "Czasy przesuwu kubków [ms]: mediana / 90%% / 99%% / maksimum" );
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		for (int Direction=1; Direction >= 0; Direction--){
+			const TravelHistogram * TotalPtr = &TravelHistograms[Cup][Direction][(int)TravelPhases::TOTAL];
+			const TravelHistogram * WirePtr = &TravelHistograms[Cup][Direction][(int)TravelPhases::COMMAND_TO_WIRE];
+			const TravelHistogram * SwitchPtr = &TravelHistograms[Cup][Direction][(int)TravelPhases::WIRE_TO_SWITCH];
+			if (Position >= (int)sizeof(ActuatorReport)){
+				return;
+			}
+			if (0 == TotalPtr->SamplesNumber){
+				Position += snprintf( ActuatorReport + Position, sizeof(ActuatorReport) - Position,
+						"\n%s, %s: brak pomiarów", CupDescriptionPtr[Cup], (1 == Direction)? "wsuwanie" : "wysuwanie" );
+			}
+			else{
+				Position += snprintf( ActuatorReport + Position, sizeof(ActuatorReport) - Position,
+						"\n%s, %s (%u): %.0f / %.0f / %.0f / %.0f\n"
+						"      rozkaz-zapis %.0f / %.0f,  zapis-krańcówka %.0f / %.0f",
+						CupDescriptionPtr[Cup], (1 == Direction)? "wsuwanie" : "wysuwanie", (unsigned)TotalPtr->SamplesNumber,
+						getPercentile( TotalPtr, 0.5 ), getPercentile( TotalPtr, 0.9 ), getPercentile( TotalPtr, 0.99 ), TotalPtr->Maximum,
+						getPercentile( WirePtr, 0.5 ), getPercentile( WirePtr, 0.9 ),
+						getPercentile( SwitchPtr, 0.5 ), getPercentile( SwitchPtr, 0.9 ));
+			}
+			if ((0 != AbandonedTravels[Cup][Direction]) && (Position < (int)sizeof(ActuatorReport))){
+				Position += snprintf( ActuatorReport + Position, sizeof(ActuatorReport) - Position,
+						"\n      bez potwierdzenia krańcówki: %u", (unsigned)AbandonedTravels[Cup][Direction] );
+			}
+		}
+	}
+}
+
+/// The line of the log is dated with the command
+static std::chrono::high_resolution_clock::time_point formatActuatorEvent( const void * EventPtr, char * TextPtr, size_t TextSize ){
+	const ActuatorTravelEvent * TravelPtr = (const ActuatorTravelEvent *)EventPtr;
+	snprintf( TextPtr, TextSize, "kubek %d  %-10s  rozkaz-zapis %6.1f ms  zapis-krańcówka %7.1f ms  razem %7.1f ms",
+			TravelPtr->CupIndex+1, TravelPtr->IsInsertion? "wsuwanie" : "wysuwanie", (double)TravelPtr->CommandToWire,
+			(double)TravelPtr->WireToSwitch, (double)(TravelPtr->CommandToWire + TravelPtr->WireToSwitch) );
+	return TravelPtr->CommandTime;
+}
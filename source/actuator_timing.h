@@ -0,0 +1,43 @@
+/// @file actuator_timing.h
+
+#ifndef SOURCE_ACTUATOR_TIMING_H_
+#define SOURCE_ACTUATOR_TIMING_H_
+
+#include <chrono>
+#include <cstddef>
+
+#include "config.h"
+#include "shared_data.h"
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+/// A completed insertion or removal of a cup
+struct ActuatorTravelEvent {
+	int CupIndex;
+	bool IsInsertion;
+	std::chrono::high_resolution_clock::time_point CommandTime;
+	float CommandToWire;				// ms; from the click (or the interlock) to the coil written
+	float WireToSwitch;					// ms; from the coil written to the limit switch
+};
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+void initializeActuatorTiming(void);
+
+void noteActuatorCommandWritten( int CupIndex, bool Value, FailureCodes Result );
+
+void abandonActuatorTravel( int CupIndex );
+
+void measureActuatorTravel( const AcquisitionFrame * FramePtr );
+
+void writeActuatorTravelLog(void);
+
+void requestActuatorReport(void);
+
+bool finishActuatorReport( char * ReportPtr, size_t ReportSize );
+
+#endif // SOURCE_ACTUATOR_TIMING_H_
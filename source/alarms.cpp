@@ -0,0 +1,333 @@
+/// @file alarms.cpp
+///
+/// Alarm engine: the rules defined in the configuration file (thresholds with hysteresis on the channels,
+/// states of the coils) are evaluated by the peripheral thread on every frame, before the frame is published,
+/// so an alarm is raised in the same poll cycle in which its condition is met (or when the delay of the rule
+/// expires). An alarm may remove a cup (interlock): the coil write is queued at once and the peripheral thread
+/// performs it in the next cycle, without waiting for the coils to be read; the time from the readout that raised
+/// the alarm to the completed coil write is measured. The interlocked cup stays latched: until the operator
+/// acknowledges the interlock, every write of its coil is a removal, whatever the GUI requested. An active alarm
+/// is cleared only by a valid value beyond its hysteresis, so an alarm on the currents of a cup removed by its
+/// interlock stays active until the cup is inserted again. The events are passed through a single-producer
+/// single-consumer queue to the GUI thread, which writes them to the log file.
+
+#include <cmath>
+#include <cstdio>
+#include <atomic>
+
+#include "alarms.h"
+#include "actuator_timing.h"
+#include "event_log.h"
+#include "signal_processing.h"
+#include "settings_file.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define ALARM_LOG_FILE_NAME				"Alarmy.log"
+
+#define ALARM_QUEUE_SIZE				64		// power of 2
+static_assert( 0 == (ALARM_QUEUE_SIZE & (ALARM_QUEUE_SIZE-1)) );
+static_assert( ALARMS_MAX <= 32 );		// see CupDerivedData::ActiveAlarmsMask
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+struct AlarmState {
+	bool IsConditionMet;
+	bool IsActive;
+	std::chrono::high_resolution_clock::time_point ConditionStartTime;
+};
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static void raiseAlarm( int AlarmIndex, const AcquisitionFrame * FramePtr, double Value,
+		std::chrono::high_resolution_clock::time_point Time );
+
+static void requestInterlock( int AlarmIndex, const AcquisitionFrame * FramePtr,
+		std::chrono::high_resolution_clock::time_point Time );
+
+static std::chrono::high_resolution_clock::time_point formatAlarmEvent( const void * EventPtr, char * TextPtr, size_t TextSize );
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+/// These variables are used by the peripheral thread only
+static AlarmState AlarmStates[ALARMS_MAX];
+static uint32_t PendingInterlocks;			// bit Cup is set from the alarm until the coil of the cup is written
+static std::chrono::high_resolution_clock::time_point InterlockDetectionTime[CUPS_NUMBER];
+static int InterlockAlarmIndex[CUPS_NUMBER];
+
+/// Bit Cup is set by the peripheral thread with the interlock and cleared by the GUI thread when acknowledged
+static std::atomic<uint32_t> LatchedInterlocks;
+
+/// The queue of the alarm events; written by the peripheral thread, read by the GUI thread
+static AlarmEvent AlarmQueue[ALARM_QUEUE_SIZE];
+static EventLog AlarmLog = { ALARM_LOG_FILE_NAME, "Alarm", AlarmQueue, sizeof(AlarmEvent), ALARM_QUEUE_SIZE,
+		formatAlarmEvent, {0}, {0}, {0} };
+
+/// The latency of the interlocks (microseconds); written by the peripheral thread
+static std::atomic<int64_t> LastInterlockLatency;
+static std::atomic<int64_t> MaximumInterlockLatency;
+static std::atomic<bool> IsInterlockLatencyMeasured;
+
+static const char * const SeverityNames[] = {"OSTRZEŻENIE", "ALARM", "KRYTYCZNY"};
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+void initializeAlarms(void){
+	for (int J=0; J < ALARMS_MAX; J++){
+		AlarmStates[J].IsConditionMet = false;
+		AlarmStates[J].IsActive = false;
+	}
+	PendingInterlocks = 0;
+	atomic_store_explicit( &LatchedInterlocks, 0u, std::memory_order_release );
+	atomic_store_explicit( &IsInterlockLatencyMeasured, false, std::memory_order_release );
+}
+
+/// This function is called by the peripheral thread for each frame (after the currents are converted);
+/// a rule is evaluated only on the frames in which its signal (the registers or the coils) was read
+void evaluateAlarms( AcquisitionFrame * FramePtr ){
+	uint32_t ActiveAlarmsMask[CUPS_NUMBER] = {0};
+
+	for (int J=0; J < AlarmsNumber; J++){
+		const AlarmDefinition * AlarmPtr = &Alarms[J];
+		AlarmState * StatePtr = &AlarmStates[J];
+		bool IsCoilAlarm = (AlarmPtr->Condition >= AlarmConditions::COIL_ON);
+		uint8_t UpdatedFlag = IsCoilAlarm? FRAME_QUALITY_COILS_UPDATED : FRAME_QUALITY_REGISTERS_UPDATED;
+
+		if (0 != (FramePtr->QualityFlags & UpdatedFlag)){
+			std::chrono::high_resolution_clock::time_point Time;
+			double Value;
+			bool IsValueValid;
+			if (IsCoilAlarm){
+				Value = FramePtr->Coils[AlarmPtr->CupIndex*MODBUS_COILS_PER_CUP + AlarmPtr->Channel]? 1.0 : 0.0;
+				Time = FramePtr->CoilsTime;
+				IsValueValid = true;
+			}
+			else{
+				// the currents of a removed cup are not measured
+				bool IsCupInserted = FramePtr->Coils[COIL_OFFSET_IS_SWITCH_PRESSED + AlarmPtr->CupIndex*MODBUS_COILS_PER_CUP];
+				Value = getChannelValue( FramePtr, AlarmPtr->CupIndex, AlarmPtr->Channel );
+				Time = FramePtr->RegistersTime;
+				IsValueValid = !std::isnan( Value ) && (IsCupInserted || (AlarmPtr->Channel >= VISIBLE_VALUES_PER_DISC));
+			}
+
+			bool IsMet = false;
+			bool IsCleared = false;		// an invalid value (e.g. of a removed cup) keeps the alarm active
+			if (IsValueValid){
+				switch (AlarmPtr->Condition){
+				case AlarmConditions::ABOVE:
+					IsMet = (Value > AlarmPtr->Level);
+					IsCleared = (Value < AlarmPtr->Level - AlarmPtr->Hysteresis);
+					break;
+				case AlarmConditions::BELOW:
+					IsMet = (Value < AlarmPtr->Level);
+					IsCleared = (Value > AlarmPtr->Level + AlarmPtr->Hysteresis);
+					break;
+				case AlarmConditions::COIL_ON:
+					IsMet = (Value > 0.5);
+					IsCleared = !IsMet;
+					break;
+				case AlarmConditions::COIL_OFF:
+					IsMet = (Value < 0.5);
+					IsCleared = !IsMet;
+					break;
+				}
+			}
+
+			if (!IsMet){
+				StatePtr->IsConditionMet = false;
+			}
+			else if (!StatePtr->IsConditionMet){
+				StatePtr->IsConditionMet = true;
+				StatePtr->ConditionStartTime = Time;
+			}
+
+			if (!StatePtr->IsActive){
+				if (StatePtr->IsConditionMet &&
+						(std::chrono::duration_cast<std::chrono::milliseconds>(Time - StatePtr->ConditionStartTime).count() >= AlarmPtr->Delay))
+				{
+					raiseAlarm( J, FramePtr, Value, Time );
+				}
+			}
+			else if (IsCleared){
+				StatePtr->IsActive = false;
+				AlarmEvent Event;
+				Event.Type = AlarmEventTypes::CLEARED;
+				Event.AlarmIndex = J;
+				Event.Time = Time;
+				Event.Value = (float)Value;
+				Event.Latency = 0.0f;
+				pushLogEvent( &AlarmLog, &Event );
+			}
+		}
+
+		if (StatePtr->IsActive){
+			ActiveAlarmsMask[AlarmPtr->CupIndex] |= (1u << J);
+		}
+	}
+
+	for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+		FramePtr->Derived[Cup].ActiveAlarmsMask = ActiveAlarmsMask[Cup];
+	}
+}
+
+/// The peripheral thread writes the coil of the interlock without waiting for the coils to be read
+bool isInterlockPending(void){
+	return (0 != PendingInterlocks);
+}
+
+/// This function is called by the peripheral thread before each write of the coil that inserts or removes a cup;
+/// an insertion requested by the GUI between the interlock and its acknowledgement is turned into a removal
+bool filterCoilRequest( int CupIndex, bool RequestedValue ){
+	uint32_t Latched = atomic_load_explicit( &LatchedInterlocks, std::memory_order_acquire ) | PendingInterlocks;
+	if (0 != (Latched & (1u << CupIndex))){
+		return false;
+	}
+	return RequestedValue;
+}
+
+/// This function is called by the GUI thread
+bool isInterlockLatched( int CupIndex ){
+	return (0 != (atomic_load_explicit( &LatchedInterlocks, std::memory_order_acquire ) & (1u << CupIndex)));
+}
+
+/// This function is called by the GUI thread when the operator confirms the insertion of an interlocked cup
+void acknowledgeInterlock( int CupIndex ){
+	atomic_fetch_and_explicit( &LatchedInterlocks, ~(1u << CupIndex), std::memory_order_acq_rel );
+}
+
+/// This function is called by the peripheral thread after each write of the coil that inserts or removes a cup
+void reportCoilWritten( int CupIndex, FailureCodes Result ){
+	if (0 == (PendingInterlocks & (1u << CupIndex))){
+		return;
+	}
+	if (FailureCodes::NO_FAILURE != Result){
+		// the removal is repeated in the next cycle
+		atomic_store_explicit( &ModbusCoilRequestedValue[CupIndex], false, std::memory_order_release );
+		atomic_store_explicit( &ModbusCoilChangeReqest[CupIndex], true, std::memory_order_release );
+		return;
+	}
+	PendingInterlocks &= ~(1u << CupIndex);
+
+	std::chrono::high_resolution_clock::time_point TimeNow = std::chrono::high_resolution_clock::now();
+	int64_t Latency = std::chrono::duration_cast<std::chrono::microseconds>(TimeNow - InterlockDetectionTime[CupIndex]).count();
+	atomic_store_explicit( &LastInterlockLatency, Latency, std::memory_order_relaxed );
+	if (!atomic_load_explicit( &IsInterlockLatencyMeasured, std::memory_order_relaxed ) ||
+			(Latency > atomic_load_explicit( &MaximumInterlockLatency, std::memory_order_relaxed )))
+	{
+		atomic_store_explicit( &MaximumInterlockLatency, Latency, std::memory_order_relaxed );
+	}
+	atomic_store_explicit( &IsInterlockLatencyMeasured, true, std::memory_order_release );
+
+	AlarmEvent Event;
+	Event.Type = AlarmEventTypes::INTERLOCK;
+	Event.AlarmIndex = InterlockAlarmIndex[CupIndex];
+	Event.Time = TimeNow;
+	Event.Value = (float)CupIndex;
+	Event.Latency = (float)(0.001 * Latency);
+	pushLogEvent( &AlarmLog, &Event );
+}
+
+/// This function is called by the GUI thread
+/// @return false if no interlock has been performed yet; otherwise the latencies in milliseconds
+bool getInterlockLatency( double * LastLatencyPtr, double * MaximumLatencyPtr ){
+	if (!atomic_load_explicit( &IsInterlockLatencyMeasured, std::memory_order_acquire )){
+		return false;
+	}
+	*LastLatencyPtr = 0.001 * atomic_load_explicit( &LastInterlockLatency, std::memory_order_relaxed );
+	*MaximumLatencyPtr = 0.001 * atomic_load_explicit( &MaximumInterlockLatency, std::memory_order_relaxed );
+	return true;
+}
+
+/// The description of a rule, e.g. "KRYTYCZNY: Pierścień zewnętrzny > 500 μA" or "ALARM: cewka 3 = 0"
+void formatAlarmDescription( char * TextPtr, size_t TextSize, int AlarmIndex ){
+	const AlarmDefinition * AlarmPtr = &Alarms[AlarmIndex];
+	const char * SeverityName = SeverityNames[(int)AlarmPtr->Severity];
+	switch (AlarmPtr->Condition){
+	case AlarmConditions::ABOVE:
+	case AlarmConditions::BELOW:
+		snprintf( TextPtr, TextSize, "%s: %s %s %g %s", SeverityName, ChannelName[AlarmPtr->CupIndex][AlarmPtr->Channel],
+				(AlarmConditions::ABOVE == AlarmPtr->Condition)? ">" : "<", AlarmPtr->Level,
+				ChannelUnit[AlarmPtr->CupIndex][AlarmPtr->Channel] );
+		break;
+	case AlarmConditions::COIL_ON:
+	case AlarmConditions::COIL_OFF:
+		snprintf( TextPtr, TextSize, "%s: cewka %d = %d", SeverityName, AlarmPtr->Channel+1,
+				(AlarmConditions::COIL_ON == AlarmPtr->Condition)? 1 : 0 );
+		break;
+	}
+}
+
+/// This function is called by the GUI thread; the events since the previous call are appended to the log file
+void writeAlarmLog(void){
+	writeEventLog( &AlarmLog );
+}
+
+static void raiseAlarm( int AlarmIndex, const AcquisitionFrame * FramePtr, double Value,
+		std::chrono::high_resolution_clock::time_point Time )
+{
+	AlarmStates[AlarmIndex].IsActive = true;
+	if (Alarms[AlarmIndex].InterlockCupIndex >= 0){
+		requestInterlock( AlarmIndex, FramePtr, Time );
+	}
+
+	AlarmEvent Event;
+	Event.Type = AlarmEventTypes::RAISED;
+	Event.AlarmIndex = AlarmIndex;
+	Event.Time = Time;
+	Event.Value = (float)Value;
+	Event.Latency = 0.0f;
+	pushLogEvent( &AlarmLog, &Event );
+}
+
+/// The removal of the cup is queued like a click of its button; nothing is done if the cup is already removed
+static void requestInterlock( int AlarmIndex, const AcquisitionFrame * FramePtr,
+		std::chrono::high_resolution_clock::time_point Time )
+{
+	int Cup = Alarms[AlarmIndex].InterlockCupIndex;
+	bool IsCupForced = FramePtr->Coils[COIL_OFFSET_IS_CUP_FORCED + Cup*MODBUS_COILS_PER_CUP];
+	bool IsSwitchPressed = FramePtr->Coils[COIL_OFFSET_IS_SWITCH_PRESSED + Cup*MODBUS_COILS_PER_CUP];
+	if (!IsCupForced && !IsSwitchPressed){
+		return;
+	}
+	abandonActuatorTravel( Cup );
+	atomic_store_explicit( &CupInsertionOrRemovalStartTime[Cup], std::chrono::high_resolution_clock::now(),
+			std::memory_order_release );
+	atomic_store_explicit( &ModbusCoilRequestedValue[Cup], false, std::memory_order_release );
+	atomic_store_explicit( &ModbusCoilChangeReqest[Cup], true, std::memory_order_release );
+	PendingInterlocks |= (1u << Cup);
+	atomic_fetch_or_explicit( &LatchedInterlocks, (1u << Cup), std::memory_order_acq_rel );
+	InterlockDetectionTime[Cup] = Time;
+	InterlockAlarmIndex[Cup] = AlarmIndex;
+}
+
+/// The line of the log is dated with the readout that raised or cleared the alarm, or with the coil written
+static std::chrono::high_resolution_clock::time_point formatAlarmEvent( const void * EventPtr, char * TextPtr, size_t TextSize ){
+	const AlarmEvent * AlarmEventPtr = (const AlarmEvent *)EventPtr;
+	char Description[2*CHANNEL_NAME_MAX_LENGTH + 60];
+	formatAlarmDescription( Description, sizeof(Description), AlarmEventPtr->AlarmIndex );
+	switch (AlarmEventPtr->Type){
+	case AlarmEventTypes::RAISED:
+		snprintf( TextPtr, TextSize, "kubek %d  początek  %s  (wartość %.4g)",
+				Alarms[AlarmEventPtr->AlarmIndex].CupIndex+1, Description, (double)AlarmEventPtr->Value );
+		break;
+	case AlarmEventTypes::CLEARED:
+		snprintf( TextPtr, TextSize, "kubek %d  koniec    %s  (wartość %.4g)",
+				Alarms[AlarmEventPtr->AlarmIndex].CupIndex+1, Description, (double)AlarmEventPtr->Value );
+		break;
+	case AlarmEventTypes::INTERLOCK:
+		snprintf( TextPtr, TextSize, "kubek %d  wysunięty (alarm %d)  opóźnienie %.1f ms",
+				(int)AlarmEventPtr->Value + 1, AlarmEventPtr->AlarmIndex+1, (double)AlarmEventPtr->Latency );
+		break;
+	}
+	return AlarmEventPtr->Time;
+}
@@ -0,0 +1,55 @@
+/// @file alarms.h
+
+#ifndef SOURCE_ALARMS_H_
+#define SOURCE_ALARMS_H_
+
+#include <chrono>
+#include <cstddef>
+
+#include "config.h"
+#include "shared_data.h"
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+enum class AlarmEventTypes
+{
+	RAISED,
+	CLEARED,
+	INTERLOCK,			// the cup removal coil has been written
+};
+
+struct AlarmEvent {
+	AlarmEventTypes Type;
+	int AlarmIndex;						// index in Alarms[]
+	std::chrono::high_resolution_clock::time_point Time;
+	float Value;						// the value of the channel or the coil (0/1); INTERLOCK: the index of the cup
+	float Latency;						// ms; INTERLOCK only: from the readout that raised the alarm to the coil written
+};
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+void initializeAlarms(void);
+
+void evaluateAlarms( AcquisitionFrame * FramePtr );
+
+bool isInterlockPending(void);
+
+bool filterCoilRequest( int CupIndex, bool RequestedValue );
+
+bool isInterlockLatched( int CupIndex );
+
+void acknowledgeInterlock( int CupIndex );
+
+void reportCoilWritten( int CupIndex, FailureCodes Result );
+
+void writeAlarmLog(void);
+
+void formatAlarmDescription( char * TextPtr, size_t TextSize, int AlarmIndex );
+
+bool getInterlockLatency( double * LastLatencyPtr, double * MaximumLatencyPtr );
+
+#endif // SOURCE_ALARMS_H_
@@ -0,0 +1,148 @@
+/// @file auto_zero.cpp
+///
+/// Automatic zero calibration: with the beam switched off, the peripheral thread collects AutoZeroSamplesNumber
+/// frames of raw registers; the baseline of each cup is the median of its valid samples (a single spike or
+/// a few corrupted readouts do not move it). The GUI thread then shifts the calibration function, so that
+/// the baseline gives zero current, and switches the conversion table atomically (see applyZeroShift).
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <atomic>
+#include <algorithm>
+#include <iostream>
+
+#include "auto_zero.h"
+#include "current_conversion.h"
+#include "settings_file.h"
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+static std::atomic<AutoZeroStates> AutoZeroState( AutoZeroStates::IDLE );
+
+/// This flag is set by the GUI thread and taken by the peripheral thread
+static std::atomic<bool> AutoZeroRequest( false );
+
+/// Used by the GUI thread only
+static bool SaveAutoZeroToFile;
+
+/// The raw samples of the visible channels of each cup; used by the peripheral thread only
+static uint16_t BaselineSamples[CUPS_NUMBER][AUTO_ZERO_SAMPLES_MAX*VISIBLE_VALUES_PER_DISC];
+static int BaselineSamplesNumber[CUPS_NUMBER];
+static int CollectedFramesNumber;
+
+/// The medians of the samples (NaN if the cup gave no valid sample); written by the peripheral thread
+/// before AutoZeroState becomes COMPLETED, read by the GUI thread after that
+static double BaselineRegister[CUPS_NUMBER];
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+/// This function is called by the GUI thread (the operator confirms that the beam is switched off)
+/// @return false if the previous auto-zero is not finished yet
+bool requestAutoZero( bool SaveToFile ){
+	if (AutoZeroStates::IDLE != atomic_load_explicit( &AutoZeroState, std::memory_order_acquire )){
+		return false;
+	}
+	SaveAutoZeroToFile = SaveToFile;
+	atomic_store_explicit( &AutoZeroRequest, true, std::memory_order_release );
+	return true;
+}
+
+AutoZeroStates getAutoZeroState(void){
+	return atomic_load_explicit( &AutoZeroState, std::memory_order_acquire );
+}
+
+/// This function is called by the peripheral thread for each frame with new registers
+void processAutoZero( const AcquisitionFrame * FramePtr ){
+	if (atomic_exchange_explicit( &AutoZeroRequest, false, std::memory_order_acquire )){
+		for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+			BaselineSamplesNumber[Cup] = 0;
+		}
+		CollectedFramesNumber = 0;
+		atomic_store_explicit( &AutoZeroState, AutoZeroStates::COLLECTING, std::memory_order_release );
+	}
+	if (AutoZeroStates::COLLECTING != atomic_load_explicit( &AutoZeroState, std::memory_order_relaxed )){
+		return;
+	}
+
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		for (int J=0; J < VISIBLE_VALUES_PER_DISC; J++){
+			uint16_t RegisterValue = FramePtr->InputRegisters[Cup*MODBUS_INPUTS_PER_CUP + J];
+			if (RegisterValue < 0x8000){
+				BaselineSamples[Cup][BaselineSamplesNumber[Cup]++] = RegisterValue;
+			}
+		}
+	}
+	CollectedFramesNumber++;
+	if (CollectedFramesNumber < AutoZeroSamplesNumber){
+		return;
+	}
+
+	for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+		int Number = BaselineSamplesNumber[Cup];
+		if (0 == Number){
+			BaselineRegister[Cup] = std::numeric_limits<double>::quiet_NaN();
+			continue;
+		}
+		uint16_t * SamplesPtr = BaselineSamples[Cup];
+		std::nth_element( SamplesPtr, SamplesPtr + Number/2, SamplesPtr + Number );
+		double Median = SamplesPtr[Number/2];
+		if (0 == Number % 2){
+			double LowerMedian = *std::max_element( SamplesPtr, SamplesPtr + Number/2 );
+			Median = 0.5 * (Median + LowerMedian);
+		}
+		BaselineRegister[Cup] = Median;
+	}
+	atomic_store_explicit( &AutoZeroState, AutoZeroStates::COMPLETED, std::memory_order_release );
+}
+
+/// This function is called by the GUI thread; when the baselines are ready, the zero shifts are applied
+/// (and optionally written to the configuration file)
+/// @return true if the auto-zero has just been finished; the report for the operator is then in ReportPtr
+bool finishAutoZero( char * ReportPtr, size_t ReportSize ){
+	if (AutoZeroStates::COMPLETED != atomic_load_explicit( &AutoZeroState, std::memory_order_acquire )){
+		return false;
+	}
+
+	int Length = snprintf( ReportPtr, ReportSize, "Autozerowanie:" );
+	bool IsSuccessful = true;
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		double CalibrationZero;
+		if (std::isnan( BaselineRegister[Cup] )){
+			Length += snprintf( ReportPtr+Length, ReportSize-Length, "\n kubek %d: brak poprawnych odczytów", Cup+1 );
+			IsSuccessful = false;
+		}
+		else if (!findCalibrationZero( Cup, BaselineRegister[Cup], &CalibrationZero )){
+			Length += snprintf( ReportPtr+Length, ReportSize-Length, "\n kubek %d: funkcja kalibracji nie ma zera", Cup+1 );
+			IsSuccessful = false;
+		}
+		else{
+			double PreviousShift = ZeroShift[Cup];
+			applyZeroShift( Cup, BaselineRegister[Cup] - CalibrationZero );
+			Length += snprintf( ReportPtr+Length, ReportSize-Length, "\n kubek %d: linia bazowa %.1f, korekta zera %.2f (było %.2f)",
+					Cup+1, BaselineRegister[Cup], ZeroShift[Cup], PreviousShift );
+		}
+		if (Length >= (int)ReportSize){
+			Length = (int)ReportSize - 1;
+		}
+	}
+
+	if (SaveAutoZeroToFile){
+		if (IsSuccessful && (FailureCodes::NO_FAILURE == saveZeroShiftsToConfigurationFile())){
+			snprintf( ReportPtr+Length, ReportSize-Length, "\nZapisano w pliku konfiguracyjnym" );
+		}
+		else{
+			snprintf( ReportPtr+Length, ReportSize-Length, "\nNie zapisano pliku konfiguracyjnego" );
+		}
+	}
+	if (VerboseMode){
+		std::cout << ReportPtr << std::endl;
+	}
+
+	atomic_store_explicit( &AutoZeroState, AutoZeroStates::IDLE, std::memory_order_release );
+	return true;
+}
@@ -0,0 +1,34 @@
+/// @file auto_zero.h
+
+#ifndef SOURCE_AUTO_ZERO_H_
+#define SOURCE_AUTO_ZERO_H_
+
+#include <cstddef>
+
+#include "config.h"
+#include "shared_data.h"
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+enum class AutoZeroStates
+{
+	IDLE,
+	COLLECTING,		// the peripheral thread collects the baseline samples
+	COMPLETED,		// the baselines are ready; the GUI thread applies them
+};
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+bool requestAutoZero( bool SaveToFile );
+
+AutoZeroStates getAutoZeroState(void);
+
+void processAutoZero( const AcquisitionFrame * FramePtr );
+
+bool finishAutoZero( char * ReportPtr, size_t ReportSize );
+
+#endif // SOURCE_AUTO_ZERO_H_
@@ -0,0 +1,243 @@
+/// @file beam_trips.cpp
+///
+/// Detection of beam trips (short drops of the total current of a cup). The detector runs in the peripheral
+/// thread; the times of the threshold crossings are interpolated between the readout times (RegistersTime),
+/// so the start and the duration of a trip do not depend on the polling period. The detected trips are passed
+/// to the GUI thread, which writes them to the log file (see event_log.cpp).
+
+#include <cmath>
+#include <ctime>
+#include <cstdio>
+#include <algorithm>
+
+#include "beam_trips.h"
+#include "event_log.h"
+#include "settings_file.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define BEAM_TRIP_LOG_FILE_NAME			"WyłączeniaWiązki.log"
+
+#define BEAM_TRIP_MAXIMUM_DURATION		60.0	// s; a longer drop is the beam switched off, not a trip
+#define BEAM_TRIP_REFERENCE_SMOOTHING	0.1		// exponential smoothing of the total current before a trip
+
+#define BEAM_TRIP_QUEUE_SIZE			64		// power of 2
+static_assert( 0 == (BEAM_TRIP_QUEUE_SIZE & (BEAM_TRIP_QUEUE_SIZE-1)) );
+
+#define SHIFT_DURATION_HOURS			8
+#define SHIFT_RATE_MINIMUM_HOURS		1.0		// the rate is related to at least one hour, so it does not spike
+												// just after the start of the shift (or of the application)
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+struct BeamTripDetector {
+	bool IsReferenceValid;			// the current has been above the threshold since the cup was inserted
+	bool IsTripped;
+	bool IsPreviousSampleValid;
+	double PreviousCurrent;
+	std::chrono::high_resolution_clock::time_point PreviousTime;
+	double ReferenceCurrent;
+	double MinimumCurrent;
+	std::chrono::high_resolution_clock::time_point TripStartTime;
+	uint32_t TripsNumber;
+	uint32_t ShiftTripsNumber;
+};
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static void determineShift( std::chrono::high_resolution_clock::time_point Time );
+
+static std::chrono::high_resolution_clock::time_point interpolateCrossing( double Threshold,
+		double Current0, std::chrono::high_resolution_clock::time_point Time0,
+		double Current1, std::chrono::high_resolution_clock::time_point Time1 );
+
+static std::chrono::high_resolution_clock::time_point formatBeamTripEvent( const void * EventPtr, char * TextPtr, size_t TextSize );
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+static BeamTripDetector BeamTripDetectors[CUPS_NUMBER];
+
+/// The queue of the detected trips; written by the peripheral thread, read by the GUI thread
+static BeamTripEvent BeamTripQueue[BEAM_TRIP_QUEUE_SIZE];
+static EventLog BeamTripLog = { BEAM_TRIP_LOG_FILE_NAME, "Wyłączenie wiązki", BeamTripQueue, sizeof(BeamTripEvent),
+		BEAM_TRIP_QUEUE_SIZE, formatBeamTripEvent, {0}, {0}, {0} };
+
+/// The beginning and the end of the current shift (peripheral thread only)
+static std::chrono::high_resolution_clock::time_point ShiftStartTime;
+static std::chrono::high_resolution_clock::time_point ShiftEndTime;
+static std::chrono::high_resolution_clock::time_point DetectionStartTime;
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+void initializeBeamTripDetection(void){
+	for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+		BeamTripDetectors[Cup].IsReferenceValid = false;
+		BeamTripDetectors[Cup].IsTripped = false;
+		BeamTripDetectors[Cup].IsPreviousSampleValid = false;
+		BeamTripDetectors[Cup].TripsNumber = 0;
+		BeamTripDetectors[Cup].ShiftTripsNumber = 0;
+	}
+	DetectionStartTime = std::chrono::high_resolution_clock::now();
+	determineShift( DetectionStartTime );
+}
+
+/// This function is called by the peripheral thread for each frame with new registers (after the currents are converted)
+void detectBeamTrips( AcquisitionFrame * FramePtr ){
+	std::chrono::high_resolution_clock::time_point Time = FramePtr->RegistersTime;
+	if (Time >= ShiftEndTime){
+		determineShift( Time );
+		for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+			BeamTripDetectors[Cup].ShiftTripsNumber = 0;
+		}
+	}
+	std::chrono::high_resolution_clock::time_point CountingStartTime = (ShiftStartTime > DetectionStartTime)? ShiftStartTime : DetectionStartTime;
+	double ShiftHours = std::max( std::chrono::duration<double>(Time - CountingStartTime).count() / 3600.0,
+			SHIFT_RATE_MINIMUM_HOURS );
+
+	for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+		BeamTripDetector * DetectorPtr = &BeamTripDetectors[Cup];
+		CupDerivedData * DerivedPtr = &FramePtr->Derived[Cup];
+		bool IsCupInserted = FramePtr->Coils[COIL_OFFSET_IS_SWITCH_PRESSED + Cup*MODBUS_COILS_PER_CUP];
+
+		if (!IsBeamTripDetected[Cup] || !IsCupInserted){
+			// a trip cannot be measured without the cup in the beam; the trip in progress is abandoned
+			DetectorPtr->IsReferenceValid = false;
+			DetectorPtr->IsTripped = false;
+			DetectorPtr->IsPreviousSampleValid = false;
+		}
+		else{
+			double TotalCurrent = 0.0;
+			bool IsSampleValid = true;
+			for (int J=0; J < VISIBLE_VALUES_PER_DISC; J++){
+				if (std::isnan( DerivedPtr->Currents[J] )){
+					IsSampleValid = false;
+				}
+				else{
+					TotalCurrent += DerivedPtr->Currents[J];	// not filtered: the filters would smear short trips
+				}
+			}
+
+			if (IsSampleValid){
+				double Threshold = BeamTripThreshold[Cup];
+				bool IsBelow = (TotalCurrent < Threshold);
+
+				if (!DetectorPtr->IsTripped){
+					if (!IsBelow){
+						if (DetectorPtr->IsReferenceValid){
+							DetectorPtr->ReferenceCurrent += BEAM_TRIP_REFERENCE_SMOOTHING * (TotalCurrent - DetectorPtr->ReferenceCurrent);
+						}
+						else{
+							DetectorPtr->ReferenceCurrent = TotalCurrent;
+							DetectorPtr->IsReferenceValid = true;
+						}
+					}
+					else if (DetectorPtr->IsReferenceValid && DetectorPtr->IsPreviousSampleValid){
+						DetectorPtr->IsTripped = true;
+						DetectorPtr->MinimumCurrent = TotalCurrent;
+						DetectorPtr->TripStartTime = interpolateCrossing( Threshold, DetectorPtr->PreviousCurrent, DetectorPtr->PreviousTime,
+								TotalCurrent, Time );
+					}
+				}
+				else{
+					if (IsBelow){
+						if (TotalCurrent < DetectorPtr->MinimumCurrent){
+							DetectorPtr->MinimumCurrent = TotalCurrent;
+						}
+					}
+					else{
+						std::chrono::high_resolution_clock::time_point TripEndTime = interpolateCrossing( Threshold,
+								DetectorPtr->PreviousCurrent, DetectorPtr->PreviousTime, TotalCurrent, Time );
+						double Duration = std::chrono::duration<double>(TripEndTime - DetectorPtr->TripStartTime).count();
+						if ((Duration >= 0.001 * BeamTripMinimumDuration[Cup]) && (Duration <= BEAM_TRIP_MAXIMUM_DURATION)){
+							BeamTripEvent Event;
+							Event.CupIndex = Cup;
+							Event.StartTime = DetectorPtr->TripStartTime;
+							Event.Duration = Duration;
+							Event.ReferenceCurrent = (float)DetectorPtr->ReferenceCurrent;
+							Event.MinimumCurrent = (float)DetectorPtr->MinimumCurrent;
+							Event.Depth = (float)(1.0 - DetectorPtr->MinimumCurrent / DetectorPtr->ReferenceCurrent);
+							pushLogEvent( &BeamTripLog, &Event );
+							DetectorPtr->TripsNumber++;
+							DetectorPtr->ShiftTripsNumber++;
+						}
+						DetectorPtr->IsTripped = false;
+						DetectorPtr->ReferenceCurrent = TotalCurrent;
+					}
+				}
+				DetectorPtr->PreviousCurrent = TotalCurrent;
+				DetectorPtr->PreviousTime = Time;
+			}
+			DetectorPtr->IsPreviousSampleValid = IsSampleValid;
+		}
+
+		DerivedPtr->BeamTripsNumber = DetectorPtr->TripsNumber;
+		DerivedPtr->ShiftBeamTripsNumber = DetectorPtr->ShiftTripsNumber;
+		DerivedPtr->ShiftBeamTripRate = (float)(DetectorPtr->ShiftTripsNumber / ShiftHours);
+		DerivedPtr->IsBeamTripped = DetectorPtr->IsTripped? 1 : 0;
+	}
+}
+
+/// This function is called by the GUI thread; the trips detected since the previous call are appended to the log file
+void writeBeamTripLog(void){
+	writeEventLog( &BeamTripLog );
+}
+
+/// The shifts last SHIFT_DURATION_HOURS and one of them begins at ShiftStartHour local time
+static void determineShift( std::chrono::high_resolution_clock::time_point Time ){
+	std::chrono::system_clock::time_point SystemTime = std::chrono::system_clock::now() +
+			std::chrono::duration_cast<std::chrono::system_clock::duration>(Time - std::chrono::high_resolution_clock::now());
+	time_t Seconds = std::chrono::system_clock::to_time_t( SystemTime );
+	struct tm LocalTime;
+	localtime_r( &Seconds, &LocalTime );
+	LocalTime.tm_hour = ShiftStartHour;
+	LocalTime.tm_min = 0;
+	LocalTime.tm_sec = 0;
+	LocalTime.tm_isdst = -1;
+	time_t ShiftStart = mktime( &LocalTime );
+	while (ShiftStart > Seconds){
+		ShiftStart -= SHIFT_DURATION_HOURS * 3600;
+	}
+	while (ShiftStart + SHIFT_DURATION_HOURS * 3600 <= Seconds){
+		ShiftStart += SHIFT_DURATION_HOURS * 3600;
+	}
+	ShiftStartTime = Time - std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(
+			SystemTime - std::chrono::system_clock::from_time_t( ShiftStart ));
+	ShiftEndTime = ShiftStartTime + std::chrono::hours( SHIFT_DURATION_HOURS );
+}
+
+/// The time at which the straight line between two samples crosses the threshold
+static std::chrono::high_resolution_clock::time_point interpolateCrossing( double Threshold,
+		double Current0, std::chrono::high_resolution_clock::time_point Time0,
+		double Current1, std::chrono::high_resolution_clock::time_point Time1 )
+{
+	if (Current0 == Current1){
+		return Time1;
+	}
+	double Fraction = (Current0 - Threshold) / (Current0 - Current1);
+	if (Fraction < 0.0){
+		Fraction = 0.0;
+	}
+	if (Fraction > 1.0){
+		Fraction = 1.0;
+	}
+	return Time0 + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>((Time1 - Time0) * Fraction);
+}
+
+/// The line of the log is dated with the start of the trip
+static std::chrono::high_resolution_clock::time_point formatBeamTripEvent( const void * EventPtr, char * TextPtr, size_t TextSize ){
+	const BeamTripEvent * TripPtr = (const BeamTripEvent *)EventPtr;
+	snprintf( TextPtr, TextSize, "kubek %d  czas %.3f s  głębokość %.0f%%  prąd %.2f -> %.2f uA",
+			TripPtr->CupIndex+1, TripPtr->Duration, 100.0 * TripPtr->Depth,
+			(double)TripPtr->ReferenceCurrent, (double)TripPtr->MinimumCurrent );
+	return TripPtr->StartTime;
+}
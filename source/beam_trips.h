@@ -0,0 +1,35 @@
+/// @file beam_trips.h
+
+#ifndef SOURCE_BEAM_TRIPS_H_
+#define SOURCE_BEAM_TRIPS_H_
+
+#include <chrono>
+
+#include "config.h"
+#include "shared_data.h"
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+/// A beam trip: the total current of the cup was below the threshold for at least the minimum duration
+struct BeamTripEvent {
+	int CupIndex;
+	std::chrono::high_resolution_clock::time_point StartTime;	// interpolated crossing of the threshold
+	double Duration;					// s; from the crossing down to the crossing up
+	float ReferenceCurrent;				// uA; the total current before the trip
+	float MinimumCurrent;				// uA; the lowest total current during the trip
+	float Depth;						// 1 - MinimumCurrent/ReferenceCurrent
+};
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+void initializeBeamTripDetection(void);
+
+void detectBeamTrips( AcquisitionFrame * FramePtr );
+
+void writeBeamTripLog(void);
+
+#endif // SOURCE_BEAM_TRIPS_H_
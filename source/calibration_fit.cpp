@@ -0,0 +1,389 @@
+/// @file calibration_fit.cpp
+///
+/// Command line mode (--kalibracja): least squares fit of the calibration function of each cup to the reference
+/// points "cup  register  current"; the result is printed as lines ready to be pasted into the configuration file.
+///
+/// The polynomial is fitted in the normalized variable t = (x - Center) / Scale (|t| <= 1), which keeps the normal
+/// equations well conditioned even for the 5th degree; the coefficients and their covariance are then transformed
+/// to the variable x used in the configuration file.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#include "calibration_fit.h"
+#include "settings_file.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define FIT_MAX_COEFFICIENTS		(CALIBRATION_POLYNOMIAL_MAX_DEGREE+1)
+#define FIT_LINE_MAX_LENGTH			400
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+struct CalibrationPoint {
+	double Register;
+	double Current;		// uA
+};
+
+struct FitResult {
+	int CoefficientsNumber;
+	double Coefficient[FIT_MAX_COEFFICIENTS];				// I = a0 + a1*x + a2*x^2 + ...
+	double Covariance[FIT_MAX_COEFFICIENTS][FIT_MAX_COEFFICIENTS];
+	double ResidualStandardDeviation;
+	double MaximumResidual;
+	double MaximumResidualRegister;
+	double DeterminationCoefficient;						// R^2
+	double MaximumConfidenceBand;							// half-width of the 95% band of the fitted current
+};
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+static const char * const CupOrdinal[CUPS_NUMBER] = { "pierwszym", "drugim", "trzecim" };
+
+static const char * const CupOrdinalGenitive[CUPS_NUMBER] = { "pierwszego", "drugiego", "trzeciego" };
+
+/// Two-sided 95% quantiles of the Student's t-distribution for 1 ... 30 degrees of freedom
+static const double StudentQuantile95[30] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static FailureCodes readCalibrationPoints( const char * FileNamePtr, std::vector<CalibrationPoint> * PointsPtr );
+
+static bool fitPolynomial( const std::vector<CalibrationPoint> * PointsPtr, int Degree, FitResult * ResultPtr );
+
+static bool invertMatrix( double Matrix[FIT_MAX_COEFFICIENTS][FIT_MAX_COEFFICIENTS], int Size );
+
+static double getStudentQuantile95( int DegreesOfFreedom );
+
+static void printFitResult( int CupIndex, int PointsNumber, const FitResult * ResultPtr );
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+/// This function is called instead of starting the GUI when the application is run with "--kalibracja"
+/// @return code defined in FailureCodes
+FailureCodes runCalibrationFit( const char * FileNamePtr, int Degree ){
+	std::vector<CalibrationPoint> Points[CUPS_NUMBER];
+
+	FailureCodes Result = readCalibrationPoints( FileNamePtr, Points );
+	if (FailureCodes::NO_FAILURE != Result){
+		return Result;
+	}
+
+	bool IsAnyCupFitted = false;
+	for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+		if (Points[Cup].empty()){
+			continue;
+		}
+		if ((int)Points[Cup].size() <= Degree + 1){
+			std::cout << "Kubek " << (Cup+1) << ": za mało punktów (" << Points[Cup].size() << ") dla wielomianu stopnia " << Degree
+					<< "; potrzeba co najmniej " << (Degree+2) << std::endl;
+			return FailureCodes::ERROR_CALIBRATION_FIT;
+		}
+		FitResult Fit;
+		if (!fitPolynomial( &Points[Cup], Degree, &Fit )){
+			std::cout << "Kubek " << (Cup+1) << ": układ równań jest osobliwy (za mało różnych wartości rejestru)" << std::endl;
+			return FailureCodes::ERROR_CALIBRATION_FIT;
+		}
+		printFitResult( Cup, (int)Points[Cup].size(), &Fit );
+
+		if (VerboseMode){
+			std::cout << "  Rejestr      Prąd [uA]    Dopasowanie   Residuum" << std::endl;
+			for (const CalibrationPoint & Point : Points[Cup]){
+				double Fitted = 0.0;
+				for (int K = Fit.CoefficientsNumber-1; K >= 0; K--){
+					Fitted = Fitted * Point.Register + Fit.Coefficient[K];
+				}
+				printf( "  %7.0f  %13.6g  %13.6g  %+10.3e\n", Point.Register, Point.Current, Fitted, Point.Current - Fitted );
+			}
+		}
+		IsAnyCupFitted = true;
+	}
+	if (!IsAnyCupFitted){
+		std::cout << "Brak punktów kalibracji w pliku: " << FileNamePtr << std::endl;
+		return FailureCodes::ERROR_CALIBRATION_FIT;
+	}
+	return FailureCodes::NO_FAILURE;
+}
+
+/// Each line of the file holds a point: the cup number (1 ... CUPS_NUMBER), the register value (decimal or
+/// hexadecimal 0x...) and the reference current in uA, separated by spaces, tabs or semicolons; a decimal comma
+/// is accepted (spreadsheet export); empty lines and lines starting with '#' are skipped
+static FailureCodes readCalibrationPoints( const char * FileNamePtr, std::vector<CalibrationPoint> * PointsPtr ){
+	FILE * File = fopen( FileNamePtr, "r" );
+	if (nullptr == File){
+		std::cout << "Nie można otworzyć pliku: " << FileNamePtr << std::endl;
+		return FailureCodes::ERROR_CALIBRATION_FIT_FILE;
+	}
+
+	char Line[FIT_LINE_MAX_LENGTH];
+	int LineNumber = 0;
+	while (nullptr != fgets( Line, sizeof(Line), File )){
+		LineNumber++;
+		for (char * CharacterPtr = Line; *CharacterPtr != 0; CharacterPtr++){
+			if (';' == *CharacterPtr){
+				*CharacterPtr = ' ';
+			}
+			else if (',' == *CharacterPtr){
+				*CharacterPtr = '.';
+			}
+		}
+		char * TextPtr = Line;
+		while ((' ' == *TextPtr) || ('\t' == *TextPtr)){
+			TextPtr++;
+		}
+		if (('#' == *TextPtr) || ('\n' == *TextPtr) || ('\r' == *TextPtr) || (0 == *TextPtr)){
+			continue;
+		}
+
+		char * EndPtr;
+		long Cup = strtol( TextPtr, &EndPtr, 10 );
+		bool IsCorrect = (EndPtr != TextPtr);
+		TextPtr = EndPtr;
+		long Register = strtol( TextPtr, &EndPtr, 0 );
+		IsCorrect = IsCorrect && (EndPtr != TextPtr);
+		TextPtr = EndPtr;
+		double Current = strtod( TextPtr, &EndPtr );
+		IsCorrect = IsCorrect && (EndPtr != TextPtr);
+		TextPtr = EndPtr;
+		while ((' ' == *TextPtr) || ('\t' == *TextPtr) || ('\n' == *TextPtr) || ('\r' == *TextPtr)){
+			TextPtr++;
+		}
+		IsCorrect = IsCorrect && (0 == *TextPtr) && std::isfinite( Current );
+
+		if (!IsCorrect){
+			std::cout << "Błędna linia " << LineNumber << " w pliku " << FileNamePtr << ": [" << Line << "]" << std::endl;
+			fclose( File );
+			return FailureCodes::ERROR_CALIBRATION_FIT_FILE;
+		}
+		if ((Cup < 1) || (Cup > PHYSICALLY_INSTALLED_CUPS) || (Register < 0) || (Register >= 0x8000)){
+			std::cout << "Numer kubka lub wartość rejestru poza zakresem w linii " << LineNumber << " w pliku " << FileNamePtr << std::endl;
+			fclose( File );
+			return FailureCodes::ERROR_CALIBRATION_FIT_FILE;
+		}
+		PointsPtr[Cup-1].push_back( CalibrationPoint{ (double)Register, Current } );
+	}
+	fclose( File );
+	return FailureCodes::NO_FAILURE;
+}
+
+/// Least squares fit by the normal equations in the normalized variable t; the cost is linear in the number
+/// of points (Degree+1)^2 operations per point
+static bool fitPolynomial( const std::vector<CalibrationPoint> * PointsPtr, int Degree, FitResult * ResultPtr ){
+	const int Size = Degree + 1;
+	const int Number = (int)PointsPtr->size();
+
+	double Center = 0.0;
+	for (const CalibrationPoint & Point : *PointsPtr){
+		Center += Point.Register;
+	}
+	Center /= Number;
+	double Scale = 0.0;
+	for (const CalibrationPoint & Point : *PointsPtr){
+		Scale = fmax( Scale, fabs( Point.Register - Center ));
+	}
+	if (0.0 == Scale){
+		return false;
+	}
+
+	double Normal[FIT_MAX_COEFFICIENTS][FIT_MAX_COEFFICIENTS] = {};
+	double RightSide[FIT_MAX_COEFFICIENTS] = {};
+	double Powers[FIT_MAX_COEFFICIENTS];
+	double MeanCurrent = 0.0;
+	for (const CalibrationPoint & Point : *PointsPtr){
+		double T = (Point.Register - Center) / Scale;
+		Powers[0] = 1.0;
+		for (int K=1; K < Size; K++){
+			Powers[K] = Powers[K-1] * T;
+		}
+		for (int J=0; J < Size; J++){
+			for (int K=0; K < Size; K++){
+				Normal[J][K] += Powers[J] * Powers[K];
+			}
+			RightSide[J] += Powers[J] * Point.Current;
+		}
+		MeanCurrent += Point.Current;
+	}
+	MeanCurrent /= Number;
+	if (!invertMatrix( Normal, Size )){
+		return false;
+	}
+
+	double NormalizedCoefficient[FIT_MAX_COEFFICIENTS];
+	for (int J=0; J < Size; J++){
+		NormalizedCoefficient[J] = 0.0;
+		for (int K=0; K < Size; K++){
+			NormalizedCoefficient[J] += Normal[J][K] * RightSide[K];
+		}
+	}
+
+	double SquaredResiduals = 0.0;
+	double SquaredDeviations = 0.0;
+	ResultPtr->MaximumResidual = 0.0;
+	ResultPtr->MaximumResidualRegister = PointsPtr->front().Register;
+	for (const CalibrationPoint & Point : *PointsPtr){
+		double T = (Point.Register - Center) / Scale;
+		double Fitted = 0.0;
+		for (int K = Size-1; K >= 0; K--){
+			Fitted = Fitted * T + NormalizedCoefficient[K];
+		}
+		double Residual = Point.Current - Fitted;
+		SquaredResiduals += Residual * Residual;
+		SquaredDeviations += (Point.Current - MeanCurrent) * (Point.Current - MeanCurrent);
+		if (fabs( Residual ) > fabs( ResultPtr->MaximumResidual )){
+			ResultPtr->MaximumResidual = Residual;
+			ResultPtr->MaximumResidualRegister = Point.Register;
+		}
+	}
+	double ResidualVariance = SquaredResiduals / (Number - Size);
+	ResultPtr->ResidualStandardDeviation = sqrt( ResidualVariance );
+	ResultPtr->DeterminationCoefficient = (SquaredDeviations > 0.0)? 1.0 - SquaredResiduals / SquaredDeviations : 1.0;
+
+	// the half-width of the confidence band at each point: t * sqrt(s^2 * p^T (X^T X)^-1 p), p = (1, t, t^2, ...)
+	double Quantile = getStudentQuantile95( Number - Size );
+	ResultPtr->MaximumConfidenceBand = 0.0;
+	for (const CalibrationPoint & Point : *PointsPtr){
+		double T = (Point.Register - Center) / Scale;
+		Powers[0] = 1.0;
+		for (int K=1; K < Size; K++){
+			Powers[K] = Powers[K-1] * T;
+		}
+		double Variance = 0.0;
+		for (int J=0; J < Size; J++){
+			for (int K=0; K < Size; K++){
+				Variance += Powers[J] * Normal[J][K] * Powers[K];
+			}
+		}
+		ResultPtr->MaximumConfidenceBand = fmax( ResultPtr->MaximumConfidenceBand, Quantile * sqrt( ResidualVariance * Variance ));
+	}
+
+	// a = Transformation * b, where Transformation[J][K] = C(K,J) * (-Center)^(K-J) / Scale^K for K >= J
+	double Transformation[FIT_MAX_COEFFICIENTS][FIT_MAX_COEFFICIENTS] = {};
+	for (int K=0; K < Size; K++){
+		double Binomial = 1.0;
+		for (int J=0; J <= K; J++){
+			if (J > 0){
+				Binomial = Binomial * (K - J + 1) / J;
+			}
+			Transformation[J][K] = Binomial * pow( -Center, K - J ) / pow( Scale, K );
+		}
+	}
+	ResultPtr->CoefficientsNumber = Size;
+	for (int J=0; J < Size; J++){
+		ResultPtr->Coefficient[J] = 0.0;
+		for (int K=0; K < Size; K++){
+			ResultPtr->Coefficient[J] += Transformation[J][K] * NormalizedCoefficient[K];
+		}
+	}
+	for (int J=0; J < Size; J++){
+		for (int L=0; L < Size; L++){
+			double Sum = 0.0;
+			for (int K=0; K < Size; K++){
+				for (int M=0; M < Size; M++){
+					Sum += Transformation[J][K] * Normal[K][M] * Transformation[L][M];
+				}
+			}
+			ResultPtr->Covariance[J][L] = ResidualVariance * Sum;
+		}
+	}
+	return true;
+}
+
+/// Gauss-Jordan elimination with partial pivoting; the matrix is replaced by its inverse
+/// @return false if the matrix is singular
+static bool invertMatrix( double Matrix[FIT_MAX_COEFFICIENTS][FIT_MAX_COEFFICIENTS], int Size ){
+	double Inverse[FIT_MAX_COEFFICIENTS][FIT_MAX_COEFFICIENTS] = {};
+	for (int J=0; J < Size; J++){
+		Inverse[J][J] = 1.0;
+	}
+	for (int Column=0; Column < Size; Column++){
+		int Pivot = Column;
+		for (int J = Column+1; J < Size; J++){
+			if (fabs( Matrix[J][Column] ) > fabs( Matrix[Pivot][Column] )){
+				Pivot = J;
+			}
+		}
+		if (fabs( Matrix[Pivot][Column] ) < 1e-12 * fabs( Matrix[0][0] )){
+			return false;
+		}
+		for (int K=0; K < Size; K++){
+			std::swap( Matrix[Column][K], Matrix[Pivot][K] );
+			std::swap( Inverse[Column][K], Inverse[Pivot][K] );
+		}
+		double Divisor = Matrix[Column][Column];
+		for (int K=0; K < Size; K++){
+			Matrix[Column][K] /= Divisor;
+			Inverse[Column][K] /= Divisor;
+		}
+		for (int J=0; J < Size; J++){
+			if (J != Column){
+				double Factor = Matrix[J][Column];
+				for (int K=0; K < Size; K++){
+					Matrix[J][K] -= Factor * Matrix[Column][K];
+					Inverse[J][K] -= Factor * Inverse[Column][K];
+				}
+			}
+		}
+	}
+	memcpy( Matrix, Inverse, sizeof(Inverse) );
+	return true;
+}
+
+/// Above 30 degrees of freedom the Cornish-Fisher expansion around the normal quantile is used
+static double getStudentQuantile95( int DegreesOfFreedom ){
+	if (DegreesOfFreedom <= 30){
+		return StudentQuantile95[DegreesOfFreedom-1];
+	}
+	const double Z = 1.959964;
+	double Nu = DegreesOfFreedom;
+	return Z + (Z*Z*Z + Z) / (4.0*Nu) + (5.0*pow(Z,5) + 16.0*Z*Z*Z + 3.0*Z) / (96.0*Nu*Nu);
+}
+
+/// The linear fit I = a0 + a1*x is printed as the formula I = a1*(x + a0/a1) if a1 > 0 (the only form accepted
+/// by the configuration file); the offset must be an integer there, so its fractional part goes to the zero shift
+static void printFitResult( int CupIndex, int PointsNumber, const FitResult * ResultPtr ){
+	double Quantile = getStudentQuantile95( PointsNumber - ResultPtr->CoefficientsNumber );
+
+	printf( "\nKubek %d: %d punktów, stopień %d\n", CupIndex+1, PointsNumber, ResultPtr->CoefficientsNumber-1 );
+	for (int J=0; J < ResultPtr->CoefficientsNumber; J++){
+		printf( "  a%d = %+.9e  ± %.3e (95%%)\n", J, ResultPtr->Coefficient[J], Quantile * sqrt( ResultPtr->Covariance[J][J] ));
+	}
+	printf( "  Odchylenie standardowe residuów: %.4g uA\n", ResultPtr->ResidualStandardDeviation );
+	printf( "  Największe residuum: %+.4g uA (x = %.0f)\n", ResultPtr->MaximumResidual, ResultPtr->MaximumResidualRegister );
+	printf( "  Największa połowa szerokości pasma ufności 95%%: %.4g uA\n", ResultPtr->MaximumConfidenceBand );
+	printf( "  R^2 = %.8f\n", ResultPtr->DeterminationCoefficient );
+
+	if ((2 == ResultPtr->CoefficientsNumber) && (ResultPtr->Coefficient[1] > 0.0)){
+		double Offset = ResultPtr->Coefficient[0] / ResultPtr->Coefficient[1];
+		double IntegerOffset = round( Offset );
+		double OffsetUncertainty = Quantile * sqrt( ResultPtr->Covariance[0][0] ) / ResultPtr->Coefficient[1];
+		printf( "  Przesunięcie zera: %.3f ± %.3f\n", Offset, OffsetUncertainty );
+		printf( "Wzór na prądy w %s kubku: I = %.9g * (x %c %.0f)\n", CupOrdinal[CupIndex], ResultPtr->Coefficient[1],
+				(IntegerOffset < 0.0)? '-' : '+', fabs( IntegerOffset ));
+		printf( "Korekta zera %s kubka: %.3f\n", CupOrdinalGenitive[CupIndex], IntegerOffset - Offset );
+	}
+	else{
+		printf( "Wielomian na prądy w %s kubku:", CupOrdinal[CupIndex] );
+		for (int J=0; J < ResultPtr->CoefficientsNumber; J++){
+			printf( "%s%.12e", (0 == J)? " " : "; ", ResultPtr->Coefficient[J] );
+		}
+		printf( "\n" );
+	}
+}
@@ -0,0 +1,14 @@
+/// @file calibration_fit.h
+
+#ifndef SOURCE_CALIBRATION_FIT_H_
+#define SOURCE_CALIBRATION_FIT_H_
+
+#include "config.h"
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+FailureCodes runCalibrationFit( const char * FileNamePtr, int Degree );
+
+#endif // SOURCE_CALIBRATION_FIT_H_
@@ -0,0 +1,315 @@
+/// @file chunk_codec.cpp
+///
+/// The COMPRESSED encoding of the recording chunks. The payload begins with the sizes of the streams (uint32_t each,
+/// CHUNK_STREAMS_NUMBER of them), followed by the streams, one per field of RecordedFrame:
+/// - RegistersTime: delta-of-delta (the readouts are nearly periodic, so mostly the jitter remains),
+/// - CoilsTime and FrameNumber: delta (zero or nearly so),
+/// - each register: delta from the previous frame (the beam currents change slowly between samples),
+/// - Coils and QualityFlags: run-length encoding (run, value).
+/// The signed numbers are zigzag-mapped and all the numbers are varints (7 bits per byte, least significant first),
+/// so each stream is decoded with a tight loop of its own and a reader may skip the streams it does not need.
+
+#include <cstdio>
+#include <cstring>
+
+#include "chunk_codec.h"
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static inline uint64_t zigzagEncode( int64_t Value );
+
+static inline int64_t zigzagDecode( uint64_t Value );
+
+static inline uint8_t * putVarint( uint8_t * Ptr, uint64_t Value );
+
+static inline const uint8_t * getVarint( const uint8_t * Ptr, const uint8_t * EndPtr, uint64_t * ValuePtr );
+
+static uint8_t * encodeRuns( uint8_t * Ptr, const RecordedFrame * FramesPtr, int FramesNumber, bool IsCoils );
+
+static bool decodeRuns( const uint8_t * Ptr, const uint8_t * EndPtr, RecordedFrame * FramesPtr, int FramesNumber,
+		bool IsCoils );
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+/// @param FirstTime the RegistersTime of the first frame, stored in the chunk header
+/// @param PayloadPtr at least CHUNK_ENCODED_SIZE_MAX bytes
+/// @param StreamSizesPtr CHUNK_STREAMS_NUMBER sizes (bytes) of the streams, for the statistics of the compression
+/// @return the size of the payload
+size_t encodeChunk( const RecordedFrame * FramesPtr, int FramesNumber, int64_t FirstTime, uint8_t * PayloadPtr,
+		uint32_t * StreamSizesPtr )
+{
+	uint8_t * StreamStartPtr = PayloadPtr + CHUNK_STREAMS_NUMBER*sizeof(uint32_t);
+	uint8_t * Ptr = StreamStartPtr;
+
+	// the differences are taken modulo 2^64, like the sums of the decoder, so no time can overflow them
+	uint64_t PreviousTime = (uint64_t)FirstTime;
+	uint64_t PreviousDelta = 0;
+	for (int J=0; J < FramesNumber; J++){
+		uint64_t Delta = (uint64_t)FramesPtr[J].RegistersTime - PreviousTime;
+		Ptr = putVarint( Ptr, zigzagEncode( (int64_t)(Delta - PreviousDelta) ));
+		PreviousDelta = Delta;
+		PreviousTime = (uint64_t)FramesPtr[J].RegistersTime;
+	}
+	StreamSizesPtr[CHUNK_STREAM_REGISTERS_TIME] = (uint32_t)(Ptr - StreamStartPtr);
+	StreamStartPtr = Ptr;
+
+	PreviousTime = (uint64_t)FirstTime;
+	for (int J=0; J < FramesNumber; J++){
+		Ptr = putVarint( Ptr, zigzagEncode( (int64_t)((uint64_t)FramesPtr[J].CoilsTime - PreviousTime) ));
+		PreviousTime = (uint64_t)FramesPtr[J].CoilsTime;
+	}
+	StreamSizesPtr[CHUNK_STREAM_COILS_TIME] = (uint32_t)(Ptr - StreamStartPtr);
+	StreamStartPtr = Ptr;
+
+	uint64_t PreviousNumber = FramesPtr[0].FrameNumber;
+	for (int J=0; J < FramesNumber; J++){
+		Ptr = putVarint( Ptr, zigzagEncode( (int64_t)(FramesPtr[J].FrameNumber - PreviousNumber) ));
+		PreviousNumber = FramesPtr[J].FrameNumber + 1;
+	}
+	StreamSizesPtr[CHUNK_STREAM_FRAME_NUMBER] = (uint32_t)(Ptr - StreamStartPtr);
+	StreamStartPtr = Ptr;
+
+	for (int Register=0; Register < MODBUS_INPUTS_NUMBER; Register++){
+		int32_t PreviousValue = 0;
+		for (int J=0; J < FramesNumber; J++){
+			int32_t Value = FramesPtr[J].InputRegisters[Register];
+			Ptr = putVarint( Ptr, zigzagEncode( Value - PreviousValue ));
+			PreviousValue = Value;
+		}
+		StreamSizesPtr[CHUNK_STREAM_REGISTER(Register)] = (uint32_t)(Ptr - StreamStartPtr);
+		StreamStartPtr = Ptr;
+	}
+
+	Ptr = encodeRuns( Ptr, FramesPtr, FramesNumber, true );
+	StreamSizesPtr[CHUNK_STREAM_COILS] = (uint32_t)(Ptr - StreamStartPtr);
+	StreamStartPtr = Ptr;
+	Ptr = encodeRuns( Ptr, FramesPtr, FramesNumber, false );
+	StreamSizesPtr[CHUNK_STREAM_QUALITY] = (uint32_t)(Ptr - StreamStartPtr);
+
+	memcpy( PayloadPtr, StreamSizesPtr, CHUNK_STREAMS_NUMBER*sizeof(uint32_t) );
+	return (size_t)(Ptr - PayloadPtr);
+}
+
+/// Both the RAW and the COMPRESSED chunks are decoded; the header and the payload checksum must have been verified
+/// @param FramesPtr HeaderPtr->FramesNumber frames
+/// @return false if the payload is inconsistent with the header
+bool decodeChunk( const RecordingChunkHeader * HeaderPtr, const uint8_t * PayloadPtr, RecordedFrame * FramesPtr ){
+	int FramesNumber = HeaderPtr->FramesNumber;
+	if (ChunkEncodings::RAW == HeaderPtr->Encoding){
+		if (HeaderPtr->PayloadSize != FramesNumber*sizeof(RecordedFrame)){
+			return false;
+		}
+		memcpy( FramesPtr, PayloadPtr, HeaderPtr->PayloadSize );
+		return true;
+	}
+	if ((ChunkEncodings::COMPRESSED != HeaderPtr->Encoding) || (HeaderPtr->PayloadSize < CHUNK_STREAMS_NUMBER*sizeof(uint32_t))){
+		return false;
+	}
+
+	uint32_t StreamSizes[CHUNK_STREAMS_NUMBER];
+	memcpy( StreamSizes, PayloadPtr, sizeof(StreamSizes) );
+	const uint8_t * StreamPtr[CHUNK_STREAMS_NUMBER+1];
+	StreamPtr[0] = PayloadPtr + sizeof(StreamSizes);
+	const uint8_t * PayloadEndPtr = PayloadPtr + HeaderPtr->PayloadSize;
+	for (int Stream=0; Stream < CHUNK_STREAMS_NUMBER; Stream++){
+		if (StreamSizes[Stream] > (size_t)(PayloadEndPtr - StreamPtr[Stream])){
+			return false;
+		}
+		StreamPtr[Stream+1] = StreamPtr[Stream] + StreamSizes[Stream];
+	}
+	if (StreamPtr[CHUNK_STREAMS_NUMBER] != PayloadEndPtr){
+		return false;
+	}
+	memset( FramesPtr, 0, FramesNumber*sizeof(RecordedFrame) );
+
+	// the sums are accumulated modulo 2^64, so a corrupted stream cannot overflow a signed number
+	const uint8_t * Ptr = StreamPtr[CHUNK_STREAM_REGISTERS_TIME];
+	uint64_t Time = (uint64_t)HeaderPtr->FirstTime;
+	uint64_t Delta = 0;
+	for (int J=0; J < FramesNumber; J++){
+		uint64_t Value;
+		Ptr = getVarint( Ptr, StreamPtr[CHUNK_STREAM_REGISTERS_TIME+1], &Value );
+		if (nullptr == Ptr){
+			break;
+		}
+		Delta += (uint64_t)zigzagDecode( Value );
+		Time += Delta;
+		FramesPtr[J].RegistersTime = (int64_t)Time;
+	}
+	if (Ptr != StreamPtr[CHUNK_STREAM_REGISTERS_TIME+1]){
+		return false;
+	}
+
+	Ptr = StreamPtr[CHUNK_STREAM_COILS_TIME];
+	Time = (uint64_t)HeaderPtr->FirstTime;
+	for (int J=0; J < FramesNumber; J++){
+		uint64_t Value;
+		Ptr = getVarint( Ptr, StreamPtr[CHUNK_STREAM_COILS_TIME+1], &Value );
+		if (nullptr == Ptr){
+			break;
+		}
+		Time += (uint64_t)zigzagDecode( Value );
+		FramesPtr[J].CoilsTime = (int64_t)Time;
+	}
+	if (Ptr != StreamPtr[CHUNK_STREAM_COILS_TIME+1]){
+		return false;
+	}
+
+	Ptr = StreamPtr[CHUNK_STREAM_FRAME_NUMBER];
+	uint64_t Number = HeaderPtr->FirstFrameNumber;
+	for (int J=0; J < FramesNumber; J++){
+		uint64_t Value;
+		Ptr = getVarint( Ptr, StreamPtr[CHUNK_STREAM_FRAME_NUMBER+1], &Value );
+		if (nullptr == Ptr){
+			break;
+		}
+		Number += (uint64_t)zigzagDecode( Value );
+		FramesPtr[J].FrameNumber = Number;
+		Number++;
+	}
+	if (Ptr != StreamPtr[CHUNK_STREAM_FRAME_NUMBER+1]){
+		return false;
+	}
+
+	for (int Register=0; Register < MODBUS_INPUTS_NUMBER; Register++){
+		int Stream = CHUNK_STREAM_REGISTER(Register);
+		Ptr = StreamPtr[Stream];
+		uint64_t RegisterValue = 0;
+		for (int J=0; J < FramesNumber; J++){
+			uint64_t Value;
+			Ptr = getVarint( Ptr, StreamPtr[Stream+1], &Value );
+			if (nullptr == Ptr){
+				break;
+			}
+			RegisterValue += (uint64_t)zigzagDecode( Value );
+			FramesPtr[J].InputRegisters[Register] = (uint16_t)RegisterValue;
+		}
+		if (Ptr != StreamPtr[Stream+1]){
+			return false;
+		}
+	}
+
+	return decodeRuns( StreamPtr[CHUNK_STREAM_COILS], StreamPtr[CHUNK_STREAM_COILS+1], FramesPtr, FramesNumber, true ) &&
+			decodeRuns( StreamPtr[CHUNK_STREAM_QUALITY], StreamPtr[CHUNK_STREAM_QUALITY+1], FramesPtr, FramesNumber, false );
+}
+
+/// @return bytes per frame taken by the field in a RAW chunk
+size_t getChunkStreamRawSize( int Stream ){
+	switch (Stream){
+	case CHUNK_STREAM_REGISTERS_TIME:
+		return sizeof(RecordedFrame::RegistersTime);
+	case CHUNK_STREAM_COILS_TIME:
+		return sizeof(RecordedFrame::CoilsTime);
+	case CHUNK_STREAM_FRAME_NUMBER:
+		return sizeof(RecordedFrame::FrameNumber);
+	case CHUNK_STREAM_COILS:
+		return sizeof(RecordedFrame::Coils);
+	case CHUNK_STREAM_QUALITY:
+		return sizeof(RecordedFrame::QualityFlags);
+	default:
+		return sizeof(RecordedFrame::InputRegisters[0]);
+	}
+}
+
+void formatChunkStreamName( char * TextPtr, size_t TextSize, int Stream ){
+	switch (Stream){
+	case CHUNK_STREAM_REGISTERS_TIME:
+		snprintf( TextPtr, TextSize, "czas rejestrów" );
+		break;
+	case CHUNK_STREAM_COILS_TIME:
+		snprintf( TextPtr, TextSize, "czas cewek" );
+		break;
+	case CHUNK_STREAM_FRAME_NUMBER:
+		snprintf( TextPtr, TextSize, "numer ramki" );
+		break;
+	case CHUNK_STREAM_COILS:
+		snprintf( TextPtr, TextSize, "cewki" );
+		break;
+	case CHUNK_STREAM_QUALITY:
+		snprintf( TextPtr, TextSize, "jakość" );
+		break;
+	default:
+		snprintf( TextPtr, TextSize, "K%d rejestr %d", (Stream - CHUNK_STREAM_REGISTER(0)) / MODBUS_INPUTS_PER_CUP + 1,
+				(Stream - CHUNK_STREAM_REGISTER(0)) % MODBUS_INPUTS_PER_CUP + 1 );
+		break;
+	}
+}
+
+static inline uint64_t zigzagEncode( int64_t Value ){
+	return ((uint64_t)Value << 1) ^ (uint64_t)(Value >> 63);
+}
+
+static inline int64_t zigzagDecode( uint64_t Value ){
+	return (int64_t)(Value >> 1) ^ -(int64_t)(Value & 1);
+}
+
+static inline uint8_t * putVarint( uint8_t * Ptr, uint64_t Value ){
+	while (Value >= 0x80){
+		*Ptr++ = (uint8_t)(Value | 0x80);
+		Value >>= 7;
+	}
+	*Ptr++ = (uint8_t)Value;
+	return Ptr;
+}
+
+/// @return the pointer past the varint or nullptr if the stream ends in the middle of it
+static inline const uint8_t * getVarint( const uint8_t * Ptr, const uint8_t * EndPtr, uint64_t * ValuePtr ){
+	if ((Ptr < EndPtr) && (*Ptr < 0x80)){		// the most frequent case: one byte
+		*ValuePtr = *Ptr;
+		return Ptr + 1;
+	}
+	uint64_t Value = 0;
+	for (int Shift = 0; (Ptr < EndPtr) && (Shift < 64); Shift += 7){
+		uint8_t Byte = *Ptr++;
+		Value |= (uint64_t)(Byte & 0x7F) << Shift;
+		if (0 == (Byte & 0x80)){
+			*ValuePtr = Value;
+			return Ptr;
+		}
+	}
+	return nullptr;
+}
+
+/// Each run is written as two varints: the number of frames and the value (of the coils or the quality flags)
+static uint8_t * encodeRuns( uint8_t * Ptr, const RecordedFrame * FramesPtr, int FramesNumber, bool IsCoils ){
+	int RunStart = 0;
+	for (int J=1; J <= FramesNumber; J++){
+		uint32_t Previous = IsCoils? FramesPtr[J-1].Coils : FramesPtr[J-1].QualityFlags;
+		if ((J == FramesNumber) || (Previous != (IsCoils? FramesPtr[J].Coils : FramesPtr[J].QualityFlags))){
+			Ptr = putVarint( Ptr, (uint64_t)(J - RunStart) );
+			Ptr = putVarint( Ptr, Previous );
+			RunStart = J;
+		}
+	}
+	return Ptr;
+}
+
+static bool decodeRuns( const uint8_t * Ptr, const uint8_t * EndPtr, RecordedFrame * FramesPtr, int FramesNumber,
+		bool IsCoils )
+{
+	int J = 0;
+	while ((J < FramesNumber) && (Ptr < EndPtr)){
+		uint64_t Run, Value;
+		Ptr = getVarint( Ptr, EndPtr, &Run );
+		if (nullptr == Ptr){
+			return false;
+		}
+		Ptr = getVarint( Ptr, EndPtr, &Value );
+		if ((nullptr == Ptr) || (0 == Run) || (Run > (uint64_t)(FramesNumber - J))){
+			return false;
+		}
+		for (int End = J + (int)Run; J < End; J++){
+			if (IsCoils){
+				FramesPtr[J].Coils = (uint16_t)Value;
+			}
+			else{
+				FramesPtr[J].QualityFlags = (uint8_t)Value;
+			}
+		}
+	}
+	return (J == FramesNumber) && (Ptr == EndPtr);
+}
@@ -0,0 +1,43 @@
+/// @file chunk_codec.h
+
+#ifndef SOURCE_CHUNK_CODEC_H_
+#define SOURCE_CHUNK_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "config.h"
+#include "recording_format.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+// the streams of a COMPRESSED chunk, in the order of the payload
+#define CHUNK_STREAM_REGISTERS_TIME			0
+#define CHUNK_STREAM_COILS_TIME				1
+#define CHUNK_STREAM_FRAME_NUMBER			2
+#define CHUNK_STREAM_REGISTER(Index)		(3 + (Index))		// Index < MODBUS_INPUTS_NUMBER
+#define CHUNK_STREAM_COILS					(3 + MODBUS_INPUTS_NUMBER)
+#define CHUNK_STREAM_QUALITY				(4 + MODBUS_INPUTS_NUMBER)
+#define CHUNK_STREAMS_NUMBER				(5 + MODBUS_INPUTS_NUMBER)
+
+/// The worst case: 10-byte varints of the times and the frame numbers, 3-byte varints of the register deltas
+/// and a run of one frame for each change of the coils and the quality flags
+#define CHUNK_ENCODED_SIZE_MAX				(CHUNK_STREAMS_NUMBER*sizeof(uint32_t) + \
+		RECORDING_CHUNK_FRAMES_MAX*(3*10 + MODBUS_INPUTS_NUMBER*3 + 2*(2+3)))
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+size_t encodeChunk( const RecordedFrame * FramesPtr, int FramesNumber, int64_t FirstTime, uint8_t * PayloadPtr,
+		uint32_t * StreamSizesPtr );
+
+bool decodeChunk( const RecordingChunkHeader * HeaderPtr, const uint8_t * PayloadPtr, RecordedFrame * FramesPtr );
+
+size_t getChunkStreamRawSize( int Stream );
+
+void formatChunkStreamName( char * TextPtr, size_t TextSize, int Stream );
+
+#endif // SOURCE_CHUNK_CODEC_H_
@@ -13,6 +13,12 @@ static_assert( PHYSICALLY_INSTALLED_CUPS <= CUPS_NUMBER );
 
 #define VALUES_PER_DISC						5
 #define VISIBLE_VALUES_PER_DISC				3
+#define DIAGNOSTIC_VALUES_PER_DISC			(VALUES_PER_DISC - VISIBLE_VALUES_PER_DISC)	// registers after the currents
+
+// the currents of a cup in the order of the Modbus registers (as drawn by TripleDiscWidgetWithNoSlit)
+#define CURRENT_OF_OUTER_RING				0
+#define CURRENT_OF_MIDDLE_RING				1
+#define CURRENT_OF_INNER_CIRCLE				2
 
 #define CONFIGURATION_FILE_NAME				"PomiarWiązki.cfg"
 
@@ -21,6 +27,13 @@ static_assert( PHYSICALLY_INSTALLED_CUPS <= CUPS_NUMBER );
 
 #define MODBUS_RESPONSE_TIMEOUT				40	// milliseconds
 
+#define HISTORY_BUFFER_CAPACITY_DEFAULT		32768	// frames, power of 2; about 27 minutes of readouts, about 42 MB
+#define HISTORY_BUFFER_CAPACITY_MIN			1024	// frames
+#define HISTORY_BUFFER_CAPACITY_MAX			262144	// frames; about 3.6 hours of readouts, about 333 MB (1272 bytes per frame)
+static_assert( 0 == (HISTORY_BUFFER_CAPACITY_DEFAULT & (HISTORY_BUFFER_CAPACITY_DEFAULT-1)) );
+
+#define STATISTICS_WINDOWS_MAX				3		// the statistics of each channel are kept for up to 3 windows
+
 enum class FailureCodes
 {
     NO_FAILURE,
@@ -34,6 +47,22 @@ enum class FailureCodes
 	ERROR_SETTINGS_EXCESSIVE_PROPAGATION,
 	ERROR_SETTINGS_CONVERTION_PROPAGATION,
 	ERROR_SETTINGS_IMPROPER_PROPAGATION,
+	ERROR_SETTINGS_CALIBRATION_TABLE,
+	ERROR_SETTINGS_EXCESSIVE_PARAMETER,
+	ERROR_SETTINGS_IMPROPER_PARAMETER,
+	ERROR_SETTINGS_FILTER,
+	ERROR_SETTINGS_TRANSMISSION,
+	ERROR_SETTINGS_ZERO_SHIFT,
+	ERROR_SETTINGS_SAVING_FILE,
+	ERROR_SETTINGS_DIAGNOSTIC_CHANNEL,
+	ERROR_SETTINGS_BEAM_TRIP,
+	ERROR_SETTINGS_TRIGGER,
+	ERROR_SETTINGS_SPECTRUM,
+	ERROR_SETTINGS_ALARM,
+	ERROR_CALIBRATION_FIT_FILE,
+	ERROR_CALIBRATION_FIT,
+	ERROR_EXPORT,
+	ERROR_EXPORT_FILE,
 	ERROR_MODBUS_INITIALIZATION_1,
 	ERROR_MODBUS_INITIALIZATION_2,
 	ERROR_MODBUS_OPENING,
@@ -52,5 +81,9 @@ extern bool VeryVerboseMode;
 
 extern int StatusLevelForGui;
 
+extern bool ShowStatisticsInDiscs;
+
+extern int ShownStatisticsWindow;
+
 
 #endif // SOURCE_CONFIG_H_
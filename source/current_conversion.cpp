@@ -0,0 +1,194 @@
+/// @file current_conversion.cpp
+///
+/// Conversion of Modbus register values to currents in uA; the conversion formulas from the configuration
+/// file are evaluated once for every possible register value, so the conversion is a single table lookup
+/// shared by all the consumers (display, logging, export, statistics)
+
+#include <cmath>
+#include <limits>
+#include <cassert>
+#include <atomic>
+#include <chrono>
+
+#include "current_conversion.h"
+#include "settings_file.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define ZERO_SEARCH_RANGE			0x10000	// the zero of the calibration function is looked for within +/- this range
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+/// @brief Currents in uA for register values 0 ... CONVERSION_TABLE_SIZE-1; NaN marks a value without a current
+/// There are two tables per cup: the active one is used for the conversion, the other one is rebuilt
+/// when the zero shift changes (auto-zero) and then activated with a single atomic store.
+static float ConversionTables[CUPS_NUMBER][2][CONVERSION_TABLE_SIZE];
+
+static std::atomic<const float *> ActiveConversionTable[CUPS_NUMBER];
+
+/// @brief The zero shifts in effect and the moments they took effect (the high resolution clock, in ns), for the recorder
+/// They are written by applyZeroShift() only; the sequence number is odd while they are being changed.
+static std::atomic<uint32_t> ZeroShiftSequence;
+static std::atomic<double> ActiveZeroShift[CUPS_NUMBER];
+static std::atomic<int64_t> ZeroShiftTime[CUPS_NUMBER];
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static double evaluateCalibrationFunction( int CupIndex, double RegisterValue );
+
+static void publishZeroShift( int CupIndex );
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+/// This function is called after the configuration file has been parsed; whatever the calibration model
+/// (linear, polynomial, piecewise linear), the cost of the conversion of a sample is the same
+void buildConversionTables(void){
+	for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+		buildConversionTable( Cup, ZeroShift[Cup], ConversionTables[Cup][0] );
+		atomic_store_explicit( &ActiveConversionTable[Cup], ConversionTables[Cup][0], std::memory_order_release );
+		publishZeroShift( Cup );
+	}
+}
+
+/// @brief This function changes the zero shift of the cup at run time
+/// The inactive table is rebuilt and activated atomically; a consumer that is just converting a block of data
+/// with the previous table finishes it consistently (the previous table is overwritten only by the next change).
+void applyZeroShift( int CupIndex, double NewZeroShift ){
+	assert( CupIndex < CUPS_NUMBER );
+	const float * ActiveTablePtr = atomic_load_explicit( &ActiveConversionTable[CupIndex], std::memory_order_acquire );
+	float * InactiveTablePtr = (ActiveTablePtr == ConversionTables[CupIndex][0])? ConversionTables[CupIndex][1] : ConversionTables[CupIndex][0];
+
+	ZeroShift[CupIndex] = NewZeroShift;
+	buildConversionTable( CupIndex, NewZeroShift, InactiveTablePtr );
+	atomic_store_explicit( &ActiveConversionTable[CupIndex], InactiveTablePtr, std::memory_order_release );
+	publishZeroShift( CupIndex );
+}
+
+/// This function is called by the recorder, which keeps the zero shifts of the frames along with the recording
+/// @param ShiftsPtr, TimesPtr CUPS_NUMBER values each; the times are of the high resolution clock, in ns
+void getActiveZeroShifts( double * ShiftsPtr, int64_t * TimesPtr ){
+	uint32_t Sequence;
+	do{
+		Sequence = atomic_load_explicit( &ZeroShiftSequence, std::memory_order_acquire );
+		for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+			ShiftsPtr[Cup] = atomic_load_explicit( &ActiveZeroShift[Cup], std::memory_order_relaxed );
+			TimesPtr[Cup] = atomic_load_explicit( &ZeroShiftTime[Cup], std::memory_order_relaxed );
+		}
+		std::atomic_thread_fence( std::memory_order_acquire );
+	} while ((0 != (Sequence & 1)) || (Sequence != atomic_load_explicit( &ZeroShiftSequence, std::memory_order_relaxed )));
+}
+
+/// This function looks for the register value at which the calibration function (without the zero shift)
+/// gives zero current; the zero closest to NearRegisterValue is chosen
+/// @return false if the function has no zero in the searched range
+bool findCalibrationZero( int CupIndex, double NearRegisterValue, double * ZeroPtr ){
+	assert( CupIndex < CUPS_NUMBER );
+	double Start = floor( NearRegisterValue );
+	for (int Distance=0; Distance < ZERO_SEARCH_RANGE; Distance++){
+		for (int Direction=-1; Direction <= 1; Direction += 2){
+			double X0 = Start + Direction*Distance;
+			double X1 = X0 + 1.0;
+			double Y0 = evaluateCalibrationFunction( CupIndex, X0 );
+			double Y1 = evaluateCalibrationFunction( CupIndex, X1 );
+			if (0.0 == Y0){
+				*ZeroPtr = X0;
+				return true;
+			}
+			if ((Y0 < 0.0) != (Y1 < 0.0)){
+				*ZeroPtr = X0 + Y0 / (Y0 - Y1);	// linear interpolation within one step of the register
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/// @return current in uA or NaN if the register does not hold a valid measurement (0x8000 and above)
+float convertRegisterToCurrent( int CupIndex, uint16_t RegisterValue ){
+	assert( CupIndex < CUPS_NUMBER );
+	const float * TablePtr = atomic_load_explicit( &ActiveConversionTable[CupIndex], std::memory_order_acquire );
+	float Current = TablePtr[RegisterValue & (CONVERSION_TABLE_SIZE-1)];
+	return (RegisterValue < CONVERSION_TABLE_SIZE)? Current : std::numeric_limits<float>::quiet_NaN();
+}
+
+/// This function converts a block of registers of one cup (e.g. recorded data); the loop has no branches,
+/// so the compiler can turn it into a vector gather
+void convertRegistersToCurrents( int CupIndex, const uint16_t * __restrict RegistersPtr, float * __restrict CurrentsPtr, int Number ){
+	assert( CupIndex < CUPS_NUMBER );
+	const float * TablePtr = atomic_load_explicit( &ActiveConversionTable[CupIndex], std::memory_order_acquire );
+	convertRegistersThroughTable( TablePtr, RegistersPtr, CurrentsPtr, Number );
+}
+
+/// As convertRegistersToCurrents(), but through a table built by buildConversionTable() (e.g. for a recorded zero shift)
+void convertRegistersThroughTable( const float * TablePtr, const uint16_t * __restrict RegistersPtr,
+		float * __restrict CurrentsPtr, int Number )
+{
+	const float NotANumber = std::numeric_limits<float>::quiet_NaN();
+	for (int J=0; J < Number; J++){
+		int RegisterValue = RegistersPtr[J];	// int, not uint16_t: the index and the mask must be of the same width as float
+		float Current = TablePtr[RegisterValue & (CONVERSION_TABLE_SIZE-1)];
+		CurrentsPtr[J] = (RegisterValue < CONVERSION_TABLE_SIZE)? Current : NotANumber;
+	}
+}
+
+/// The calibration function of the cup as defined in the configuration file (the zero shift is not included)
+static double evaluateCalibrationFunction( int CupIndex, double RegisterValue ){
+	if (CalibrationModels::POLYNOMIAL == CalibrationModel[CupIndex]){
+		double Current = 0.0;
+		for (int K = PolynomialDegree[CupIndex]; K >= 0; K--){
+			Current = Current * RegisterValue + PolynomialCoefficient[CupIndex][K];	// Horner's method
+		}
+		return Current;
+	}
+	else if (CalibrationModels::PIECEWISE_LINEAR == CalibrationModel[CupIndex]){
+		// the first and the last segment are extrapolated beyond the table
+		int Lower = 0;
+		int Upper = CalibrationPointsNumber[CupIndex]-1;
+		while (Upper - Lower > 1){
+			int Middle = (Lower + Upper) / 2;
+			if (RegisterValue < CalibrationPointRegister[CupIndex][Middle]){
+				Upper = Middle;
+			}
+			else{
+				Lower = Middle;
+			}
+		}
+		double X0 = CalibrationPointRegister[CupIndex][Lower];
+		double X1 = CalibrationPointRegister[CupIndex][Upper];
+		double Y0 = CalibrationPointCurrent[CupIndex][Lower];
+		double Y1 = CalibrationPointCurrent[CupIndex][Upper];
+		return Y0 + (Y1 - Y0) * (RegisterValue - X0) / (X1 - X0);
+	}
+	else{
+		return DirectionalCoefficient[CupIndex] * (RegisterValue + OffsetForZeroCurrent[CupIndex]);
+	}
+}
+
+/// The register value is corrected by the zero shift (auto-zero) before the calibration function is applied
+/// @param TablePtr CONVERSION_TABLE_SIZE values
+void buildConversionTable( int CupIndex, double Shift, float * TablePtr ){
+	assert( CupIndex < CUPS_NUMBER );
+	for (int J=0; J < CONVERSION_TABLE_SIZE; J++){
+		TablePtr[J] = (float)evaluateCalibrationFunction( CupIndex, (double)J - Shift );
+	}
+}
+
+/// The new zero shift is stamped with the moment its table has been activated
+static void publishZeroShift( int CupIndex ){
+	int64_t Time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+	uint32_t Sequence = atomic_load_explicit( &ZeroShiftSequence, std::memory_order_relaxed );
+	atomic_store_explicit( &ZeroShiftSequence, Sequence + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	atomic_store_explicit( &ActiveZeroShift[CupIndex], ZeroShift[CupIndex], std::memory_order_relaxed );
+	atomic_store_explicit( &ZeroShiftTime[CupIndex], Time, std::memory_order_relaxed );
+	atomic_store_explicit( &ZeroShiftSequence, Sequence + 2, std::memory_order_release );
+}
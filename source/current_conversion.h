@@ -0,0 +1,36 @@
+/// @file current_conversion.h
+
+#ifndef SOURCE_CURRENT_CONVERSION_H_
+#define SOURCE_CURRENT_CONVERSION_H_
+
+#include <cstdint>
+
+#include "config.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define CONVERSION_TABLE_SIZE		0x8000	// register values 0x8000 and above mean "N/A"
+
+//.................................................................................................
+// Function prototypes
+//.................................................................................................
+
+void buildConversionTables(void);
+
+void applyZeroShift( int CupIndex, double NewZeroShift );
+
+void getActiveZeroShifts( double * ShiftsPtr, int64_t * TimesPtr );
+
+void buildConversionTable( int CupIndex, double Shift, float * TablePtr );
+
+bool findCalibrationZero( int CupIndex, double NearRegisterValue, double * ZeroPtr );
+
+float convertRegisterToCurrent( int CupIndex, uint16_t RegisterValue );
+
+void convertRegistersToCurrents( int CupIndex, const uint16_t * RegistersPtr, float * CurrentsPtr, int Number );
+
+void convertRegistersThroughTable( const float * TablePtr, const uint16_t * RegistersPtr, float * CurrentsPtr, int Number );
+
+#endif // SOURCE_CURRENT_CONVERSION_H_
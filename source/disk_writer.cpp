@@ -0,0 +1,377 @@
+/// @file disk_writer.cpp
+///
+/// The asynchronous writer of the recording files. The recorder thread (the only producer) copies or encodes the data
+/// into the page aligned buffers of a preallocated pool and queues the write requests through a lock-free single
+/// producer queue; the writer thread takes the requests in batches and appends them to the files. The requests
+/// of a batch are written in the order of the queue; the consecutive requests for the same file are written with
+/// a single vectored write, followed by a single fdatasync() if any of them asks for it, so the index entry queued
+/// after a chunk never reaches the disk before the chunk. After a failed write or synchronisation of a file, the later
+/// requests for that file are dropped (their buffers released) until its closing request, so the file never gets
+/// data after a gap. The outcome of a request submitted with a report tag (written, or dropped after a failure)
+/// is reported back to the producer in the order of the queue, so it can count the data lost on the way.
+/// Neither the producer nor the peripheral thread ever waits for the disk: when all the buffers are in flight,
+/// acquireDiskBuffer() returns nullptr and the producer keeps its data (the recorder stops reading the history,
+/// which absorbs the frames); a request that does not fit in the queue is dropped and counted.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <iostream>
+#include <climits>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "disk_writer.h"
+#include "settings_file.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define DISK_WRITER_BUFFER_ALIGNMENT		4096	// bytes; the page
+#define DISK_WRITER_QUEUE_SIZE				64		// power of 2; more than the buffers, for the closing requests
+static_assert( 0 == (DISK_WRITER_QUEUE_SIZE & (DISK_WRITER_QUEUE_SIZE-1)) );
+static_assert( DISK_WRITER_BUFFERS_NUMBER <= 64 );
+#define DISK_WRITER_ALL_BUFFERS_MASK		((DISK_WRITER_BUFFERS_NUMBER < 64)? ((uint64_t)1 << DISK_WRITER_BUFFERS_NUMBER) - 1 : UINT64_MAX)
+
+#define DISK_WRITER_BATCH_MAX				32		// the requests taken from the queue at once
+#define DISK_WRITER_CLOSE_RETRY				1		// milliseconds; the closing request waits so long for the queue
+#define DISK_WRITER_FAILED_FILES_MAX		16		// more than the files written at once
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+struct DiskWriteRequest {
+	int File;
+	int BufferIndex;			// -1 if there is no data (closing only)
+	size_t Size;
+	unsigned Flags;
+	int ReportTag;				// DISK_WRITE_NOT_REPORTED if the outcome is not reported
+};
+
+struct DiskWriteReport {
+	int Tag;
+	bool IsWritten;
+};
+
+struct DiskBuffer {
+	alignas(DISK_WRITER_BUFFER_ALIGNMENT) uint8_t Data[DISK_WRITER_BUFFER_SIZE];
+};
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+static std::thread DiskWriterThread;
+
+static std::atomic<bool> CloseDiskWriterFlag;
+
+static DiskBuffer DiskBuffers[DISK_WRITER_BUFFERS_NUMBER];
+
+/// The bit J is set if DiskBuffers[J] is free; cleared by the producer, set by the writer thread
+static std::atomic<uint64_t> FreeBuffersMask;
+
+/// The queue of the requests; written by the producer, read by the writer thread
+static DiskWriteRequest DiskWriteQueue[DISK_WRITER_QUEUE_SIZE];
+static std::atomic<uint32_t> DiskWriteQueueHead;	// the next request to be written
+static std::atomic<uint32_t> DiskWriteQueueTail;	// the next request to be read
+static std::atomic<uint32_t> DiskWriteQueueDone;	// the requests written (or dropped) and completed
+
+/// The outcomes of the reported requests; written by the writer thread, read by the producer, which takes them
+/// before it has more than DISK_WRITER_QUEUE_SIZE of them outstanding
+static DiskWriteReport DiskWriteReports[DISK_WRITER_QUEUE_SIZE];
+static std::atomic<uint32_t> DiskWriteReportsHead;
+static std::atomic<uint32_t> DiskWriteReportsTail;
+
+static std::atomic<uint64_t> DroppedDiskWrites;
+
+static std::atomic<uint64_t> DiskWriteErrors;
+
+/// These variables are used by the writer thread only
+static DiskWriteRequest Batch[DISK_WRITER_BATCH_MAX];
+static struct iovec BatchVectors[DISK_WRITER_BATCH_MAX];
+static bool IsBatchWritten[DISK_WRITER_BATCH_MAX];
+static int FailedFiles[DISK_WRITER_FAILED_FILES_MAX];	// the descriptors not written any more until closed
+static int FailedFilesNumber;
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static void diskWriterThreadHandler(void);
+
+static int takeBatch(void);
+
+static void writeBatch( int RequestsNumber );
+
+static bool isFileFailed( int File );
+
+static void setFileFailed( int File, bool IsFailed );
+
+static bool writeVectors( int File, struct iovec * VectorsPtr, int VectorsNumber );
+
+static void completeBatch( int RequestsNumber );
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+void diskWriterStart(void){
+	atomic_store_explicit( &FreeBuffersMask, DISK_WRITER_ALL_BUFFERS_MASK, std::memory_order_release );
+	FailedFilesNumber = 0;
+	atomic_store_explicit( &CloseDiskWriterFlag, false, std::memory_order_release );
+	DiskWriterThread = std::thread(diskWriterThreadHandler);
+}
+
+/// This function is called by FLTK onMainWindowCloseCallback event handler after the producers have been stopped;
+/// the requests queued so far are written
+void diskWriterExit(void){
+	atomic_store_explicit( &CloseDiskWriterFlag, true, std::memory_order_release );
+	if (DiskWriterThread.joinable()){
+		DiskWriterThread.join();
+	}
+}
+
+/// This function is called by the producer
+/// @return nullptr if all the buffers are in flight (the data is to be kept and offered again later)
+uint8_t * acquireDiskBuffer( int * BufferIndexPtr ){
+	uint64_t Mask = atomic_load_explicit( &FreeBuffersMask, std::memory_order_acquire );
+	if (0 == Mask){
+		return nullptr;
+	}
+	int BufferIndex = __builtin_ctzll( Mask );
+	atomic_fetch_and_explicit( &FreeBuffersMask, ~((uint64_t)1 << BufferIndex), std::memory_order_acq_rel );
+	*BufferIndexPtr = BufferIndex;
+	return DiskBuffers[BufferIndex].Data;
+}
+
+/// This function is called by the producer; the buffer is handed over to the writer thread (or released, if dropped)
+/// @param ReportTag the tag of the report of the outcome (see takeDiskWriteReport()) or DISK_WRITE_NOT_REPORTED
+/// @return false if the queue is full (the write is dropped and counted, but not reported)
+bool submitDiskWrite( int File, int BufferIndex, size_t Size, unsigned Flags, int ReportTag ){
+	uint32_t Head = atomic_load_explicit( &DiskWriteQueueHead, std::memory_order_relaxed );
+	uint32_t Tail = atomic_load_explicit( &DiskWriteQueueTail, std::memory_order_acquire );
+	if (Head - Tail >= DISK_WRITER_QUEUE_SIZE){
+		releaseDiskBuffer( BufferIndex );
+		atomic_fetch_add_explicit( &DroppedDiskWrites, 1u, std::memory_order_relaxed );
+		return false;
+	}
+	DiskWriteRequest * RequestPtr = &DiskWriteQueue[Head & (DISK_WRITER_QUEUE_SIZE-1)];
+	RequestPtr->File = File;
+	RequestPtr->BufferIndex = BufferIndex;
+	RequestPtr->Size = Size;
+	RequestPtr->Flags = Flags;
+	RequestPtr->ReportTag = ReportTag;
+	atomic_store_explicit( &DiskWriteQueueHead, Head + 1, std::memory_order_release );
+	return true;
+}
+
+/// This function is called by the producer for the small records (the file header, the index, the summaries)
+/// @return false if there is no free buffer (nothing is written; the data is to be offered again) or the write is dropped
+bool copyToDisk( int File, const void * DataPtr, size_t Size, unsigned Flags, int ReportTag ){
+	int BufferIndex;
+	uint8_t * BufferPtr = acquireDiskBuffer( &BufferIndex );
+	if ((nullptr == BufferPtr) || (Size > DISK_WRITER_BUFFER_SIZE)){
+		if (nullptr != BufferPtr){
+			releaseDiskBuffer( BufferIndex );
+		}
+		return false;
+	}
+	memcpy( BufferPtr, DataPtr, Size );
+	return submitDiskWrite( File, BufferIndex, Size, Flags, ReportTag );
+}
+
+/// This function is called by the producer; the file is closed by the writer thread after the writes queued before
+/// (the descriptor must not be used any more). The closing is never dropped: the producer waits for a place
+/// in the queue, which has more places than there are buffers.
+void closeDiskFile( int File ){
+	while (true){
+		uint32_t Head = atomic_load_explicit( &DiskWriteQueueHead, std::memory_order_relaxed );
+		uint32_t Tail = atomic_load_explicit( &DiskWriteQueueTail, std::memory_order_acquire );
+		if (Head - Tail < DISK_WRITER_QUEUE_SIZE){
+			DiskWriteRequest * RequestPtr = &DiskWriteQueue[Head & (DISK_WRITER_QUEUE_SIZE-1)];
+			RequestPtr->File = File;
+			RequestPtr->BufferIndex = -1;
+			RequestPtr->Size = 0;
+			RequestPtr->Flags = DISK_WRITE_CLOSE;
+			RequestPtr->ReportTag = DISK_WRITE_NOT_REPORTED;
+			atomic_store_explicit( &DiskWriteQueueHead, Head + 1, std::memory_order_release );
+			return;
+		}
+		std::this_thread::sleep_for( std::chrono::milliseconds( DISK_WRITER_CLOSE_RETRY ));
+	}
+}
+
+/// This function is called by the producer
+/// @return false if there is no report; otherwise the tag of the next reported request and whether it has been written
+bool takeDiskWriteReport( int * ReportTagPtr, bool * IsWrittenPtr ){
+	uint32_t Tail = atomic_load_explicit( &DiskWriteReportsTail, std::memory_order_relaxed );
+	if (Tail == atomic_load_explicit( &DiskWriteReportsHead, std::memory_order_acquire )){
+		return false;
+	}
+	const DiskWriteReport * ReportPtr = &DiskWriteReports[Tail & (DISK_WRITER_QUEUE_SIZE-1)];
+	*ReportTagPtr = ReportPtr->Tag;
+	*IsWrittenPtr = ReportPtr->IsWritten;
+	atomic_store_explicit( &DiskWriteReportsTail, Tail + 1, std::memory_order_release );
+	return true;
+}
+
+/// @param DroppedWritesPtr the writes dropped because the queue was full
+/// @param ErrorsPtr the failed writes and synchronisations (the producer compares it with the previous value)
+void getDiskWriterStatus( uint64_t * DroppedWritesPtr, uint64_t * ErrorsPtr ){
+	*DroppedWritesPtr = atomic_load_explicit( &DroppedDiskWrites, std::memory_order_relaxed );
+	*ErrorsPtr = atomic_load_explicit( &DiskWriteErrors, std::memory_order_acquire );
+}
+
+/// The background tasks (see retention.cpp) wait for the idle writer, so they never delay the recording
+/// @return true if no buffer is in flight and no request (e.g. a closing one, without a buffer) is queued
+bool isDiskWriterIdle(void){
+	return (DISK_WRITER_ALL_BUFFERS_MASK == atomic_load_explicit( &FreeBuffersMask, std::memory_order_acquire )) &&
+			(atomic_load_explicit( &DiskWriteQueueDone, std::memory_order_acquire ) ==
+			atomic_load_explicit( &DiskWriteQueueHead, std::memory_order_acquire ));
+}
+
+static void diskWriterThreadHandler(void){
+	while (true){
+		bool IsClosing = atomic_load_explicit( &CloseDiskWriterFlag, std::memory_order_acquire );
+		int RequestsNumber = takeBatch();
+		if (RequestsNumber > 0){
+			writeBatch( RequestsNumber );
+			continue;
+		}
+		if (IsClosing){
+			break;		// the queue was empty after the flag had been set
+		}
+		std::this_thread::sleep_for( std::chrono::milliseconds( PERIPHERAL_THREAD_LOOP_DURATION ));
+	}
+}
+
+/// @return the number of the requests copied from the queue to Batch[]
+static int takeBatch(void){
+	uint32_t Tail = atomic_load_explicit( &DiskWriteQueueTail, std::memory_order_relaxed );
+	uint32_t Head = atomic_load_explicit( &DiskWriteQueueHead, std::memory_order_acquire );
+	int RequestsNumber = 0;
+	while ((Tail != Head) && (RequestsNumber < DISK_WRITER_BATCH_MAX)){
+		Batch[RequestsNumber++] = DiskWriteQueue[Tail & (DISK_WRITER_QUEUE_SIZE-1)];
+		Tail++;
+	}
+	atomic_store_explicit( &DiskWriteQueueTail, Tail, std::memory_order_release );
+	return RequestsNumber;
+}
+
+/// The consecutive requests for the same file make a group: a single vectored write, then fdatasync() and close()
+/// if any request of the group asks for them; the groups of a failed file are not written
+static void writeBatch( int RequestsNumber ){
+	for (int J=0; J < RequestsNumber; J++){
+		BatchVectors[J].iov_base = (Batch[J].BufferIndex >= 0)? DiskBuffers[Batch[J].BufferIndex].Data : nullptr;
+		BatchVectors[J].iov_len = Batch[J].Size;
+	}
+	int First = 0;
+	while (First < RequestsNumber){
+		int Last = First + 1;
+		unsigned Flags = Batch[First].Flags;
+		while ((Last < RequestsNumber) && (Batch[Last].File == Batch[First].File) &&
+				(0 == (Batch[Last-1].Flags & DISK_WRITE_CLOSE)))
+		{
+			Flags |= Batch[Last].Flags;
+			Last++;
+		}
+		bool IsWritten = false;
+		if (!isFileFailed( Batch[First].File )){
+			IsWritten = writeVectors( Batch[First].File, &BatchVectors[First], Last - First ) &&
+					((0 == (Flags & DISK_WRITE_SYNC)) || (0 == fdatasync( Batch[First].File )));
+			if (!IsWritten){
+				std::cout << "Błąd zapisu na dysk (" << strerror( errno ) << ")" << std::endl;
+				atomic_fetch_add_explicit( &DiskWriteErrors, 1u, std::memory_order_acq_rel );
+				setFileFailed( Batch[First].File, true );
+			}
+		}
+		for (int J = First; J < Last; J++){
+			IsBatchWritten[J] = IsWritten;
+		}
+		First = Last;
+	}
+	completeBatch( RequestsNumber );
+}
+
+static bool isFileFailed( int File ){
+	for (int J=0; J < FailedFilesNumber; J++){
+		if (File == FailedFiles[J]){
+			return true;
+		}
+	}
+	return false;
+}
+
+/// The mark is removed when the file is closed (the descriptor may then be reused)
+static void setFileFailed( int File, bool IsFailed ){
+	for (int J=0; J < FailedFilesNumber; J++){
+		if (File == FailedFiles[J]){
+			if (!IsFailed){
+				FailedFiles[J] = FailedFiles[--FailedFilesNumber];
+			}
+			return;
+		}
+	}
+	if (IsFailed && (FailedFilesNumber < DISK_WRITER_FAILED_FILES_MAX)){
+		FailedFiles[FailedFilesNumber++] = File;
+	}
+}
+
+/// The partial writes are continued
+/// @return false on error (errno is set)
+static bool writeVectors( int File, struct iovec * VectorsPtr, int VectorsNumber ){
+	while ((VectorsNumber > 0) && (0 == VectorsPtr->iov_len)){
+		VectorsPtr++;
+		VectorsNumber--;
+	}
+	while (VectorsNumber > 0){
+		ssize_t Written = writev( File, VectorsPtr, std::min( VectorsNumber, IOV_MAX ));
+		if (Written < 0){
+			if (EINTR == errno){
+				continue;
+			}
+			return false;
+		}
+		while ((VectorsNumber > 0) && ((size_t)Written >= VectorsPtr->iov_len)){
+			Written -= VectorsPtr->iov_len;
+			VectorsPtr++;
+			VectorsNumber--;
+		}
+		if (VectorsNumber > 0){
+			VectorsPtr->iov_base = static_cast<uint8_t *>(VectorsPtr->iov_base) + Written;
+			VectorsPtr->iov_len -= (size_t)Written;
+		}
+	}
+	return true;
+}
+
+/// The files are closed, the outcomes reported and the buffers returned to the pool
+static void completeBatch( int RequestsNumber ){
+	uint32_t ReportsHead = atomic_load_explicit( &DiskWriteReportsHead, std::memory_order_relaxed );
+	for (int J=0; J < RequestsNumber; J++){
+		if (0 != (Batch[J].Flags & DISK_WRITE_CLOSE)){
+			close( Batch[J].File );
+			setFileFailed( Batch[J].File, false );
+		}
+		if (DISK_WRITE_NOT_REPORTED != Batch[J].ReportTag){
+			DiskWriteReport * ReportPtr = &DiskWriteReports[ReportsHead & (DISK_WRITER_QUEUE_SIZE-1)];
+			ReportPtr->Tag = Batch[J].ReportTag;
+			ReportPtr->IsWritten = IsBatchWritten[J];
+			ReportsHead++;
+		}
+		if (Batch[J].BufferIndex >= 0){
+			releaseDiskBuffer( Batch[J].BufferIndex );
+		}
+	}
+	atomic_store_explicit( &DiskWriteReportsHead, ReportsHead, std::memory_order_release );
+	atomic_fetch_add_explicit( &DiskWriteQueueDone, (uint32_t)RequestsNumber, std::memory_order_acq_rel );
+}
+
+/// This function is called by the producer for a buffer acquired but not submitted, and by the writer thread
+void releaseDiskBuffer( int BufferIndex ){
+	atomic_fetch_or_explicit( &FreeBuffersMask, (uint64_t)1 << BufferIndex, std::memory_order_acq_rel );
+}
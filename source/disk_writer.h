@@ -0,0 +1,48 @@
+/// @file disk_writer.h
+
+#ifndef SOURCE_DISK_WRITER_H_
+#define SOURCE_DISK_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "config.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define DISK_WRITER_BUFFER_SIZE				(128*1024)	// bytes; must hold a chunk of the recording
+#define DISK_WRITER_BUFFERS_NUMBER			32			// at most 64 (see FreeBuffersMask)
+
+// flags of the write requests
+#define DISK_WRITE_SYNC						0x01	// the file is synchronised (fdatasync) after the data
+#define DISK_WRITE_CLOSE					0x02	// the file is closed after the data (and the synchronisation)
+
+#define DISK_WRITE_NOT_REPORTED				(-1)	// the tag of a request whose outcome is not reported
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+void diskWriterStart(void);
+
+void diskWriterExit(void);
+
+uint8_t * acquireDiskBuffer( int * BufferIndexPtr );
+
+void releaseDiskBuffer( int BufferIndex );
+
+bool submitDiskWrite( int File, int BufferIndex, size_t Size, unsigned Flags, int ReportTag );
+
+bool copyToDisk( int File, const void * DataPtr, size_t Size, unsigned Flags, int ReportTag );
+
+bool takeDiskWriteReport( int * ReportTagPtr, bool * IsWrittenPtr );
+
+void closeDiskFile( int File );
+
+void getDiskWriterStatus( uint64_t * DroppedWritesPtr, uint64_t * ErrorsPtr );
+
+bool isDiskWriterIdle(void);
+
+#endif // SOURCE_DISK_WRITER_H_
@@ -0,0 +1,91 @@
+/// @file event_log.cpp
+///
+/// The events detected by the peripheral thread (beam trips, alarms, movements of the cups) are passed to the GUI
+/// thread through single-producer single-consumer queues; the GUI thread appends them to the log files in each
+/// refresh, with the readout times converted to the calendar time. The peripheral thread never waits: an event is
+/// dropped if its queue is full, and the number of the dropped events is written to the log.
+
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <iostream>
+
+#include "event_log.h"
+#include "settings_file.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define EVENT_LOG_LINE_SIZE				400
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+/// This function is called by the peripheral thread; the event is dropped (and counted) if the GUI thread does not keep up
+void pushLogEvent( EventLog * LogPtr, const void * EventPtr ){
+	uint32_t Head = atomic_load_explicit( &LogPtr->QueueHead, std::memory_order_relaxed );
+	uint32_t Tail = atomic_load_explicit( &LogPtr->QueueTail, std::memory_order_acquire );
+	if (Head - Tail >= LogPtr->QueueSize){
+		atomic_fetch_add_explicit( &LogPtr->LostEvents, 1u, std::memory_order_relaxed );
+		return;
+	}
+	memcpy( (char*)LogPtr->Events + (Head & (LogPtr->QueueSize-1)) * LogPtr->EventSize, EventPtr, LogPtr->EventSize );
+	atomic_store_explicit( &LogPtr->QueueHead, Head + 1, std::memory_order_release );
+}
+
+/// This function is called by the GUI thread; the events since the previous call are appended to the log file
+void writeEventLog( EventLog * LogPtr ){
+	uint32_t Tail = atomic_load_explicit( &LogPtr->QueueTail, std::memory_order_relaxed );
+	uint32_t Head = atomic_load_explicit( &LogPtr->QueueHead, std::memory_order_acquire );
+	if (Tail == Head){
+		return;
+	}
+
+	std::string LogFilePath = ThisApplicationDirectory + "/" + LogPtr->FileName;
+	FILE * File = fopen( LogFilePath.c_str(), "a" );
+	if (nullptr == File){
+		if (VerboseMode){
+			std::cout << "Nie można otworzyć pliku: " << LogFilePath << std::endl;
+		}
+	}
+
+	// the readout times are converted to the calendar time
+	std::chrono::system_clock::time_point SystemNow = std::chrono::system_clock::now();
+	std::chrono::high_resolution_clock::time_point Now = std::chrono::high_resolution_clock::now();
+	while (Tail != Head){
+		const void * EventPtr = (const char*)LogPtr->Events + (Tail & (LogPtr->QueueSize-1)) * LogPtr->EventSize;
+		char Description[EVENT_LOG_LINE_SIZE];
+		std::chrono::high_resolution_clock::time_point Time = LogPtr->formatEvent( EventPtr, Description, sizeof(Description) );
+
+		std::chrono::system_clock::time_point EventTime = SystemNow +
+				std::chrono::duration_cast<std::chrono::system_clock::duration>(Time - Now);
+		time_t EventSeconds = std::chrono::system_clock::to_time_t( EventTime );
+		int Milliseconds = (int)(std::chrono::duration_cast<std::chrono::milliseconds>(EventTime.time_since_epoch()).count() % 1000);
+		struct tm LocalTime;
+		localtime_r( &EventSeconds, &LocalTime );
+		char TimeText[40];
+		strftime( TimeText, sizeof(TimeText), "%Y-%m-%d %H:%M:%S", &LocalTime );
+
+		char Text[EVENT_LOG_LINE_SIZE + 60];
+		snprintf( Text, sizeof(Text), "%s.%03d  %s", TimeText, Milliseconds, Description );
+		if (nullptr != File){
+			fprintf( File, "%s\n", Text );
+		}
+		if (VerboseMode){
+			std::cout << LogPtr->VerboseLabel << ": " << Text << std::endl;
+		}
+		Tail++;
+	}
+	atomic_store_explicit( &LogPtr->QueueTail, Tail, std::memory_order_release );
+
+	uint32_t LostEvents = atomic_exchange_explicit( &LogPtr->LostEvents, 0u, std::memory_order_relaxed );
+	if ((0 != LostEvents) && (nullptr != File)){
+		fprintf( File, "(pominięto %u wpisów)\n", LostEvents );
+	}
+	if (nullptr != File){
+		fclose( File );
+	}
+}
@@ -0,0 +1,40 @@
+/// @file event_log.h
+
+#ifndef SOURCE_EVENT_LOG_H_
+#define SOURCE_EVENT_LOG_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+/// Writes the description of the event (without its time) and returns the time of the event
+typedef std::chrono::high_resolution_clock::time_point (*EventFormatter)( const void * EventPtr, char * TextPtr, size_t TextSize );
+
+/// A single-producer single-consumer queue of events (written by the peripheral thread, read by the GUI thread)
+/// and the log file to which the GUI thread appends them
+struct EventLog {
+	const char * FileName;				// in the directory of the application
+	const char * VerboseLabel;			// the prefix of the event on the console in the verbose mode
+	void * Events;						// the array of QueueSize events, EventSize bytes each
+	size_t EventSize;
+	uint32_t QueueSize;					// power of 2
+	EventFormatter formatEvent;
+	std::atomic<uint32_t> QueueHead;	// the next event to be written
+	std::atomic<uint32_t> QueueTail;	// the next event to be read
+	std::atomic<uint32_t> LostEvents;
+};
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+void pushLogEvent( EventLog * LogPtr, const void * EventPtr );
+
+void writeEventLog( EventLog * LogPtr );
+
+#endif // SOURCE_EVENT_LOG_H_
@@ -1,6 +1,8 @@
 /// @file gui_widgets.c
 
 #include <cstdio>
+#include <cstring>
+#include <cmath>
 #include <string>
 #include <iostream>
 #include <assert.h>
@@ -12,12 +14,21 @@
 #include <FL/Fl_PNG_Image.H>
 #include <FL/Fl_Box.H>
 #include <FL/Fl_Group.H>
+#include <FL/fl_ask.H>
 
 #include "peripheral_thread.h"
 #include "png_graphics.h"
 #include "gui_widgets.h"
 #include "shared_data.h"
 #include "settings_file.h"
+#include "auto_zero.h"
+#include "beam_trips.h"
+#include "triggered_capture.h"
+#include "spectral_analysis.h"
+#include "alarms.h"
+#include "actuator_timing.h"
+#include "recorder.h"
+#include "disk_writer.h"
 
 //.................................................................................................
 // Preprocessor directives
@@ -27,6 +38,8 @@
 #define DISC3_RADIUS		40
 #define DISC_VALUE1_Y		30
 #define DISC_VALUE2_Y		80
+#define DISC_STATISTICS_DY	28	// statistics are displayed below the value
+#define DISC_FOCUS_Y		232	// focus metrics are displayed at the bottom of the disc
 #define DISC_TEXTS_SPACE	10
 #define DISC_SLIT_WIDTH		8
 #define DISC_SPACE_Y		((MAIN_WINDOW_HEIGHT-MAIN_MENU_HEIGHT)/3)
@@ -34,6 +47,7 @@
 #define ORDINARY_TEXT_FONT	FL_HELVETICA
 #define ORDINARY_TEXT_SIZE	14
 #define DEBUGGING_TEXT_SIZE	11
+#define FOCUS_TEXT_SIZE		12
 
 #define COLOR_STRONGER_BLUE	0xE5
 #define COLOR_MEDIUM_BLUE	0xEE
@@ -112,11 +126,26 @@ private:
 class CupGuiGroup : public Fl_Group {
 private:
 	int CupId;
+	uint64_t RenderedChangeFrame;	// CupLastChangeFrame[] of the frame displayed
+	int RenderedStatusLevel;
+	bool RenderedLimitSwitchError;
+	bool RenderedStatisticsVisibility;
+	int RenderedStatisticsWindow;
 	char StaticLabelBuffer[CUPS_NUMBER][VALUES_PER_DISC][64];
 	char StatusText[800];
+	char ChargeText[40];
+	char BeamTripsText[60];
+	char DiagnosticsText[2*CHANNEL_NAME_MAX_LENGTH + 2*CHANNEL_UNIT_MAX_LENGTH + 40];
+	char TitleText[sizeof(CupDescriptionPtr[0]) + 2*CHANNEL_NAME_MAX_LENGTH + 64];
 	Fl_Box* TitleTextBoxPtr;
 	TripleDiscWidgetWithNoSlit * TripleDisc;
 	Fl_Box * CupValueLabelPtr[VALUES_PER_DISC];
+	Fl_Box * CupStatisticsLabelPtr[VISIBLE_VALUES_PER_DISC];
+	char StatisticsLabelBuffer[VISIBLE_VALUES_PER_DISC][96];
+	Fl_Box * FocusLabelPtr;
+	char FocusLabelBuffer[96];
+	Fl_Box * TransmissionLabelPtr;
+	char TransmissionLabelBuffer[96];
 	ImageWidget * PadlockImagePtr;
 	ImageWidget * UnconnectedImagePtr;
 	Fl_Box* LockoutTextBoxPtr;
@@ -129,7 +158,8 @@ public:
 	CupGuiGroup(int X, int Y, int W, int H, const char* L = nullptr);
     void configure( int IdValue );
     int getCupId();
-    void refreshData();
+    bool isRefreshNeeded( const AcquisitionFrame * FramePtr );
+    void refreshData( const AcquisitionFrame * FramePtr );
 };
 
 //.................................................................................................
@@ -147,6 +177,15 @@ static Fl_Box* GeneralStatusTextBoxPtr;
 
 static CupGuiGroup * CupGroupPtr[CUPS_NUMBER];
 
+/// The copy of the shared data used by the GUI (main thread only)
+static AcquisitionFrame GuiFrame;
+
+static char AutoZeroReportText[400];
+
+static char SpectrumReportText[800];
+
+static char ActuatorReportText[1200];
+
 
 //.................................................................................................
 // Local function prototypes
@@ -154,6 +193,14 @@ static CupGuiGroup * CupGroupPtr[CUPS_NUMBER];
 
 static void cupInsertionButtonCallback(Fl_Widget* Widget, void* Data);
 
+static void formatCharge( char * TextPtr, size_t TextSize, const CupDerivedData * DerivedPtr );
+
+static void showAutoZeroReport( void * Data );
+
+static void showSpectrumReport( void * Data );
+
+static void showActuatorReport( void * Data );
+
 //.................................................................................................
 // Function definitions
 //.................................................................................................
@@ -161,10 +208,10 @@ static void cupInsertionButtonCallback(Fl_Widget* Widget, void* Data);
 void initializeGraphicWidgets(void){
 	std::chrono::high_resolution_clock::time_point NowTemporary = std::chrono::high_resolution_clock::now();
 	for (int J=0; J<CUPS_NUMBER; J++){
-		CupInsertionOrRemovalStartTime[J] = NowTemporary;
+		atomic_store_explicit( &CupInsertionOrRemovalStartTime[J], NowTemporary, std::memory_order_release );
 	}
 
-	GeneralStatusTextBoxPtr = new Fl_Box(200, 10, 300, 15, "Tu powinny być różne dane");
+	GeneralStatusTextBoxPtr = new Fl_Box(180, 10, 320, 15, "Tu powinny być różne dane");
 	GeneralStatusTextBoxPtr->labelfont( FL_COURIER );
 	GeneralStatusTextBoxPtr->labelsize( DEBUGGING_TEXT_SIZE );
 	GeneralStatusTextBoxPtr->labelcolor( FL_BLACK );
@@ -255,7 +302,8 @@ static void cupInsertionButtonCallback(Fl_Widget* Widget, void* Data){
 	// protection against too frequent clicking + protection against too early display of limit switch error
 	std::chrono::high_resolution_clock::time_point TimeNow = std::chrono::high_resolution_clock::now();
 	std::chrono::milliseconds DurationTime;
-	DurationTime = std::chrono::duration_cast<std::chrono::milliseconds>(TimeNow - CupInsertionOrRemovalStartTime[DiscIndex]);
+	DurationTime = std::chrono::duration_cast<std::chrono::milliseconds>(TimeNow -
+			atomic_load_explicit( &CupInsertionOrRemovalStartTime[DiscIndex], std::memory_order_acquire ));
 
 	if (DurationTime.count() < MaximumPropagationTime){
 	    if (VeryVerboseMode){
@@ -266,20 +314,30 @@ static void cupInsertionButtonCallback(Fl_Widget* Widget, void* Data){
 
 	int TemporaryIndex = COIL_OFFSET_IS_SWITCH_PRESSED+MODBUS_COILS_PER_CUP*DiscIndex;
 	if (TemporaryIndex < MODBUS_COILS_NUMBER){
-		if (atomic_load_explicit( &ModbusCoilsReadout[TemporaryIndex], std::memory_order_acquire )){
+		// the time of the command is set before the request, see noteActuatorCommandWritten()
+		atomic_store_explicit( &CupInsertionOrRemovalStartTime[DiscIndex], std::chrono::high_resolution_clock::now(),
+				std::memory_order_release );
+		readAcquisitionFrame( &GuiFrame );
+		if (GuiFrame.Coils[TemporaryIndex]){
 			atomic_store_explicit( &ModbusCoilRequestedValue[DiscIndex], false, std::memory_order_release );
 		    if (VeryVerboseMode){
 		    	std::cout << "Akcja związana z naciśnięciem przycisku: wysuń " << DiscIndex << std::endl;
 		    }
 		}
 		else{
+			if (isInterlockLatched( DiscIndex )){
+				// the cup has been removed by an alarm; it is not inserted again without the operator's confirmation
+				if (0 == fl_choice("Kubek %d został wysunięty przez alarm.\nCzy wsunąć go ponownie?", "Anuluj", "Wsuń", nullptr, DiscIndex+1)){
+					return;
+				}
+				acknowledgeInterlock( DiscIndex );
+			}
 			atomic_store_explicit( &ModbusCoilRequestedValue[DiscIndex], true, std::memory_order_release );
 		    if (VeryVerboseMode){
 		    	std::cout << "Akcja związana z naciśnięciem przycisku: wsuń " << DiscIndex << std::endl;
 		    }
 		}
 		atomic_store_explicit( &ModbusCoilChangeReqest[DiscIndex], true, std::memory_order_release );
-		CupInsertionOrRemovalStartTime[DiscIndex] = std::chrono::high_resolution_clock::now();
 	}
 	else{
 	    std::cout << "Internal error, file " << __FILE__ << ", line " << __LINE__ << ", index " << DiscIndex << std::endl;
@@ -289,6 +347,11 @@ static void cupInsertionButtonCallback(Fl_Widget* Widget, void* Data){
 CupGuiGroup::CupGuiGroup(int X, int Y, int W, int H, const char* L) : Fl_Group(X, Y, W, H, L) {
 	this->begin();
 	CupId = -1;
+	RenderedChangeFrame = 0;
+	RenderedStatusLevel = -1;
+	RenderedLimitSwitchError = false;
+	RenderedStatisticsVisibility = false;
+	RenderedStatisticsWindow = 0;
 
 	TitleTextBoxPtr = new Fl_Box(X+0, Y, 296, 20, "Tytuł");
 	TitleTextBoxPtr->labelfont( ORDINARY_TEXT_FONT );
@@ -299,6 +362,12 @@ CupGuiGroup::CupGuiGroup(int X, int Y, int W, int H, const char* L) : Fl_Group(X
 #endif
 	TitleTextBoxPtr->align(FL_ALIGN_CENTER | FL_ALIGN_INSIDE | FL_ALIGN_CLIP);
 
+	TransmissionLabelPtr = new Fl_Box(X+300, Y+2, 205, 18, "" );
+	TransmissionLabelPtr->labelfont( FL_HELVETICA_BOLD );
+	TransmissionLabelPtr->labelsize( FOCUS_TEXT_SIZE );
+	TransmissionLabelPtr->align(FL_ALIGN_LEFT | FL_ALIGN_INSIDE | FL_ALIGN_CLIP);
+	TransmissionLabelPtr->hide();
+
 	TripleDisc = new TripleDiscWidgetWithNoSlit( X+20, Y+20, 256, 256 );
 	TripleDisc->hide();
 
@@ -309,6 +378,18 @@ CupGuiGroup::CupGuiGroup(int X, int Y, int W, int H, const char* L) : Fl_Group(X
 		CupValueLabelPtr[J]->hide();
 	}
 
+	for (int J=0; J <VISIBLE_VALUES_PER_DISC; J++){
+		CupStatisticsLabelPtr[J] = new Fl_Box(X+20, Y+DISC_VALUE1_Y+J*(DISC_VALUE2_Y-DISC_VALUE1_Y)+DISC_STATISTICS_DY, 256, 14, "" );
+		CupStatisticsLabelPtr[J]->labelfont( ORDINARY_TEXT_FONT );
+		CupStatisticsLabelPtr[J]->labelsize( DEBUGGING_TEXT_SIZE );
+		CupStatisticsLabelPtr[J]->hide();
+	}
+
+	FocusLabelPtr = new Fl_Box(X+20, Y+DISC_FOCUS_Y, 256, 20, "" );
+	FocusLabelPtr->labelfont( FL_HELVETICA_BOLD );
+	FocusLabelPtr->labelsize( FOCUS_TEXT_SIZE );
+	FocusLabelPtr->hide();
+
 	PadlockImagePtr = new ImageWidget( X+380, Y+30, 54, 54, padlock_png, padlock_png_len, nullptr );
 	PadlockImagePtr->hide();
 
@@ -372,7 +453,17 @@ int CupGuiGroup::getCupId(){
 	return CupId;
 }
 
-void CupGuiGroup::refreshData(){
+/// The widgets of the cup are refreshed only if the readouts or the settings affecting them have changed
+bool CupGuiGroup::isRefreshNeeded( const AcquisitionFrame * FramePtr ){
+	assert( CupId < CUPS_NUMBER );
+	return (FramePtr->CupLastChangeFrame[CupId] != RenderedChangeFrame) ||
+			(StatusLevelForGui != RenderedStatusLevel) ||
+			(ShowStatisticsInDiscs != RenderedStatisticsVisibility) ||
+			(ShownStatisticsWindow != RenderedStatisticsWindow) ||
+			(atomic_load_explicit( &DisplayLimitSwitchError[CupId], std::memory_order_acquire ) != RenderedLimitSwitchError);
+}
+
+void CupGuiGroup::refreshData( const AcquisitionFrame * FramePtr ){
 	assert( CupId < CUPS_NUMBER );
 
 	int TemporaryIndexForSwitchPressed = COIL_OFFSET_IS_SWITCH_PRESSED+MODBUS_COILS_PER_CUP*CupId;
@@ -381,9 +472,17 @@ void CupGuiGroup::refreshData(){
 	int TemporaryIndexForBlockage = COIL_OFFSET_IS_CUP_BLOCKED+MODBUS_COILS_PER_CUP*CupId;
 	assert(TemporaryIndexForBlockage < MODBUS_COILS_NUMBER);
 
-	bool IsTransmissionCorrect = isTransmissionCorrect();
+	RenderedChangeFrame = FramePtr->CupLastChangeFrame[CupId];
+	RenderedStatusLevel = StatusLevelForGui;
+	RenderedStatisticsVisibility = ShowStatisticsInDiscs;
+	RenderedStatisticsWindow = ShownStatisticsWindow;
+	RenderedLimitSwitchError = atomic_load_explicit( &DisplayLimitSwitchError[CupId], std::memory_order_acquire );
+
+	bool IsTransmissionCorrect = (0 != (FramePtr->QualityFlags & FRAME_QUALITY_TRANSMISSION_CORRECT));
+	bool IsSwitchPressed = FramePtr->Coils[TemporaryIndexForSwitchPressed];
+	bool IsCupBlocked = FramePtr->Coils[TemporaryIndexForBlockage];
 
-	if (IsTransmissionCorrect && atomic_load_explicit( &ModbusCoilsReadout[TemporaryIndexForSwitchPressed], std::memory_order_acquire )){
+	if (IsTransmissionCorrect && IsSwitchPressed){
 		if (0 == TripleDisc->visible()){
 			TripleDisc->show();
 		}
@@ -397,20 +496,18 @@ void CupGuiGroup::refreshData(){
 		}
 	}
 
-	if (IsTransmissionCorrect &&
-			atomic_load_explicit( &ModbusCoilsReadout[COIL_OFFSET_IS_SWITCH_PRESSED + CupId*MODBUS_COILS_PER_CUP], std::memory_order_acquire ))
-		{
+	if (IsTransmissionCorrect && IsSwitchPressed){
 		for (int J=0; J < VISIBLE_VALUES_PER_DISC; J++){
 			int TemporaryRegisterIndex = CupId*VALUES_PER_DISC + J;
 			assert( TemporaryRegisterIndex < MODBUS_INPUTS_NUMBER );
-			uint16_t TemporaryValue = atomic_load_explicit( &ModbusInputRegisters[TemporaryRegisterIndex], std::memory_order_acquire );
+			uint16_t TemporaryValue = FramePtr->InputRegisters[TemporaryRegisterIndex];
+			float TemporaryCurrent = FramePtr->Derived[CupId].FilteredCurrents[J];	// the same as the raw value if there is no filter
 
 			if (J >= 3){
 				std::snprintf(StaticLabelBuffer[CupId][J], sizeof(StaticLabelBuffer[CupId][J])-1, "0x%04X", (unsigned)TemporaryValue);
 			}
-			else if (0x8000 > TemporaryValue){
-				double TemporaryFloatingPoint = DirectionalCoefficient[CupId] * ((double)TemporaryValue + OffsetForZeroCurrent[CupId]);
-				std::snprintf(StaticLabelBuffer[CupId][J], sizeof(StaticLabelBuffer[CupId][J])-1, "%.1fμA", TemporaryFloatingPoint);
+			else if (!std::isnan( TemporaryCurrent )){
+				std::snprintf(StaticLabelBuffer[CupId][J], sizeof(StaticLabelBuffer[CupId][J])-1, "%.1fμA", (double)TemporaryCurrent);
 				if (strcmp(StaticLabelBuffer[CupId][J], "-0.0μA") == 0){
 					std::snprintf(StaticLabelBuffer[CupId][J], sizeof(StaticLabelBuffer[CupId][J])-1, "0.0μA");
 				}
@@ -423,22 +520,95 @@ void CupGuiGroup::refreshData(){
 			CupValueLabelPtr[J]->show();
 			CupValueLabelPtr[J]->label(StaticLabelBuffer[CupId][J]);
 			CupValueLabelPtr[J]->redraw();
+
+			const ChannelStatistics * StatisticsPtr = &FramePtr->Derived[CupId].Statistics[J][ShownStatisticsWindow];
+			if (ShowStatisticsInDiscs && (StatisticsPtr->SamplesNumber > 0)){
+				std::snprintf(StatisticsLabelBuffer[J], sizeof(StatisticsLabelBuffer[J])-1,
+						"(%d) śr %.1f  σ %.2f  min %.1f  max %.1f", StatisticsWindowLength[ShownStatisticsWindow],
+						(double)StatisticsPtr->Mean, (double)StatisticsPtr->StandardDeviation,
+						(double)StatisticsPtr->Minimum, (double)StatisticsPtr->Maximum );
+				StatisticsLabelBuffer[J][sizeof(StatisticsLabelBuffer[J])-1] = '\0';
+				CupStatisticsLabelPtr[J]->show();
+				CupStatisticsLabelPtr[J]->label(StatisticsLabelBuffer[J]);
+				CupStatisticsLabelPtr[J]->redraw();
+			}
+			else{
+				CupStatisticsLabelPtr[J]->hide();
+			}
 		}
 	}
 	else{
 		for (int J=0; J < VALUES_PER_DISC; J++){
 			CupValueLabelPtr[J]->hide();
 		}
+		for (int J=0; J < VISIBLE_VALUES_PER_DISC; J++){
+			CupStatisticsLabelPtr[J]->hide();
+		}
+	}
+
+	if (IsTransmissionCorrect && IsSwitchPressed && !std::isnan( FramePtr->Derived[CupId].TotalCurrent )){
+		const CupDerivedData * DerivedPtr = &FramePtr->Derived[CupId];
+		char RatioText[16], HaloText[16];
+		if (std::isnan( DerivedPtr->InnerToOuterRatio )){
+			snprintf( RatioText, sizeof(RatioText)-1, "—" );
+		}
+		else{
+			snprintf( RatioText, sizeof(RatioText)-1, "%.2f", (double)DerivedPtr->InnerToOuterRatio );
+		}
+		if (std::isnan( DerivedPtr->HaloFraction )){
+			snprintf( HaloText, sizeof(HaloText)-1, "—" );
+		}
+		else{
+			snprintf( HaloText, sizeof(HaloText)-1, "%.0f%%", 100.0 * DerivedPtr->HaloFraction );
+		}
+		snprintf( FocusLabelBuffer, sizeof(FocusLabelBuffer)-1, "Σ %.1fμA  śr/zew %s  halo %s",
+				(double)DerivedPtr->TotalCurrent, RatioText, HaloText );
+		FocusLabelBuffer[sizeof(FocusLabelBuffer)-1] = '\0';
+		FocusLabelPtr->label( FocusLabelBuffer );
+		FocusLabelPtr->show();
+		FocusLabelPtr->redraw();
+	}
+	else{
+		FocusLabelPtr->hide();
+	}
+
+	// the transmission from the upstream cups to this cup
+	int TransmissionTextLength = 0;
+	TransmissionLabelBuffer[0] = '\0';
+	for (int Upstream=0; Upstream < CUPS_NUMBER; Upstream++){
+		if (!IsTransmissionMeasured[Upstream][CupId]){
+			continue;
+		}
+		float Transmission = FramePtr->Derived[CupId].TransmissionFrom[Upstream];
+		if (std::isnan( Transmission )){
+			TransmissionTextLength += snprintf( TransmissionLabelBuffer + TransmissionTextLength, sizeof(TransmissionLabelBuffer) - TransmissionTextLength,
+					"T %d→%d —  ", Upstream+1, CupId+1 );
+		}
+		else{
+			TransmissionTextLength += snprintf( TransmissionLabelBuffer + TransmissionTextLength, sizeof(TransmissionLabelBuffer) - TransmissionTextLength,
+					"T %d→%d %.1f%%  ", Upstream+1, CupId+1, 100.0 * Transmission );
+		}
+		if (TransmissionTextLength >= (int)sizeof(TransmissionLabelBuffer)){
+			break;
+		}
+	}
+	if (IsTransmissionCorrect && (TransmissionTextLength > 0)){
+		TransmissionLabelPtr->label( TransmissionLabelBuffer );
+		TransmissionLabelPtr->show();
+		TransmissionLabelPtr->redraw();
+	}
+	else{
+		TransmissionLabelPtr->hide();
 	}
 
 	if (IsTransmissionCorrect){
-		if (atomic_load_explicit( &DisplayLimitSwitchError[CupId], std::memory_order_acquire )){
+		if (RenderedLimitSwitchError){
 			if (0 == SwitchErrorTextBoxPtr->visible()){
 				SwitchErrorTextBoxPtr->show();
 			}
 		}
 		else{
-			if (ModbusCoilsReadout[TemporaryIndexForBlockage] && !ModbusCoilsReadout[TemporaryIndexForSwitchPressed]){
+			if (IsCupBlocked && !IsSwitchPressed){
 				if (0 == SwitchErrorTextBoxPtr->visible()){
 					SwitchErrorTextBoxPtr->show();
 				}
@@ -456,7 +626,7 @@ void CupGuiGroup::refreshData(){
 		}
 	}
 
-	if (IsTransmissionCorrect && atomic_load_explicit( &ModbusCoilsReadout[TemporaryIndexForBlockage], std::memory_order_acquire )){
+	if (IsTransmissionCorrect && IsCupBlocked){
 		if (0 == PadlockImagePtr->visible()){
 			PadlockImagePtr->show();
 			LockoutTextBoxPtr->show();
@@ -487,48 +657,101 @@ void CupGuiGroup::refreshData(){
 		if (0 == StatusTextBoxPtr->visible()){
 			StatusTextBoxPtr->show();
 		}
+		formatCharge( ChargeText, sizeof(ChargeText), &FramePtr->Derived[CupId] );
+		BeamTripsText[0] = '\0';
+		if (IsBeamTripDetected[CupId]){
+			snprintf( BeamTripsText, sizeof(BeamTripsText), "Wyłączenia %u (%.1f/h)%s",
+					(unsigned)FramePtr->Derived[CupId].ShiftBeamTripsNumber, (double)FramePtr->Derived[CupId].ShiftBeamTripRate,
+					(0 != FramePtr->Derived[CupId].IsBeamTripped)? " !" : "" );
+		}
 		if (1 == StatusLevelForGui){
 			if (StatusTextBoxPtr->labelsize() != ORDINARY_TEXT_SIZE){
 				StatusTextBoxPtr->labelsize(ORDINARY_TEXT_SIZE);
 			}
-			if (atomic_load_explicit( &ModbusCoilsReadout[TemporaryIndexForSwitchPressed], std::memory_order_acquire )){
-				StatusTextBoxPtr->label( TextCupIsInserted );
-			}
-			else{
-				StatusTextBoxPtr->label( TextCupIsRemoved );
-			}
+			snprintf( StatusText, sizeof(StatusText)-1,
+					"%s\n"
+					"     Q = %s\n"
+					"     %s",
+					IsSwitchPressed? TextCupIsInserted : TextCupIsRemoved,
+					ChargeText, BeamTripsText );
+			StatusTextBoxPtr->label( StatusText );
 		}
 		else{
 			if (StatusTextBoxPtr->labelsize() != DEBUGGING_TEXT_SIZE){
 				StatusTextBoxPtr->labelsize(DEBUGGING_TEXT_SIZE);
 			}
+			int DiagnosticsTextLength = 0;
+			DiagnosticsText[0] = '\0';
+			for (int J=0; J < DIAGNOSTIC_VALUES_PER_DISC; J++){
+				int Channel = VISIBLE_VALUES_PER_DISC + J;
+				float Diagnostic = FramePtr->Derived[CupId].Diagnostics[J];
+				if (std::isnan( Diagnostic )){
+					DiagnosticsTextLength += snprintf( DiagnosticsText + DiagnosticsTextLength, sizeof(DiagnosticsText) - DiagnosticsTextLength,
+							"%s%s N/A", (0 == J)? "" : "  ", ChannelName[CupId][Channel] );
+				}
+				else{
+					DiagnosticsTextLength += snprintf( DiagnosticsText + DiagnosticsTextLength, sizeof(DiagnosticsText) - DiagnosticsTextLength,
+							"%s%s %.4g%s", (0 == J)? "" : "  ", ChannelName[CupId][Channel],
+							(double)Diagnostic, ChannelUnit[CupId][Channel] );
+				}
+				if (DiagnosticsTextLength >= (int)sizeof(DiagnosticsText)){
+					break;
+				}
+			}
 			snprintf( StatusText, sizeof(StatusText)-1,
 					"%s\n"
 					"In: %04X %04X %04X %04X %04X\n"
-					"Coils %c %c %c",
-					atomic_load_explicit( &ModbusCoilsReadout[TemporaryIndexForSwitchPressed], std::memory_order_acquire )?
-							TextCupIsInserted : TextCupIsRemoved,
-					(uint16_t)atomic_load_explicit( &ModbusInputRegisters[MODBUS_INPUTS_PER_CUP*CupId+0], std::memory_order_acquire ),
-					(uint16_t)atomic_load_explicit( &ModbusInputRegisters[MODBUS_INPUTS_PER_CUP*CupId+1], std::memory_order_acquire ),
-					(uint16_t)atomic_load_explicit( &ModbusInputRegisters[MODBUS_INPUTS_PER_CUP*CupId+2], std::memory_order_acquire ),
-					(uint16_t)atomic_load_explicit( &ModbusInputRegisters[MODBUS_INPUTS_PER_CUP*CupId+3], std::memory_order_acquire ),
-					(uint16_t)atomic_load_explicit( &ModbusInputRegisters[MODBUS_INPUTS_PER_CUP*CupId+4], std::memory_order_acquire ),
-					atomic_load_explicit( &ModbusCoilsReadout[MODBUS_COILS_PER_CUP*CupId+0], std::memory_order_acquire )? '1' : '0',
-					atomic_load_explicit( &ModbusCoilsReadout[MODBUS_COILS_PER_CUP*CupId+1], std::memory_order_acquire )? '1' : '0',
-					atomic_load_explicit( &ModbusCoilsReadout[MODBUS_COILS_PER_CUP*CupId+2], std::memory_order_acquire )? '1' : '0' );
+					"%s\n"
+					"Coils %c %c %c  %s\n"
+					"Q = %s  (%.0f s)",
+					IsSwitchPressed? TextCupIsInserted : TextCupIsRemoved,
+					FramePtr->InputRegisters[MODBUS_INPUTS_PER_CUP*CupId+0],
+					FramePtr->InputRegisters[MODBUS_INPUTS_PER_CUP*CupId+1],
+					FramePtr->InputRegisters[MODBUS_INPUTS_PER_CUP*CupId+2],
+					FramePtr->InputRegisters[MODBUS_INPUTS_PER_CUP*CupId+3],
+					FramePtr->InputRegisters[MODBUS_INPUTS_PER_CUP*CupId+4],
+					DiagnosticsText,
+					FramePtr->Coils[MODBUS_COILS_PER_CUP*CupId+0]? '1' : '0',
+					FramePtr->Coils[MODBUS_COILS_PER_CUP*CupId+1]? '1' : '0',
+					FramePtr->Coils[MODBUS_COILS_PER_CUP*CupId+2]? '1' : '0',
+					BeamTripsText,
+					ChargeText, (double)FramePtr->Derived[CupId].ChargeIntegrationTime );
 			StatusTextBoxPtr->label( StatusText );
 		}
 	}
 
-	if (atomic_load_explicit( &ModbusCoilsReadout[TemporaryIndexForSwitchPressed], std::memory_order_acquire )){
+	// the most severe active alarm is shown in the title, regardless of the status level
+	uint32_t ActiveAlarmsMask = FramePtr->Derived[CupId].ActiveAlarmsMask;
+	if (0 != ActiveAlarmsMask){
+		int ShownAlarm = -1;
+		for (int J=0; J < AlarmsNumber; J++){
+			if ((0 != (ActiveAlarmsMask & (1u << J))) && ((ShownAlarm < 0) || (Alarms[J].Severity > Alarms[ShownAlarm].Severity))){
+				ShownAlarm = J;
+			}
+		}
+		char Description[2*CHANNEL_NAME_MAX_LENGTH + 60];
+		formatAlarmDescription( Description, sizeof(Description), ShownAlarm );
+		snprintf( TitleText, sizeof(TitleText), "%s  %s", CupDescriptionPtr[CupId], Description );
+		TitleTextBoxPtr->label( TitleText );
+		TitleTextBoxPtr->box( FL_FLAT_BOX );
+		TitleTextBoxPtr->color( (AlarmSeverities::WARNING == Alarms[ShownAlarm].Severity)? FL_YELLOW : FL_RED );
+		TitleTextBoxPtr->labelfont( (AlarmSeverities::CRITICAL == Alarms[ShownAlarm].Severity)? FL_HELVETICA_BOLD : ORDINARY_TEXT_FONT );
+		TitleTextBoxPtr->redraw();
+	}
+	else if (TitleTextBoxPtr->label() != CupDescriptionPtr[CupId]){
+		TitleTextBoxPtr->label( CupDescriptionPtr[CupId] );
+		TitleTextBoxPtr->box( FL_NO_BOX );
+		TitleTextBoxPtr->labelfont( ORDINARY_TEXT_FONT );
+		TitleTextBoxPtr->redraw();
+	}
+
+	if (IsSwitchPressed){
 		CupInsertionButtonPtr->label( "Wysuń" );
 	}
 	else{
 		CupInsertionButtonPtr->label( "Wsuń" );
 	}
-	if (!IsTransmissionCorrect ||
-		atomic_load_explicit( &ModbusCoilsReadout[TemporaryIndexForBlockage], std::memory_order_acquire ))
-	{
+	if (!IsTransmissionCorrect || IsCupBlocked){
 		CupInsertionButtonPtr->deactivate();
 	}
 	else{
@@ -536,24 +759,111 @@ void CupGuiGroup::refreshData(){
 	}
 }
 
+/// The charge is displayed in nC below 1 uC and in uC above
+static void formatCharge( char * TextPtr, size_t TextSize, const CupDerivedData * DerivedPtr ){
+	double Charge = DerivedPtr->Charge;
+	const char * StateText = (0 != DerivedPtr->IsChargeIntegrated)? "" : " (stop)";
+	if (fabs( Charge ) < 1.0){
+		snprintf( TextPtr, TextSize-1, "%.1f nC%s", 1000.0 * Charge, StateText );
+	}
+	else{
+		snprintf( TextPtr, TextSize-1, "%.3f μC%s", Charge, StateText );
+	}
+	TextPtr[TextSize-1] = '\0';
+}
+
 void refreshGui(void* Data){
 	(void)Data; // intentionally unused
 
-	CupGroupPtr[0]->refreshData();
-	CupGroupPtr[1]->refreshData();
-	CupGroupPtr[2]->refreshData();
+	readAcquisitionFrame( &GuiFrame );
+
+	for (int J=0; J<CUPS_NUMBER; J++){
+		if (CupGroupPtr[J]->isRefreshNeeded( &GuiFrame )){
+			CupGroupPtr[J]->refreshData( &GuiFrame );
+		}
+	}
+
+	writeBeamTripLog();
+	writeAlarmLog();
+	writeActuatorTravelLog();
+
+	if (finishAutoZero( AutoZeroReportText, sizeof(AutoZeroReportText) )){
+		Fl::add_timeout( 0.0, showAutoZeroReport );	// the dialog is not opened inside the awake callback
+	}
+	if (finishSpectrum( SpectrumReportText, sizeof(SpectrumReportText) )){
+		Fl::add_timeout( 0.0, showSpectrumReport );
+	}
+	if (finishActuatorReport( ActuatorReportText, sizeof(ActuatorReportText) )){
+		Fl::add_timeout( 0.0, showActuatorReport );
+	}
 
 	if (2 != StatusLevelForGui){
 		GeneralStatusTextBoxPtr->hide();
 	}
 	else{
 		static char GeneralDescriptionText[800];
+		char InterlockText[60];
+		double LastLatency, MaximumLatency;
+		InterlockText[0] = '\0';
+		if (getInterlockLatency( &LastLatency, &MaximumLatency )){
+			snprintf( InterlockText, sizeof(InterlockText), "  Blokada %.0f ms (max %.0f)", LastLatency, MaximumLatency );
+		}
+		char CaptureText[60];
+		uint64_t MissedTriggers = getMissedTriggersNumber();
+		CaptureText[0] = '\0';
+		if (0 != MissedTriggers){
+			snprintf( CaptureText, sizeof(CaptureText), "  Pominięte wyzwalacze: %llu", (unsigned long long)MissedTriggers );
+		}
+		char RecordingText[100];
+		uint64_t BytesWritten, LostFrames, DroppedWrites, DiskErrors;
+		bool IsRecordingFailed;
+		RecordingText[0] = '\0';
+		if (getRecordingStatus( &BytesWritten, &LostFrames, &IsRecordingFailed )){
+			if (IsRecordingFailed){
+				snprintf( RecordingText, sizeof(RecordingText), "  Błąd zapisu" );
+			}
+			else if (0 != LostFrames){
+				snprintf( RecordingText, sizeof(RecordingText), "  Zapis %.1f MB (utracone ramki: %llu)", BytesWritten/1.0e6,
+						(unsigned long long)LostFrames );
+			}
+			else{
+				snprintf( RecordingText, sizeof(RecordingText), "  Zapis %.1f MB", BytesWritten/1.0e6 );
+			}
+			getDiskWriterStatus( &DroppedWrites, &DiskErrors );
+			if (0 != DroppedWrites){
+				size_t Length = strlen( RecordingText );
+				snprintf( RecordingText + Length, sizeof(RecordingText) - Length, " (pominięte zapisy: %llu)",
+						(unsigned long long)DroppedWrites );
+			}
+		}
 		GeneralStatusTextBoxPtr->show();
 		snprintf( GeneralDescriptionText, sizeof(GeneralDescriptionText)-1,
-				"Port %s    Modbus %s",
+				"Port %s  Modbus %s  Bez zmian %.0f%%%s%s%s%s%s%s%s",
 				SerialPortRequestedNamePtr->c_str(),
-				getTransmissionQualityIndicatorTextForGui() );
+				getTransmissionQualityIndicatorTextForGui(),
+				getUnchangedCupReadoutsPercentage(),
+				(AutoZeroStates::IDLE != getAutoZeroState())? "  Autozerowanie" : "",
+				isCaptureInProgress()? "  Przechwytywanie" : "",
+				CaptureText,
+				isSpectrumInProgress()? "  Widmo" : "",
+				isBurstModeActive()? "  Odczyt seryjny" : "",
+				InterlockText,
+				RecordingText );
 		GeneralStatusTextBoxPtr->label( GeneralDescriptionText );
 	}
 }
 
+static void showAutoZeroReport( void * Data ){
+	(void)Data; // intentionally unused
+	fl_message( "%s", AutoZeroReportText );
+}
+
+static void showSpectrumReport( void * Data ){
+	(void)Data; // intentionally unused
+	fl_message( "%s", SpectrumReportText );
+}
+
+static void showActuatorReport( void * Data ){
+	(void)Data; // intentionally unused
+	fl_message( "%s", ActuatorReportText );
+}
@@ -0,0 +1,120 @@
+/// @file history_buffer.cpp
+///
+/// The history of acquired frames: a ring buffer with one writer (the peripheral thread)
+/// and any number of readers; each slot is protected by its own sequence number (seqlock),
+/// so the writer never waits for the readers and a slow reader only loses the oldest frames;
+/// the capacity is set by the configuration file (rounded up to a power of 2) before the threads start
+
+#include <cstring>
+
+#include "history_buffer.h"
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+struct HistorySlot {
+	/// 2*(FrameIndex+1) when the slot holds the frame FrameIndex; odd value while the slot is being overwritten
+	std::atomic<uint64_t> Stamp;
+	AcquisitionFrame Frame;
+};
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+static HistorySlot * HistorySlots;
+static uint64_t HistoryCapacity;
+static uint64_t HistoryIndexMask;	// HistoryCapacity-1
+
+/// The number of frames appended so far (the index of the next frame)
+static std::atomic<uint64_t> HistoryHead;
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+/// This function allocates the ring; it is called once, before any thread uses the history
+/// @param Capacity frames; rounded up to a power of 2
+void initializeHistoryBuffer( int Capacity ){
+	HistoryCapacity = 1;
+	while (HistoryCapacity < (uint64_t)Capacity){
+		HistoryCapacity *= 2;
+	}
+	HistoryIndexMask = HistoryCapacity - 1;
+	HistorySlots = new HistorySlot[HistoryCapacity]();
+	atomic_store_explicit( &HistoryHead, 0, std::memory_order_release );
+}
+
+uint64_t getHistoryCapacity(void){
+	return HistoryCapacity;
+}
+
+/// This function is called by the peripheral thread only
+void appendToHistory( const AcquisitionFrame * FramePtr ){
+	uint64_t FrameIndex = atomic_load_explicit( &HistoryHead, std::memory_order_relaxed );
+	HistorySlot * SlotPtr = &HistorySlots[FrameIndex & HistoryIndexMask];
+
+	atomic_store_explicit( &SlotPtr->Stamp, 2*FrameIndex+1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	memcpy( &SlotPtr->Frame, FramePtr, sizeof(SlotPtr->Frame) );
+	atomic_store_explicit( &SlotPtr->Stamp, 2*(FrameIndex+1), std::memory_order_release );
+
+	atomic_store_explicit( &HistoryHead, FrameIndex+1, std::memory_order_release );
+}
+
+uint64_t getHistoryFramesNumber(void){
+	return atomic_load_explicit( &HistoryHead, std::memory_order_acquire );
+}
+
+/// This function copies a frame from the history (random access)
+/// @return false if the frame has not been written yet or has already been overwritten
+bool readHistoryFrame( uint64_t FrameIndex, AcquisitionFrame * FramePtr ){
+	const HistorySlot * SlotPtr = &HistorySlots[FrameIndex & HistoryIndexMask];
+	uint64_t ExpectedStamp = 2*(FrameIndex+1);
+
+	if (atomic_load_explicit( &SlotPtr->Stamp, std::memory_order_acquire ) != ExpectedStamp){
+		return false;
+	}
+	memcpy( FramePtr, &SlotPtr->Frame, sizeof(SlotPtr->Frame) );
+	std::atomic_thread_fence( std::memory_order_acquire );
+	return atomic_load_explicit( &SlotPtr->Stamp, std::memory_order_relaxed ) == ExpectedStamp;
+}
+
+/// This function sets the cursor either at the oldest frame still available or at the next frame to come
+void initializeHistoryCursor( HistoryCursor * CursorPtr, bool FromOldestFrame ){
+	uint64_t Head = getHistoryFramesNumber();
+	if (FromOldestFrame && (Head > HistoryCapacity)){
+		CursorPtr->NextFrameIndex = Head - HistoryCapacity;
+	}
+	else if (FromOldestFrame){
+		CursorPtr->NextFrameIndex = 0;
+	}
+	else{
+		CursorPtr->NextFrameIndex = Head;
+	}
+	CursorPtr->LostFrames = 0;
+}
+
+/// This function reads the next frame for the consumer; if the writer has overtaken the consumer,
+/// the overwritten frames are skipped and counted in CursorPtr->LostFrames
+/// @return false if there is no new frame
+bool readFromHistory( HistoryCursor * CursorPtr, AcquisitionFrame * FramePtr ){
+	while (true){
+		uint64_t Head = getHistoryFramesNumber();
+		if (CursorPtr->NextFrameIndex >= Head){
+			return false;
+		}
+		if (Head - CursorPtr->NextFrameIndex > HistoryCapacity){
+			CursorPtr->LostFrames += Head - HistoryCapacity - CursorPtr->NextFrameIndex;
+			CursorPtr->NextFrameIndex = Head - HistoryCapacity;
+		}
+		if (readHistoryFrame( CursorPtr->NextFrameIndex, FramePtr )){
+			CursorPtr->NextFrameIndex++;
+			return true;
+		}
+		// the slot has just been overwritten
+		CursorPtr->LostFrames++;
+		CursorPtr->NextFrameIndex++;
+	}
+}
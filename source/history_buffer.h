@@ -0,0 +1,39 @@
+/// @file history_buffer.h
+
+#ifndef SOURCE_HISTORY_BUFFER_H_
+#define SOURCE_HISTORY_BUFFER_H_
+
+#include <cstdint>
+
+#include "config.h"
+#include "shared_data.h"
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+/// Each consumer of the history (GUI, logger, analysis, ...) has its own cursor
+struct HistoryCursor {
+	uint64_t NextFrameIndex;	// index of the next frame to be read (frames are numbered from 0)
+	uint64_t LostFrames;		// frames overwritten before the consumer managed to read them
+};
+
+//.................................................................................................
+// Function prototypes
+//.................................................................................................
+
+void initializeHistoryBuffer( int Capacity );
+
+uint64_t getHistoryCapacity(void);
+
+void appendToHistory( const AcquisitionFrame * FramePtr );
+
+uint64_t getHistoryFramesNumber(void);
+
+bool readHistoryFrame( uint64_t FrameIndex, AcquisitionFrame * FramePtr );
+
+void initializeHistoryCursor( HistoryCursor * CursorPtr, bool FromOldestFrame );
+
+bool readFromHistory( HistoryCursor * CursorPtr, AcquisitionFrame * FramePtr );
+
+#endif // SOURCE_HISTORY_BUFFER_H_
@@ -26,8 +26,22 @@
 #include "peripheral_thread.h"
 #include "gui_widgets.h"
 #include "shared_data.h"
+#include "history_buffer.h"
 #include "settings_file.h"
 #include "modbus_rtu_master.h"
+#include "current_conversion.h"
+#include "signal_processing.h"
+#include "auto_zero.h"
+#include "beam_trips.h"
+#include "triggered_capture.h"
+#include "spectral_analysis.h"
+#include "alarms.h"
+#include "actuator_timing.h"
+#include "recorder.h"
+#include "disk_writer.h"
+#include "retention.h"
+#include "calibration_fit.h"
+#include "recording_export.h"
 
 //.................................................................................................
 // Preprocessor directives
@@ -62,6 +76,11 @@ WindowEscProof* ApplicationWindow;
 
 int StatusLevelForGui;
 
+/// These variables are set by the menu; mean, standard deviation, minimum and maximum over the window
+/// StatisticsWindowLength[ShownStatisticsWindow] are displayed under the currents
+bool ShowStatisticsInDiscs;
+int ShownStatisticsWindow;
+
 
 //.................................................................................................
 // Local variables
@@ -69,6 +88,19 @@ int StatusLevelForGui;
 
 static Fl_Box * FailureMessagePtr;
 
+/// These variables are set by the arguments "--kalibracja <file>" and "--stopien <degree>"; the application
+/// then fits the calibration functions and exits without starting the GUI
+static const char * CalibrationFitFileNamePtr;
+static int CalibrationFitDegree = 1;
+
+/// These variables are set by the argument "--eksport <start> <end> <file>" (or "--podsumowanie <start> <end> <tiles>
+/// <file>"); the application then exports the recorded frames (or the summary tiles) of the range and exits
+/// without starting the GUI
+static const char * ExportStartTextPtr;
+static const char * ExportEndTextPtr;
+static const char * ExportTilesTextPtr;
+static const char * ExportFileNamePtr;
+
 //.................................................................................................
 // Local function prototypes
 //.................................................................................................
@@ -83,6 +115,20 @@ static FailureCodes mainInitializations(int argc, char** argv);
 
 static void callbackForMenuItemStatus(Fl_Widget* WidgetPtr, void*);
 
+static void callbackForMenuItemStatistics(Fl_Widget* WidgetPtr, void*);
+
+static void callbackForMenuItemChargeReset(Fl_Widget*, void*);
+
+static void callbackForMenuItemAutoZero(Fl_Widget*, void* Data);
+
+static void callbackForMenuItemCapture(Fl_Widget*, void*);
+
+static void callbackForMenuItemSpectrum(Fl_Widget*, void*);
+
+static void callbackForMenuItemActuatorReport(Fl_Widget*, void*);
+
+static void callbackForMenuItemCompressionReport(Fl_Widget*, void*);
+
 static void callbackForMenuItemHelp(Fl_Widget*, void*);
 
 //.................................................................................................
@@ -94,6 +140,21 @@ int main(int argc, char** argv) {
 
 	FailureCodes ErrorCode = mainInitializations( argc, argv);
 
+	if (nullptr != CalibrationFitFileNamePtr){
+		if (FailureCodes::NO_FAILURE == ErrorCode){
+			ErrorCode = runCalibrationFit( CalibrationFitFileNamePtr, CalibrationFitDegree );
+		}
+		return (FailureCodes::NO_FAILURE == ErrorCode)? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	if (nullptr != ExportFileNamePtr){
+		if (FailureCodes::NO_FAILURE == ErrorCode){
+			ErrorCode = (nullptr != ExportTilesTextPtr)?
+					runSummaryExport( ExportStartTextPtr, ExportEndTextPtr, ExportTilesTextPtr, ExportFileNamePtr ) :
+					runRecordingExport( ExportStartTextPtr, ExportEndTextPtr, ExportFileNamePtr );
+		}
+		return (FailureCodes::NO_FAILURE == ErrorCode)? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
     // Main window of the application
 	Fl::scheme("gtk+");
 	ApplicationWindow = new WindowEscProof(MAIN_WINDOW_WIDTH, MAIN_WINDOW_HEIGHT, "Pomiar Wiązki w Linii Iniekcyjnej" );
@@ -108,10 +169,25 @@ int main(int argc, char** argv) {
     MenuWidget.add(                 "Narzędzia/Status/Ukryty", 0, callbackForMenuItemStatus, (void*)0, FL_MENU_RADIO);
 	int indexOfMenuItemStatusNormal = MenuWidget.add("Narzędzia/Status/Normalny", 0, callbackForMenuItemStatus, (void*)1, FL_MENU_RADIO);
 	MenuWidget.add(                 "Narzędzia/Status/Szczegółowy", 0, callbackForMenuItemStatus, (void*)2, FL_MENU_RADIO);
+	int IndexOfMenuItemStatisticsHidden = MenuWidget.add("Narzędzia/Statystyki na tarczach/Ukryte", 0,
+			callbackForMenuItemStatistics, (void*)-1, FL_MENU_RADIO);
+	for (int J=0; J < StatisticsWindowsNumber; J++){
+		std::string ItemName = "Narzędzia/Statystyki na tarczach/Okno " + std::to_string( StatisticsWindowLength[J] ) + " próbek";
+		MenuWidget.add( ItemName.c_str(), 0, callbackForMenuItemStatistics, (void*)(intptr_t)J, FL_MENU_RADIO);
+	}
+	MenuWidget.add("Narzędzia/Zeruj liczniki ładunku", 0, callbackForMenuItemChargeReset);
+	MenuWidget.add("Narzędzia/Autozerowanie (wiązka wyłączona)", 0, callbackForMenuItemAutoZero, (void*)0);
+	MenuWidget.add("Narzędzia/Autozerowanie z zapisem do pliku", 0, callbackForMenuItemAutoZero, (void*)1);
+	MenuWidget.add("Narzędzia/Przechwyć teraz", 0, callbackForMenuItemCapture);
+	MenuWidget.add("Narzędzia/Widmo prądów", 0, callbackForMenuItemSpectrum, (void*)0);
+	MenuWidget.add("Narzędzia/Widmo prądów (odczyt seryjny)", 0, callbackForMenuItemSpectrum, (void*)1);
+	MenuWidget.add("Narzędzia/Czasy przesuwu kubków", 0, callbackForMenuItemActuatorReport);
+	MenuWidget.add("Narzędzia/Kompresja zapisu", 0, callbackForMenuItemCompressionReport);
 	MenuWidget.add("Pomoc/Otwórz PDF", 0, callbackForMenuItemHelp);
 
 	Fl_Menu_Item* MenuItems = const_cast<Fl_Menu_Item*>(MenuWidget.menu());
 	MenuWidget.setonly(&MenuItems[indexOfMenuItemStatusNormal]);
+	MenuWidget.setonly(&MenuItems[IndexOfMenuItemStatisticsHidden]);
 
 	StatusLevelForGui = DEFAULT_STATUS_LEVEL;
 
@@ -131,6 +207,11 @@ int main(int argc, char** argv) {
 
 	if (FailureCodes::NO_FAILURE == ErrorCode){
 		serialCommunicationStart();
+		triggeredCaptureStart();
+		spectralAnalysisStart();
+		diskWriterStart();
+		recorderStart();
+		retentionStart();
 	}
 
     return Fl::run();
@@ -208,6 +289,11 @@ static void onMainWindowCloseCallback(Fl_Widget *Widget, void *Data) {
     	std::cout << "Zamykanie aplikacji" << std::endl;
     }
     serialCommunicationExit();
+    triggeredCaptureExit();
+    spectralAnalysisExit();
+    recorderExit();
+    retentionExit();
+    diskWriterExit();
     ApplicationWindow->hide(); // close the application
 }
 
@@ -230,6 +316,30 @@ static FailureCodes mainInitializations(int argc, char** argv){
         	std::cout << "Wywołanie programu: " << Argument0 << std::endl;
 #endif
         }
+        else if ((Argument == "--kalibracja") && (J+1 < argc)) {
+        	J++;
+        	CalibrationFitFileNamePtr = argv[J];
+        }
+        else if ((Argument == "--eksport") && (J+3 < argc)) {
+        	ExportStartTextPtr = argv[++J];
+        	ExportEndTextPtr = argv[++J];
+        	ExportFileNamePtr = argv[++J];
+        }
+        else if ((Argument == "--podsumowanie") && (J+4 < argc)) {
+        	ExportStartTextPtr = argv[++J];
+        	ExportEndTextPtr = argv[++J];
+        	ExportTilesTextPtr = argv[++J];
+        	ExportFileNamePtr = argv[++J];
+        }
+        else if ((Argument == "--stopien") && (J+1 < argc)) {
+        	J++;
+        	char* EndPtr;
+        	CalibrationFitDegree = (int)strtol( argv[J], &EndPtr, 10 );
+        	if ((EndPtr == argv[J]) || (0 != *EndPtr) || (CalibrationFitDegree < 1) || (CalibrationFitDegree > CALIBRATION_POLYNOMIAL_MAX_DEGREE)){
+                std::cout << "Stopień wielomianu musi zawierać się w przedziale [1; " << CALIBRATION_POLYNOMIAL_MAX_DEGREE << "]" << std::endl;
+                FailureCode = FailureCodes::ERROR_COMMAND_SYNTAX;
+        	}
+        }
         else {
             std::cout << "Nieznany argument: " << Argument << std::endl;
             FailureCode = FailureCodes::ERROR_COMMAND_SYNTAX;
@@ -244,6 +354,10 @@ static FailureCodes mainInitializations(int argc, char** argv){
 		}
 	}
 
+	if (nullptr != CalibrationFitFileNamePtr){
+		return FailureCode;	// the command line mode needs neither the configuration file nor the serial port
+	}
+
 	if (FailureCodes::NO_FAILURE == FailureCode){
 		FailureCode = determineApplicationPath( argv[0] );
 	}
@@ -251,22 +365,20 @@ static FailureCodes mainInitializations(int argc, char** argv){
 		FailureCode = configurationFileParsing();
 	}
 	if (FailureCodes::NO_FAILURE == FailureCode){
-		FailureCode = initializeModbus();
-	}
-	for (int Cup = 0; Cup < CUPS_NUMBER; Cup++){
-		for (int J=0; J < MODBUS_INPUTS_PER_CUP; J++){
-			int TemporaryRegisterIndex = Cup*MODBUS_INPUTS_PER_CUP + J;
-			assert( TemporaryRegisterIndex < MODBUS_INPUTS_NUMBER );
-			atomic_store_explicit( &ModbusInputRegisters[TemporaryRegisterIndex], 0xFFFF, std::memory_order_release );
+		buildConversionTables();
+		if (nullptr != ExportFileNamePtr){
+			return FailureCode;	// the export needs the calibration only
 		}
+		initializeHistoryBuffer( HistoryBufferCapacity );
+		initializeSignalProcessing();
+		initializeBeamTripDetection();
+		initializeAlarms();
+		initializeActuatorTiming();
 	}
-	for (int Cup = 0; Cup < CUPS_NUMBER; Cup++){
-		for (int J=0; J < MODBUS_COILS_PER_CUP; J++){
-			int TemporaryRegisterIndex = Cup*MODBUS_COILS_PER_CUP + J;
-			assert( TemporaryRegisterIndex < MODBUS_COILS_NUMBER );
-			atomic_store_explicit( &ModbusCoilsReadout[TemporaryRegisterIndex], false, std::memory_order_release );
-		}
+	if (FailureCodes::NO_FAILURE == FailureCode){
+		FailureCode = initializeModbus();
 	}
+	initializeSharedData();
 	return FailureCode;
 }
 
@@ -283,6 +395,75 @@ static void callbackForMenuItemStatus(Fl_Widget* WidgetPtr, void*) {
 	}
 }
 
+static void callbackForMenuItemStatistics(Fl_Widget* WidgetPtr, void*) {
+    auto* TemporaryMenu = static_cast<Fl_Menu_Bar*>(WidgetPtr);
+    const Fl_Menu_Item* TemporaryMenuItem = TemporaryMenu->mvalue();
+    if (!TemporaryMenuItem){
+    	return;
+    }
+
+    int Window = static_cast<int>(reinterpret_cast<intptr_t>(TemporaryMenuItem->user_data()));
+    ShowStatisticsInDiscs = (Window >= 0);
+    ShownStatisticsWindow = ShowStatisticsInDiscs? Window : 0;
+	if (VerboseMode){
+		std::cout << "Opcja Statystyki ustawiona na wartość: " << Window << std::endl;
+	}
+}
+
+static void callbackForMenuItemChargeReset(Fl_Widget*, void*) {
+	for (int J=0; J < CUPS_NUMBER; J++){
+		atomic_store_explicit( &ChargeResetRequest[J], true, std::memory_order_release );
+	}
+	if (VerboseMode){
+		std::cout << "Zerowanie liczników ładunku" << std::endl;
+	}
+}
+
+/// The baselines are measured only after the operator confirms that the beam is switched off
+static void callbackForMenuItemAutoZero(Fl_Widget*, void* Data) {
+	bool SaveToFile = (0 != reinterpret_cast<intptr_t>(Data));
+	if (0 == fl_choice("Czy wiązka jest wyłączona?", "Anuluj", "Wyłączona", nullptr)){
+		return;
+	}
+	if (!requestAutoZero( SaveToFile )){
+		fl_alert("Poprzednie autozerowanie jeszcze trwa.");
+		return;
+	}
+	if (VerboseMode){
+		std::cout << "Autozerowanie" << (SaveToFile? " z zapisem do pliku" : "") << std::endl;
+	}
+}
+
+static void callbackForMenuItemCapture(Fl_Widget*, void*) {
+	requestManualTrigger();
+	if (VerboseMode){
+		std::cout << "Ręczne wyzwolenie przechwytywania" << std::endl;
+	}
+}
+
+/// The spectrum is computed from the recent readouts, or from the readouts of the burst mode started here
+static void callbackForMenuItemSpectrum(Fl_Widget*, void* Data) {
+	bool IsBurstRequested = (0 != reinterpret_cast<intptr_t>(Data));
+	if (!requestSpectrum( IsBurstRequested )){
+		fl_alert("Poprzednie widmo jeszcze nie jest gotowe.");
+		return;
+	}
+	if (VerboseMode){
+		std::cout << "Widmo prądów" << (IsBurstRequested? " (odczyt seryjny)" : "") << std::endl;
+	}
+}
+
+/// The report is prepared by the peripheral thread and shown at the next refresh of the GUI
+static void callbackForMenuItemActuatorReport(Fl_Widget*, void*) {
+	requestActuatorReport();
+}
+
+static void callbackForMenuItemCompressionReport(Fl_Widget*, void*) {
+	static char ReportText[1500];
+	formatCompressionReport( ReportText, sizeof(ReportText) );
+	fl_message( "%s", ReportText );
+}
+
 static void callbackForMenuItemHelp(Fl_Widget*, void*) {
     const char* PdfFileName = "Pomiar_Wiązki.pdf";
 
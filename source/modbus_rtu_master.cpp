@@ -96,8 +96,10 @@ FailureCodes readInputRegisters(void){
     }
     else {
         for (int i = 0; i < ReceivedRegisters; ++i) {
-        	atomic_store_explicit( &ModbusInputRegisters[i], RegistersTable[i], std::memory_order_release );
+        	AcquisitionWorkingFrame.InputRegisters[i] = RegistersTable[i];
         }
+        AcquisitionWorkingFrame.RegistersTime = std::chrono::high_resolution_clock::now();
+        AcquisitionWorkingFrame.QualityFlags |= FRAME_QUALITY_REGISTERS_VALID | FRAME_QUALITY_REGISTERS_UPDATED;
 
 #if 0 // debugging
         printf("Odczytano: " );
@@ -137,13 +139,10 @@ FailureCodes readCoils(void){
     }
     else {
         for (int i = 0; i < ReceivedBits; ++i) {
-        	if (0 != TemporaryTable[i]){
-        		atomic_store_explicit( &ModbusCoilsReadout[i], true, std::memory_order_release );
-        	}
-        	else{
-        		atomic_store_explicit( &ModbusCoilsReadout[i], false, std::memory_order_release );
-        	}
+        	AcquisitionWorkingFrame.Coils[i] = (0 != TemporaryTable[i]);
         }
+        AcquisitionWorkingFrame.CoilsTime = std::chrono::high_resolution_clock::now();
+        AcquisitionWorkingFrame.QualityFlags |= FRAME_QUALITY_COILS_VALID | FRAME_QUALITY_COILS_UPDATED;
 
 #if 0 // debugging
         printf(" bity: " );
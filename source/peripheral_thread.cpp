@@ -11,9 +11,13 @@
 
 #include "peripheral_thread.h"
 #include "shared_data.h"
+#include "history_buffer.h"
+#include "signal_processing.h"
 #include "modbus_rtu_master.h"
 #include "gui_widgets.h"
 #include "settings_file.h"
+#include "alarms.h"
+#include "actuator_timing.h"
 
 //.................................................................................................
 // Preprocessor directives
@@ -29,6 +33,10 @@
 
 #define TRANSMISSION_CORRECTNESS_LIMIT		((LOW_LEVEL_CONTINUOUS_COUNTING_MAX * 3) / 4)
 
+#define GUI_HEARTBEAT_PERIOD				500	// milliseconds; the GUI is refreshed at least this often even without changes
+
+#define BURST_COILS_READING_PERIOD			10	// in the burst mode the coils are read once per this number of cycles
+
 //...............................................................................................
 // Types definitions
 //...............................................................................................
@@ -60,12 +68,36 @@ static uint16_t LowLevelContinuousErrors, LowLevelSuccessfulTransmission;
 
 static std::atomic<int> TransmissionQualityLowLevelIndicator;
 
+/// Changes accumulated since the last GUI refresh (logical sum of AcquisitionFrame::CupChangeMask[])
+static uint16_t ChangesPendingForGui;
+
+/// The state of DisplayLimitSwitchError[] at the last GUI refresh
+static bool LimitSwitchErrorShownByGui[CUPS_NUMBER];
+
+static std::chrono::high_resolution_clock::time_point LastGuiRefreshTime;
+
+/// The duration of the burst mode requested by another thread (0 when there is no request)
+static std::atomic<int> BurstModeRequest;
+
+/// This flag is set from the request until the end of the burst mode
+static std::atomic<bool> IsBurstModeOn;
+
+/// These variables are used by the peripheral thread only
+static int64_t BurstModeEndInMilliseconds;
+static int BurstCyclesCounter;
+
 //.................................................................................................
 // Local function prototypes
 //.................................................................................................
 
 static void peripheralThreadHandler(void);
 
+static bool isGuiRefreshNeeded(void);
+
+static void checkLimitSwitches( std::chrono::high_resolution_clock::time_point TimeNow );
+
+static void updateBurstMode(void);
+
 //.................................................................................................
 // Function definitions
 //.................................................................................................
@@ -124,6 +156,7 @@ static void peripheralThreadHandler(void){
 	while( !atomic_load_explicit( &ClosePeripheralsFlag, std::memory_order_acquire )){
 
 		// timing
+		updateBurstMode();
 		if (LOW_LEVEL_CONTINUOUS_ERRORS_LIMIT <= LowLevelContinuousErrors){
 			PeripheralThreadTimeInMilliseconds += DELAY_MULTIPLIER_ON_ERROR * PERIPHERAL_THREAD_LOOP_DURATION;
 			DelayMultiplierOnError = DELAY_MULTIPLIER_ON_ERROR;
@@ -134,27 +167,13 @@ static void peripheralThreadHandler(void){
 		}
 		std::chrono::high_resolution_clock::time_point TimeNow = std::chrono::high_resolution_clock::now();
 		std::chrono::milliseconds DurationTime = std::chrono::duration_cast<std::chrono::milliseconds>(TimeNow - PeripheralThreadLoopStart);
+		if (DurationTime.count() >= PeripheralThreadTimeInMilliseconds){
+			// no free time (e.g. the burst mode)
+			checkLimitSwitches( TimeNow );
+		}
 		while(DurationTime.count() < PeripheralThreadTimeInMilliseconds){
 			// free time activities:  checking for inconsistencies in the status of limit switches
-			for (int J=0; J<PHYSICALLY_INSTALLED_CUPS; J++){
-				int TemporaryCoilIndex1 = COIL_OFFSET_IS_CUP_FORCED+J*MODBUS_COILS_PER_CUP;
-				assert( TemporaryCoilIndex1 < MODBUS_COILS_NUMBER );
-				int TemporaryCoilIndex2 = COIL_OFFSET_IS_SWITCH_PRESSED+J*MODBUS_COILS_PER_CUP;
-				assert( TemporaryCoilIndex2 < MODBUS_COILS_NUMBER );
-				if (ModbusCoilsReadout[TemporaryCoilIndex1] == ModbusCoilsReadout[TemporaryCoilIndex2]){
-					atomic_store_explicit( &DisplayLimitSwitchError[J], false, std::memory_order_release );
-				}
-				else{
-					std::chrono::milliseconds CupInsertionOrRemovalDuration =
-							std::chrono::duration_cast<std::chrono::milliseconds>(TimeNow - CupInsertionOrRemovalStartTime[J]);
-					if (CupInsertionOrRemovalDuration.count() > MaximumPropagationTime){
-						atomic_store_explicit( &DisplayLimitSwitchError[J], true, std::memory_order_release );
-					}
-					else{
-						atomic_store_explicit( &DisplayLimitSwitchError[J], false, std::memory_order_release );
-					}
-				}
-			}
+			checkLimitSwitches( TimeNow );
 			TimeNow = std::chrono::high_resolution_clock::now();
 			DurationTime = std::chrono::duration_cast<std::chrono::milliseconds>(TimeNow - PeripheralThreadLoopStart);
 			if (DurationTime.count() >= PeripheralThreadTimeInMilliseconds){
@@ -178,12 +197,27 @@ static void peripheralThreadHandler(void){
 			bool IsEssentialActionDone = false;
 			FailureCodes Result;
 
+			AcquisitionWorkingFrame.QualityFlags &= ~(FRAME_QUALITY_REGISTERS_UPDATED | FRAME_QUALITY_COILS_UPDATED);
+
 			if (!IsEssentialActionDone && (ModbusFsmStates::OPEN == FsmState)){
 				FsmState = ModbusFsmStates::READING_INPUT_REGISTERS;
 				Result = readInputRegisters();
 				IsEssentialActionDone = true;
 			}
 
+			if (!IsEssentialActionDone && (ModbusFsmStates::READING_INPUT_REGISTERS == FsmState) && isInterlockPending()){
+				// the cup removal requested by an alarm does not wait for the coils to be read
+				FsmState = ModbusFsmStates::READING_COILS;
+			}
+
+			if (!IsEssentialActionDone && (ModbusFsmStates::READING_INPUT_REGISTERS == FsmState) &&
+					atomic_load_explicit( &IsBurstModeOn, std::memory_order_acquire ) &&
+					(0 != (++BurstCyclesCounter % BURST_COILS_READING_PERIOD)))
+			{
+				Result = readInputRegisters();
+				IsEssentialActionDone = true;
+			}
+
 			if (!IsEssentialActionDone && (ModbusFsmStates::READING_INPUT_REGISTERS == FsmState)){
 				FsmState = ModbusFsmStates::READING_COILS;
 				Result = readCoils();
@@ -196,9 +230,13 @@ static void peripheralThreadHandler(void){
 						FsmState = ModbusFsmStates::WRITING_COIL;
 
 						atomic_store_explicit( &ModbusCoilChangeReqest[J], false, std::memory_order_release );
+						bool RequestedValue = atomic_load_explicit( &ModbusCoilRequestedValue[J], std::memory_order_acquire );
+						RequestedValue = filterCoilRequest( J, RequestedValue );
 						Result = writeSingleCoil(
 							MODBUS_COILS_ADDRESS+COIL_OFFSET_IS_CUP_FORCED+J*MODBUS_COILS_PER_CUP,
-							atomic_load_explicit( &ModbusCoilRequestedValue[J], std::memory_order_acquire ) );
+							RequestedValue );
+						reportCoilWritten( J, Result );
+						noteActuatorCommandWritten( J, RequestedValue, Result );
 
 						IsEssentialActionDone = true;
 						break;
@@ -246,13 +284,28 @@ static void peripheralThreadHandler(void){
 			atomic_store_explicit(&TransmissionQualityLowLevelIndicator,
 					LowLevelSuccessfulTransmission, std::memory_order_release);
 
+			if (isTransmissionCorrect()){
+				AcquisitionWorkingFrame.QualityFlags |= FRAME_QUALITY_TRANSMISSION_CORRECT;
+			}
+			else{
+				AcquisitionWorkingFrame.QualityFlags &= ~FRAME_QUALITY_TRANSMISSION_CORRECT;
+			}
+			processAcquisitionFrame( &AcquisitionWorkingFrame );
+			publishAcquisitionFrame();
+			if (0 != (AcquisitionWorkingFrame.QualityFlags & (FRAME_QUALITY_REGISTERS_UPDATED | FRAME_QUALITY_COILS_UPDATED))){
+				appendToHistory( &AcquisitionWorkingFrame );
+			}
+			for (int J=0; J<CUPS_NUMBER; J++){
+				ChangesPendingForGui |= AcquisitionWorkingFrame.CupChangeMask[J];
+			}
+
 #if 0 // debugging
 			std::chrono::high_resolution_clock::time_point TimeAfter = std::chrono::high_resolution_clock::now();
 			std::chrono::milliseconds ProcessingTime = std::chrono::duration_cast<std::chrono::milliseconds>(TimeAfter - TimeNow);
 			std::cout << "Peripheral thread " << PeripheralThreadTimeInMilliseconds << "  " << ProcessingTime.count() << std::endl;
 #endif
 
-			if (ModbusFsmStates::READING_INPUT_REGISTERS == FsmState) {
+			if ((ModbusFsmStates::READING_INPUT_REGISTERS == FsmState) && isGuiRefreshNeeded()) {
 				Fl::awake(refreshGui, nullptr);
 			}
 		}
@@ -279,6 +332,92 @@ static void peripheralThreadHandler(void){
 	atomic_store_explicit( &PeripheralsClosedFlag, true, std::memory_order_release );
 }
 
+/// The status of a limit switch is inconsistent, when it differs from the state of the actuator for too long
+static void checkLimitSwitches( std::chrono::high_resolution_clock::time_point TimeNow ){
+	for (int J=0; J<PHYSICALLY_INSTALLED_CUPS; J++){
+		int TemporaryCoilIndex1 = COIL_OFFSET_IS_CUP_FORCED+J*MODBUS_COILS_PER_CUP;
+		assert( TemporaryCoilIndex1 < MODBUS_COILS_NUMBER );
+		int TemporaryCoilIndex2 = COIL_OFFSET_IS_SWITCH_PRESSED+J*MODBUS_COILS_PER_CUP;
+		assert( TemporaryCoilIndex2 < MODBUS_COILS_NUMBER );
+		if (AcquisitionWorkingFrame.Coils[TemporaryCoilIndex1] == AcquisitionWorkingFrame.Coils[TemporaryCoilIndex2]){
+			atomic_store_explicit( &DisplayLimitSwitchError[J], false, std::memory_order_release );
+		}
+		else{
+			std::chrono::milliseconds CupInsertionOrRemovalDuration =
+					std::chrono::duration_cast<std::chrono::milliseconds>(TimeNow -
+					atomic_load_explicit( &CupInsertionOrRemovalStartTime[J], std::memory_order_acquire ));
+			if (CupInsertionOrRemovalDuration.count() > MaximumPropagationTime){
+				atomic_store_explicit( &DisplayLimitSwitchError[J], true, std::memory_order_release );
+			}
+			else{
+				atomic_store_explicit( &DisplayLimitSwitchError[J], false, std::memory_order_release );
+			}
+		}
+	}
+}
+
+/// The GUI is not woken up when nothing it displays has changed; the heartbeat refreshes
+/// the transmission quality text and the settings changed from the menu. In the burst mode
+/// the GUI is not refreshed more often than in the normal mode.
+static bool isGuiRefreshNeeded(void){
+	std::chrono::high_resolution_clock::time_point TimeNow = std::chrono::high_resolution_clock::now();
+	if (atomic_load_explicit( &IsBurstModeOn, std::memory_order_acquire ) &&
+			(std::chrono::duration_cast<std::chrono::milliseconds>(TimeNow - LastGuiRefreshTime).count() < 2*PERIPHERAL_THREAD_LOOP_DURATION))
+	{
+		return false;
+	}
+	bool IsNeeded = (0 != ChangesPendingForGui);
+
+	for (int J=0; J<CUPS_NUMBER; J++){
+		bool IsErrorDisplayed = atomic_load_explicit( &DisplayLimitSwitchError[J], std::memory_order_acquire );
+		if (LimitSwitchErrorShownByGui[J] != IsErrorDisplayed){
+			LimitSwitchErrorShownByGui[J] = IsErrorDisplayed;
+			IsNeeded = true;
+		}
+	}
+	if (std::chrono::duration_cast<std::chrono::milliseconds>(TimeNow - LastGuiRefreshTime).count() >= GUI_HEARTBEAT_PERIOD){
+		IsNeeded = true;
+	}
+	if (IsNeeded){
+		ChangesPendingForGui = 0;
+		LastGuiRefreshTime = TimeNow;
+	}
+	return IsNeeded;
+}
+
+/// This function is called by another thread (see spectral_analysis.cpp); in the burst mode the registers
+/// are read back-to-back, without waiting for the next PERIPHERAL_THREAD_LOOP_DURATION period, and the coils
+/// are read only once per BURST_COILS_READING_PERIOD cycles. The burst mode ends after the given time
+/// or on continuous transmission errors.
+void startBurstMode( int DurationInMilliseconds ){
+	atomic_store_explicit( &IsBurstModeOn, true, std::memory_order_release );
+	atomic_store_explicit( &BurstModeRequest, DurationInMilliseconds, std::memory_order_release );
+}
+
+bool isBurstModeActive(void){
+	return atomic_load_explicit( &IsBurstModeOn, std::memory_order_acquire );
+}
+
+/// This function takes the request of the burst mode and ends the burst mode in due time
+static void updateBurstMode(void){
+	int64_t TimeInMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::high_resolution_clock::now() - PeripheralThreadLoopStart).count();
+	int Request = atomic_exchange_explicit( &BurstModeRequest, 0, std::memory_order_acq_rel );
+	if (Request > 0){
+		BurstModeEndInMilliseconds = TimeInMilliseconds + Request;
+		BurstCyclesCounter = 0;
+	}
+	if (atomic_load_explicit( &IsBurstModeOn, std::memory_order_acquire )){
+		if ((TimeInMilliseconds >= BurstModeEndInMilliseconds) || (LOW_LEVEL_CONTINUOUS_ERRORS_LIMIT <= LowLevelContinuousErrors)){
+			atomic_store_explicit( &IsBurstModeOn, false, std::memory_order_release );
+		}
+		else{
+			// no waiting for the next period
+			PeripheralThreadTimeInMilliseconds = TimeInMilliseconds - PERIPHERAL_THREAD_LOOP_DURATION;
+		}
+	}
+}
+
 bool isTransmissionCorrect(void){
 	return atomic_load_explicit( &TransmissionQualityLowLevelIndicator, std::memory_order_acquire ) > TRANSMISSION_CORRECTNESS_LIMIT;
 }
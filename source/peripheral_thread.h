@@ -22,4 +22,8 @@ char * getTransmissionQualityIndicatorTextForDebugging(void);
 
 bool isTransmissionCorrect(void);
 
+void startBurstMode( int DurationInMilliseconds );
+
+bool isBurstModeActive(void);
+
 #endif // SOURCE_PERIPHERAL_THREAD_H_
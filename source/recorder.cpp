@@ -0,0 +1,545 @@
+/// @file recorder.cpp
+///
+/// Continuous recording: a thread of its own reads the history with its own cursor and appends every frame to
+/// the recording file (see recording_format.h). The frames are packed into one of the preallocated chunk buffers,
+/// which is encoded into a buffer of the disk writer (see disk_writer.cpp) when it is full or when
+/// RECORDING_CHUNK_DURATION has passed; the writer thread appends the chunk and synchronises the file, so a crash
+/// (even a power failure) loses at most the last chunks. The frames of a queued chunk are kept until the writer
+/// reports its outcome: only then they are added to the summaries and to the bytes written, or counted as lost if
+/// the chunk has been dropped. The chunks are written COMPRESSED (see chunk_codec.cpp), unless the encoding happens
+/// not to be shorter than the RAW frames. Along with the chunks, the recorder maintains the time index (an entry per
+/// chunk, see recording_reader.cpp), the pyramid of summaries of the recording (see summary_pyramid.cpp) and the zero
+/// shifts of the cups (auto-zero), so the export converts the frames as they were displayed.
+/// Neither this thread nor the peripheral thread waits for the disk: when the writer lags behind (e.g. a slow disk),
+/// the full chunk waits for a free buffer (or for the reports of the chunks before) and the history absorbs up to
+/// its capacity (see HistoryBufferCapacity); only then the oldest frames are lost (and counted).
+/// A new file is started every RECORDING_FILE_DURATION or RECORDING_FILE_SIZE_MAX, so the old recordings can be
+/// reduced to their summaries piece by piece (see retention.cpp).
+
+#include <ctime>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <cstddef>
+#include <climits>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "recorder.h"
+#include "disk_writer.h"
+#include "recording_format.h"
+#include "chunk_codec.h"
+#include "summary_pyramid.h"
+#include "current_conversion.h"
+#include "history_buffer.h"
+#include "settings_file.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define RECORDER_THREAD_LOOP_DURATION	(4*PERIPHERAL_THREAD_LOOP_DURATION)	// milliseconds
+#define RECORDING_CHUNK_DURATION		5000	// milliseconds; the longest time a frame waits in the chunk buffer
+#define RECORDING_RETRY_PERIOD			60000	// milliseconds; after an error the file is opened again so late
+#define RECORDING_FILE_DURATION			3600000	// milliseconds; the file is closed after so long, the next chunk opens a new one
+#define RECORDING_FILE_SIZE_MAX			(256*1024*1024)	// bytes; as above
+#define RECORDER_CHUNKS_NUMBER			(DISK_WRITER_BUFFERS_NUMBER/2)	// the chunk being filled and the queued ones
+#define RECORDER_HEADER_TAG				RECORDER_CHUNKS_NUMBER	// the report tag of the file header; the chunks have their index
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+/// The chunk header is followed by the frames, so the chunk is written at once
+struct RawChunk {
+	RecordingChunkHeader Header;
+	RecordedFrame Frames[RECORDING_CHUNK_FRAMES_MAX];
+};
+static_assert( offsetof(RawChunk, Frames) == sizeof(RecordingChunkHeader) );
+
+static_assert( sizeof(RawChunk) <= DISK_WRITER_BUFFER_SIZE );
+static_assert( sizeof(RecordingChunkHeader) + CHUNK_ENCODED_SIZE_MAX <= DISK_WRITER_BUFFER_SIZE );
+
+/// A chunk queued for the disk writer, waiting for the report of its outcome
+struct PendingChunk {
+	int FramesNumber;
+	size_t Size;						// the header and the payload
+	bool IsCompressed;
+	uint32_t StreamSizes[CHUNK_STREAMS_NUMBER];
+};
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+static std::thread RecorderThread;
+
+static std::atomic<bool> CloseRecorderFlag;
+
+static std::atomic<uint64_t> RecordingBytesWritten;
+
+static std::atomic<uint64_t> RecordingLostFrames;
+
+static std::atomic<bool> IsRecordingFailed;
+
+/// The path of the file being written (empty if none), for the retention thread
+static std::mutex OpenFilePathMutex;
+static std::string OpenFilePath;
+
+/// The bytes taken by each field of the frames in the RAW form and in the chunks actually written
+static std::atomic<uint64_t> StreamRawBytes[CHUNK_STREAMS_NUMBER];
+static std::atomic<uint64_t> StreamWrittenBytes[CHUNK_STREAMS_NUMBER];
+
+/// These variables are used by the recorder thread only
+static RawChunk ChunkBuffers[RECORDER_CHUNKS_NUMBER];
+static PendingChunk PendingChunks[RECORDER_CHUNKS_NUMBER];
+static int FillingChunk;					// the index of the chunk being filled; the queued ones precede it (cyclically)
+static int PendingChunksNumber;
+static int ChunkFramesNumber;
+static std::chrono::high_resolution_clock::time_point ChunkStartTime;
+static AcquisitionFrame RecorderFrame;
+static int RecordingFile = -1;
+static std::string RecordingFilePath;
+static uint64_t RecordingFileSize;
+static std::chrono::high_resolution_clock::time_point RecordingFileTime;	// the moment the file was opened
+static int IndexFile = -1;
+static int ZeroShiftFile = -1;
+static std::string ZeroShiftFilePath;
+static int64_t RecordingTimeOffset;
+static std::chrono::high_resolution_clock::time_point FailureTime;
+static uint64_t DroppedFramesNumber;
+static uint64_t DiskErrorsNumber;			// the errors of the disk writer already handled
+static bool IsFileClosing;					// the file is closed when the last of its chunks is reported
+static SummaryPyramid RecorderPyramid;
+
+/// The zero shifts last seen by the recorder and the ones before them: the frames still waiting in the history
+/// and in the chunk buffer may have been taken before the last change
+static ZeroShiftEntry LatestZeroShift[CUPS_NUMBER];
+static ZeroShiftEntry PreviousZeroShift[CUPS_NUMBER];
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static void recorderThreadHandler(void);
+
+static bool writeChunk(void);
+
+static void takeChunkReports(void);
+
+static bool openRecordingFile( int64_t StartTime );
+
+static void closeRecordingFile(void);
+
+static void finishRecordingFile(void);
+
+static void failRecordingFile(void);
+
+static void updateZeroShifts(void);
+
+static void writeZeroShifts( const ZeroShiftEntry * EntriesPtr, int EntriesNumber );
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+/// The recording is started only if the directory is declared in the configuration file
+void recorderStart(void){
+	if (RecordingDirectory.empty()){
+		return;
+	}
+	atomic_store_explicit( &CloseRecorderFlag, false, std::memory_order_release );
+	RecorderThread = std::thread(recorderThreadHandler);
+}
+
+/// This function is called by FLTK onMainWindowCloseCallback event handler; the frames collected so far are written
+void recorderExit(void){
+	atomic_store_explicit( &CloseRecorderFlag, true, std::memory_order_release );
+	if (RecorderThread.joinable()){
+		RecorderThread.join();
+	}
+}
+
+/// @return false if the recording is not enabled
+bool getRecordingStatus( uint64_t * BytesWrittenPtr, uint64_t * LostFramesPtr, bool * IsFailedPtr ){
+	*BytesWrittenPtr = atomic_load_explicit( &RecordingBytesWritten, std::memory_order_acquire );
+	*LostFramesPtr = atomic_load_explicit( &RecordingLostFrames, std::memory_order_acquire );
+	*IsFailedPtr = atomic_load_explicit( &IsRecordingFailed, std::memory_order_acquire );
+	return !RecordingDirectory.empty();
+}
+
+/// This function is called by the retention thread, which must not touch the file being written
+/// @return an empty string if no file is open
+std::string getOpenRecordingFilePath(void){
+	std::lock_guard<std::mutex> Lock( OpenFilePathMutex );
+	return OpenFilePath;
+}
+
+/// This function is called by the GUI thread
+/// @return false if nothing has been recorded yet
+bool formatCompressionReport( char * ReportPtr, size_t ReportSize ){
+	uint64_t TotalRaw = 0;
+	uint64_t TotalWritten = 0;
+	for (int Stream=0; Stream < CHUNK_STREAMS_NUMBER; Stream++){
+		TotalRaw += atomic_load_explicit( &StreamRawBytes[Stream], std::memory_order_acquire );
+		TotalWritten += atomic_load_explicit( &StreamWrittenBytes[Stream], std::memory_order_acquire );
+	}
+	if (0 == TotalWritten){
+		snprintf( ReportPtr, ReportSize, "Brak zapisanych danych" );
+		return false;
+	}
+	size_t Length = (size_t)snprintf( ReportPtr, ReportSize, "Stopień kompresji zapisu (dane surowe / zapisane):\n"
+			"razem %.2f (%.1f MB / %.1f MB)\n", (double)TotalRaw/TotalWritten, TotalRaw/1.0e6, TotalWritten/1.0e6 );
+	for (int Stream=0; (Stream < CHUNK_STREAMS_NUMBER) && (Length < ReportSize); Stream++){
+		uint64_t Raw = atomic_load_explicit( &StreamRawBytes[Stream], std::memory_order_acquire );
+		uint64_t Written = atomic_load_explicit( &StreamWrittenBytes[Stream], std::memory_order_acquire );
+		char NameText[40];
+		formatChunkStreamName( NameText, sizeof(NameText), Stream );
+		Length += (size_t)snprintf( ReportPtr + Length, ReportSize - Length, "%s: %.2f\n", NameText,
+				(0 == Written)? 0.0 : (double)Raw/Written );
+	}
+	return true;
+}
+
+static void recorderThreadHandler(void){
+	HistoryCursor Cursor;
+	initializeHistoryCursor( &Cursor, false );
+	RecordingTimeOffset = getRecordingTimeOffset();
+	for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+		LatestZeroShift[Cup].Time = INT64_MIN;
+	}
+	updateZeroShifts();
+
+	while (!atomic_load_explicit( &CloseRecorderFlag, std::memory_order_acquire )){
+		updateZeroShifts();
+		uint64_t DroppedWritesNumber;
+		uint64_t ErrorsNumber;
+		getDiskWriterStatus( &DroppedWritesNumber, &ErrorsNumber );
+		if (ErrorsNumber != DiskErrorsNumber){
+			DiskErrorsNumber = ErrorsNumber;
+			if (RecordingFile >= 0){
+				failRecordingFile();
+			}
+		}
+		takeChunkReports();
+
+		// a full chunk waiting for a free buffer of the disk writer stops the reading of the history
+		while ((ChunkFramesNumber < RECORDING_CHUNK_FRAMES_MAX) && readFromHistory( &Cursor, &RecorderFrame )){
+			if (0 == ChunkFramesNumber){
+				ChunkStartTime = std::chrono::high_resolution_clock::now();
+			}
+			packRecordedFrame( &ChunkBuffers[FillingChunk].Frames[ChunkFramesNumber], &RecorderFrame, RecordingTimeOffset );
+			ChunkFramesNumber++;
+			if (RECORDING_CHUNK_FRAMES_MAX == ChunkFramesNumber){
+				writeChunk();
+			}
+		}
+		if ((ChunkFramesNumber > 0) && ((RECORDING_CHUNK_FRAMES_MAX == ChunkFramesNumber) ||
+				(std::chrono::duration_cast<std::chrono::milliseconds>(
+						std::chrono::high_resolution_clock::now() - ChunkStartTime).count() >= RECORDING_CHUNK_DURATION)))
+		{
+			writeChunk();
+		}
+		atomic_store_explicit( &RecordingLostFrames, Cursor.LostFrames + DroppedFramesNumber, std::memory_order_release );
+		std::this_thread::sleep_for( std::chrono::milliseconds( RECORDER_THREAD_LOOP_DURATION ));
+	}
+	while ((ChunkFramesNumber > 0) && !writeChunk()){
+		std::this_thread::sleep_for( std::chrono::milliseconds( PERIPHERAL_THREAD_LOOP_DURATION ));
+		takeChunkReports();
+	}
+	closeRecordingFile();
+	while (IsFileClosing){
+		std::this_thread::sleep_for( std::chrono::milliseconds( PERIPHERAL_THREAD_LOOP_DURATION ));
+		takeChunkReports();
+	}
+	atomic_store_explicit( &RecordingLostFrames, Cursor.LostFrames + DroppedFramesNumber, std::memory_order_release );
+}
+
+/// The chunk and its index entry are queued for the disk writer; the chunk is dropped (and its frames counted as lost)
+/// when the file cannot be written
+/// @return false if the disk writer has no free buffers or the chunks queued before have not been reported yet
+/// (the chunk is kept, to be written later)
+static bool writeChunk(void){
+	if (IsFileClosing || (PendingChunksNumber + 1 >= RECORDER_CHUNKS_NUMBER)){
+		return false;
+	}
+	int ChunkBufferIndex;
+	int IndexBufferIndex;
+	uint8_t * ChunkPtr = acquireDiskBuffer( &ChunkBufferIndex );
+	if (nullptr == ChunkPtr){
+		return false;
+	}
+	uint8_t * IndexPtr = acquireDiskBuffer( &IndexBufferIndex );
+	if (nullptr == IndexPtr){
+		releaseDiskBuffer( ChunkBufferIndex );
+		return false;
+	}
+	int FramesNumber = ChunkFramesNumber;
+	ChunkFramesNumber = 0;
+	RawChunk * ChunkBufferPtr = &ChunkBuffers[FillingChunk];
+	PendingChunk * PendingPtr = &PendingChunks[FillingChunk];
+
+	int64_t FirstTime = ChunkBufferPtr->Frames[0].RegistersTime;
+	size_t RawSize = FramesNumber * sizeof(RecordedFrame);
+	size_t EncodedSize = encodeChunk( ChunkBufferPtr->Frames, FramesNumber, FirstTime,
+			ChunkPtr + sizeof(RecordingChunkHeader), PendingPtr->StreamSizes );
+	bool IsCompressed = (EncodedSize < RawSize);
+	if (!IsCompressed){
+		memcpy( ChunkPtr + sizeof(RecordingChunkHeader), ChunkBufferPtr->Frames, RawSize );
+	}
+
+	RecordingChunkHeader * HeaderPtr = &ChunkBufferPtr->Header;
+	memset( HeaderPtr, 0, sizeof(RecordingChunkHeader) );
+	HeaderPtr->Magic = RECORDING_CHUNK_MAGIC;
+	HeaderPtr->Encoding = IsCompressed? ChunkEncodings::COMPRESSED : ChunkEncodings::RAW;
+	HeaderPtr->FramesNumber = (uint16_t)FramesNumber;
+	HeaderPtr->PayloadSize = (uint32_t)(IsCompressed? EncodedSize : RawSize);
+	HeaderPtr->PayloadChecksum = computeRecordingChecksum( ChunkPtr + sizeof(RecordingChunkHeader), HeaderPtr->PayloadSize );
+	HeaderPtr->FirstTime = FirstTime;
+	HeaderPtr->LastTime = ChunkBufferPtr->Frames[FramesNumber-1].RegistersTime;
+	HeaderPtr->FirstFrameNumber = ChunkBufferPtr->Frames[0].FrameNumber;
+	HeaderPtr->HeaderChecksum = computeRecordingChecksum( HeaderPtr, offsetof(RecordingChunkHeader, HeaderChecksum) );
+	memcpy( ChunkPtr, HeaderPtr, sizeof(RecordingChunkHeader) );
+
+	if (RecordingFile < 0){
+		if ((atomic_load_explicit( &IsRecordingFailed, std::memory_order_acquire ) &&
+				(std::chrono::duration_cast<std::chrono::milliseconds>(
+						std::chrono::high_resolution_clock::now() - FailureTime).count() < RECORDING_RETRY_PERIOD)) ||
+				!openRecordingFile( HeaderPtr->FirstTime ))
+		{
+			releaseDiskBuffer( ChunkBufferIndex );
+			releaseDiskBuffer( IndexBufferIndex );
+			DroppedFramesNumber += FramesNumber;
+			return true;
+		}
+	}
+
+	// the index entry is queued after the chunk, so it never points beyond the synchronised file; the index itself
+	// is not synchronised (the readers find the chunks missing in the index by themselves)
+	size_t Size = sizeof(RecordingChunkHeader) + HeaderPtr->PayloadSize;
+	if (!submitDiskWrite( RecordingFile, ChunkBufferIndex, Size, DISK_WRITE_SYNC, FillingChunk )){
+		releaseDiskBuffer( IndexBufferIndex );
+		DroppedFramesNumber += FramesNumber;
+		failRecordingFile();		// the file would have a gap
+		return true;
+	}
+	PendingPtr->FramesNumber = FramesNumber;
+	PendingPtr->Size = Size;
+	PendingPtr->IsCompressed = IsCompressed;
+	PendingChunksNumber++;
+	FillingChunk = (FillingChunk + 1) % RECORDER_CHUNKS_NUMBER;
+
+	ChunkIndexEntry Entry;
+	Entry.FirstTime = HeaderPtr->FirstTime;
+	Entry.LastTime = HeaderPtr->LastTime;
+	Entry.Offset = RecordingFileSize;
+	if (IndexFile >= 0){
+		memcpy( IndexPtr, &Entry, sizeof(Entry) );
+		if (!submitDiskWrite( IndexFile, IndexBufferIndex, sizeof(Entry), 0, DISK_WRITE_NOT_REPORTED )){
+			// the index would have a gap; the readers find the rest of the chunks by themselves
+			closeDiskFile( IndexFile );
+			IndexFile = -1;
+		}
+	}
+	else{
+		releaseDiskBuffer( IndexBufferIndex );
+	}
+	RecordingFileSize += Size;
+	if ((RecordingFileSize >= RECORDING_FILE_SIZE_MAX) || (std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::high_resolution_clock::now() - RecordingFileTime).count() >= RECORDING_FILE_DURATION))
+	{
+		closeRecordingFile();
+	}
+	return true;
+}
+
+/// The reports of the disk writer come in the order of the chunks: the frames of a chunk written are added to
+/// the summaries (so the summaries cover only the frames in the file), the frames of a chunk dropped after
+/// a failure of the file are counted as lost; the file being closed is closed after its last chunk
+static void takeChunkReports(void){
+	int ReportTag;
+	bool IsWritten;
+	bool IsAnyChunkWritten = false;
+	while (takeDiskWriteReport( &ReportTag, &IsWritten )){
+		if (RECORDER_HEADER_TAG == ReportTag){
+			if (IsWritten){
+				atomic_fetch_add_explicit( &RecordingBytesWritten, sizeof(RecordingFileHeader), std::memory_order_acq_rel );
+			}
+			continue;
+		}
+		const PendingChunk * PendingPtr = &PendingChunks[ReportTag];
+		PendingChunksNumber--;
+		if (!IsWritten){
+			DroppedFramesNumber += PendingPtr->FramesNumber;
+			continue;
+		}
+		IsAnyChunkWritten = true;
+		atomic_fetch_add_explicit( &RecordingBytesWritten, PendingPtr->Size, std::memory_order_acq_rel );
+		for (int J=0; J < PendingPtr->FramesNumber; J++){
+			addFrameToSummaryPyramid( &RecorderPyramid, &ChunkBuffers[ReportTag].Frames[J] );
+		}
+		for (int Stream=0; Stream < CHUNK_STREAMS_NUMBER; Stream++){
+			size_t StreamRawSize = PendingPtr->FramesNumber * getChunkStreamRawSize( Stream );
+			atomic_fetch_add_explicit( &StreamRawBytes[Stream], StreamRawSize, std::memory_order_acq_rel );
+			atomic_fetch_add_explicit( &StreamWrittenBytes[Stream], PendingPtr->IsCompressed? PendingPtr->StreamSizes[Stream] :
+					StreamRawSize, std::memory_order_acq_rel );
+		}
+	}
+	if (IsAnyChunkWritten){
+		flushSummaryPyramid( &RecorderPyramid, false );
+	}
+	if (IsFileClosing && (0 == PendingChunksNumber)){
+		finishRecordingFile();
+	}
+}
+
+/// A new file is created at each start of the application and then every RECORDING_FILE_DURATION:
+/// Zapis_YYYY-MM-DD_HH-MM-SS.rec, named after its first frame
+/// @param StartTime ns since 1970-01-01 UTC
+static bool openRecordingFile( int64_t StartTime ){
+	time_t Seconds = (time_t)(StartTime / 1000000000);
+	struct tm LocalTime;
+	localtime_r( &Seconds, &LocalTime );
+	char TimeText[40];
+	strftime( TimeText, sizeof(TimeText), "%Y-%m-%d_%H-%M-%S", &LocalTime );
+
+	mkdir( RecordingDirectory.c_str(), 0775 );	// the directory may exist already
+	RecordingFilePath = RecordingDirectory + "/" + RECORDING_FILE_PREFIX + TimeText + RECORDING_FILE_EXTENSION;
+	{
+		// published before the file exists, so the retention never sees it unprotected
+		std::lock_guard<std::mutex> Lock( OpenFilePathMutex );
+		OpenFilePath = RecordingFilePath;
+	}
+	RecordingFile = open( RecordingFilePath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644 );
+	if (RecordingFile < 0){
+		std::cout << "Nie można utworzyć pliku: " << RecordingFilePath << " (" << strerror( errno ) << ")" << std::endl;
+		{
+			std::lock_guard<std::mutex> Lock( OpenFilePathMutex );
+			OpenFilePath.clear();
+		}
+		FailureTime = std::chrono::high_resolution_clock::now();
+		atomic_store_explicit( &IsRecordingFailed, true, std::memory_order_release );
+		return false;
+	}
+
+	RecordingFileHeader Header;
+	initializeRecordingFileHeader( &Header, StartTime );
+	if (!copyToDisk( RecordingFile, &Header, sizeof(Header), 0, RECORDER_HEADER_TAG )){
+		std::cout << "Błąd zapisu pliku: " << RecordingFilePath << " (brak wolnych buforów zapisu)" << std::endl;
+		failRecordingFile();
+		unlink( RecordingFilePath.c_str() );		// a file without the header could not be read
+		return false;
+	}
+	RecordingFileSize = sizeof(Header);
+	RecordingFileTime = std::chrono::high_resolution_clock::now();
+
+	std::string IndexFilePath = getRecordingSidecarPath( RecordingFilePath, RECORDING_INDEX_EXTENSION );
+	IndexFile = open( IndexFilePath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644 );
+	if (IndexFile < 0){
+		std::cout << "Nie można utworzyć pliku: " << IndexFilePath << " (" << strerror( errno ) << ")" << std::endl;
+	}
+	ZeroShiftFilePath = getRecordingSidecarPath( RecordingFilePath, RECORDING_ZERO_SHIFT_EXTENSION );
+	ZeroShiftFile = open( ZeroShiftFilePath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644 );
+	if (ZeroShiftFile < 0){
+		std::cout << "Nie można utworzyć pliku: " << ZeroShiftFilePath << " (" << strerror( errno ) << ")" << std::endl;
+	}
+	else{
+		// the first frames may precede the last change of a shift
+		ZeroShiftEntry Entries[2*CUPS_NUMBER];
+		int EntriesNumber = 0;
+		for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+			if ((LatestZeroShift[Cup].Time > StartTime) && (INT64_MIN != PreviousZeroShift[Cup].Time)){
+				Entries[EntriesNumber++] = PreviousZeroShift[Cup];
+			}
+			Entries[EntriesNumber++] = LatestZeroShift[Cup];
+		}
+		writeZeroShifts( Entries, EntriesNumber );
+	}
+	atomic_store_explicit( &IsRecordingFailed, false, std::memory_order_release );
+	openSummaryPyramid( &RecorderPyramid, RecordingFilePath );
+	if (VerboseMode){
+		std::cout << "Zapis ciągły do pliku: " << RecordingFilePath << std::endl;
+	}
+	return true;
+}
+
+/// The file is closed once the disk writer has reported all its chunks (their frames still go to the summaries);
+/// until then the next chunk waits
+static void closeRecordingFile(void){
+	IsFileClosing = true;
+	if (0 == PendingChunksNumber){
+		finishRecordingFile();
+	}
+}
+
+/// The files are closed by the disk writer, after the data queued so far
+static void finishRecordingFile(void){
+	IsFileClosing = false;
+	if (RecordingFile >= 0){
+		flushSummaryPyramid( &RecorderPyramid, true );
+		closeDiskFile( RecordingFile );
+		RecordingFile = -1;
+	}
+	if (IndexFile >= 0){
+		closeDiskFile( IndexFile );
+		IndexFile = -1;
+	}
+	if (ZeroShiftFile >= 0){
+		closeDiskFile( ZeroShiftFile );
+		ZeroShiftFile = -1;
+	}
+	std::lock_guard<std::mutex> Lock( OpenFilePathMutex );
+	OpenFilePath.clear();
+}
+
+/// The recording file is abandoned after an error of the disk writer; the next chunk after RECORDING_RETRY_PERIOD
+/// starts a new file
+static void failRecordingFile(void){
+	closeRecordingFile();
+	FailureTime = std::chrono::high_resolution_clock::now();
+	atomic_store_explicit( &IsRecordingFailed, true, std::memory_order_release );
+}
+
+/// The changes of the zero shifts are appended to the sidecar of the open file; without a file they are only
+/// remembered for the next one
+static void updateZeroShifts(void){
+	double Shifts[CUPS_NUMBER];
+	int64_t Times[CUPS_NUMBER];
+	getActiveZeroShifts( Shifts, Times );
+	ZeroShiftEntry Entries[CUPS_NUMBER];
+	int EntriesNumber = 0;
+	for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+		int64_t Time = Times[Cup] + RecordingTimeOffset;
+		if (Time == LatestZeroShift[Cup].Time){
+			continue;
+		}
+		PreviousZeroShift[Cup] = LatestZeroShift[Cup];
+		memset( &LatestZeroShift[Cup], 0, sizeof(ZeroShiftEntry) );
+		LatestZeroShift[Cup].Time = Time;
+		LatestZeroShift[Cup].ZeroShift = Shifts[Cup];
+		LatestZeroShift[Cup].CupIndex = (uint32_t)Cup;
+		Entries[EntriesNumber++] = LatestZeroShift[Cup];
+	}
+	if ((EntriesNumber > 0) && (ZeroShiftFile >= 0)){
+		writeZeroShifts( Entries, EntriesNumber );
+	}
+}
+
+/// A sidecar with a missing entry would give wrong currents, so it is deleted instead (the export then uses
+/// the zero shifts of the configuration file)
+static void writeZeroShifts( const ZeroShiftEntry * EntriesPtr, int EntriesNumber ){
+	if (!copyToDisk( ZeroShiftFile, EntriesPtr, EntriesNumber * sizeof(ZeroShiftEntry), DISK_WRITE_SYNC,
+			DISK_WRITE_NOT_REPORTED ))
+	{
+		std::cout << "Błąd zapisu pliku: " << ZeroShiftFilePath << " (brak wolnych buforów zapisu)" << std::endl;
+		closeDiskFile( ZeroShiftFile );
+		ZeroShiftFile = -1;
+		unlink( ZeroShiftFilePath.c_str() );
+	}
+}
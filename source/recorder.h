@@ -0,0 +1,26 @@
+/// @file recorder.h
+
+#ifndef SOURCE_RECORDER_H_
+#define SOURCE_RECORDER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "config.h"
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+void recorderStart(void);
+
+void recorderExit(void);
+
+bool getRecordingStatus( uint64_t * BytesWrittenPtr, uint64_t * LostFramesPtr, bool * IsFailedPtr );
+
+bool formatCompressionReport( char * ReportPtr, size_t ReportSize );
+
+std::string getOpenRecordingFilePath(void);
+
+#endif // SOURCE_RECORDER_H_
@@ -0,0 +1,936 @@
+/// @file recording_export.cpp
+///
+/// Command line mode (--eksport): the frames of a time range of the recordings are written to a CSV file (the columns
+/// of the capture files, see triggered_capture.cpp, but with the time in s since 1970-01-01 UTC instead of the time
+/// since the trigger), to a NumPy .npy file (one structured array, a record per frame)
+/// or to a NumPy .npz file (an array per column, in an uncompressed ZIP archive). The currents are converted through
+/// the calibration of the configuration file with the zero shifts recorded along with the frames (so the changes made
+/// by the auto-zero apply from the frame they were made at; a recording without them gets the zero shifts of
+/// the configuration file), the diagnostic channels through their gain and offset. The recordings
+/// hold the raw frames only, so the transmissions of the pairs of cups declared in the configuration file are derived
+/// here, as by the peripheral thread (see calculateTransmissions()), but from the currents before the filters.
+///
+/// The frames are converted a block (a decoded chunk) at a time, column by column: the registers are transposed
+/// into contiguous columns and converted by branchless loops (table lookups, multiply-adds, selects), which
+/// the compiler vectorises. The numbers of the CSV are formatted by std::to_chars (the shortest text that reads back
+/// exactly), not by printf. The .npy/.npz headers hold the number of rows, so the range is counted first; the counting
+/// pass only decodes the chunks. The columns of the .npz file are written in one pass into their members, whose
+/// offsets are known from the count, and the headers with the checksums are completed at the end. An output file
+/// that could not be completed is deleted.
+///
+/// Command line mode (--podsumowanie): the summary tiles of a time range (see summary_pyramid.cpp), of the recordings
+/// still with their frames and of the ones reduced to their summaries alike, are written to a CSV file: the minimum,
+/// maximum and mean of each channel in each of at most the given number of tiles of equal width.
+
+#include <ctime>
+#include <cmath>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <charconv>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "recording_export.h"
+#include "recording_reader.h"
+#include "summary_pyramid.h"
+#include "current_conversion.h"
+#include "signal_processing.h"
+#include "settings_file.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define EXPORT_TIME_FORMAT				"%Y-%m-%d_%H:%M:%S"	// local time, as in the names of the recording files
+
+#define EXPORT_CHANNELS_NUMBER			(PHYSICALLY_INSTALLED_CUPS * VALUES_PER_DISC)
+#define EXPORT_COILS_NUMBER				(PHYSICALLY_INSTALLED_CUPS * MODBUS_COILS_PER_CUP)
+#define EXPORT_TRANSMISSIONS_MAX		(PHYSICALLY_INSTALLED_CUPS * (PHYSICALLY_INSTALLED_CUPS-1))
+#define EXPORT_COLUMNS_MAX				(3 + EXPORT_CHANNELS_NUMBER + EXPORT_COILS_NUMBER + EXPORT_TRANSMISSIONS_MAX)
+static_assert( MODBUS_INPUTS_PER_CUP == VALUES_PER_DISC );
+
+#define EXPORT_OUTPUT_BUFFER_SIZE		(1024*1024)	// bytes
+#define EXPORT_CSV_FIELD_MAX			32		// bytes; more than any number of the CSV needs
+#define EXPORT_CSV_ROW_MAX				(EXPORT_COLUMNS_MAX * EXPORT_CSV_FIELD_MAX)
+
+#define EXPORT_SUMMARY_TILES_MAX		10000	// about the width of a screen, with a margin
+#define EXPORT_SUMMARY_ROW_MAX			((3 + 3*EXPORT_CHANNELS_NUMBER) * EXPORT_CSV_FIELD_MAX)
+
+#define NPY_HEADER_ALIGNMENT			64		// the data starts at a multiple of it
+#define NPY_VERSION_1_HEADER_MAX		65535	// bytes; a longer header needs the version 2.0
+
+#define ZIP_LOCAL_HEADER_SIZE			30		// bytes, without the name
+#define ZIP_CENTRAL_HEADER_SIZE			46
+#define ZIP_END_RECORD_SIZE				22
+#define ZIP_SIZE_MAX					0xFFFFFFFFull	// bytes; the limit of a ZIP archive without the ZIP64 extension
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+enum class ExportFormats
+{
+	CSV,
+	NPY,
+	NPZ,
+};
+
+/// The frames of a block converted column by column; the channels and the coils of the installed cups only
+struct ExportBlock {
+	int RowsNumber;
+	double Times[RECORDING_CHUNK_FRAMES_MAX];					// s since 1970-01-01 UTC
+	uint64_t FrameNumbers[RECORDING_CHUNK_FRAMES_MAX];
+	uint8_t Qualities[RECORDING_CHUNK_FRAMES_MAX];
+	uint16_t Registers[EXPORT_CHANNELS_NUMBER][RECORDING_CHUNK_FRAMES_MAX];
+	float Values[EXPORT_CHANNELS_NUMBER][RECORDING_CHUNK_FRAMES_MAX];	// currents in uA, diagnostic channels scaled
+	uint8_t Coils[EXPORT_COILS_NUMBER][RECORDING_CHUNK_FRAMES_MAX];
+	float Transmissions[EXPORT_TRANSMISSIONS_MAX][RECORDING_CHUNK_FRAMES_MAX];	// the smoothed ratios; NaN if not valid
+};
+
+/// A column of the .npy/.npz file: a field of the record or an array of the archive
+struct ExportColumn {
+	std::string Name;
+	const char * TypePtr;					// the NumPy type: '<f8', '<u8', '|u1', '<f4'
+	size_t ItemSize;						// bytes
+	const uint8_t * DataPtr;				// the column in the block
+	uint64_t MemberOffset;					// .npz: the local header of the member
+	uint64_t DataOffset;					// .npz: the first value
+	uint32_t Checksum;						// .npz: CRC-32 of the member (the .npy header and the values)
+	std::string HeaderText;					// .npz: the .npy header of the member
+};
+
+struct ExportContext {
+	ExportFormats Format;
+	int RecordingIndex;						// of the recording being read
+	int File;
+	uint64_t RowsNumber;					// counted (.npy/.npz) or written so far
+	uint64_t RowsWritten;
+	bool IsFailed;							// errno is set
+};
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+static ExportBlock Block;
+
+/// Time, frame, quality, the channels and the coils of each cup, then the transmissions
+static ExportColumn Columns[EXPORT_COLUMNS_MAX];
+static int ColumnsNumber;
+
+/// The pairs of cups "upstream -> downstream" of IsTransmissionMeasured[][] and their smoothed transmissions
+static int TransmissionUpstream[EXPORT_TRANSMISSIONS_MAX];
+static int TransmissionDownstream[EXPORT_TRANSMISSIONS_MAX];
+static double SmoothedTransmission[EXPORT_TRANSMISSIONS_MAX];
+static int TransmissionsNumber;
+
+/// The zero shifts of each recording, per cup in the order of time (see ZeroShiftEntry); empty if not recorded
+static std::vector<std::vector<ZeroShiftEntry>> RecordingZeroShifts[PHYSICALLY_INSTALLED_CUPS];
+
+/// The conversion table of each cup for the zero shift it has been built for (NaN if none yet)
+static float ExportConversionTables[PHYSICALLY_INSTALLED_CUPS][CONVERSION_TABLE_SIZE];
+static double ExportTableShift[PHYSICALLY_INSTALLED_CUPS];
+
+static char OutputBuffer[EXPORT_OUTPUT_BUFFER_SIZE];
+static size_t OutputLength;
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static bool parseExportTime( const char * TextPtr, int64_t * TimePtr );
+
+static void writeSummaryHeader( ExportContext * ContextPtr, const char * StartTextPtr, const char * EndTextPtr,
+		int64_t TileWidth );
+
+static void writeSummaryRow( ExportContext * ContextPtr, const SummaryTile * TilePtr );
+
+static float convertSummaryValue( int Cup, int Channel, double RegisterValue );
+
+static void listRecordingFiles( std::vector<std::string> * FilePathsPtr );
+
+static void defineColumns(void);
+
+static bool loadZeroShifts( const std::string & RecordingFilePath, size_t RecordingIndex );
+
+static double findZeroShift( int Cup, int RecordingIndex, const RecordedFrame * FramesPtr, int FirstFrame, int FramesNumber,
+		int * EndFramePtr );
+
+static bool countFrames( const RecordedFrame * FramesPtr, int FramesNumber, void * ContextPtr );
+
+static bool exportFrames( const RecordedFrame * FramesPtr, int FramesNumber, void * ContextPtr );
+
+static void convertBlock( const RecordedFrame * FramesPtr, int FramesNumber, int RecordingIndex );
+
+static void calculateTransmissions(void);
+
+static void writeCsvHeader( ExportContext * ContextPtr, const char * StartTextPtr, const char * EndTextPtr );
+
+static void writeCsvRows( ExportContext * ContextPtr );
+
+static void writeNpyRows( ExportContext * ContextPtr );
+
+static void writeNpzColumns( ExportContext * ContextPtr );
+
+static std::string formatNpyHeader( const std::string & DescriptionText, uint64_t RowsNumber );
+
+static bool prepareNpzArchive( ExportContext * ContextPtr );
+
+static bool finishNpzArchive( ExportContext * ContextPtr );
+
+static void putLittleEndian( uint8_t * BytesPtr, uint64_t Value, int BytesNumber );
+
+static void writeOutput( ExportContext * ContextPtr, const void * DataPtr, size_t Size );
+
+static void flushOutput( ExportContext * ContextPtr );
+
+static bool writeAt( int File, const void * DataPtr, size_t Size, uint64_t Offset );
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+/// The format is chosen by the extension of the file: .npy, .npz, otherwise CSV
+/// @param StartTextPtr, EndTextPtr the range [start; end) as RRRR-MM-DD_GG:MM:SS, local time
+FailureCodes runRecordingExport( const char * StartTextPtr, const char * EndTextPtr, const char * FileNamePtr ){
+	int64_t StartTime;
+	int64_t EndTime;
+	if (!parseExportTime( StartTextPtr, &StartTime ) || !parseExportTime( EndTextPtr, &EndTime ) || (EndTime <= StartTime)){
+		std::cout << "Zakres eksportu: --eksport RRRR-MM-DD_GG:MM:SS RRRR-MM-DD_GG:MM:SS plik(.csv|.npy|.npz)" << std::endl;
+		return FailureCodes::ERROR_COMMAND_SYNTAX;
+	}
+	if (RecordingDirectory.empty()){
+		std::cout << "Zapis ciągły nie jest zadeklarowany w pliku konfiguracyjnym" << std::endl;
+		return FailureCodes::ERROR_EXPORT;
+	}
+	std::chrono::steady_clock::time_point BeginningTime = std::chrono::steady_clock::now();
+
+	ExportContext Context;
+	std::string FileName = FileNamePtr;
+	Context.Format = ExportFormats::CSV;
+	if ((FileName.size() > 4) && (0 == FileName.compare( FileName.size() - 4, 4, ".npy" ))){
+		Context.Format = ExportFormats::NPY;
+	}
+	else if ((FileName.size() > 4) && (0 == FileName.compare( FileName.size() - 4, 4, ".npz" ))){
+		Context.Format = ExportFormats::NPZ;
+	}
+	Context.RowsNumber = 0;
+	Context.RowsWritten = 0;
+	Context.IsFailed = false;
+	defineColumns();
+
+	// the recordings stay mapped between the passes, so a recording being written gives the same frames twice
+	std::vector<std::string> FilePaths;
+	listRecordingFiles( &FilePaths );
+	std::vector<RecordingReader> Readers( FilePaths.size() );
+	size_t ReadersNumber = 0;
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		RecordingZeroShifts[Cup].assign( FilePaths.size(), std::vector<ZeroShiftEntry>() );
+		ExportTableShift[Cup] = std::numeric_limits<double>::quiet_NaN();
+	}
+	for (const std::string & FilePath : FilePaths){
+		if (!openRecording( FilePath, &Readers[ReadersNumber] )){
+			std::cout << "Pominięto plik: " << FilePath << std::endl;
+			continue;
+		}
+		if (!loadZeroShifts( FilePath, ReadersNumber )){
+			std::cout << "Brak zapisu korekt zera, użyto korekt z pliku konfiguracyjnego: " << FilePath << std::endl;
+		}
+		ReadersNumber++;
+	}
+	if (ExportFormats::CSV != Context.Format){
+		for (size_t J=0; J < ReadersNumber; J++){
+			readRecordingRange( &Readers[J], StartTime, EndTime, countFrames, &Context );
+		}
+	}
+
+	Context.File = -1;
+	if ((ExportFormats::NPZ != Context.Format) || prepareNpzArchive( &Context )){
+		Context.File = open( FileNamePtr, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+		if (Context.File < 0){
+			std::cout << "Nie można utworzyć pliku: " << FileNamePtr << " (" << strerror( errno ) << ")" << std::endl;
+		}
+	}
+	if (Context.File < 0){
+		for (size_t J=0; J < ReadersNumber; J++){
+			closeRecording( &Readers[J] );
+		}
+		return FailureCodes::ERROR_EXPORT_FILE;
+	}
+	OutputLength = 0;
+	if (ExportFormats::CSV == Context.Format){
+		writeCsvHeader( &Context, StartTextPtr, EndTextPtr );
+	}
+	else if (ExportFormats::NPY == Context.Format){
+		std::string DescriptionText = "[";
+		for (int C=0; C < ColumnsNumber; C++){
+			const ExportColumn & Column = Columns[C];
+			DescriptionText += "('" + Column.Name + "', '" + Column.TypePtr + "'), ";
+		}
+		DescriptionText += "]";
+		std::string HeaderText = formatNpyHeader( DescriptionText, Context.RowsNumber );
+		writeOutput( &Context, HeaderText.data(), HeaderText.size() );
+	}
+
+	uint64_t DamagedChunksNumber = 0;
+	for (size_t J=0; J < ReadersNumber; J++){
+		if (!Context.IsFailed){
+			Context.RecordingIndex = (int)J;
+			readRecordingRange( &Readers[J], StartTime, EndTime, exportFrames, &Context );
+		}
+		DamagedChunksNumber += Readers[J].DamagedChunksNumber;
+		closeRecording( &Readers[J] );
+	}
+	flushOutput( &Context );
+	if ((ExportFormats::NPZ == Context.Format) && !Context.IsFailed && !finishNpzArchive( &Context )){
+		Context.IsFailed = true;
+	}
+	if ((0 != close( Context.File )) && !Context.IsFailed){
+		Context.IsFailed = true;
+	}
+	if (Context.IsFailed){
+		std::cout << "Błąd zapisu pliku: " << FileNamePtr << " (" << strerror( errno ) << ")" << std::endl;
+		unlink( FileNamePtr );
+		return FailureCodes::ERROR_EXPORT_FILE;
+	}
+
+	std::cout << "Wyeksportowano ramek: " << Context.RowsWritten << " do pliku: " << FileNamePtr << " w czasie " <<
+			std::chrono::duration<double>(std::chrono::steady_clock::now() - BeginningTime).count() << " s" << std::endl;
+	if (0 != DamagedChunksNumber){
+		std::cout << "Pominięto uszkodzone porcje zapisu: " << DamagedChunksNumber << std::endl;
+	}
+	if (0 == Context.RowsWritten){
+		std::cout << "Brak zapisanych ramek w podanym zakresie (starsze zapisy mogły zostać zredukowane do podsumowań, zob. --podsumowanie)" << std::endl;
+	}
+	return FailureCodes::NO_FAILURE;
+}
+
+/// The currents are converted with the zero shifts of the configuration file (the summaries do not keep the recorded ones)
+/// @param StartTextPtr, EndTextPtr the range [start; end) as RRRR-MM-DD_GG:MM:SS, local time
+/// @param TilesTextPtr the largest number of tiles; the tiles are the narrowest that cover the range in so many
+FailureCodes runSummaryExport( const char * StartTextPtr, const char * EndTextPtr, const char * TilesTextPtr,
+		const char * FileNamePtr )
+{
+	int64_t StartTime;
+	int64_t EndTime;
+	char * EndPtr;
+	long TilesNumberMax = strtol( TilesTextPtr, &EndPtr, 10 );
+	if (!parseExportTime( StartTextPtr, &StartTime ) || !parseExportTime( EndTextPtr, &EndTime ) || (EndTime <= StartTime) ||
+			(EndPtr == TilesTextPtr) || (0 != *EndPtr) || (TilesNumberMax < 1) || (TilesNumberMax > EXPORT_SUMMARY_TILES_MAX))
+	{
+		std::cout << "Zakres podsumowania: --podsumowanie RRRR-MM-DD_GG:MM:SS RRRR-MM-DD_GG:MM:SS kafle(1 ... " <<
+				EXPORT_SUMMARY_TILES_MAX << ") plik.csv" << std::endl;
+		return FailureCodes::ERROR_COMMAND_SYNTAX;
+	}
+	if (RecordingDirectory.empty()){
+		std::cout << "Zapis ciągły nie jest zadeklarowany w pliku konfiguracyjnym" << std::endl;
+		return FailureCodes::ERROR_EXPORT;
+	}
+	std::chrono::steady_clock::time_point BeginningTime = std::chrono::steady_clock::now();
+
+	std::vector<SummaryTile> Tiles( TilesNumberMax );
+	int64_t TileWidth;
+	int TilesNumber = readRecordingSummaries( RecordingDirectory, StartTime, EndTime, (int)TilesNumberMax, Tiles.data(),
+			&TileWidth );
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		buildConversionTable( Cup, ZeroShift[Cup], ExportConversionTables[Cup] );
+		ExportTableShift[Cup] = ZeroShift[Cup];
+	}
+
+	ExportContext Context;
+	Context.Format = ExportFormats::CSV;
+	Context.RowsWritten = 0;
+	Context.IsFailed = false;
+	Context.File = open( FileNamePtr, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+	if (Context.File < 0){
+		std::cout << "Nie można utworzyć pliku: " << FileNamePtr << " (" << strerror( errno ) << ")" << std::endl;
+		return FailureCodes::ERROR_EXPORT_FILE;
+	}
+	OutputLength = 0;
+	writeSummaryHeader( &Context, StartTextPtr, EndTextPtr, TileWidth );
+	for (int J=0; J < TilesNumber; J++){
+		if (0 != Tiles[J].ReadoutsNumber){
+			writeSummaryRow( &Context, &Tiles[J] );
+		}
+	}
+	flushOutput( &Context );
+	if ((0 != close( Context.File )) && !Context.IsFailed){
+		Context.IsFailed = true;
+	}
+	if (Context.IsFailed){
+		std::cout << "Błąd zapisu pliku: " << FileNamePtr << " (" << strerror( errno ) << ")" << std::endl;
+		unlink( FileNamePtr );
+		return FailureCodes::ERROR_EXPORT_FILE;
+	}
+
+	std::cout << "Wyeksportowano kafli podsumowania: " << Context.RowsWritten << " (po " << TileWidth / 1000000000 <<
+			" s) do pliku: " << FileNamePtr << " w czasie " <<
+			std::chrono::duration<double>(std::chrono::steady_clock::now() - BeginningTime).count() << " s" << std::endl;
+	if (0 == Context.RowsWritten){
+		std::cout << "Brak podsumowań zapisu w podanym zakresie" << std::endl;
+	}
+	return FailureCodes::NO_FAILURE;
+}
+
+/// @param TimePtr ns since 1970-01-01 UTC
+/// @return false if the text is not RRRR-MM-DD_GG:MM:SS
+static bool parseExportTime( const char * TextPtr, int64_t * TimePtr ){
+	struct tm LocalTime;
+	memset( &LocalTime, 0, sizeof(LocalTime) );
+	const char * EndPtr = strptime( TextPtr, EXPORT_TIME_FORMAT, &LocalTime );
+	if ((nullptr == EndPtr) || (0 != *EndPtr)){
+		return false;
+	}
+	LocalTime.tm_isdst = -1;
+	time_t Seconds = mktime( &LocalTime );
+	if ((time_t)-1 == Seconds){
+		return false;
+	}
+	*TimePtr = (int64_t)Seconds * 1000000000;
+	return true;
+}
+
+/// @param FilePathsPtr the recording files of the directory, in the order of time (of their names)
+static void listRecordingFiles( std::vector<std::string> * FilePathsPtr ){
+	DIR * DirectoryPtr = opendir( RecordingDirectory.c_str() );
+	if (nullptr == DirectoryPtr){
+		std::cout << "Nie można otworzyć katalogu: " << RecordingDirectory << std::endl;
+		return;
+	}
+	size_t PrefixLength = sizeof(RECORDING_FILE_PREFIX) - 1;
+	size_t ExtensionLength = sizeof(RECORDING_FILE_EXTENSION) - 1;
+	while (struct dirent * EntryPtr = readdir( DirectoryPtr )){
+		std::string Name = EntryPtr->d_name;
+		if ((Name.size() > PrefixLength + ExtensionLength) && (0 == Name.compare( 0, PrefixLength, RECORDING_FILE_PREFIX )) &&
+				(0 == Name.compare( Name.size() - ExtensionLength, ExtensionLength, RECORDING_FILE_EXTENSION )))
+		{
+			FilePathsPtr->push_back( RecordingDirectory + "/" + Name );
+		}
+	}
+	closedir( DirectoryPtr );
+	std::sort( FilePathsPtr->begin(), FilePathsPtr->end() );
+}
+
+/// Time (s since 1970-01-01 UTC), frame, quality, then for each cup its channels and its coils (the columns of
+/// the capture files), then the transmissions (T<upstream cup>_<downstream cup>)
+static void defineColumns(void){
+	Columns[0] = ExportColumn{ "t", "<f8", sizeof(double), reinterpret_cast<const uint8_t *>(Block.Times), 0, 0, 0, "" };
+	Columns[1] = ExportColumn{ "ramka", "<u8", sizeof(uint64_t), reinterpret_cast<const uint8_t *>(Block.FrameNumbers), 0, 0, 0, "" };
+	Columns[2] = ExportColumn{ "jakosc", "|u1", sizeof(uint8_t), Block.Qualities, 0, 0, 0, "" };
+	int Column = 3;
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		for (int Channel=0; Channel < VALUES_PER_DISC; Channel++){
+			Columns[Column++] = ExportColumn{ "K" + std::to_string( Cup+1 ) + "_ch" + std::to_string( Channel+1 ), "<f4",
+					sizeof(float), reinterpret_cast<const uint8_t *>(Block.Values[Cup*VALUES_PER_DISC + Channel]), 0, 0, 0, "" };
+		}
+		for (int Coil=0; Coil < MODBUS_COILS_PER_CUP; Coil++){
+			Columns[Column++] = ExportColumn{ "K" + std::to_string( Cup+1 ) + "_cewka" + std::to_string( Coil+1 ), "|u1",
+					sizeof(uint8_t), Block.Coils[Cup*MODBUS_COILS_PER_CUP + Coil], 0, 0, 0, "" };
+		}
+	}
+	TransmissionsNumber = 0;
+	for (int Upstream=0; Upstream < PHYSICALLY_INSTALLED_CUPS; Upstream++){
+		for (int Downstream=0; Downstream < PHYSICALLY_INSTALLED_CUPS; Downstream++){
+			if (!IsTransmissionMeasured[Upstream][Downstream]){
+				continue;
+			}
+			TransmissionUpstream[TransmissionsNumber] = Upstream;
+			TransmissionDownstream[TransmissionsNumber] = Downstream;
+			SmoothedTransmission[TransmissionsNumber] = std::numeric_limits<double>::quiet_NaN();
+			Columns[Column++] = ExportColumn{ "T" + std::to_string( Upstream+1 ) + "_" + std::to_string( Downstream+1 ), "<f4",
+					sizeof(float), reinterpret_cast<const uint8_t *>(Block.Transmissions[TransmissionsNumber]), 0, 0, 0, "" };
+			TransmissionsNumber++;
+		}
+	}
+	ColumnsNumber = Column;
+}
+
+/// The entries are checked and sorted by time for each cup; the ones of the cups not installed are ignored
+/// @return false if the recording has no (valid) sidecar of the zero shifts
+static bool loadZeroShifts( const std::string & RecordingFilePath, size_t RecordingIndex ){
+	int File = open( getRecordingSidecarPath( RecordingFilePath, RECORDING_ZERO_SHIFT_EXTENSION ).c_str(), O_RDONLY | O_CLOEXEC );
+	if (File < 0){
+		return false;
+	}
+	ZeroShiftEntry Entry;
+	bool IsValid = true;
+	ssize_t Size;
+	while (sizeof(Entry) == (Size = read( File, &Entry, sizeof(Entry) ))){
+		if ((Entry.CupIndex >= CUPS_NUMBER) || !std::isfinite( Entry.ZeroShift )){
+			IsValid = false;
+			break;
+		}
+		if (Entry.CupIndex < PHYSICALLY_INSTALLED_CUPS){
+			RecordingZeroShifts[Entry.CupIndex][RecordingIndex].push_back( Entry );
+		}
+	}
+	close( File );
+	// a partial entry at the end is left by a crash; the complete ones are valid
+	IsValid = IsValid && (Size >= 0);
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		IsValid = IsValid && !RecordingZeroShifts[Cup][RecordingIndex].empty();
+	}
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		std::vector<ZeroShiftEntry> & Entries = RecordingZeroShifts[Cup][RecordingIndex];
+		if (!IsValid){
+			Entries.clear();
+		}
+		std::stable_sort( Entries.begin(), Entries.end(),
+				[]( const ZeroShiftEntry & A, const ZeroShiftEntry & B ){ return A.Time < B.Time; } );
+	}
+	return IsValid;
+}
+
+/// The zero shift of a frame is the last one recorded at or before its time (the first one for earlier frames)
+/// @param EndFramePtr the frames from FirstFrame up to it (excluding) have the same zero shift
+static double findZeroShift( int Cup, int RecordingIndex, const RecordedFrame * FramesPtr, int FirstFrame, int FramesNumber,
+		int * EndFramePtr )
+{
+	const std::vector<ZeroShiftEntry> & Entries = RecordingZeroShifts[Cup][RecordingIndex];
+	*EndFramePtr = FramesNumber;
+	if (Entries.empty()){
+		return ZeroShift[Cup];
+	}
+	size_t Next = 0;
+	while ((Next < Entries.size()) && (Entries[Next].Time <= FramesPtr[FirstFrame].RegistersTime)){
+		Next++;
+	}
+	if (Next < Entries.size()){
+		int EndFrame = FirstFrame + 1;
+		while ((EndFrame < FramesNumber) && (FramesPtr[EndFrame].RegistersTime < Entries[Next].Time)){
+			EndFrame++;
+		}
+		*EndFramePtr = EndFrame;
+	}
+	return Entries[(Next > 0)? Next-1 : 0].ZeroShift;
+}
+
+static bool countFrames( const RecordedFrame * FramesPtr, int FramesNumber, void * ContextPtr ){
+	(void)FramesPtr; // intentionally unused
+	static_cast<ExportContext *>(ContextPtr)->RowsNumber += FramesNumber;
+	return true;
+}
+
+/// @return false to stop the reading (an error of the output file, or the rows counted for the headers exhausted)
+static bool exportFrames( const RecordedFrame * FramesPtr, int FramesNumber, void * ContextPtr ){
+	ExportContext * ExportPtr = static_cast<ExportContext *>(ContextPtr);
+	if (ExportFormats::CSV != ExportPtr->Format){
+		FramesNumber = (int)std::min<uint64_t>( FramesNumber, ExportPtr->RowsNumber - ExportPtr->RowsWritten );
+	}
+	if (FramesNumber <= 0){
+		return false;
+	}
+	convertBlock( FramesPtr, FramesNumber, ExportPtr->RecordingIndex );
+	switch (ExportPtr->Format){
+	case ExportFormats::CSV:
+		writeCsvRows( ExportPtr );
+		break;
+	case ExportFormats::NPY:
+		writeNpyRows( ExportPtr );
+		break;
+	case ExportFormats::NPZ:
+		writeNpzColumns( ExportPtr );
+		break;
+	}
+	ExportPtr->RowsWritten += FramesNumber;
+	return !ExportPtr->IsFailed;
+}
+
+/// The frames are transposed into the columns of the block and converted; the values of the frames without
+/// a valid readout of the registers are NaN; the currents are converted in runs of the frames of the same zero shift
+static void convertBlock( const RecordedFrame * FramesPtr, int FramesNumber, int RecordingIndex ){
+	Block.RowsNumber = FramesNumber;
+	for (int J=0; J < FramesNumber; J++){
+		int64_t Time = FramesPtr[J].RegistersTime;
+		Block.Times[J] = (double)(Time / 1000000000) + 1.0e-9 * (double)(Time % 1000000000);
+		Block.FrameNumbers[J] = FramesPtr[J].FrameNumber;
+		Block.Qualities[J] = FramesPtr[J].QualityFlags;
+	}
+	for (int J=0; J < FramesNumber; J++){
+		for (int Channel=0; Channel < EXPORT_CHANNELS_NUMBER; Channel++){
+			Block.Registers[Channel][J] = FramesPtr[J].InputRegisters[Channel];
+		}
+		for (int Coil=0; Coil < EXPORT_COILS_NUMBER; Coil++){
+			Block.Coils[Coil][J] = (uint8_t)((FramesPtr[J].Coils >> Coil) & 1);
+		}
+	}
+
+	const float NotANumber = std::numeric_limits<float>::quiet_NaN();
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		int EndFrame;
+		for (int FirstFrame=0; FirstFrame < FramesNumber; FirstFrame = EndFrame){
+			double Shift = findZeroShift( Cup, RecordingIndex, FramesPtr, FirstFrame, FramesNumber, &EndFrame );
+			if (Shift != ExportTableShift[Cup]){
+				buildConversionTable( Cup, Shift, ExportConversionTables[Cup] );
+				ExportTableShift[Cup] = Shift;
+			}
+			for (int Channel=0; Channel < VISIBLE_VALUES_PER_DISC; Channel++){
+				int Index = Cup*VALUES_PER_DISC + Channel;
+				convertRegistersThroughTable( ExportConversionTables[Cup], Block.Registers[Index] + FirstFrame,
+						Block.Values[Index] + FirstFrame, EndFrame - FirstFrame );
+			}
+		}
+		for (int Channel=0; Channel < VALUES_PER_DISC; Channel++){
+			int Index = Cup*VALUES_PER_DISC + Channel;
+			const uint16_t * __restrict RegistersPtr = Block.Registers[Index];
+			float * __restrict ValuesPtr = Block.Values[Index];
+			if (Channel >= VISIBLE_VALUES_PER_DISC){
+				float Gain = (float)DiagnosticGain[Cup][Channel - VISIBLE_VALUES_PER_DISC];
+				float Offset = (float)DiagnosticOffset[Cup][Channel - VISIBLE_VALUES_PER_DISC];
+				for (int J=0; J < FramesNumber; J++){
+					ValuesPtr[J] = (RegistersPtr[J] < CONVERSION_TABLE_SIZE)? Gain * (float)RegistersPtr[J] + Offset : NotANumber;
+				}
+			}
+			for (int J=0; J < FramesNumber; J++){
+				ValuesPtr[J] = (0 != (Block.Qualities[J] & FRAME_QUALITY_REGISTERS_VALID))? ValuesPtr[J] : NotANumber;
+			}
+		}
+	}
+	calculateTransmissions();
+}
+
+/// The ratios of the total currents are computed for the whole block first; the smoothing then runs through the rows
+/// in order and keeps its state between the blocks. The ratio is valid when both cups are inserted and the upstream
+/// current is not negligible; the frames without new registers repeat the previous result, as in the live display.
+static void calculateTransmissions(void){
+	const double SmoothingCoefficient = 1.0 / TransmissionSmoothing;
+	const float NotANumber = std::numeric_limits<float>::quiet_NaN();
+	for (int T=0; T < TransmissionsNumber; T++){
+		float (* UpstreamPtr)[RECORDING_CHUNK_FRAMES_MAX] = &Block.Values[TransmissionUpstream[T]*VALUES_PER_DISC];
+		float (* DownstreamPtr)[RECORDING_CHUNK_FRAMES_MAX] = &Block.Values[TransmissionDownstream[T]*VALUES_PER_DISC];
+		const uint8_t * UpstreamSwitchPtr =
+				Block.Coils[TransmissionUpstream[T]*MODBUS_COILS_PER_CUP + COIL_OFFSET_IS_SWITCH_PRESSED];
+		const uint8_t * DownstreamSwitchPtr =
+				Block.Coils[TransmissionDownstream[T]*MODBUS_COILS_PER_CUP + COIL_OFFSET_IS_SWITCH_PRESSED];
+		float * __restrict RatiosPtr = Block.Transmissions[T];
+		for (int J=0; J < Block.RowsNumber; J++){
+			float Upstream = UpstreamPtr[CURRENT_OF_OUTER_RING][J] + UpstreamPtr[CURRENT_OF_MIDDLE_RING][J] +
+					UpstreamPtr[CURRENT_OF_INNER_CIRCLE][J];	// NaN if any of them is NaN
+			float Downstream = DownstreamPtr[CURRENT_OF_OUTER_RING][J] + DownstreamPtr[CURRENT_OF_MIDDLE_RING][J] +
+					DownstreamPtr[CURRENT_OF_INNER_CIRCLE][J];
+			bool IsValid = (0 != (UpstreamSwitchPtr[J] & DownstreamSwitchPtr[J])) && (fabsf( Upstream ) >= FOCUS_MINIMUM_CURRENT);
+			RatiosPtr[J] = IsValid? Downstream / Upstream : NotANumber;
+		}
+		double Smoothed = SmoothedTransmission[T];
+		for (int J=0; J < Block.RowsNumber; J++){
+			if (0 != (Block.Qualities[J] & FRAME_QUALITY_REGISTERS_UPDATED)){
+				if (std::isnan( RatiosPtr[J] ) || std::isnan( Smoothed )){
+					Smoothed = RatiosPtr[J];
+				}
+				else{
+					Smoothed += SmoothingCoefficient * (RatiosPtr[J] - Smoothed);
+				}
+			}
+			RatiosPtr[J] = (float)Smoothed;
+		}
+		SmoothedTransmission[T] = Smoothed;
+	}
+}
+
+static void writeCsvHeader( ExportContext * ContextPtr, const char * StartTextPtr, const char * EndTextPtr ){
+	std::string HeaderText = std::string( "# Eksport zapisu od " ) + StartTextPtr + " do " + EndTextPtr + "\n"
+			"# t: sekundy od 1970-01-01 UTC; prądy według kalibracji z pliku konfiguracyjnego i korekt zera zapisanych z danymi\n"
+			"t [s];ramka;jakość";
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		for (int Channel=0; Channel < VALUES_PER_DISC; Channel++){
+			HeaderText += ";K" + std::to_string( Cup+1 ) + " " + ChannelName[Cup][Channel] + " [" + ChannelUnit[Cup][Channel] + "]";
+		}
+		for (int Coil=0; Coil < MODBUS_COILS_PER_CUP; Coil++){
+			HeaderText += ";K" + std::to_string( Cup+1 ) + " cewka " + std::to_string( Coil+1 );
+		}
+	}
+	for (int T=0; T < TransmissionsNumber; T++){
+		HeaderText += ";transmisja K" + std::to_string( TransmissionUpstream[T]+1 ) + " -> K" +
+				std::to_string( TransmissionDownstream[T]+1 );
+	}
+	HeaderText += "\n";
+	writeOutput( ContextPtr, HeaderText.data(), HeaderText.size() );
+}
+
+/// The absolute time with microseconds, the values in the shortest form that reads back as the same float
+static void writeCsvRows( ExportContext * ContextPtr ){
+	for (int Row=0; Row < Block.RowsNumber; Row++){
+		if (OutputLength + EXPORT_CSV_ROW_MAX > EXPORT_OUTPUT_BUFFER_SIZE){
+			flushOutput( ContextPtr );
+		}
+		char * TextPtr = OutputBuffer + OutputLength;
+		TextPtr = std::to_chars( TextPtr, TextPtr + EXPORT_CSV_FIELD_MAX, Block.Times[Row], std::chars_format::fixed, 6 ).ptr;
+		*TextPtr++ = ';';
+		TextPtr = std::to_chars( TextPtr, TextPtr + EXPORT_CSV_FIELD_MAX, Block.FrameNumbers[Row] ).ptr;
+		*TextPtr++ = ';';
+		TextPtr = std::to_chars( TextPtr, TextPtr + EXPORT_CSV_FIELD_MAX, (unsigned)Block.Qualities[Row] ).ptr;
+		for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+			for (int Channel=0; Channel < VALUES_PER_DISC; Channel++){
+				*TextPtr++ = ';';
+				TextPtr = std::to_chars( TextPtr, TextPtr + EXPORT_CSV_FIELD_MAX, Block.Values[Cup*VALUES_PER_DISC + Channel][Row] ).ptr;
+			}
+			for (int Coil=0; Coil < MODBUS_COILS_PER_CUP; Coil++){
+				*TextPtr++ = ';';
+				*TextPtr++ = (char)('0' + Block.Coils[Cup*MODBUS_COILS_PER_CUP + Coil][Row]);
+			}
+		}
+		for (int T=0; T < TransmissionsNumber; T++){
+			*TextPtr++ = ';';
+			TextPtr = std::to_chars( TextPtr, TextPtr + EXPORT_CSV_FIELD_MAX, Block.Transmissions[T][Row] ).ptr;
+		}
+		*TextPtr++ = '\n';
+		OutputLength = (size_t)(TextPtr - OutputBuffer);
+	}
+}
+
+/// The columns are interleaved into the packed records of the structured array
+static void writeNpyRows( ExportContext * ContextPtr ){
+	size_t RecordSize = 0;
+	for (int C=0; C < ColumnsNumber; C++){
+		const ExportColumn & Column = Columns[C];
+		RecordSize += Column.ItemSize;
+	}
+	for (int Row=0; Row < Block.RowsNumber; Row++){
+		if (OutputLength + RecordSize > EXPORT_OUTPUT_BUFFER_SIZE){
+			flushOutput( ContextPtr );
+		}
+		uint8_t * RecordPtr = reinterpret_cast<uint8_t *>(OutputBuffer + OutputLength);
+		for (int C=0; C < ColumnsNumber; C++){
+			const ExportColumn & Column = Columns[C];
+			memcpy( RecordPtr, Column.DataPtr + Row*Column.ItemSize, Column.ItemSize );
+			RecordPtr += Column.ItemSize;
+		}
+		OutputLength += RecordSize;
+	}
+}
+
+/// Each column of the block is appended to its member of the archive
+static void writeNpzColumns( ExportContext * ContextPtr ){
+	for (int C=0; C < ColumnsNumber; C++){
+		ExportColumn & Column = Columns[C];
+		size_t Size = Block.RowsNumber * Column.ItemSize;
+		if (!writeAt( ContextPtr->File, Column.DataPtr, Size, Column.DataOffset + ContextPtr->RowsWritten*Column.ItemSize )){
+			ContextPtr->IsFailed = true;
+			return;
+		}
+		Column.Checksum = (uint32_t)crc32( Column.Checksum, Column.DataPtr, (uInt)Size );
+	}
+}
+
+/// The header of the format version 1.0, padded so that the data is aligned
+static std::string formatNpyHeader( const std::string & DescriptionText, uint64_t RowsNumber ){
+	std::string DictionaryText = "{'descr': " + DescriptionText + ", 'fortran_order': False, 'shape': (" +
+			std::to_string( RowsNumber ) + ",), }";
+	size_t Length = 10 + DictionaryText.size() + 1;		// magic, version, length, dictionary, '\n'
+	DictionaryText.append( (NPY_HEADER_ALIGNMENT - Length % NPY_HEADER_ALIGNMENT) % NPY_HEADER_ALIGNMENT, ' ' );
+	DictionaryText += '\n';
+	std::string HeaderText( "\x93NUMPY\x01\x00", 8 );
+	HeaderText += (char)(DictionaryText.size() & 0xFF);
+	HeaderText += (char)(DictionaryText.size() >> 8);
+	return HeaderText + DictionaryText;
+}
+
+/// The members (ColumnName.npy) are laid out in the file from the number of rows, before the file is created;
+/// their headers are written at the end, with the checksums
+/// @return false if the archive would exceed the limit of the ZIP format without the ZIP64 extension
+static bool prepareNpzArchive( ExportContext * ContextPtr ){
+	uint64_t Offset = 0;
+	for (int C=0; C < ColumnsNumber; C++){
+		ExportColumn & Column = Columns[C];
+		Column.HeaderText = formatNpyHeader( std::string( "'" ) + Column.TypePtr + "'", ContextPtr->RowsNumber );
+		Column.MemberOffset = Offset;
+		Column.DataOffset = Offset + ZIP_LOCAL_HEADER_SIZE + Column.Name.size() + 4 + Column.HeaderText.size();
+		Column.Checksum = (uint32_t)crc32( 0, reinterpret_cast<const Bytef *>(Column.HeaderText.data()),
+				(uInt)Column.HeaderText.size() );
+		Offset = Column.DataOffset + ContextPtr->RowsNumber*Column.ItemSize;
+	}
+	if (Offset + ColumnsNumber*(ZIP_CENTRAL_HEADER_SIZE + 32) + ZIP_END_RECORD_SIZE > ZIP_SIZE_MAX){
+		std::cout << "Plik .npz przekroczyłby 4 GB; należy wybrać krótszy zakres albo format .npy/.csv" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// The local headers with the .npy headers, the central directory and the end record are written (stored members,
+/// no compression)
+static bool finishNpzArchive( ExportContext * ContextPtr ){
+	time_t Now = time( nullptr );
+	struct tm LocalTime;
+	localtime_r( &Now, &LocalTime );
+	uint16_t DosTime = (uint16_t)((LocalTime.tm_hour << 11) | (LocalTime.tm_min << 5) | (LocalTime.tm_sec / 2));
+	uint16_t DosDate = (uint16_t)(((LocalTime.tm_year - 80) << 9) | ((LocalTime.tm_mon + 1) << 5) | LocalTime.tm_mday);
+
+	std::vector<uint8_t> Directory;
+	uint64_t DirectoryOffset = 0;
+	for (int C=0; C < ColumnsNumber; C++){
+		const ExportColumn & Column = Columns[C];
+		std::string MemberName = Column.Name + ".npy";
+		uint64_t MemberSize = Column.HeaderText.size() + ContextPtr->RowsNumber*Column.ItemSize;
+		uint8_t Header[ZIP_CENTRAL_HEADER_SIZE];
+		memset( Header, 0, sizeof(Header) );
+		putLittleEndian( Header + 0, 0x04034B50, 4 );			// the local header
+		putLittleEndian( Header + 4, 20, 2 );					// version needed to extract: 2.0
+		putLittleEndian( Header + 10, DosTime, 2 );
+		putLittleEndian( Header + 12, DosDate, 2 );
+		putLittleEndian( Header + 14, Column.Checksum, 4 );
+		putLittleEndian( Header + 18, MemberSize, 4 );			// compressed
+		putLittleEndian( Header + 22, MemberSize, 4 );			// uncompressed
+		putLittleEndian( Header + 26, MemberName.size(), 2 );
+		if (!writeAt( ContextPtr->File, Header, ZIP_LOCAL_HEADER_SIZE, Column.MemberOffset ) ||
+				!writeAt( ContextPtr->File, MemberName.data(), MemberName.size(), Column.MemberOffset + ZIP_LOCAL_HEADER_SIZE ) ||
+				!writeAt( ContextPtr->File, Column.HeaderText.data(), Column.HeaderText.size(),
+						Column.DataOffset - Column.HeaderText.size() ))
+		{
+			return false;
+		}
+
+		memset( Header, 0, sizeof(Header) );
+		putLittleEndian( Header + 0, 0x02014B50, 4 );			// the central directory header
+		putLittleEndian( Header + 4, 20, 2 );					// version made by
+		putLittleEndian( Header + 6, 20, 2 );					// version needed to extract
+		putLittleEndian( Header + 12, DosTime, 2 );
+		putLittleEndian( Header + 14, DosDate, 2 );
+		putLittleEndian( Header + 16, Column.Checksum, 4 );
+		putLittleEndian( Header + 20, MemberSize, 4 );
+		putLittleEndian( Header + 24, MemberSize, 4 );
+		putLittleEndian( Header + 28, MemberName.size(), 2 );
+		putLittleEndian( Header + 42, Column.MemberOffset, 4 );
+		Directory.insert( Directory.end(), Header, Header + ZIP_CENTRAL_HEADER_SIZE );
+		Directory.insert( Directory.end(), MemberName.begin(), MemberName.end() );
+		DirectoryOffset = Column.DataOffset + ContextPtr->RowsNumber*Column.ItemSize;
+	}
+
+	uint8_t EndRecord[ZIP_END_RECORD_SIZE];
+	memset( EndRecord, 0, sizeof(EndRecord) );
+	putLittleEndian( EndRecord + 0, 0x06054B50, 4 );
+	putLittleEndian( EndRecord + 8, ColumnsNumber, 2 );		// the entries on this disk
+	putLittleEndian( EndRecord + 10, ColumnsNumber, 2 );	// the entries in total
+	putLittleEndian( EndRecord + 12, Directory.size(), 4 );
+	putLittleEndian( EndRecord + 16, DirectoryOffset, 4 );
+	Directory.insert( Directory.end(), EndRecord, EndRecord + ZIP_END_RECORD_SIZE );
+	return writeAt( ContextPtr->File, Directory.data(), Directory.size(), DirectoryOffset );
+}
+
+static void putLittleEndian( uint8_t * BytesPtr, uint64_t Value, int BytesNumber ){
+	for (int J=0; J < BytesNumber; J++){
+		BytesPtr[J] = (uint8_t)(Value >> (8*J));
+	}
+}
+
+static void writeSummaryHeader( ExportContext * ContextPtr, const char * StartTextPtr, const char * EndTextPtr,
+		int64_t TileWidth )
+{
+	std::string HeaderText = std::string( "# Podsumowanie zapisu od " ) + StartTextPtr + " do " + EndTextPtr + ", kafle po " +
+			std::to_string( TileWidth / 1000000000 ) + " s\n"
+			"# t: początek kafla, sekundy od 1970-01-01 UTC; prądy według kalibracji i korekt zera z pliku konfiguracyjnego\n"
+			"t [s];odczyty";
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		for (int Channel=0; Channel < VALUES_PER_DISC; Channel++){
+			std::string NameText = ";K" + std::to_string( Cup+1 ) + " " + ChannelName[Cup][Channel];
+			std::string UnitText = std::string( " [" ) + ChannelUnit[Cup][Channel] + "]";
+			HeaderText += NameText + " min." + UnitText + NameText + " maks." + UnitText + NameText + " średnia" + UnitText;
+		}
+	}
+	HeaderText += "\n";
+	writeOutput( ContextPtr, HeaderText.data(), HeaderText.size() );
+}
+
+/// The readouts "N/A" (0x8000 and above) are summarised as the other ones: the maximum and the mean of a tile
+/// with any of them are NaN
+static void writeSummaryRow( ExportContext * ContextPtr, const SummaryTile * TilePtr ){
+	if (OutputLength + EXPORT_SUMMARY_ROW_MAX > EXPORT_OUTPUT_BUFFER_SIZE){
+		flushOutput( ContextPtr );
+	}
+	char * TextPtr = OutputBuffer + OutputLength;
+	TextPtr = std::to_chars( TextPtr, TextPtr + EXPORT_CSV_FIELD_MAX, TilePtr->StartTime / 1000000000 ).ptr;
+	*TextPtr++ = ';';
+	TextPtr = std::to_chars( TextPtr, TextPtr + EXPORT_CSV_FIELD_MAX, TilePtr->ReadoutsNumber ).ptr;
+	const float NotANumber = std::numeric_limits<float>::quiet_NaN();
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		for (int Channel=0; Channel < VALUES_PER_DISC; Channel++){
+			int Index = Cup*VALUES_PER_DISC + Channel;
+			float Values[3];
+			Values[0] = convertSummaryValue( Cup, Channel, TilePtr->Minimum[Index] );
+			Values[1] = convertSummaryValue( Cup, Channel, TilePtr->Maximum[Index] );
+			Values[2] = (TilePtr->Maximum[Index] < CONVERSION_TABLE_SIZE)?
+					convertSummaryValue( Cup, Channel, TilePtr->Mean[Index] ) : NotANumber;
+			if (Values[0] > Values[1]){
+				std::swap( Values[0], Values[1] );	// a negative coefficient
+			}
+			for (float Value : Values){
+				*TextPtr++ = ';';
+				TextPtr = std::to_chars( TextPtr, TextPtr + EXPORT_CSV_FIELD_MAX, Value ).ptr;
+			}
+		}
+	}
+	*TextPtr++ = '\n';
+	OutputLength = (size_t)(TextPtr - OutputBuffer);
+	ContextPtr->RowsWritten++;
+}
+
+/// The mean of the registers is converted by the linear interpolation of the conversion table
+/// @return NaN for "N/A"
+static float convertSummaryValue( int Cup, int Channel, double RegisterValue ){
+	if (!(RegisterValue < CONVERSION_TABLE_SIZE)){
+		return std::numeric_limits<float>::quiet_NaN();
+	}
+	if (Channel >= VISIBLE_VALUES_PER_DISC){
+		return (float)(DiagnosticGain[Cup][Channel - VISIBLE_VALUES_PER_DISC] * RegisterValue +
+				DiagnosticOffset[Cup][Channel - VISIBLE_VALUES_PER_DISC]);
+	}
+	int Index = std::min( (int)RegisterValue, CONVERSION_TABLE_SIZE-2 );
+	double Fraction = RegisterValue - Index;
+	const float * TablePtr = ExportConversionTables[Cup];
+	return (float)(TablePtr[Index] + Fraction * (TablePtr[Index+1] - TablePtr[Index]));
+}
+
+/// The sequential output (.csv, .npy) goes through OutputBuffer
+static void writeOutput( ExportContext * ContextPtr, const void * DataPtr, size_t Size ){
+	if (OutputLength + Size > EXPORT_OUTPUT_BUFFER_SIZE){
+		flushOutput( ContextPtr );
+	}
+	if (Size > EXPORT_OUTPUT_BUFFER_SIZE){
+		ContextPtr->IsFailed = ContextPtr->IsFailed || (-1 == write( ContextPtr->File, DataPtr, Size ));
+		return;
+	}
+	memcpy( OutputBuffer + OutputLength, DataPtr, Size );
+	OutputLength += Size;
+}
+
+static void flushOutput( ExportContext * ContextPtr ){
+	const char * TextPtr = OutputBuffer;
+	while ((OutputLength > 0) && !ContextPtr->IsFailed){
+		ssize_t Written = write( ContextPtr->File, TextPtr, OutputLength );
+		if (Written < 0){
+			if (EINTR != errno){
+				ContextPtr->IsFailed = true;
+			}
+			continue;
+		}
+		TextPtr += Written;
+		OutputLength -= (size_t)Written;
+	}
+	OutputLength = 0;
+}
+
+/// @return false on error (errno is set)
+static bool writeAt( int File, const void * DataPtr, size_t Size, uint64_t Offset ){
+	const uint8_t * BytePtr = static_cast<const uint8_t *>(DataPtr);
+	while (Size > 0){
+		ssize_t Written = pwrite( File, BytePtr, Size, (off_t)Offset );
+		if (Written < 0){
+			if (EINTR == errno){
+				continue;
+			}
+			return false;
+		}
+		BytePtr += Written;
+		Size -= (size_t)Written;
+		Offset += (uint64_t)Written;
+	}
+	return true;
+}
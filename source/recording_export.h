@@ -0,0 +1,17 @@
+/// @file recording_export.h
+
+#ifndef SOURCE_RECORDING_EXPORT_H_
+#define SOURCE_RECORDING_EXPORT_H_
+
+#include "config.h"
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+FailureCodes runRecordingExport( const char * StartTextPtr, const char * EndTextPtr, const char * FileNamePtr );
+
+FailureCodes runSummaryExport( const char * StartTextPtr, const char * EndTextPtr, const char * TilesTextPtr,
+		const char * FileNamePtr );
+
+#endif // SOURCE_RECORDING_EXPORT_H_
@@ -0,0 +1,114 @@
+/// @file recording_format.cpp
+///
+/// The functions shared by the writer and the readers of the recording files (see recording_format.h)
+
+#include <array>
+#include <cstring>
+
+#include "recording_format.h"
+#include "settings_file.h"
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+/// The table of the CRC-32 (the polynomial 0xEDB88320, as in zlib), computed at compile time
+static constexpr std::array<uint32_t, 256> ChecksumTable = [](){
+	std::array<uint32_t, 256> Table{};
+	for (uint32_t J=0; J < 256; J++){
+		uint32_t Value = J;
+		for (int K=0; K < 8; K++){
+			Value = (Value & 1)? (0xEDB88320u ^ (Value >> 1)) : (Value >> 1);
+		}
+		Table[J] = Value;
+	}
+	return Table;
+}();
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+uint32_t computeRecordingChecksum( const void * DataPtr, size_t Size ){
+	const uint8_t * BytePtr = static_cast<const uint8_t *>(DataPtr);
+	uint32_t Checksum = 0xFFFFFFFFu;
+	for (size_t J=0; J < Size; J++){
+		Checksum = ChecksumTable[(Checksum ^ BytePtr[J]) & 0xFF] ^ (Checksum >> 8);
+	}
+	return Checksum ^ 0xFFFFFFFFu;
+}
+
+/// The time points of the frames are given by the high resolution clock; the files hold the calendar time
+/// @return the value to be added to the high resolution clock (in ns) to get the time since 1970-01-01 UTC
+int64_t getRecordingTimeOffset(void){
+	int64_t SystemTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+	int64_t ClockTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+	return SystemTime - ClockTime;
+}
+
+void packRecordedFrame( RecordedFrame * RecordPtr, const AcquisitionFrame * FramePtr, int64_t TimeOffset ){
+	memset( RecordPtr, 0, sizeof(RecordedFrame) );
+	RecordPtr->RegistersTime = TimeOffset + std::chrono::duration_cast<std::chrono::nanoseconds>(
+			FramePtr->RegistersTime.time_since_epoch()).count();
+	RecordPtr->CoilsTime = TimeOffset + std::chrono::duration_cast<std::chrono::nanoseconds>(
+			FramePtr->CoilsTime.time_since_epoch()).count();
+	RecordPtr->FrameNumber = FramePtr->FrameNumber;
+	memcpy( RecordPtr->InputRegisters, FramePtr->InputRegisters, sizeof(RecordPtr->InputRegisters) );
+	for (int J=0; J < MODBUS_COILS_NUMBER; J++){
+		if (FramePtr->Coils[J]){
+			RecordPtr->Coils |= (uint16_t)(1u << J);
+		}
+	}
+	RecordPtr->QualityFlags = FramePtr->QualityFlags;
+}
+
+void initializeRecordingFileHeader( RecordingFileHeader * HeaderPtr, int64_t StartTime ){
+	memset( HeaderPtr, 0, sizeof(RecordingFileHeader) );
+	memcpy( HeaderPtr->Magic, RECORDING_FILE_MAGIC, sizeof(HeaderPtr->Magic) );
+	HeaderPtr->StartTime = StartTime;
+	HeaderPtr->Version = RECORDING_FORMAT_VERSION;
+	HeaderPtr->HeaderSize = sizeof(RecordingFileHeader);
+	HeaderPtr->FrameSize = sizeof(RecordedFrame);
+	HeaderPtr->RegistersAddress = MODBUS_INPUTS_ADDRESS;
+	HeaderPtr->CoilsAddress = MODBUS_COILS_ADDRESS;
+	HeaderPtr->CupsNumber = CUPS_NUMBER;
+	HeaderPtr->InstalledCupsNumber = PHYSICALLY_INSTALLED_CUPS;
+	HeaderPtr->RegistersPerCup = MODBUS_INPUTS_PER_CUP;
+	HeaderPtr->CurrentsPerCup = VISIBLE_VALUES_PER_DISC;
+	HeaderPtr->CoilsPerCup = MODBUS_COILS_PER_CUP;
+	HeaderPtr->PollingPeriod = PERIPHERAL_THREAD_LOOP_DURATION;
+	for (int J=0; J < CUPS_NUMBER; J++){
+		strncpy( HeaderPtr->CupTitle[J], CupDescriptionPtr[J], RECORDING_CUP_TITLE_LENGTH-1 );
+	}
+	HeaderPtr->Checksum = computeRecordingChecksum( HeaderPtr, offsetof(RecordingFileHeader, Checksum) );
+}
+
+/// The readers accept only the files of the same layout of the cups and the registers as this build
+bool isRecordingFileHeaderValid( const RecordingFileHeader * HeaderPtr ){
+	return (0 == memcmp( HeaderPtr->Magic, RECORDING_FILE_MAGIC, sizeof(HeaderPtr->Magic) )) &&
+			(HeaderPtr->Checksum == computeRecordingChecksum( HeaderPtr, offsetof(RecordingFileHeader, Checksum) )) &&
+			(RECORDING_FORMAT_VERSION == HeaderPtr->Version) && (sizeof(RecordingFileHeader) == HeaderPtr->HeaderSize) &&
+			(sizeof(RecordedFrame) == HeaderPtr->FrameSize) && (CUPS_NUMBER == HeaderPtr->CupsNumber) &&
+			(MODBUS_INPUTS_PER_CUP == HeaderPtr->RegistersPerCup) && (MODBUS_COILS_PER_CUP == HeaderPtr->CoilsPerCup);
+}
+
+/// The payload is checked separately (it may not have been read yet)
+bool isChunkHeaderValid( const RecordingChunkHeader * HeaderPtr ){
+	return (RECORDING_CHUNK_MAGIC == HeaderPtr->Magic) &&
+			(HeaderPtr->HeaderChecksum == computeRecordingChecksum( HeaderPtr, offsetof(RecordingChunkHeader, HeaderChecksum) )) &&
+			(HeaderPtr->FramesNumber > 0) && (HeaderPtr->FramesNumber <= RECORDING_CHUNK_FRAMES_MAX);
+}
+
+/// Zapis_<date>_<time>.rec -> Zapis_<date>_<time><Extension>
+std::string getRecordingSidecarPath( const std::string & RecordingFilePath, const char * ExtensionPtr ){
+	std::string FilePath = RecordingFilePath;
+	size_t ExtensionLength = sizeof(RECORDING_FILE_EXTENSION) - 1;
+	if ((FilePath.size() > ExtensionLength) && (0 == FilePath.compare( FilePath.size() - ExtensionLength, ExtensionLength,
+			RECORDING_FILE_EXTENSION )))
+	{
+		FilePath.resize( FilePath.size() - ExtensionLength );
+	}
+	return FilePath + ExtensionPtr;
+}
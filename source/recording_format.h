@@ -0,0 +1,122 @@
+/// @file recording_format.h
+///
+/// The layout of the recording files (see recorder.cpp). A file consists of the file header followed by chunks;
+/// each chunk is a chunk header followed by the payload (the frames). The file is only ever appended to, and every
+/// chunk carries its own checksums, so after a crash the file is readable up to the last complete chunk.
+/// All the numbers are little-endian (as written by the PC).
+
+#ifndef SOURCE_RECORDING_FORMAT_H_
+#define SOURCE_RECORDING_FORMAT_H_
+
+#include <chrono>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#include "config.h"
+#include "shared_data.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define RECORDING_FILE_MAGIC				"FCUPREC"		// 7 characters and the terminating zero
+#define RECORDING_FORMAT_VERSION			1
+#define RECORDING_CHUNK_MAGIC				0x4B4E4843u		// "CHNK"
+#define RECORDING_CHUNK_FRAMES_MAX			1024
+#define RECORDING_CUP_TITLE_LENGTH			32
+#define RECORDING_FILE_PREFIX				"Zapis_"
+#define RECORDING_FILE_EXTENSION			".rec"
+#define RECORDING_INDEX_EXTENSION			".idx"
+#define RECORDING_ZERO_SHIFT_EXTENSION		".zero"
+
+static_assert( MODBUS_COILS_NUMBER <= 16 );
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+enum class ChunkEncodings : uint16_t
+{
+	RAW,				// an array of RecordedFrame
+	COMPRESSED,			// separate streams of the fields (see chunk_codec.cpp)
+};
+
+/// The beginning of each recording file; describes the layout of the cups and the registers
+struct RecordingFileHeader {
+	char Magic[8];						// RECORDING_FILE_MAGIC
+	int64_t StartTime;					// ns since 1970-01-01 UTC
+	uint16_t Version;					// RECORDING_FORMAT_VERSION
+	uint16_t HeaderSize;				// sizeof(RecordingFileHeader); the first chunk starts here
+	uint16_t FrameSize;					// sizeof(RecordedFrame)
+	uint16_t RegistersAddress;			// MODBUS_INPUTS_ADDRESS
+	uint16_t CoilsAddress;				// MODBUS_COILS_ADDRESS
+	uint8_t CupsNumber;
+	uint8_t InstalledCupsNumber;
+	uint8_t RegistersPerCup;			// the registers of a cup: the currents first, then the diagnostic channels
+	uint8_t CurrentsPerCup;
+	uint8_t CoilsPerCup;
+	uint8_t Reserved;
+	uint32_t PollingPeriod;				// ms
+	char CupTitle[CUPS_NUMBER][RECORDING_CUP_TITLE_LENGTH];
+	uint32_t Checksum;					// CRC-32 of the preceding bytes of the header
+};
+
+struct RecordingChunkHeader {
+	uint32_t Magic;						// RECORDING_CHUNK_MAGIC
+	ChunkEncodings Encoding;
+	uint16_t FramesNumber;
+	uint32_t PayloadSize;				// bytes following the header
+	uint32_t PayloadChecksum;			// CRC-32 of the payload
+	int64_t FirstTime;					// RegistersTime of the first frame; ns since 1970-01-01 UTC
+	int64_t LastTime;					// RegistersTime of the last frame
+	uint64_t FirstFrameNumber;
+	uint32_t HeaderChecksum;			// CRC-32 of the preceding bytes of the header
+	uint32_t Reserved;
+};
+
+/// One acquired frame as written in a RAW chunk; the padding is zeroed
+struct RecordedFrame {
+	int64_t RegistersTime;				// ns since 1970-01-01 UTC
+	int64_t CoilsTime;
+	uint64_t FrameNumber;
+	uint16_t InputRegisters[MODBUS_INPUTS_NUMBER];
+	uint16_t Coils;						// bit J is Coils[J] of AcquisitionFrame
+	uint8_t QualityFlags;
+};
+
+/// The time index of a recording (a sidecar file): one entry per chunk, in the order of the chunks
+struct ChunkIndexEntry {
+	int64_t FirstTime;					// as in the chunk header
+	int64_t LastTime;
+	uint64_t Offset;					// of the chunk header in the recording file
+};
+
+/// The zero shifts of a recording (a sidecar file): the shifts in effect when the file was opened, then an entry
+/// per change (auto-zero); a shift applies to the frames from its time on, up to the next entry of the cup
+struct ZeroShiftEntry {
+	int64_t Time;						// ns since 1970-01-01 UTC, as RegistersTime
+	double ZeroShift;					// register units, as in the configuration file
+	uint32_t CupIndex;
+	uint32_t Reserved;
+};
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+uint32_t computeRecordingChecksum( const void * DataPtr, size_t Size );
+
+int64_t getRecordingTimeOffset(void);
+
+void packRecordedFrame( RecordedFrame * RecordPtr, const AcquisitionFrame * FramePtr, int64_t TimeOffset );
+
+void initializeRecordingFileHeader( RecordingFileHeader * HeaderPtr, int64_t StartTime );
+
+bool isRecordingFileHeaderValid( const RecordingFileHeader * HeaderPtr );
+
+bool isChunkHeaderValid( const RecordingChunkHeader * HeaderPtr );
+
+std::string getRecordingSidecarPath( const std::string & RecordingFilePath, const char * ExtensionPtr );
+
+#endif // SOURCE_RECORDING_FORMAT_H_
@@ -0,0 +1,237 @@
+/// @file recording_reader.cpp
+///
+/// Random access to the recording files. The recording and its time index (the sidecar .idx file, one entry per chunk,
+/// appended by the recorder after each chunk) are mapped into memory; a time range is found by a binary search
+/// of the index, and only the chunks overlapping the range are touched (and decoded). The chunks written after the last
+/// index entry (the index is not synchronised, so it may lag behind after a crash) are found by following the chunk
+/// headers from the last indexed chunk; a recording without the index is thus read as well, only opened slower.
+/// The binary search needs the times of the chunks to grow; if the clock was set back during the recording, they do not,
+/// and the chunks are scanned one by one instead (the frames of a chunk are then checked one by one as well).
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "recording_reader.h"
+#include "chunk_codec.h"
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static const void * mapFile( const std::string & FilePath, size_t * SizePtr );
+
+static bool readChunkHeader( const RecordingReader * ReaderPtr, uint64_t Offset, RecordingChunkHeader * HeaderPtr );
+
+static bool isRecordingTimeOrdered( const RecordingReader * ReaderPtr );
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+/// @return false if the file cannot be read or is not a recording of the layout of this application
+bool openRecording( const std::string & RecordingFilePath, RecordingReader * ReaderPtr ){
+	ReaderPtr->DataPtr = static_cast<const uint8_t *>(mapFile( RecordingFilePath, &ReaderPtr->DataSize ));
+	if (nullptr == ReaderPtr->DataPtr){
+		return false;
+	}
+	if ((ReaderPtr->DataSize < sizeof(RecordingFileHeader)) ||
+			!isRecordingFileHeaderValid( reinterpret_cast<const RecordingFileHeader *>(ReaderPtr->DataPtr) ))
+	{
+		munmap( const_cast<uint8_t *>(ReaderPtr->DataPtr), ReaderPtr->DataSize );
+		ReaderPtr->DataPtr = nullptr;
+		return false;
+	}
+	madvise( const_cast<uint8_t *>(ReaderPtr->DataPtr), ReaderPtr->DataSize, MADV_RANDOM );
+	ReaderPtr->TailEntries.clear();
+	ReaderPtr->Frames.resize( RECORDING_CHUNK_FRAMES_MAX );
+	ReaderPtr->DamagedChunksNumber = 0;
+
+	// the index is trusted as far as the offsets of its entries grow and its last entry points to a valid chunk header
+	ReaderPtr->IndexPtr = static_cast<const ChunkIndexEntry *>(mapFile(
+			getRecordingSidecarPath( RecordingFilePath, RECORDING_INDEX_EXTENSION ), &ReaderPtr->IndexSize ));
+	ReaderPtr->IndexEntriesNumber = 0;
+	if (nullptr != ReaderPtr->IndexPtr){
+		size_t EntriesNumber = ReaderPtr->IndexSize / sizeof(ChunkIndexEntry);
+		for (size_t J=1; J < EntriesNumber; J++){
+			if (ReaderPtr->IndexPtr[J].Offset <= ReaderPtr->IndexPtr[J-1].Offset){
+				EntriesNumber = J;
+				break;
+			}
+		}
+		RecordingChunkHeader Header;
+		while ((EntriesNumber > 0) && !readChunkHeader( ReaderPtr, ReaderPtr->IndexPtr[EntriesNumber-1].Offset, &Header )){
+			EntriesNumber--;
+		}
+		ReaderPtr->IndexEntriesNumber = EntriesNumber;
+	}
+
+	uint64_t Offset = sizeof(RecordingFileHeader);
+	RecordingChunkHeader Header;
+	if (ReaderPtr->IndexEntriesNumber > 0){
+		Offset = ReaderPtr->IndexPtr[ReaderPtr->IndexEntriesNumber-1].Offset;
+		readChunkHeader( ReaderPtr, Offset, &Header );
+		Offset += sizeof(RecordingChunkHeader) + Header.PayloadSize;
+	}
+	while (readChunkHeader( ReaderPtr, Offset, &Header )){
+		ChunkIndexEntry Entry;
+		Entry.FirstTime = Header.FirstTime;
+		Entry.LastTime = Header.LastTime;
+		Entry.Offset = Offset;
+		ReaderPtr->TailEntries.push_back( Entry );
+		Offset += sizeof(RecordingChunkHeader) + Header.PayloadSize;
+	}
+	ReaderPtr->IsTimeOrdered = isRecordingTimeOrdered( ReaderPtr );
+	return true;
+}
+
+void closeRecording( RecordingReader * ReaderPtr ){
+	if (nullptr != ReaderPtr->DataPtr){
+		munmap( const_cast<uint8_t *>(ReaderPtr->DataPtr), ReaderPtr->DataSize );
+		ReaderPtr->DataPtr = nullptr;
+	}
+	if (nullptr != ReaderPtr->IndexPtr){
+		munmap( const_cast<ChunkIndexEntry *>(ReaderPtr->IndexPtr), ReaderPtr->IndexSize );
+		ReaderPtr->IndexPtr = nullptr;
+	}
+	ReaderPtr->TailEntries.clear();
+}
+
+size_t getRecordingChunksNumber( const RecordingReader * ReaderPtr ){
+	return ReaderPtr->IndexEntriesNumber + ReaderPtr->TailEntries.size();
+}
+
+const ChunkIndexEntry * getRecordingChunkEntry( const RecordingReader * ReaderPtr, size_t ChunkIndex ){
+	if (ChunkIndex < ReaderPtr->IndexEntriesNumber){
+		return &ReaderPtr->IndexPtr[ChunkIndex];
+	}
+	return &ReaderPtr->TailEntries[ChunkIndex - ReaderPtr->IndexEntriesNumber];
+}
+
+/// @return the index of the first chunk ending at or after Time (binary search, or a linear scan if the times of
+/// the chunks do not grow); getRecordingChunksNumber() if none
+size_t findRecordingChunk( const RecordingReader * ReaderPtr, int64_t Time ){
+	size_t Low = 0;
+	size_t High = getRecordingChunksNumber( ReaderPtr );
+	if (!ReaderPtr->IsTimeOrdered){
+		while ((Low < High) && (getRecordingChunkEntry( ReaderPtr, Low )->LastTime < Time)){
+			Low++;
+		}
+		return Low;
+	}
+	while (Low < High){
+		size_t Middle = Low + (High - Low)/2;
+		if (getRecordingChunkEntry( ReaderPtr, Middle )->LastTime < Time){
+			Low = Middle + 1;
+		}
+		else{
+			High = Middle;
+		}
+	}
+	return Low;
+}
+
+/// The chunk is checked and decoded into ReaderPtr->Frames
+/// @return the number of frames or -1 if the chunk is damaged
+int readRecordingChunk( RecordingReader * ReaderPtr, size_t ChunkIndex ){
+	uint64_t Offset = getRecordingChunkEntry( ReaderPtr, ChunkIndex )->Offset;
+	RecordingChunkHeader Header;
+	if (!readChunkHeader( ReaderPtr, Offset, &Header )){
+		ReaderPtr->DamagedChunksNumber++;
+		return -1;
+	}
+	const uint8_t * PayloadPtr = ReaderPtr->DataPtr + Offset + sizeof(RecordingChunkHeader);
+	if ((Header.PayloadChecksum != computeRecordingChecksum( PayloadPtr, Header.PayloadSize )) ||
+			!decodeChunk( &Header, PayloadPtr, ReaderPtr->Frames.data() ))
+	{
+		ReaderPtr->DamagedChunksNumber++;
+		return -1;
+	}
+	return Header.FramesNumber;
+}
+
+/// The frames with RegistersTime in [StartTime; EndTime) are passed to the handler in the order of the file, a run
+/// of consecutive frames at a time; after the clock was set back, every chunk of the file is decoded
+/// @return the number of frames passed
+uint64_t readRecordingRange( RecordingReader * ReaderPtr, int64_t StartTime, int64_t EndTime,
+		RecordedFramesHandler Handler, void * ContextPtr )
+{
+	uint64_t FramesNumber = 0;
+	size_t ChunksNumber = getRecordingChunksNumber( ReaderPtr );
+	size_t ChunkIndex = ReaderPtr->IsTimeOrdered? findRecordingChunk( ReaderPtr, StartTime ) : 0;
+	for (; ChunkIndex < ChunksNumber; ChunkIndex++){
+		if (ReaderPtr->IsTimeOrdered && (getRecordingChunkEntry( ReaderPtr, ChunkIndex )->FirstTime >= EndTime)){
+			break;
+		}
+		int ChunkFramesNumber = readRecordingChunk( ReaderPtr, ChunkIndex );
+		const RecordedFrame * FramesPtr = ReaderPtr->Frames.data();
+		int First = 0;
+		while (First < ChunkFramesNumber){
+			while ((First < ChunkFramesNumber) &&
+					((FramesPtr[First].RegistersTime < StartTime) || (FramesPtr[First].RegistersTime >= EndTime)))
+			{
+				First++;
+			}
+			int Last = First;
+			while ((Last < ChunkFramesNumber) &&
+					(FramesPtr[Last].RegistersTime >= StartTime) && (FramesPtr[Last].RegistersTime < EndTime))
+			{
+				Last++;
+			}
+			if (Last > First){
+				FramesNumber += Last - First;
+				if (!Handler( FramesPtr + First, Last - First, ContextPtr )){
+					return FramesNumber;
+				}
+			}
+			First = Last;
+		}
+	}
+	return FramesNumber;
+}
+
+/// @return nullptr if the file cannot be mapped (or is empty)
+static const void * mapFile( const std::string & FilePath, size_t * SizePtr ){
+	int File = open( FilePath.c_str(), O_RDONLY | O_CLOEXEC );
+	if (File < 0){
+		return nullptr;
+	}
+	struct stat Status;
+	if ((0 != fstat( File, &Status )) || (0 == Status.st_size)){
+		close( File );
+		return nullptr;
+	}
+	*SizePtr = (size_t)Status.st_size;
+	void * AddressPtr = mmap( nullptr, *SizePtr, PROT_READ, MAP_SHARED, File, 0 );
+	close( File );
+	return (MAP_FAILED == AddressPtr)? nullptr : AddressPtr;
+}
+
+/// The header is copied, as the chunks of the COMPRESSED encoding are not aligned in the file
+/// @return false if there is no complete and valid chunk header at the offset (the payload is not checked)
+static bool readChunkHeader( const RecordingReader * ReaderPtr, uint64_t Offset, RecordingChunkHeader * HeaderPtr ){
+	if ((Offset < sizeof(RecordingFileHeader)) || (Offset + sizeof(RecordingChunkHeader) > ReaderPtr->DataSize)){
+		return false;
+	}
+	memcpy( HeaderPtr, ReaderPtr->DataPtr + Offset, sizeof(RecordingChunkHeader) );
+	return isChunkHeaderValid( HeaderPtr ) &&
+			(HeaderPtr->PayloadSize <= ReaderPtr->DataSize - Offset - sizeof(RecordingChunkHeader));
+}
+
+/// The chunks must not overlap in time: each starts at or after the end of the previous one
+static bool isRecordingTimeOrdered( const RecordingReader * ReaderPtr ){
+	size_t ChunksNumber = getRecordingChunksNumber( ReaderPtr );
+	for (size_t J=0; J < ChunksNumber; J++){
+		const ChunkIndexEntry * EntryPtr = getRecordingChunkEntry( ReaderPtr, J );
+		if (EntryPtr->FirstTime > EntryPtr->LastTime){
+			return false;
+		}
+		if ((J > 0) && (EntryPtr->FirstTime < getRecordingChunkEntry( ReaderPtr, J-1 )->LastTime)){
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,53 @@
+/// @file recording_reader.h
+
+#ifndef SOURCE_RECORDING_READER_H_
+#define SOURCE_RECORDING_READER_H_
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "config.h"
+#include "recording_format.h"
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+/// A recording file mapped into memory, with its time index
+struct RecordingReader {
+	const uint8_t * DataPtr;			// the whole recording file
+	size_t DataSize;
+	const ChunkIndexEntry * IndexPtr;	// the sidecar index file; nullptr if missing
+	size_t IndexSize;					// bytes mapped
+	size_t IndexEntriesNumber;			// the valid entries of the sidecar
+	std::vector<ChunkIndexEntry> TailEntries;	// the chunks after the last indexed one (e.g. after a crash)
+	bool IsTimeOrdered;					// false if the clock was set back during the recording (no binary search)
+	std::vector<RecordedFrame> Frames;	// the decoded chunk
+	uint64_t DamagedChunksNumber;		// the chunks skipped because of the checksum or the encoding
+};
+
+/// The function called for consecutive parts of a time range; returns false to stop the reading
+typedef bool (*RecordedFramesHandler)( const RecordedFrame * FramesPtr, int FramesNumber, void * ContextPtr );
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+bool openRecording( const std::string & RecordingFilePath, RecordingReader * ReaderPtr );
+
+void closeRecording( RecordingReader * ReaderPtr );
+
+size_t getRecordingChunksNumber( const RecordingReader * ReaderPtr );
+
+const ChunkIndexEntry * getRecordingChunkEntry( const RecordingReader * ReaderPtr, size_t ChunkIndex );
+
+size_t findRecordingChunk( const RecordingReader * ReaderPtr, int64_t Time );
+
+int readRecordingChunk( RecordingReader * ReaderPtr, size_t ChunkIndex );
+
+uint64_t readRecordingRange( RecordingReader * ReaderPtr, int64_t StartTime, int64_t EndTime,
+		RecordedFramesHandler Handler, void * ContextPtr );
+
+#endif // SOURCE_RECORDING_READER_H_
@@ -0,0 +1,318 @@
+/// @file retention.cpp
+///
+/// The retention of the recordings: a background thread of the lowest CPU and I/O priority keeps the recording
+/// directory within RecordingFullDataDays and RecordingSizeLimit. An old recording is not deleted but compacted:
+/// its pyramid of summaries (1 s minimum/maximum/mean tiles and the coarser levels, see summary_pyramid.cpp) is rebuilt
+/// from all its frames into temporary files, which replace the old summaries only when complete and synchronised;
+/// only then the full data (.rec and .idx) is deleted, so the long-term trends stay available at about a third
+/// of the space. Only when the summaries alone exceed the size limit, the oldest of them are deleted.
+/// The compaction never competes with the acquisition: besides the idle I/O class, it reads the next chunk only when
+/// the disk writer has nothing in flight, and it is abandoned (to be repeated from the start) when the application
+/// is closed. The recording being written (published by the recorder) is never touched.
+
+#include <ctime>
+#include <cerrno>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <map>
+#include <iostream>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "retention.h"
+#include "recording_format.h"
+#include "recording_reader.h"
+#include "summary_pyramid.h"
+#include "disk_writer.h"
+#include "recorder.h"
+#include "settings_file.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define RETENTION_THREAD_LOOP_DURATION	1000	// milliseconds
+#define RETENTION_FIRST_PASS_DELAY		60000	// milliseconds; the start of the application is left alone
+#define RETENTION_PERIOD				600000	// milliseconds; between the passes over the directory
+
+#define RETENTION_NICE					19		// the lowest CPU priority
+#define RETENTION_IOPRIO_WHO_PROCESS	1		// linux/ioprio.h (not exported by glibc)
+#define RETENTION_IOPRIO_CLASS_IDLE		3
+#define RETENTION_IOPRIO_CLASS_SHIFT	13
+
+#define SECONDS_PER_DAY					86400
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+/// The files of a recording: Zapis_<date>_<time>.rec, .idx, .sum0 ... .sum3
+struct RecordingFiles {
+	bool HasFullData;				// the .rec file exists
+	time_t ModificationTime;		// of the .rec file: the time of its last frames
+	uint64_t FullDataSize;			// bytes; .rec and .idx
+	uint64_t SummariesSize;			// bytes; .sum0 ... .sum3
+};
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+static std::thread RetentionThread;
+
+static std::atomic<bool> CloseRetentionFlag;
+
+/// This variable is used by the retention thread only
+static SummaryPyramid CompactionPyramid;
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static void retentionThreadHandler(void);
+
+static void listRecordings( std::map<std::string, RecordingFiles> * RecordingsPtr );
+
+static bool compactRecording( const std::string & RecordingFilePath );
+
+static uint64_t getSummariesSize( const std::string & RecordingFilePath );
+
+static void deleteSummaries( const std::string & RecordingFilePath );
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+/// The retention is started only if the recording is enabled and a limit is declared in the configuration file
+void retentionStart(void){
+	if (RecordingDirectory.empty() || ((0 == RecordingFullDataDays) && (0 == RecordingSizeLimit))){
+		return;
+	}
+	atomic_store_explicit( &CloseRetentionFlag, false, std::memory_order_release );
+	RetentionThread = std::thread(retentionThreadHandler);
+}
+
+/// This function is called by FLTK onMainWindowCloseCallback event handler; a compaction in progress is abandoned
+void retentionExit(void){
+	atomic_store_explicit( &CloseRetentionFlag, true, std::memory_order_release );
+	if (RetentionThread.joinable()){
+		RetentionThread.join();
+	}
+}
+
+static void retentionThreadHandler(void){
+	pid_t ThreadId = (pid_t)syscall( SYS_gettid );
+	if (0 != setpriority( PRIO_PROCESS, (id_t)ThreadId, RETENTION_NICE )){
+		std::cout << "Nie można obniżyć priorytetu wątku kompresji zapisu (" << strerror( errno ) << ")" << std::endl;
+	}
+	if (0 != syscall( SYS_ioprio_set, RETENTION_IOPRIO_WHO_PROCESS, ThreadId,
+			RETENTION_IOPRIO_CLASS_IDLE << RETENTION_IOPRIO_CLASS_SHIFT ))
+	{
+		std::cout << "Nie można obniżyć priorytetu dysku wątku kompresji zapisu (" << strerror( errno ) << ")" << std::endl;
+	}
+
+	std::chrono::high_resolution_clock::time_point PassTime = std::chrono::high_resolution_clock::now() +
+			std::chrono::milliseconds( RETENTION_FIRST_PASS_DELAY );
+	while (!atomic_load_explicit( &CloseRetentionFlag, std::memory_order_acquire )){
+		if (std::chrono::high_resolution_clock::now() >= PassTime){
+			applyRetention();
+			PassTime = std::chrono::high_resolution_clock::now() + std::chrono::milliseconds( RETENTION_PERIOD );
+		}
+		std::this_thread::sleep_for( std::chrono::milliseconds( RETENTION_THREAD_LOOP_DURATION ));
+	}
+}
+
+/// This function is called by the retention thread (and by the tests, with the disk writer running): the recordings
+/// older than RecordingFullDataDays are compacted; then, while the directory exceeds RecordingSizeLimit, the oldest
+/// recordings are compacted and, if that is not enough, the oldest summaries are deleted
+void applyRetention(void){
+	std::map<std::string, RecordingFiles> Recordings;	// the recording file paths, in the order of time
+	listRecordings( &Recordings );
+
+	time_t Now = time( nullptr );
+	uint64_t TotalSize = 0;
+	for (auto & Recording : Recordings){
+		if (Recording.second.HasFullData && (RecordingFullDataDays > 0) &&
+				(Now - Recording.second.ModificationTime > (time_t)RecordingFullDataDays*SECONDS_PER_DAY))
+		{
+			if (compactRecording( Recording.first )){
+				Recording.second.HasFullData = false;
+				Recording.second.FullDataSize = 0;
+				Recording.second.SummariesSize = getSummariesSize( Recording.first );
+			}
+			else if (atomic_load_explicit( &CloseRetentionFlag, std::memory_order_acquire )){
+				return;
+			}
+		}
+		TotalSize += Recording.second.FullDataSize + Recording.second.SummariesSize;
+	}
+	if (0 == RecordingSizeLimit){
+		return;
+	}
+
+	// the recording being written counts with its present size, but it is compacted only after it is closed
+	uint64_t SizeLimit = (uint64_t)RecordingSizeLimit * 1000000;
+	for (auto & Recording : Recordings){
+		if (TotalSize <= SizeLimit){
+			return;
+		}
+		if (Recording.second.HasFullData){
+			if (!compactRecording( Recording.first )){
+				if (atomic_load_explicit( &CloseRetentionFlag, std::memory_order_acquire )){
+					return;
+				}
+				continue;		// left as it is (see the message)
+			}
+			TotalSize -= Recording.second.FullDataSize + Recording.second.SummariesSize;
+			Recording.second.HasFullData = false;
+			Recording.second.FullDataSize = 0;
+			Recording.second.SummariesSize = getSummariesSize( Recording.first );
+			TotalSize += Recording.second.SummariesSize;
+		}
+	}
+	for (auto & Recording : Recordings){
+		if (TotalSize <= SizeLimit){
+			return;
+		}
+		if (Recording.second.HasFullData){
+			continue;
+		}
+		deleteSummaries( Recording.first );
+		TotalSize -= Recording.second.SummariesSize;
+		if (VerboseMode){
+			std::cout << "Usunięto podsumowania zapisu: " << Recording.first << std::endl;
+		}
+	}
+}
+
+/// The recordings are identified by the path of their .rec file, which may be already deleted
+static void listRecordings( std::map<std::string, RecordingFiles> * RecordingsPtr ){
+	DIR * DirectoryPtr = opendir( RecordingDirectory.c_str() );
+	if (nullptr == DirectoryPtr){
+		return;
+	}
+	size_t PrefixLength = sizeof(RECORDING_FILE_PREFIX) - 1;
+	while (struct dirent * EntryPtr = readdir( DirectoryPtr )){
+		std::string Name = EntryPtr->d_name;
+		size_t DotPosition = Name.rfind( '.' );
+		if ((0 != Name.compare( 0, PrefixLength, RECORDING_FILE_PREFIX )) || (std::string::npos == DotPosition)){
+			continue;
+		}
+		std::string Extension = Name.substr( DotPosition );
+		if (SUMMARY_TEMPORARY_EXTENSION == Extension){
+			unlink( (RecordingDirectory + "/" + Name).c_str() );		// left by a crash during a compaction
+			continue;
+		}
+		bool IsFullData = (RECORDING_FILE_EXTENSION == Extension) || (RECORDING_INDEX_EXTENSION == Extension) ||
+				(RECORDING_ZERO_SHIFT_EXTENSION == Extension);
+		bool IsSummary = (0 == Extension.compare( 0, sizeof(SUMMARY_FILE_EXTENSION) - 1, SUMMARY_FILE_EXTENSION ));
+		struct stat Status;
+		std::string FilePath = RecordingDirectory + "/" + Name;
+		if ((!IsFullData && !IsSummary) || (0 != stat( FilePath.c_str(), &Status ))){
+			continue;
+		}
+
+		std::string RecordingFilePath = RecordingDirectory + "/" + Name.substr( 0, DotPosition ) + RECORDING_FILE_EXTENSION;
+		RecordingFiles * FilesPtr = &(*RecordingsPtr)[RecordingFilePath];	// zeroed if new
+		if (IsFullData){
+			FilesPtr->FullDataSize += (uint64_t)Status.st_size;
+			if (RECORDING_FILE_EXTENSION == Extension){
+				FilesPtr->HasFullData = true;
+				FilesPtr->ModificationTime = Status.st_mtime;
+			}
+		}
+		else{
+			FilesPtr->SummariesSize += (uint64_t)Status.st_size;
+		}
+	}
+	closedir( DirectoryPtr );
+}
+
+/// The summaries are rebuilt from all the frames of the recording (the ones written by the recorder may lack the tiles
+/// lost in a crash), synchronised, and only then the full data is deleted
+/// @return false if the recording cannot be compacted (it is left as it is), is being written, or the application
+/// is being closed (the compaction is repeated at the next start)
+static bool compactRecording( const std::string & RecordingFilePath ){
+	if (RecordingFilePath == getOpenRecordingFilePath()){
+		return false;
+	}
+	// the chunks of a file just closed may still be queued for the disk writer
+	while (!isDiskWriterIdle()){
+		if (atomic_load_explicit( &CloseRetentionFlag, std::memory_order_acquire )){
+			return false;
+		}
+		std::this_thread::sleep_for( std::chrono::milliseconds( PERIPHERAL_THREAD_LOOP_DURATION ));
+	}
+	RecordingReader Reader{};
+	if (!openRecording( RecordingFilePath, &Reader )){
+		std::cout << "Nie można odczytać pliku: " << RecordingFilePath << std::endl;
+		return false;
+	}
+	madvise( const_cast<uint8_t *>(Reader.DataPtr), Reader.DataSize, MADV_SEQUENTIAL );
+
+	CompactionPyramid = SummaryPyramid();
+	CompactionPyramid.IsWrittenDirectly = true;
+	if (!openSummaryPyramid( &CompactionPyramid, RecordingFilePath )){
+		closeRecording( &Reader );
+		return false;
+	}
+
+	bool IsClosing = false;
+	size_t ChunksNumber = getRecordingChunksNumber( &Reader );
+	for (size_t ChunkIndex=0; (ChunkIndex < ChunksNumber) && !IsClosing; ChunkIndex++){
+		while (!isDiskWriterIdle() && !(IsClosing = atomic_load_explicit( &CloseRetentionFlag, std::memory_order_acquire ))){
+			std::this_thread::sleep_for( std::chrono::milliseconds( PERIPHERAL_THREAD_LOOP_DURATION ));
+		}
+		int FramesNumber = readRecordingChunk( &Reader, ChunkIndex );
+		for (int J=0; J < FramesNumber; J++){
+			addFrameToSummaryPyramid( &CompactionPyramid, &Reader.Frames[J] );
+		}
+		flushSummaryPyramid( &CompactionPyramid, false );
+		IsClosing = IsClosing || atomic_load_explicit( &CloseRetentionFlag, std::memory_order_acquire );
+	}
+	flushSummaryPyramid( &CompactionPyramid, true );
+	closeRecording( &Reader );
+	if (IsClosing){
+		discardSummaryPyramid( RecordingFilePath );
+		return false;
+	}
+	if (!commitSummaryPyramid( &CompactionPyramid, RecordingFilePath )){
+		std::cout << "Błąd zapisu podsumowań zapisu: " << RecordingFilePath << std::endl;
+		return false;
+	}
+
+	unlink( getRecordingSidecarPath( RecordingFilePath, RECORDING_INDEX_EXTENSION ).c_str() );
+	unlink( getRecordingSidecarPath( RecordingFilePath, RECORDING_ZERO_SHIFT_EXTENSION ).c_str() );
+	if (0 != unlink( RecordingFilePath.c_str() )){
+		std::cout << "Nie można usunąć pliku: " << RecordingFilePath << " (" << strerror( errno ) << ")" << std::endl;
+		return false;
+	}
+	if (VerboseMode){
+		std::cout << "Zapis zredukowany do podsumowań: " << RecordingFilePath << std::endl;
+	}
+	return true;
+}
+
+/// @return bytes
+static uint64_t getSummariesSize( const std::string & RecordingFilePath ){
+	uint64_t Size = 0;
+	for (int Level=0; Level < SUMMARY_LEVELS_NUMBER; Level++){
+		struct stat Status;
+		if (0 == stat( getSummaryFilePath( RecordingFilePath, Level ).c_str(), &Status )){
+			Size += (uint64_t)Status.st_size;
+		}
+	}
+	return Size;
+}
+
+static void deleteSummaries( const std::string & RecordingFilePath ){
+	for (int Level=0; Level < SUMMARY_LEVELS_NUMBER; Level++){
+		unlink( getSummaryFilePath( RecordingFilePath, Level ).c_str() );
+	}
+}
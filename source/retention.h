@@ -0,0 +1,18 @@
+/// @file retention.h
+
+#ifndef SOURCE_RETENTION_H_
+#define SOURCE_RETENTION_H_
+
+#include "config.h"
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+void retentionStart(void);
+
+void retentionExit(void);
+
+void applyRetention(void);
+
+#endif // SOURCE_RETENTION_H_
@@ -9,8 +9,12 @@
 #include <stdexcept>
 #include <cassert>
 #include <cstring>
+#include <cmath>
+#include <cstdio>    // for rename
+#include <vector>
 
 #include "settings_file.h"
+#include "modbus_addresses.h"
 
 //.................................................................................................
 // Preprocessor directives
@@ -35,6 +39,18 @@ double DirectionalCoefficient[CUPS_NUMBER];
 /// function I=DirectionalCoefficient[.]*x+OffsetForZeroCurrent[.]; here we have offsets
 int OffsetForZeroCurrent[CUPS_NUMBER];
 
+/// The kind of function used to convert the Modbus register value to current (one per cup)
+CalibrationModels CalibrationModel[CUPS_NUMBER];
+
+/// The polynomial I = PolynomialCoefficient[.][0] + PolynomialCoefficient[.][1]*x + ... (CalibrationModels::POLYNOMIAL)
+int PolynomialDegree[CUPS_NUMBER];
+double PolynomialCoefficient[CUPS_NUMBER][CALIBRATION_POLYNOMIAL_MAX_DEGREE+1];
+
+/// The calibration table: register values (strictly increasing) and currents in uA (CalibrationModels::PIECEWISE_LINEAR)
+int CalibrationPointsNumber[CUPS_NUMBER];
+int CalibrationPointRegister[CUPS_NUMBER][CALIBRATION_TABLE_MAX_POINTS];
+double CalibrationPointCurrent[CUPS_NUMBER][CALIBRATION_TABLE_MAX_POINTS];
+
 char CupDescriptionPtr[CUPS_NUMBER][101];
 
 std::string ThisApplicationDirectory;
@@ -43,6 +59,80 @@ std::string ThisApplicationDirectory;
 /// from the limit switch; value in milliseconds
 int MaximumPropagationTime;
 
+/// The number of the latest samples used for the statistics (mean, standard deviation, minimum, maximum)
+int StatisticsWindowLength[STATISTICS_WINDOWS_MAX];
+int StatisticsWindowsNumber;
+
+/// The digital filter of the currents of each cup and its parameters (length for moving average and median,
+/// coefficient for the exponential filter)
+FilterTypes FilterType[CUPS_NUMBER];
+int FilterLength[CUPS_NUMBER];
+double FilterCoefficient[CUPS_NUMBER];
+
+/// IsTransmissionMeasured[U][D] is set if the transmission from the upstream cup U to the downstream cup D
+/// (i.e. the ratio of their total currents) is to be calculated
+bool IsTransmissionMeasured[CUPS_NUMBER][CUPS_NUMBER];
+
+/// The time constant (in samples) of the exponential smoothing of the transmission
+int TransmissionSmoothing;
+
+/// The shift of the zero of the register values (baseline of the amplifier), subtracted from the register value
+/// before the calibration function is applied; it is set in the configuration file or measured by the auto-zero
+double ZeroShift[CUPS_NUMBER];
+
+/// The number of frames collected with the beam switched off to determine the zero shift (auto-zero)
+int AutoZeroSamplesNumber;
+
+/// The names and units of all the registers of a cup (the currents and the diagnostic channels) used in the GUI,
+/// the logs and the exported files
+char ChannelName[CUPS_NUMBER][VALUES_PER_DISC][CHANNEL_NAME_MAX_LENGTH+1];
+char ChannelUnit[CUPS_NUMBER][VALUES_PER_DISC][CHANNEL_UNIT_MAX_LENGTH+1];
+
+/// The diagnostic channels (the registers after the currents) are scaled linearly: y = DiagnosticGain*x + DiagnosticOffset
+double DiagnosticGain[CUPS_NUMBER][DIAGNOSTIC_VALUES_PER_DISC];
+double DiagnosticOffset[CUPS_NUMBER][DIAGNOSTIC_VALUES_PER_DISC];
+
+/// The beam trip detection: the total current of the cup falls below BeamTripThreshold (uA) for at least
+/// BeamTripMinimumDuration (ms)
+bool IsBeamTripDetected[CUPS_NUMBER];
+double BeamTripThreshold[CUPS_NUMBER];
+int BeamTripMinimumDuration[CUPS_NUMBER];
+
+/// The hour (0 ... 23) at which one of the 8-hour shifts begins; the beam trips are counted per shift
+int ShiftStartHour;
+
+/// The conditions that start the triggered capture (see triggered_capture.cpp)
+int TriggersNumber;
+TriggerDefinition Triggers[TRIGGERS_MAX];
+
+/// The time windows (in milliseconds) captured before and after the trigger
+int PreTriggerDuration;
+int PostTriggerDuration;
+
+/// The spectrum of the beam current: the length of the FFT (samples), the window function and the maximum
+/// number of averaged segments (Welch's method, 50% overlap)
+int SpectrumLength;
+SpectrumWindows SpectrumWindow;
+int SpectrumSegments;
+
+/// The duration (in milliseconds) of the back-to-back polling of the registers for the spectrum
+int BurstDuration;
+
+/// The alarm rules (see alarms.cpp)
+int AlarmsNumber;
+AlarmDefinition Alarms[ALARMS_MAX];
+
+/// The directory of the recording files (see recorder.cpp); empty if the recording is disabled
+std::string RecordingDirectory;
+
+/// The retention of the recordings (see retention.cpp): the days after which only the summaries of a recording are kept
+/// and the megabytes the directory may take; 0 - no limit
+int RecordingFullDataDays;
+int RecordingSizeLimit;
+
+/// The capacity of the history of readouts (see history_buffer.cpp), frames
+int HistoryBufferCapacity;
+
 //.................................................................................................
 // Local variables
 //.................................................................................................
@@ -54,6 +144,14 @@ static std::string SerialPortRequestedName;
 
 static bool FormulaIsDefined[CUPS_NUMBER];
 
+static bool FilterIsDefined[CUPS_NUMBER];
+
+static bool ZeroShiftIsDefined[CUPS_NUMBER];
+
+static bool DiagnosticChannelIsDefined[CUPS_NUMBER][DIAGNOSTIC_VALUES_PER_DISC];
+
+static const char * const CurrentChannelName[VISIBLE_VALUES_PER_DISC] = { "Pierścień zewnętrzny", "Pierścień środkowy", "Koło wewnętrzne" };
+
 static std::string ConfigurationFilePath;
 
 //.................................................................................................
@@ -61,7 +159,22 @@ static std::string ConfigurationFilePath;
 //.................................................................................................
 
 static FailureCodes parseFunctionFormula( std::regex Pattern, std::string *LinePtr, int CupIndex );
+static FailureCodes parsePolynomialFormula( std::regex Pattern, std::string *LinePtr, int CupIndex );
+static FailureCodes parseCalibrationTable( std::regex Pattern, std::string *LinePtr, int CupIndex );
 static FailureCodes parseCupName( std::regex Pattern, std::string *LinePtr, int CupIndex );
+static FailureCodes parseFilterDefinition( std::regex Pattern, std::string *LinePtr, int CupIndex );
+static FailureCodes parseTransmissionPair( std::regex Pattern, std::string *LinePtr );
+static FailureCodes parseZeroShift( std::regex Pattern, std::string *LinePtr, int CupIndex );
+static FailureCodes parseDiagnosticChannel( std::regex Pattern, std::string *LinePtr, int CupIndex );
+static FailureCodes parseBeamTripDetection( std::regex Pattern, std::string *LinePtr, int CupIndex );
+static FailureCodes parseTrigger( std::regex Pattern, std::string *LinePtr );
+static FailureCodes parseStatisticsWindows( std::regex Pattern, std::string *LinePtr, bool *IsDefinedPtr );
+static FailureCodes parseCaptureWindows( std::regex Pattern, std::string *LinePtr, bool *IsDefinedPtr );
+static FailureCodes parseSpectrumDefinition( std::regex Pattern, std::string *LinePtr, bool *IsDefinedPtr );
+static FailureCodes parseAlarm( std::regex Pattern, std::string *LinePtr );
+static FailureCodes parseRecordingDirectory( std::regex Pattern, std::string *LinePtr );
+static FailureCodes parseIntegerParameter( std::regex Pattern, std::string *LinePtr, int *ValuePtr, bool *IsDefinedPtr,
+		int LowerLimit, int UpperLimit );
 
 //........................................................................................................
 // Function definitions
@@ -98,10 +211,70 @@ FailureCodes configurationFileParsing(void) {
     for (int J=0; J<CUPS_NUMBER; J++){
     	FormulaIsDefined[J] = false;
     	CupDescriptionPtr[J][0] = 0;
+    	FilterIsDefined[J] = false;
+    	FilterType[J] = FilterTypes::NONE;
+    	FilterLength[J] = 1;
+    	FilterCoefficient[J] = 1.0;
+    	ZeroShiftIsDefined[J] = false;
+    	IsBeamTripDetected[J] = false;
+    	ZeroShift[J] = 0.0;
+    	for (int K=0; K < VALUES_PER_DISC; K++){
+    		if (K < VISIBLE_VALUES_PER_DISC){
+    			snprintf( ChannelName[J][K], sizeof(ChannelName[0][0]), "%s", CurrentChannelName[K] );
+    			snprintf( ChannelUnit[J][K], sizeof(ChannelUnit[0][0]), "μA" );
+    		}
+    		else{
+    			snprintf( ChannelName[J][K], sizeof(ChannelName[0][0]), "Rejestr %d", K+1 );
+    			ChannelUnit[J][K][0] = 0;
+    			DiagnosticChannelIsDefined[J][K-VISIBLE_VALUES_PER_DISC] = false;
+    			DiagnosticGain[J][K-VISIBLE_VALUES_PER_DISC] = 1.0;
+    			DiagnosticOffset[J][K-VISIBLE_VALUES_PER_DISC] = 0.0;
+    		}
+    	}
+    	for (int K=0; K<CUPS_NUMBER; K++){
+    		IsTransmissionMeasured[J][K] = false;
+    	}
     }
 
     MaximumPropagationTime = -1;
 
+    StatisticsWindowLength[0] = STATISTICS_WINDOW_DEFAULT;
+    StatisticsWindowsNumber = 1;
+    bool IsStatisticsWindowDefined = false;
+
+    HistoryBufferCapacity = HISTORY_BUFFER_CAPACITY_DEFAULT;
+    bool IsHistoryBufferCapacityDefined = false;
+
+    TransmissionSmoothing = TRANSMISSION_SMOOTHING_DEFAULT;
+    bool IsTransmissionSmoothingDefined = false;
+
+    AutoZeroSamplesNumber = AUTO_ZERO_SAMPLES_DEFAULT;
+    bool IsAutoZeroSamplesNumberDefined = false;
+
+    ShiftStartHour = SHIFT_START_HOUR_DEFAULT;
+    bool IsShiftStartHourDefined = false;
+
+    TriggersNumber = 0;
+    PreTriggerDuration = CAPTURE_WINDOW_DEFAULT;
+    PostTriggerDuration = CAPTURE_WINDOW_DEFAULT;
+    bool IsCaptureWindowDefined = false;
+
+    SpectrumLength = SPECTRUM_LENGTH_DEFAULT;
+    SpectrumWindow = SpectrumWindows::HANN;
+    SpectrumSegments = SPECTRUM_SEGMENTS_DEFAULT;
+    bool IsSpectrumDefined = false;
+
+    BurstDuration = BURST_DURATION_DEFAULT;
+    bool IsBurstDurationDefined = false;
+
+    AlarmsNumber = 0;
+
+    RecordingDirectory.clear();
+    RecordingFullDataDays = 0;
+    bool IsRecordingFullDataDaysDefined = false;
+    RecordingSizeLimit = 0;
+    bool IsRecordingSizeLimitDefined = false;
+
     int LineNumber = 1;
     std::string Line;
     std::smatch Matches;
@@ -124,10 +297,44 @@ FailureCodes configurationFileParsing(void) {
     std::regex PatternCup1FunctionFormula(R"(\s*(?!#)Wzór na prądy w pierwszym kubku:\s*I\s*=\s*([0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*\*\s*\(\s*x\s*([+-])\s*(0x[0-9A-Fa-f]+|\d+)\s*\)\s*$)");
     std::regex PatternCup2FunctionFormula(R"(\s*(?!#)Wzór na prądy w drugim kubku:\s*I\s*=\s*([0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*\*\s*\(\s*x\s*([+-])\s*(0x[0-9A-Fa-f]+|\d+)\s*\)\s*$)");
     std::regex PatternCup3FunctionFormula(R"(\s*(?!#)Wzór na prądy w trzecim kubku:\s*I\s*=\s*([0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*\*\s*\(\s*x\s*([+-])\s*(0x[0-9A-Fa-f]+|\d+)\s*\)\s*$)");
+    std::regex PatternCup1Polynomial(R"(\s*(?!#)Wielomian na prądy w pierwszym kubku:\s*(.+?)\s*$)");
+    std::regex PatternCup2Polynomial(R"(\s*(?!#)Wielomian na prądy w drugim kubku:\s*(.+?)\s*$)");
+    std::regex PatternCup3Polynomial(R"(\s*(?!#)Wielomian na prądy w trzecim kubku:\s*(.+?)\s*$)");
+    std::regex PatternCup1CalibrationTable(R"(\s*(?!#)Tabela kalibracji pierwszego kubka:\s*(.+?)\s*$)");
+    std::regex PatternCup2CalibrationTable(R"(\s*(?!#)Tabela kalibracji drugiego kubka:\s*(.+?)\s*$)");
+    std::regex PatternCup3CalibrationTable(R"(\s*(?!#)Tabela kalibracji trzeciego kubka:\s*(.+?)\s*$)");
     std::regex PatternCup1Title(R"(\s*(?!#)Tytuł pierwszego kubka:\s*(.+)\s*$)");
     std::regex PatternCup2Title(R"(\s*(?!#)Tytuł drugiego kubka:\s*(.+)\s*$)");
     std::regex PatternCup3Title(R"(\s*(?!#)Tytuł trzeciego kubka:\s*(.+)\s*$)");
     std::regex PatternMaxPropagationTime(R"(\s*(?!#)Limit czasu propagacji sygnału z krańcówki:\s*(\d+)\s*$)");
+    std::regex PatternCup1Filter(R"(\s*(?!#)Filtr prądów w pierwszym kubku:\s*(brak|średnia|wykładniczy|mediana)\s*([0-9]*\.?[0-9]+)?\s*$)");
+    std::regex PatternCup2Filter(R"(\s*(?!#)Filtr prądów w drugim kubku:\s*(brak|średnia|wykładniczy|mediana)\s*([0-9]*\.?[0-9]+)?\s*$)");
+    std::regex PatternCup3Filter(R"(\s*(?!#)Filtr prądów w trzecim kubku:\s*(brak|średnia|wykładniczy|mediana)\s*([0-9]*\.?[0-9]+)?\s*$)");
+    std::regex PatternStatisticsWindow(R"(\s*(?!#)Okno statystyk:\s*(\d+)(?:\s*;\s*(\d+))?(?:\s*;\s*(\d+))?\s*$)");
+    std::regex PatternHistoryBufferCapacity(R"(\s*(?!#)Historia odczytów:\s*(\d+)\s*$)");
+    std::regex PatternTransmissionPair(R"(\s*(?!#)Transmisja między kubkami:\s*(\d+)\s*->\s*(\d+)\s*$)");
+    std::regex PatternTransmissionSmoothing(R"(\s*(?!#)Wygładzanie transmisji:\s*(\d+)\s*$)");
+    std::regex PatternCup1ZeroShift(R"(\s*(?!#)Korekta zera pierwszego kubka:\s*([+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*$)");
+    std::regex PatternCup2ZeroShift(R"(\s*(?!#)Korekta zera drugiego kubka:\s*([+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*$)");
+    std::regex PatternCup3ZeroShift(R"(\s*(?!#)Korekta zera trzeciego kubka:\s*([+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*$)");
+    std::regex PatternCup1DiagnosticChannel(R"(\s*(?!#)Kanał diagnostyczny (\d+) pierwszego kubka:\s*([^;]+?)\s*;\s*([+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*;\s*([+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*(?:;\s*([^;\s]*))?\s*$)");
+    std::regex PatternCup2DiagnosticChannel(R"(\s*(?!#)Kanał diagnostyczny (\d+) drugiego kubka:\s*([^;]+?)\s*;\s*([+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*;\s*([+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*(?:;\s*([^;\s]*))?\s*$)");
+    std::regex PatternCup3DiagnosticChannel(R"(\s*(?!#)Kanał diagnostyczny (\d+) trzeciego kubka:\s*([^;]+?)\s*;\s*([+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*;\s*([+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*(?:;\s*([^;\s]*))?\s*$)");
+    std::regex PatternCup1BeamTrip(R"(\s*(?!#)Detekcja wyłączeń wiązki w pierwszym kubku:\s*([0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*;\s*(\d+)\s*$)");
+    std::regex PatternCup2BeamTrip(R"(\s*(?!#)Detekcja wyłączeń wiązki w drugim kubku:\s*([0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*;\s*(\d+)\s*$)");
+    std::regex PatternCup3BeamTrip(R"(\s*(?!#)Detekcja wyłączeń wiązki w trzecim kubku:\s*([0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*;\s*(\d+)\s*$)");
+    std::regex PatternShiftStartHour(R"(\s*(?!#)Początek zmiany:\s*(\d+)\s*$)");
+    std::regex PatternTrigger(R"(\s*(?!#)Wyzwalacz:\s*kubek\s+(\d+)\s+(kanał|cewka)\s+(\d+)\s+(powyżej|poniżej|narasta|opada|zbocze narastające|zbocze opadające|zbocze)\s*([+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)?\s*$)");
+    std::regex PatternCaptureWindows(R"(\s*(?!#)Przechwytywanie:\s*(\d+)\s*;\s*(\d+)\s*$)");
+    std::regex PatternSpectrum(R"(\s*(?!#)Widmo:\s*(\d+)\s*;\s*(prostokątne|hann|blackman)\s*;\s*(\d+)\s*$)");
+    std::regex PatternBurstDuration(R"(\s*(?!#)Odczyt seryjny:\s*(\d+)\s*$)");
+    std::regex PatternAlarm(R"(\s*(?!#)Alarm:\s*kubek\s+(\d+)\s+(kanał|cewka)\s+(\d+)\s+(powyżej|poniżej|włączona|wyłączona)\s*([+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)?\s*)"
+    		R"((?:;\s*histereza\s+([0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)\s*)?(?:;\s*opóźnienie\s+(\d+)\s*)?;\s*(ostrzeżenie|alarm|krytyczny)\s*)"
+    		R"((?:;\s*wysuń kubek(?:\s+(\d+))?\s*)?$)");
+    std::regex PatternRecordingDirectory(R"(\s*(?!#)Zapis ciągły:\s*(.+?)\s*$)");
+    std::regex PatternRecordingFullDataDays(R"(\s*(?!#)Zapis ciągły - pełne dane:\s*(\d+)\s*$)");
+    std::regex PatternRecordingSizeLimit(R"(\s*(?!#)Zapis ciągły - limit miejsca:\s*(\d+)\s*$)");
+    std::regex PatternAutoZeroSamples(R"(\s*(?!#)Próbki autozerowania:\s*(\d+)\s*$)");
 
     while (std::getline(File, Line)) {
         if (VerboseMode){
@@ -162,6 +369,32 @@ FailureCodes configurationFileParsing(void) {
         	return Result;
         }
 
+        Result = parsePolynomialFormula( PatternCup1Polynomial, &Line, 0 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parsePolynomialFormula( PatternCup2Polynomial, &Line, 1 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parsePolynomialFormula( PatternCup3Polynomial, &Line, 2 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+
+        Result = parseCalibrationTable( PatternCup1CalibrationTable, &Line, 0 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseCalibrationTable( PatternCup2CalibrationTable, &Line, 1 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseCalibrationTable( PatternCup3CalibrationTable, &Line, 2 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+
         Result = parseCupName( PatternCup1Title, &Line, 0 );
         if (FailureCodes::NO_FAILURE != Result){
         	return Result;
@@ -175,6 +408,121 @@ FailureCodes configurationFileParsing(void) {
         	return Result;
         }
 
+        Result = parseFilterDefinition( PatternCup1Filter, &Line, 0 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseFilterDefinition( PatternCup2Filter, &Line, 1 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseFilterDefinition( PatternCup3Filter, &Line, 2 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+
+        Result = parseStatisticsWindows( PatternStatisticsWindow, &Line, &IsStatisticsWindowDefined );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+
+        Result = parseIntegerParameter( PatternHistoryBufferCapacity, &Line, &HistoryBufferCapacity, &IsHistoryBufferCapacityDefined,
+        		HISTORY_BUFFER_CAPACITY_MIN, HISTORY_BUFFER_CAPACITY_MAX );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+
+        Result = parseTransmissionPair( PatternTransmissionPair, &Line );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseIntegerParameter( PatternTransmissionSmoothing, &Line, &TransmissionSmoothing, &IsTransmissionSmoothingDefined,
+        		1, TRANSMISSION_SMOOTHING_MAX );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+
+        Result = parseZeroShift( PatternCup1ZeroShift, &Line, 0 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseZeroShift( PatternCup2ZeroShift, &Line, 1 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseZeroShift( PatternCup3ZeroShift, &Line, 2 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseDiagnosticChannel( PatternCup1DiagnosticChannel, &Line, 0 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseDiagnosticChannel( PatternCup2DiagnosticChannel, &Line, 1 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseDiagnosticChannel( PatternCup3DiagnosticChannel, &Line, 2 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseBeamTripDetection( PatternCup1BeamTrip, &Line, 0 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseBeamTripDetection( PatternCup2BeamTrip, &Line, 1 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseBeamTripDetection( PatternCup3BeamTrip, &Line, 2 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseIntegerParameter( PatternShiftStartHour, &Line, &ShiftStartHour, &IsShiftStartHourDefined, 0, 23 );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseTrigger( PatternTrigger, &Line );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseCaptureWindows( PatternCaptureWindows, &Line, &IsCaptureWindowDefined );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseSpectrumDefinition( PatternSpectrum, &Line, &IsSpectrumDefined );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseIntegerParameter( PatternBurstDuration, &Line, &BurstDuration, &IsBurstDurationDefined,
+        		1000, BURST_DURATION_MAX );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseAlarm( PatternAlarm, &Line );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseRecordingDirectory( PatternRecordingDirectory, &Line );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseIntegerParameter( PatternRecordingFullDataDays, &Line, &RecordingFullDataDays, &IsRecordingFullDataDaysDefined,
+        		0, RECORDING_FULL_DATA_DAYS_MAX );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseIntegerParameter( PatternRecordingSizeLimit, &Line, &RecordingSizeLimit, &IsRecordingSizeLimitDefined,
+        		0, RECORDING_SIZE_LIMIT_MAX );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+        Result = parseIntegerParameter( PatternAutoZeroSamples, &Line, &AutoZeroSamplesNumber, &IsAutoZeroSamplesNumberDefined,
+        		5, AUTO_ZERO_SAMPLES_MAX );
+        if (FailureCodes::NO_FAILURE != Result){
+        	return Result;
+        }
+
         if (std::regex_match(Line, Matches, PatternMaxPropagationTime)) {
         if (MaximumPropagationTime < 0){
 				std::string PropagationText  = Matches[1]; // integer
@@ -238,6 +586,7 @@ static FailureCodes parseFunctionFormula( std::regex Pattern, std::string *LineP
     if (std::regex_match(*LinePtr, Matches, Pattern)) {
     	if (!FormulaIsDefined[CupIndex]){
     		FormulaIsDefined[CupIndex] = true;
+    		CalibrationModel[CupIndex] = CalibrationModels::LINEAR;
 
     		std::string CoefficientText  = Matches[1]; // floating point
     		std::string SignText         = Matches[2]; // '+' or '-'
@@ -299,6 +648,115 @@ static FailureCodes parseFunctionFormula( std::regex Pattern, std::string *LineP
     return FailureCodes::NO_FAILURE;
 }
 
+/// The polynomial is given as a list of coefficients a0; a1; a2; ... of the formula I = a0 + a1*x + a2*x^2 + ...
+static FailureCodes parsePolynomialFormula( std::regex Pattern, std::string *LinePtr, int CupIndex ){
+    std::smatch Matches;
+    assert( CupIndex < CUPS_NUMBER );
+    if (std::regex_match(*LinePtr, Matches, Pattern)) {
+    	if (FormulaIsDefined[CupIndex]){
+        	std::cout << "  Nadmiarowa formuła konwersji w linii: [" << *LinePtr << "]" << std::endl;
+            return FailureCodes::ERROR_SETTINGS_CONVERTION_FORMULA;
+    	}
+    	FormulaIsDefined[CupIndex] = true;
+    	CalibrationModel[CupIndex] = CalibrationModels::POLYNOMIAL;
+
+		std::string ListText = Matches[1];
+		std::regex PatternList(R"(([+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)(\s*;\s*[+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)*)");
+		std::regex PatternCoefficient(R"([+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)");
+		if (!std::regex_match(ListText, PatternList)) {
+	       	std::cout << "  Błędna lista współczynników wielomianu w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_CONVERTION_FORMULA;
+		}
+
+		PolynomialDegree[CupIndex] = -1;
+		for (std::sregex_iterator Iterator(ListText.begin(), ListText.end(), PatternCoefficient); Iterator != std::sregex_iterator(); ++Iterator){
+			if (PolynomialDegree[CupIndex] >= CALIBRATION_POLYNOMIAL_MAX_DEGREE){
+		       	std::cout << "  Stopień wielomianu większy niż " << CALIBRATION_POLYNOMIAL_MAX_DEGREE << " w linii: [" << *LinePtr << "]" << std::endl;
+		       	return FailureCodes::ERROR_SETTINGS_CONVERTION_FORMULA;
+			}
+			PolynomialDegree[CupIndex]++;
+			try {
+				PolynomialCoefficient[CupIndex][PolynomialDegree[CupIndex]] = std::stod(Iterator->str());
+			}
+			catch (const std::invalid_argument&) {
+		       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+		       	return FailureCodes::ERROR_SETTINGS_CONVERTION_FORMULA;
+			}
+			catch (const std::out_of_range&) {
+		       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+		       	return FailureCodes::ERROR_SETTINGS_CONVERTION_FORMULA;
+			}
+		}
+
+		if (VerboseMode){
+			std::cout << "  Wielomian konwersji stopnia " << PolynomialDegree[CupIndex] << ": I =";
+			for (int J=0; J <= PolynomialDegree[CupIndex]; J++){
+				std::cout << ((0 == J)? " " : " + ") << PolynomialCoefficient[CupIndex][J] << "*x^" << J;
+			}
+			std::cout << "  w linii: [" << *LinePtr << "]" << std::endl;
+		}
+    }
+    return FailureCodes::NO_FAILURE;
+}
+
+/// The calibration table is a list of points "x: I" separated by semicolons, where x is a register value
+/// (decimal or hexadecimal 0x...) and I is the current in uA; the x values must be strictly increasing
+static FailureCodes parseCalibrationTable( std::regex Pattern, std::string *LinePtr, int CupIndex ){
+    std::smatch Matches;
+    assert( CupIndex < CUPS_NUMBER );
+    if (std::regex_match(*LinePtr, Matches, Pattern)) {
+    	if (FormulaIsDefined[CupIndex]){
+        	std::cout << "  Nadmiarowa formuła konwersji w linii: [" << *LinePtr << "]" << std::endl;
+            return FailureCodes::ERROR_SETTINGS_CONVERTION_FORMULA;
+    	}
+    	FormulaIsDefined[CupIndex] = true;
+    	CalibrationModel[CupIndex] = CalibrationModels::PIECEWISE_LINEAR;
+
+		std::string ListText = Matches[1];
+		std::regex PatternList(R"((0x[0-9A-Fa-f]+|\d+)\s*:\s*[+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?(\s*;\s*(0x[0-9A-Fa-f]+|\d+)\s*:\s*[+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?)*)");
+		std::regex PatternPoint(R"((0x[0-9A-Fa-f]+|\d+)\s*:\s*([+\-]?[0-9]*\.?[0-9]+(?:[eE][+\-]?\d+)?))");
+		if (!std::regex_match(ListText, PatternList)) {
+	       	std::cout << "  Błędna tabela kalibracji w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_CALIBRATION_TABLE;
+		}
+
+		CalibrationPointsNumber[CupIndex] = 0;
+		for (std::sregex_iterator Iterator(ListText.begin(), ListText.end(), PatternPoint); Iterator != std::sregex_iterator(); ++Iterator){
+			int PointIndex = CalibrationPointsNumber[CupIndex];
+			if (PointIndex >= CALIBRATION_TABLE_MAX_POINTS){
+		       	std::cout << "  Tabela kalibracji dłuższa niż " << CALIBRATION_TABLE_MAX_POINTS << " punktów w linii: [" << *LinePtr << "]" << std::endl;
+		       	return FailureCodes::ERROR_SETTINGS_CALIBRATION_TABLE;
+			}
+			try {
+				CalibrationPointRegister[CupIndex][PointIndex] = std::stoi((*Iterator)[1].str(), nullptr, 0);
+				CalibrationPointCurrent[CupIndex][PointIndex] = std::stod((*Iterator)[2].str());
+			}
+			catch (const std::invalid_argument&) {
+		       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+		       	return FailureCodes::ERROR_SETTINGS_CALIBRATION_TABLE;
+			}
+			catch (const std::out_of_range&) {
+		       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+		       	return FailureCodes::ERROR_SETTINGS_CALIBRATION_TABLE;
+			}
+			if ((PointIndex > 0) && (CalibrationPointRegister[CupIndex][PointIndex] <= CalibrationPointRegister[CupIndex][PointIndex-1])){
+		       	std::cout << "  Wartości x w tabeli kalibracji nie są rosnące w linii: [" << *LinePtr << "]" << std::endl;
+		       	return FailureCodes::ERROR_SETTINGS_CALIBRATION_TABLE;
+			}
+			CalibrationPointsNumber[CupIndex]++;
+		}
+		if (CalibrationPointsNumber[CupIndex] < 2){
+	       	std::cout << "  Tabela kalibracji musi mieć co najmniej 2 punkty w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_CALIBRATION_TABLE;
+		}
+
+		if (VerboseMode){
+			std::cout << "  Tabela kalibracji, punktów: " << CalibrationPointsNumber[CupIndex] << "  w linii: [" << *LinePtr << "]" << std::endl;
+		}
+    }
+    return FailureCodes::NO_FAILURE;
+}
+
 static FailureCodes parseCupName( std::regex Pattern, std::string *LinePtr, int CupIndex ){
     std::smatch Matches;
     assert( CupIndex < CUPS_NUMBER );
@@ -318,3 +776,603 @@ static FailureCodes parseCupName( std::regex Pattern, std::string *LinePtr, int
     return FailureCodes::NO_FAILURE;
 }
 
+
+/// The filter is defined by its name and parameter: "brak", "średnia N", "mediana N" (N samples,
+/// 2 ... FILTER_WINDOW_MAX) or "wykładniczy A" (the smoothing coefficient A in the range (0; 1])
+static FailureCodes parseFilterDefinition( std::regex Pattern, std::string *LinePtr, int CupIndex ){
+    std::smatch Matches;
+    assert( CupIndex < CUPS_NUMBER );
+    if (std::regex_match(*LinePtr, Matches, Pattern)) {
+    	if (FilterIsDefined[CupIndex]){
+        	std::cout << "  Nadmiarowa definicja filtru w linii: [" << *LinePtr << "]" << std::endl;
+            return FailureCodes::ERROR_SETTINGS_FILTER;
+    	}
+    	FilterIsDefined[CupIndex] = true;
+
+    	std::string NameText = Matches[1];
+    	std::string ParameterText = Matches[2];
+
+    	if (NameText == "brak"){
+    		if (!ParameterText.empty()){
+    	       	std::cout << "  Zbędny parametr filtru w linii: [" << *LinePtr << "]" << std::endl;
+    	       	return FailureCodes::ERROR_SETTINGS_FILTER;
+    		}
+    		FilterType[CupIndex] = FilterTypes::NONE;
+    		return FailureCodes::NO_FAILURE;
+    	}
+		if (ParameterText.empty()){
+	       	std::cout << "  Brak parametru filtru w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_FILTER;
+		}
+
+    	if (NameText == "wykładniczy"){
+    		FilterType[CupIndex] = FilterTypes::EXPONENTIAL;
+			try {
+				FilterCoefficient[CupIndex] = std::stod(ParameterText);
+			}
+			catch (const std::exception&) {
+		       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+		       	return FailureCodes::ERROR_SETTINGS_FILTER;
+			}
+			if ((FilterCoefficient[CupIndex] <= 0.0) || (FilterCoefficient[CupIndex] > 1.0)){
+		       	std::cout << "  Współczynnik filtru poza przedziałem (0; 1] w linii: [" << *LinePtr << "]" << std::endl;
+		       	return FailureCodes::ERROR_SETTINGS_FILTER;
+			}
+    	}
+    	else{
+    		FilterType[CupIndex] = (NameText == "średnia")? FilterTypes::MOVING_AVERAGE : FilterTypes::MEDIAN;
+			try {
+				size_t ConvertedCharacters;
+				FilterLength[CupIndex] = std::stoi(ParameterText, &ConvertedCharacters, 10);
+				if (ConvertedCharacters != ParameterText.size()){
+					throw std::invalid_argument("not an integer");
+				}
+			}
+			catch (const std::exception&) {
+		       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+		       	return FailureCodes::ERROR_SETTINGS_FILTER;
+			}
+			if ((FilterLength[CupIndex] < 2) || (FilterLength[CupIndex] > FILTER_WINDOW_MAX)){
+		       	std::cout << "  Długość filtru poza przedziałem [2; " << FILTER_WINDOW_MAX << "] w linii: [" << *LinePtr << "]" << std::endl;
+		       	return FailureCodes::ERROR_SETTINGS_FILTER;
+			}
+    	}
+
+		if (VerboseMode){
+			std::cout << "  Filtr kubka " << (int)(CupIndex+1) << ": " << NameText << " " << ParameterText << " w linii: [" << *LinePtr << "]" << std::endl;
+		}
+    }
+    return FailureCodes::NO_FAILURE;
+}
+
+/// The pair of cups is given as "U -> D", where U and D are the numbers of the cups (counted from 1)
+static FailureCodes parseTransmissionPair( std::regex Pattern, std::string *LinePtr ){
+    std::smatch Matches;
+    if (std::regex_match(*LinePtr, Matches, Pattern)) {
+    	int UpstreamCup, DownstreamCup;
+		try {
+			UpstreamCup = std::stoi(Matches[1].str()) - 1;
+			DownstreamCup = std::stoi(Matches[2].str()) - 1;
+		}
+		catch (const std::exception&) {
+	       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_TRANSMISSION;
+		}
+		if ((UpstreamCup < 0) || (UpstreamCup >= PHYSICALLY_INSTALLED_CUPS) ||
+				(DownstreamCup < 0) || (DownstreamCup >= PHYSICALLY_INSTALLED_CUPS) || (UpstreamCup == DownstreamCup))
+		{
+	       	std::cout << "  Niewłaściwe numery kubków w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_TRANSMISSION;
+		}
+		if (IsTransmissionMeasured[UpstreamCup][DownstreamCup]){
+	       	std::cout << "  Nadmiarowa deklaracja transmisji w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_TRANSMISSION;
+		}
+		IsTransmissionMeasured[UpstreamCup][DownstreamCup] = true;
+
+		if (VerboseMode){
+			std::cout << "  Transmisja z kubka " << (UpstreamCup+1) << " do kubka " << (DownstreamCup+1) << " w linii: [" << *LinePtr << "]" << std::endl;
+		}
+    }
+    return FailureCodes::NO_FAILURE;
+}
+
+/// The zero shift is given in units of the register (it may be fractional, as it comes from a median of many samples)
+static FailureCodes parseZeroShift( std::regex Pattern, std::string *LinePtr, int CupIndex ){
+    std::smatch Matches;
+    assert( CupIndex < CUPS_NUMBER );
+    if (std::regex_match(*LinePtr, Matches, Pattern)) {
+    	if (ZeroShiftIsDefined[CupIndex]){
+        	std::cout << "  Nadmiarowa korekta zera w linii: [" << *LinePtr << "]" << std::endl;
+            return FailureCodes::ERROR_SETTINGS_ZERO_SHIFT;
+    	}
+    	ZeroShiftIsDefined[CupIndex] = true;
+		try {
+			ZeroShift[CupIndex] = std::stod(Matches[1].str());
+		}
+		catch (const std::exception&) {
+	       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_ZERO_SHIFT;
+		}
+		if (fabs( ZeroShift[CupIndex] ) >= (double)0x8000){
+	       	std::cout << "  Korekta zera poza zakresem rejestru w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_ZERO_SHIFT;
+		}
+
+		if (VerboseMode){
+			std::cout << "  Korekta zera kubka " << (int)(CupIndex+1) << ": " << ZeroShift[CupIndex] << " w linii: [" << *LinePtr << "]" << std::endl;
+		}
+    }
+    return FailureCodes::NO_FAILURE;
+}
+
+/// The diagnostic channel is defined as "N: name; gain; offset; unit", where N is the number of the register
+/// of the cup counted from 1 (only the registers after the currents), the unit is optional
+static FailureCodes parseDiagnosticChannel( std::regex Pattern, std::string *LinePtr, int CupIndex ){
+    std::smatch Matches;
+    assert( CupIndex < CUPS_NUMBER );
+    if (std::regex_match(*LinePtr, Matches, Pattern)) {
+    	int Channel;
+		try {
+			Channel = std::stoi(Matches[1].str()) - 1;
+		}
+		catch (const std::exception&) {
+	       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_DIAGNOSTIC_CHANNEL;
+		}
+		if ((Channel < VISIBLE_VALUES_PER_DISC) || (Channel >= VALUES_PER_DISC)){
+	       	std::cout << "  Numer rejestru diagnostycznego poza przedziałem [" << (VISIBLE_VALUES_PER_DISC+1) << "; " << VALUES_PER_DISC
+	       			<< "] w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_DIAGNOSTIC_CHANNEL;
+		}
+		int DiagnosticIndex = Channel - VISIBLE_VALUES_PER_DISC;
+    	if (DiagnosticChannelIsDefined[CupIndex][DiagnosticIndex]){
+        	std::cout << "  Nadmiarowa definicja kanału diagnostycznego w linii: [" << *LinePtr << "]" << std::endl;
+            return FailureCodes::ERROR_SETTINGS_DIAGNOSTIC_CHANNEL;
+    	}
+    	DiagnosticChannelIsDefined[CupIndex][DiagnosticIndex] = true;
+
+		try {
+			DiagnosticGain[CupIndex][DiagnosticIndex] = std::stod(Matches[3].str());
+			DiagnosticOffset[CupIndex][DiagnosticIndex] = std::stod(Matches[4].str());
+		}
+		catch (const std::exception&) {
+	       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_DIAGNOSTIC_CHANNEL;
+		}
+		snprintf( ChannelName[CupIndex][Channel], sizeof(ChannelName[0][0]), "%s", Matches[2].str().c_str() );
+		snprintf( ChannelUnit[CupIndex][Channel], sizeof(ChannelUnit[0][0]), "%s", Matches[5].str().c_str() );
+
+		if (VerboseMode){
+			std::cout << "  Kanał diagnostyczny " << (Channel+1) << " kubka " << (CupIndex+1) << ": [" << ChannelName[CupIndex][Channel]
+					<< "] = " << DiagnosticGain[CupIndex][DiagnosticIndex] << "*x + " << DiagnosticOffset[CupIndex][DiagnosticIndex]
+					<< " [" << ChannelUnit[CupIndex][Channel] << "] w linii: [" << *LinePtr << "]" << std::endl;
+		}
+    }
+    return FailureCodes::NO_FAILURE;
+}
+
+/// The beam trip detection is defined as "threshold; minimum duration", the threshold of the total current
+/// in uA and the duration in milliseconds
+static FailureCodes parseBeamTripDetection( std::regex Pattern, std::string *LinePtr, int CupIndex ){
+    std::smatch Matches;
+    assert( CupIndex < CUPS_NUMBER );
+    if (std::regex_match(*LinePtr, Matches, Pattern)) {
+    	if (IsBeamTripDetected[CupIndex]){
+        	std::cout << "  Nadmiarowa definicja detekcji wyłączeń wiązki w linii: [" << *LinePtr << "]" << std::endl;
+            return FailureCodes::ERROR_SETTINGS_BEAM_TRIP;
+    	}
+    	IsBeamTripDetected[CupIndex] = true;
+		try {
+			BeamTripThreshold[CupIndex] = std::stod(Matches[1].str());
+			BeamTripMinimumDuration[CupIndex] = std::stoi(Matches[2].str());
+		}
+		catch (const std::exception&) {
+	       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_BEAM_TRIP;
+		}
+		if ((BeamTripThreshold[CupIndex] <= 0.0) || (BeamTripMinimumDuration[CupIndex] > BEAM_TRIP_MINIMUM_DURATION_MAX)){
+	       	std::cout << "  Próg musi być dodatni, a czas nie większy niż " << BEAM_TRIP_MINIMUM_DURATION_MAX << " ms w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_BEAM_TRIP;
+		}
+
+		if (VerboseMode){
+			std::cout << "  Detekcja wyłączeń wiązki w kubku " << (CupIndex+1) << ": próg " << BeamTripThreshold[CupIndex] << " uA, czas "
+					<< BeamTripMinimumDuration[CupIndex] << " ms w linii: [" << *LinePtr << "]" << std::endl;
+		}
+    }
+    return FailureCodes::NO_FAILURE;
+}
+
+/// The trigger is defined as "kubek C kanał N condition level" (the condition: powyżej, poniżej - threshold
+/// crossing; narasta, opada - slope per second) or "kubek C cewka N edge" (zbocze narastające, zbocze opadające,
+/// zbocze - any edge); the cups, the channels and the coils are counted from 1
+static FailureCodes parseTrigger( std::regex Pattern, std::string *LinePtr ){
+    std::smatch Matches;
+    if (std::regex_match(*LinePtr, Matches, Pattern)) {
+    	if (TriggersNumber >= TRIGGERS_MAX){
+        	std::cout << "  Więcej niż " << TRIGGERS_MAX << " wyzwalaczy w linii: [" << *LinePtr << "]" << std::endl;
+            return FailureCodes::ERROR_SETTINGS_TRIGGER;
+    	}
+    	TriggerDefinition * TriggerPtr = &Triggers[TriggersNumber];
+    	std::string KindText = Matches[2];
+    	std::string ConditionText = Matches[4];
+    	std::string LevelText = Matches[5];
+    	bool IsCoil = (KindText == "cewka");
+		try {
+			TriggerPtr->CupIndex = std::stoi(Matches[1].str()) - 1;
+			TriggerPtr->Channel = std::stoi(Matches[3].str()) - 1;
+			TriggerPtr->Level = LevelText.empty()? 0.0 : std::stod(LevelText);
+		}
+		catch (const std::exception&) {
+	       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_TRIGGER;
+		}
+		if ((TriggerPtr->CupIndex < 0) || (TriggerPtr->CupIndex >= PHYSICALLY_INSTALLED_CUPS) || (TriggerPtr->Channel < 0) ||
+				(TriggerPtr->Channel >= (IsCoil? MODBUS_COILS_PER_CUP : VALUES_PER_DISC)))
+		{
+	       	std::cout << "  Niewłaściwy numer kubka, kanału lub cewki w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_TRIGGER;
+		}
+
+		bool IsEdge = (0 == ConditionText.compare( 0, 6, "zbocze" ));
+		if (IsCoil != IsEdge){
+	       	std::cout << "  Warunek niezgodny z rodzajem sygnału w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_TRIGGER;
+		}
+		if (IsEdge == !LevelText.empty()){
+	       	std::cout << "  Brak lub nadmiarowa wartość progu w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_TRIGGER;
+		}
+		if (ConditionText == "powyżej"){
+			TriggerPtr->Type = TriggerTypes::RISING_THRESHOLD;
+		}
+		else if (ConditionText == "poniżej"){
+			TriggerPtr->Type = TriggerTypes::FALLING_THRESHOLD;
+		}
+		else if (ConditionText == "narasta"){
+			TriggerPtr->Type = TriggerTypes::RISING_SLOPE;
+		}
+		else if (ConditionText == "opada"){
+			TriggerPtr->Type = TriggerTypes::FALLING_SLOPE;
+		}
+		else if (ConditionText == "zbocze narastające"){
+			TriggerPtr->Type = TriggerTypes::COIL_RISING_EDGE;
+		}
+		else if (ConditionText == "zbocze opadające"){
+			TriggerPtr->Type = TriggerTypes::COIL_FALLING_EDGE;
+		}
+		else{
+			TriggerPtr->Type = TriggerTypes::COIL_ANY_EDGE;
+		}
+		if (((TriggerTypes::RISING_SLOPE == TriggerPtr->Type) || (TriggerTypes::FALLING_SLOPE == TriggerPtr->Type)) && (TriggerPtr->Level <= 0.0)){
+	       	std::cout << "  Nachylenie musi być dodatnie w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_TRIGGER;
+		}
+		TriggersNumber++;
+
+		if (VerboseMode){
+			std::cout << "  Wyzwalacz " << TriggersNumber << " w linii: [" << *LinePtr << "]" << std::endl;
+		}
+    }
+    return FailureCodes::NO_FAILURE;
+}
+
+/// The statistics windows are defined as "length[; length[; length]]" (up to STATISTICS_WINDOWS_MAX lengths)
+static FailureCodes parseStatisticsWindows( std::regex Pattern, std::string *LinePtr, bool *IsDefinedPtr ){
+    std::smatch Matches;
+    if (std::regex_match(*LinePtr, Matches, Pattern)) {
+    	if (*IsDefinedPtr){
+        	std::cout << "  Nadmiarowa deklaracja parametru w linii: [" << *LinePtr << "]" << std::endl;
+            return FailureCodes::ERROR_SETTINGS_EXCESSIVE_PARAMETER;
+    	}
+    	*IsDefinedPtr = true;
+    	StatisticsWindowsNumber = 0;
+    	for (int J=0; J < STATISTICS_WINDOWS_MAX; J++){
+    		if (!Matches[J+1].matched){
+    			break;
+    		}
+			try {
+				StatisticsWindowLength[J] = std::stoi(Matches[J+1].str());
+			}
+			catch (const std::exception&) {
+		       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+		       	return FailureCodes::ERROR_SETTINGS_IMPROPER_PARAMETER;
+			}
+			if ((StatisticsWindowLength[J] < 2) || (StatisticsWindowLength[J] > STATISTICS_WINDOW_MAX)){
+		       	std::cout << "  Wartość parametru poza przedziałem [2; " << STATISTICS_WINDOW_MAX << "] w linii: [" << *LinePtr << "]" << std::endl;
+		       	return FailureCodes::ERROR_SETTINGS_IMPROPER_PARAMETER;
+			}
+			StatisticsWindowsNumber++;
+    	}
+
+		if (VerboseMode){
+			std::cout << "  Okna statystyk: " << StatisticsWindowsNumber << " w linii: [" << *LinePtr << "]" << std::endl;
+		}
+    }
+    return FailureCodes::NO_FAILURE;
+}
+
+/// The windows of the triggered capture are given as "before; after" in milliseconds
+static FailureCodes parseCaptureWindows( std::regex Pattern, std::string *LinePtr, bool *IsDefinedPtr ){
+    std::smatch Matches;
+    if (std::regex_match(*LinePtr, Matches, Pattern)) {
+    	if (*IsDefinedPtr){
+        	std::cout << "  Nadmiarowa deklaracja parametru w linii: [" << *LinePtr << "]" << std::endl;
+            return FailureCodes::ERROR_SETTINGS_EXCESSIVE_PARAMETER;
+    	}
+    	*IsDefinedPtr = true;
+		try {
+			PreTriggerDuration = std::stoi(Matches[1].str());
+			PostTriggerDuration = std::stoi(Matches[2].str());
+		}
+		catch (const std::exception&) {
+	       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_IMPROPER_PARAMETER;
+		}
+		if ((PreTriggerDuration > CAPTURE_WINDOW_MAX) || (PostTriggerDuration > CAPTURE_WINDOW_MAX)){
+	       	std::cout << "  Wartość parametru poza przedziałem [0; " << CAPTURE_WINDOW_MAX << "] w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_IMPROPER_PARAMETER;
+		}
+
+		if (VerboseMode){
+			std::cout << "  Przechwytywanie: " << PreTriggerDuration << " ms przed, " << PostTriggerDuration << " ms po, w linii: [" << *LinePtr << "]" << std::endl;
+		}
+    }
+    return FailureCodes::NO_FAILURE;
+}
+
+/// The spectrum is defined as "length; window; segments", the length being a power of 2 (16 ... SPECTRUM_LENGTH_MAX)
+static FailureCodes parseSpectrumDefinition( std::regex Pattern, std::string *LinePtr, bool *IsDefinedPtr ){
+    std::smatch Matches;
+    if (std::regex_match(*LinePtr, Matches, Pattern)) {
+    	if (*IsDefinedPtr){
+        	std::cout << "  Nadmiarowa deklaracja parametru w linii: [" << *LinePtr << "]" << std::endl;
+            return FailureCodes::ERROR_SETTINGS_EXCESSIVE_PARAMETER;
+    	}
+    	*IsDefinedPtr = true;
+		try {
+			SpectrumLength = std::stoi(Matches[1].str());
+			SpectrumSegments = std::stoi(Matches[3].str());
+		}
+		catch (const std::exception&) {
+	       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_SPECTRUM;
+		}
+		if ((SpectrumLength < 16) || (SpectrumLength > SPECTRUM_LENGTH_MAX) || (0 != (SpectrumLength & (SpectrumLength-1))) ||
+				(SpectrumSegments < 1) || (SpectrumSegments > SPECTRUM_SEGMENTS_MAX))
+		{
+	       	std::cout << "  Długość widma musi być potęgą 2 z przedziału [16; " << SPECTRUM_LENGTH_MAX << "], liczba segmentów z przedziału [1; "
+	       			<< SPECTRUM_SEGMENTS_MAX << "] w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_SPECTRUM;
+		}
+		std::string WindowText = Matches[2];
+		if (WindowText == "prostokątne"){
+			SpectrumWindow = SpectrumWindows::RECTANGULAR;
+		}
+		else if (WindowText == "hann"){
+			SpectrumWindow = SpectrumWindows::HANN;
+		}
+		else{
+			SpectrumWindow = SpectrumWindows::BLACKMAN;
+		}
+
+		if (VerboseMode){
+			std::cout << "  Widmo: " << SpectrumLength << " próbek, okno " << WindowText << ", segmentów " << SpectrumSegments
+					<< " w linii: [" << *LinePtr << "]" << std::endl;
+		}
+    }
+    return FailureCodes::NO_FAILURE;
+}
+
+/// The alarm rule is defined as "kubek C kanał N powyżej|poniżej X" or "kubek C cewka N włączona|wyłączona",
+/// followed by the optional "; histereza H" (channels only) and "; opóźnienie D" (ms), the severity and the optional
+/// interlock "; wysuń kubek [K]" (by default the cup of the rule); the cups, the channels and the coils are counted from 1
+static FailureCodes parseAlarm( std::regex Pattern, std::string *LinePtr ){
+    std::smatch Matches;
+    if (std::regex_match(*LinePtr, Matches, Pattern)) {
+    	if (AlarmsNumber >= ALARMS_MAX){
+        	std::cout << "  Więcej niż " << ALARMS_MAX << " alarmów w linii: [" << *LinePtr << "]" << std::endl;
+            return FailureCodes::ERROR_SETTINGS_ALARM;
+    	}
+    	AlarmDefinition * AlarmPtr = &Alarms[AlarmsNumber];
+    	std::string KindText = Matches[2];
+    	std::string ConditionText = Matches[4];
+    	std::string LevelText = Matches[5];
+    	std::string HysteresisText = Matches[6];
+    	std::string DelayText = Matches[7];
+    	std::string SeverityText = Matches[8];
+    	bool IsCoil = (KindText == "cewka");
+    	bool IsInterlock = (std::string::npos != LinePtr->find( "wysuń kubek" ));
+		try {
+			AlarmPtr->CupIndex = std::stoi(Matches[1].str()) - 1;
+			AlarmPtr->Channel = std::stoi(Matches[3].str()) - 1;
+			AlarmPtr->Level = LevelText.empty()? 0.0 : std::stod(LevelText);
+			AlarmPtr->Hysteresis = HysteresisText.empty()? 0.0 : std::stod(HysteresisText);
+			AlarmPtr->Delay = DelayText.empty()? 0 : std::stoi(DelayText);
+			AlarmPtr->InterlockCupIndex = !IsInterlock? -1 : (Matches[9].matched? std::stoi(Matches[9].str()) - 1 : AlarmPtr->CupIndex);
+		}
+		catch (const std::exception&) {
+	       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_ALARM;
+		}
+		if ((AlarmPtr->CupIndex < 0) || (AlarmPtr->CupIndex >= PHYSICALLY_INSTALLED_CUPS) || (AlarmPtr->Channel < 0) ||
+				(AlarmPtr->Channel >= (IsCoil? MODBUS_COILS_PER_CUP : VALUES_PER_DISC)) ||
+				(IsInterlock && ((AlarmPtr->InterlockCupIndex < 0) || (AlarmPtr->InterlockCupIndex >= PHYSICALLY_INSTALLED_CUPS))))
+		{
+	       	std::cout << "  Niewłaściwy numer kubka, kanału lub cewki w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_ALARM;
+		}
+
+		bool IsCoilCondition = ((ConditionText == "włączona") || (ConditionText == "wyłączona"));
+		if (IsCoil != IsCoilCondition){
+	       	std::cout << "  Warunek niezgodny z rodzajem sygnału w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_ALARM;
+		}
+		if ((IsCoil == !LevelText.empty()) || (IsCoil && !HysteresisText.empty())){
+	       	std::cout << "  Brak lub nadmiarowa wartość progu lub histerezy w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_ALARM;
+		}
+		if (AlarmPtr->Delay > ALARM_DELAY_MAX){
+	       	std::cout << "  Opóźnienie alarmu poza przedziałem [0; " << ALARM_DELAY_MAX << "] w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_ALARM;
+		}
+		if (ConditionText == "powyżej"){
+			AlarmPtr->Condition = AlarmConditions::ABOVE;
+		}
+		else if (ConditionText == "poniżej"){
+			AlarmPtr->Condition = AlarmConditions::BELOW;
+		}
+		else if (ConditionText == "włączona"){
+			AlarmPtr->Condition = AlarmConditions::COIL_ON;
+		}
+		else{
+			AlarmPtr->Condition = AlarmConditions::COIL_OFF;
+		}
+		if (SeverityText == "ostrzeżenie"){
+			AlarmPtr->Severity = AlarmSeverities::WARNING;
+		}
+		else if (SeverityText == "alarm"){
+			AlarmPtr->Severity = AlarmSeverities::ALARM;
+		}
+		else{
+			AlarmPtr->Severity = AlarmSeverities::CRITICAL;
+		}
+		AlarmsNumber++;
+
+		if (VerboseMode){
+			std::cout << "  Alarm " << AlarmsNumber << " w linii: [" << *LinePtr << "]" << std::endl;
+		}
+    }
+    return FailureCodes::NO_FAILURE;
+}
+
+/// The directory of the recording files is either absolute or relative to the directory of the application
+static FailureCodes parseRecordingDirectory( std::regex Pattern, std::string *LinePtr ){
+    std::smatch Matches;
+    if (std::regex_match(*LinePtr, Matches, Pattern)) {
+    	if (!RecordingDirectory.empty()){
+        	std::cout << "  Nadmiarowa deklaracja parametru w linii: [" << *LinePtr << "]" << std::endl;
+            return FailureCodes::ERROR_SETTINGS_EXCESSIVE_PARAMETER;
+    	}
+    	RecordingDirectory = Matches[1];
+    	if ('/' != RecordingDirectory[0]){
+    		RecordingDirectory = ThisApplicationDirectory + "/" + RecordingDirectory;
+    	}
+		if (VerboseMode){
+			std::cout << "  Katalog zapisu: " << RecordingDirectory << " w linii: [" << *LinePtr << "]" << std::endl;
+		}
+    }
+    return FailureCodes::NO_FAILURE;
+}
+
+/// This function writes the current zero shifts (e.g. measured by the auto-zero) to the configuration file:
+/// the existing "Korekta zera ..." lines are replaced, the missing ones are appended at the end of the file;
+/// the file is written to a temporary file first and then renamed, so it is never left half-written
+/// @return code defined in FailureCodes
+FailureCodes saveZeroShiftsToConfigurationFile(void){
+	static const char * const CupOrdinal[CUPS_NUMBER] = { "pierwszego", "drugiego", "trzeciego" };
+	std::regex PatternAnyZeroShift(R"(\s*(?!#)Korekta zera (pierwszego|drugiego|trzeciego) kubka:.*$)");
+	std::vector<std::string> Lines;
+	bool IsWritten[CUPS_NUMBER] = {};
+	std::string Line;
+	std::smatch Matches;
+	char Text[100];
+
+	if (ConfigurationFilePath.empty()){
+		return FailureCodes::ERROR_SETTINGS_PATH;
+	}
+	std::ifstream InputFile( ConfigurationFilePath.c_str() );
+	if (!InputFile.is_open()){
+		std::cout << "Nie można otworzyć pliku: " << CONFIGURATION_FILE_NAME << std::endl;
+		return FailureCodes::ERROR_SETTINGS_OPENING_FILE;
+	}
+	while (std::getline(InputFile, Line)){
+		if (std::regex_match(Line, Matches, PatternAnyZeroShift)){
+			for (int J=0; J < CUPS_NUMBER; J++){
+				if (Matches[1].str() == CupOrdinal[J]){
+					if (IsWritten[J]){
+						Line.clear();		// there must not be two definitions for one cup
+					}
+					else{
+						snprintf( Text, sizeof(Text), "Korekta zera %s kubka: %.2f", CupOrdinal[J], ZeroShift[J] );
+						Line = Text;
+						IsWritten[J] = true;
+					}
+				}
+			}
+		}
+		Lines.push_back( Line );
+	}
+	InputFile.close();
+	for (int J=0; J < CUPS_NUMBER; J++){
+		if (!IsWritten[J]){
+			snprintf( Text, sizeof(Text), "Korekta zera %s kubka: %.2f", CupOrdinal[J], ZeroShift[J] );
+			Lines.push_back( Text );
+		}
+	}
+
+	std::string TemporaryPath = ConfigurationFilePath + ".tmp";
+	std::ofstream OutputFile( TemporaryPath.c_str(), std::ios::trunc );
+	if (!OutputFile.is_open()){
+		std::cout << "Nie można zapisać pliku: " << TemporaryPath << std::endl;
+		return FailureCodes::ERROR_SETTINGS_SAVING_FILE;
+	}
+	for (const std::string & OutputLine : Lines){
+		OutputFile << OutputLine << "\n";
+	}
+	OutputFile.flush();
+	if (!OutputFile.good()){
+		OutputFile.close();
+		std::remove( TemporaryPath.c_str() );
+		std::cout << "Nie można zapisać pliku: " << TemporaryPath << std::endl;
+		return FailureCodes::ERROR_SETTINGS_SAVING_FILE;
+	}
+	OutputFile.close();
+	if (0 != std::rename( TemporaryPath.c_str(), ConfigurationFilePath.c_str() )){
+		std::remove( TemporaryPath.c_str() );
+		std::cout << "Nie można zastąpić pliku: " << CONFIGURATION_FILE_NAME << std::endl;
+		return FailureCodes::ERROR_SETTINGS_SAVING_FILE;
+	}
+	if (VerboseMode){
+		std::cout << "Zapisano korekty zera w pliku: " << CONFIGURATION_FILE_NAME << std::endl;
+	}
+	return FailureCodes::NO_FAILURE;
+}
+
+/// This function parses a line with an integer parameter (the first group of the pattern) that may occur
+/// at most once in the configuration file and must lie in the range [LowerLimit; UpperLimit]
+static FailureCodes parseIntegerParameter( std::regex Pattern, std::string *LinePtr, int *ValuePtr, bool *IsDefinedPtr,
+		int LowerLimit, int UpperLimit )
+{
+    std::smatch Matches;
+    if (std::regex_match(*LinePtr, Matches, Pattern)) {
+    	if (*IsDefinedPtr){
+        	std::cout << "  Nadmiarowa deklaracja parametru w linii: [" << *LinePtr << "]" << std::endl;
+            return FailureCodes::ERROR_SETTINGS_EXCESSIVE_PARAMETER;
+    	}
+    	*IsDefinedPtr = true;
+
+    	std::string ValueText = Matches[1];
+		try {
+			*ValuePtr = std::stoi(ValueText, nullptr, 0);
+		}
+		catch (const std::invalid_argument&) {
+	       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_IMPROPER_PARAMETER;
+		}
+		catch (const std::out_of_range&) {
+	       	std::cout << "  Błąd konwersji na liczbę (patrz " << __LINE__ << ")" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_IMPROPER_PARAMETER;
+		}
+		if ((*ValuePtr < LowerLimit) || (*ValuePtr > UpperLimit)){
+	       	std::cout << "  Wartość parametru poza przedziałem [" << LowerLimit << "; " << UpperLimit << "] w linii: [" << *LinePtr << "]" << std::endl;
+	       	return FailureCodes::ERROR_SETTINGS_IMPROPER_PARAMETER;
+		}
+
+		if (VerboseMode){
+			std::cout << "  Parametr: " << *ValuePtr << " w linii: [" << *LinePtr << "]" << std::endl;
+		}
+    }
+    return FailureCodes::NO_FAILURE;
+}
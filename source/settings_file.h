@@ -6,6 +6,117 @@
 #include <string>
 #include "config.h"
 
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define CALIBRATION_POLYNOMIAL_MAX_DEGREE	5
+#define CALIBRATION_TABLE_MAX_POINTS		64
+
+#define STATISTICS_WINDOW_MAX				1200	// samples
+#define STATISTICS_WINDOW_DEFAULT			20		// samples
+
+#define FILTER_WINDOW_MAX					200		// samples; moving average and median
+
+#define TRANSMISSION_SMOOTHING_MAX			1000	// samples
+#define TRANSMISSION_SMOOTHING_DEFAULT		10		// samples
+
+#define AUTO_ZERO_SAMPLES_MAX				1200	// samples (frames)
+#define AUTO_ZERO_SAMPLES_DEFAULT			40		// samples (frames)
+
+#define BEAM_TRIP_MINIMUM_DURATION_MAX		60000	// milliseconds
+#define SHIFT_START_HOUR_DEFAULT			6		// the shifts last 8 hours: 6:00, 14:00, 22:00
+
+#define TRIGGERS_MAX						8
+#define CAPTURE_WINDOW_MAX					600000	// milliseconds; limited also by the capacity of the history
+#define CAPTURE_WINDOW_DEFAULT				5000	// milliseconds
+
+#define SPECTRUM_LENGTH_MAX					4096	// samples, power of 2
+#define SPECTRUM_LENGTH_DEFAULT				256
+#define SPECTRUM_SEGMENTS_MAX				32
+#define SPECTRUM_SEGMENTS_DEFAULT			4
+#define BURST_DURATION_MAX					60000	// milliseconds
+#define BURST_DURATION_DEFAULT				10000	// milliseconds
+
+#define RECORDING_FULL_DATA_DAYS_MAX		3650	// days
+#define RECORDING_SIZE_LIMIT_MAX			16000000	// MB
+
+#define ALARMS_MAX							16
+#define ALARM_DELAY_MAX						60000	// milliseconds
+
+#define CHANNEL_NAME_MAX_LENGTH				40
+#define CHANNEL_UNIT_MAX_LENGTH				10
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+enum class CalibrationModels
+{
+	LINEAR,				// I = DirectionalCoefficient*(x + OffsetForZeroCurrent)
+	POLYNOMIAL,			// I = a0 + a1*x + a2*x^2 + ...
+	PIECEWISE_LINEAR,	// interpolation between the points of a calibration table
+};
+
+enum class FilterTypes
+{
+	NONE,
+	MOVING_AVERAGE,		// mean of the last FilterLength samples
+	EXPONENTIAL,		// y += FilterCoefficient*(x - y)
+	MEDIAN,				// median of the last FilterLength samples
+};
+
+enum class TriggerTypes
+{
+	RISING_THRESHOLD,	// the channel crosses Level upwards
+	FALLING_THRESHOLD,	// the channel crosses Level downwards
+	RISING_SLOPE,		// the channel grows faster than Level per second
+	FALLING_SLOPE,		// the channel falls faster than Level per second
+	COIL_RISING_EDGE,
+	COIL_FALLING_EDGE,
+	COIL_ANY_EDGE,
+};
+
+enum class SpectrumWindows
+{
+	RECTANGULAR,
+	HANN,
+	BLACKMAN,
+};
+
+enum class AlarmConditions
+{
+	ABOVE,				// the channel is above Level; cleared below Level - Hysteresis
+	BELOW,				// the channel is below Level; cleared above Level + Hysteresis
+	COIL_ON,
+	COIL_OFF,
+};
+
+enum class AlarmSeverities
+{
+	WARNING,
+	ALARM,
+	CRITICAL,
+};
+
+struct TriggerDefinition {
+	TriggerTypes Type;
+	int CupIndex;
+	int Channel;		// register (see getChannelValue) or coil of the cup, counted from 0
+	double Level;
+};
+
+struct AlarmDefinition {
+	AlarmConditions Condition;
+	int CupIndex;
+	int Channel;		// register (see getChannelValue) or coil of the cup, counted from 0
+	double Level;
+	double Hysteresis;
+	int Delay;			// milliseconds; the condition must last so long to raise the alarm
+	AlarmSeverities Severity;
+	int InterlockCupIndex;	// the cup removed when the alarm is raised; -1 if none
+};
+
 //.................................................................................................
 // Global variables
 //.................................................................................................
@@ -16,12 +127,86 @@ extern double DirectionalCoefficient[CUPS_NUMBER];
 
 extern int OffsetForZeroCurrent[CUPS_NUMBER];
 
+extern CalibrationModels CalibrationModel[CUPS_NUMBER];
+
+extern int PolynomialDegree[CUPS_NUMBER];
+
+extern double PolynomialCoefficient[CUPS_NUMBER][CALIBRATION_POLYNOMIAL_MAX_DEGREE+1];
+
+extern int CalibrationPointsNumber[CUPS_NUMBER];
+
+extern int CalibrationPointRegister[CUPS_NUMBER][CALIBRATION_TABLE_MAX_POINTS];
+
+extern double CalibrationPointCurrent[CUPS_NUMBER][CALIBRATION_TABLE_MAX_POINTS];
+
 extern char CupDescriptionPtr[CUPS_NUMBER][101];
 
 extern std::string ThisApplicationDirectory;
 
 extern int MaximumPropagationTime;
 
+extern int StatisticsWindowLength[STATISTICS_WINDOWS_MAX];
+
+extern int StatisticsWindowsNumber;
+
+extern int HistoryBufferCapacity;
+
+extern FilterTypes FilterType[CUPS_NUMBER];
+
+extern int FilterLength[CUPS_NUMBER];
+
+extern double FilterCoefficient[CUPS_NUMBER];
+
+extern bool IsTransmissionMeasured[CUPS_NUMBER][CUPS_NUMBER];
+
+extern int TransmissionSmoothing;
+
+extern double ZeroShift[CUPS_NUMBER];
+
+extern int AutoZeroSamplesNumber;
+
+extern char ChannelName[CUPS_NUMBER][VALUES_PER_DISC][CHANNEL_NAME_MAX_LENGTH+1];
+
+extern char ChannelUnit[CUPS_NUMBER][VALUES_PER_DISC][CHANNEL_UNIT_MAX_LENGTH+1];
+
+extern double DiagnosticGain[CUPS_NUMBER][DIAGNOSTIC_VALUES_PER_DISC];
+
+extern double DiagnosticOffset[CUPS_NUMBER][DIAGNOSTIC_VALUES_PER_DISC];
+
+extern bool IsBeamTripDetected[CUPS_NUMBER];
+
+extern double BeamTripThreshold[CUPS_NUMBER];
+
+extern int BeamTripMinimumDuration[CUPS_NUMBER];
+
+extern int ShiftStartHour;
+
+extern int TriggersNumber;
+
+extern TriggerDefinition Triggers[TRIGGERS_MAX];
+
+extern int PreTriggerDuration;
+
+extern int PostTriggerDuration;
+
+extern int SpectrumLength;
+
+extern SpectrumWindows SpectrumWindow;
+
+extern int SpectrumSegments;
+
+extern int BurstDuration;
+
+extern int AlarmsNumber;
+
+extern AlarmDefinition Alarms[ALARMS_MAX];
+
+extern std::string RecordingDirectory;
+
+extern int RecordingFullDataDays;
+
+extern int RecordingSizeLimit;
+
 //.................................................................................................
 // Global function prototypes
 //.................................................................................................
@@ -30,4 +215,6 @@ FailureCodes determineApplicationPath( char* Argv0 );
 
 FailureCodes configurationFileParsing(void);
 
+FailureCodes saveZeroShiftsToConfigurationFile(void);
+
 #endif // SOURCE_SETTINGS_FILE_H_
@@ -1,12 +1,29 @@
 /// @file shared_data.cpp
 
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
 #include "shared_data.h"
 
-/// The input values obtained from Modbus
-std::atomic<uint16_t> ModbusInputRegisters[MODBUS_INPUTS_NUMBER];
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+// the resolutions of the display (see formatCharge() and CupGuiGroup::refreshData() in gui_widgets.cpp)
+#define CHARGE_RESOLUTION_BELOW_MICROCOULOMB	1.0e-4	// uC; 0.1 nC
+#define CHARGE_RESOLUTION						1.0e-3	// uC
+#define INTEGRATION_TIME_RESOLUTION				1.0		// s
+#define BEAM_TRIP_RATE_RESOLUTION				0.1		// trips per hour
 
-/// The coil values obtained from Modbus
-std::atomic<bool> ModbusCoilsReadout[MODBUS_COILS_NUMBER];
+//.................................................................................................
+// Global variables
+//.................................................................................................
+
+/// The frame assembled by the peripheral thread (Modbus readouts are written here);
+/// no other thread may access it, the other threads use readAcquisitionFrame()
+AcquisitionFrame AcquisitionWorkingFrame;
 
 /// The coil values required by the user (one coil per cup)
 std::atomic<bool> ModbusCoilRequestedValue[CUPS_NUMBER];
@@ -16,8 +33,151 @@ std::atomic<bool> ModbusCoilChangeReqest[CUPS_NUMBER];
 
 /// @brief This is the time when the user requested the cup to be inserted/removed
 /// There is a need to measure the time it takes to send a command to the slave, physically execute it,
-/// and receive feedback from the limit switches
-std::chrono::high_resolution_clock::time_point CupInsertionOrRemovalStartTime[CUPS_NUMBER];
+/// and receive feedback from the limit switches; set by the GUI thread (a click) or by the peripheral thread (an interlock)
+std::atomic<std::chrono::high_resolution_clock::time_point> CupInsertionOrRemovalStartTime[CUPS_NUMBER];
 
 /// Flag set in a peripheral thread and read in the GUI handler
 std::atomic<bool> DisplayLimitSwitchError[CUPS_NUMBER];
+
+/// Flag set by the GUI (the user wants to zero the charge counter) and cleared by the peripheral thread
+std::atomic<bool> ChargeResetRequest[CUPS_NUMBER];
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+static_assert( std::is_trivially_copyable<AcquisitionFrame>::value, "AcquisitionFrame is copied with memcpy" );
+
+/// The last frame published by the peripheral thread; protected by PublishedFrameSequence (seqlock)
+static AcquisitionFrame PublishedFrame;
+
+/// Odd value means that the peripheral thread is just overwriting PublishedFrame
+static std::atomic<uint64_t> PublishedFrameSequence;
+
+/// Statistics of change detection: all cup readouts of the registers and readouts identical to the previous ones
+static std::atomic<uint64_t> CupReadoutsCounter;
+static std::atomic<uint64_t> UnchangedCupReadoutsCounter;
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static void detectChanges( const AcquisitionFrame * PreviousFramePtr, AcquisitionFrame * FramePtr );
+
+static bool isDerivedDataChanged( const CupDerivedData * PreviousPtr, const CupDerivedData * DerivedPtr );
+
+static double quantizeValue( double Value, double Resolution );
+
+static double quantizeCharge( double Charge );
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+/// This function sets the "no data" state (registers 0xFFFF, coils off) and publishes it
+void initializeSharedData(void){
+	AcquisitionWorkingFrame = AcquisitionFrame();
+	for (int J=0; J < MODBUS_INPUTS_NUMBER; J++){
+		AcquisitionWorkingFrame.InputRegisters[J] = 0xFFFF;
+	}
+	std::chrono::high_resolution_clock::time_point TimeNow = std::chrono::high_resolution_clock::now();
+	AcquisitionWorkingFrame.RegistersTime = TimeNow;
+	AcquisitionWorkingFrame.CoilsTime = TimeNow;
+	atomic_store_explicit( &PublishedFrameSequence, 0, std::memory_order_release );
+	publishAcquisitionFrame();
+}
+
+/// This function is called by the peripheral thread (the only writer) at the end of each cycle;
+/// it copies AcquisitionWorkingFrame to the place visible to the readers
+void publishAcquisitionFrame(void){
+	uint64_t Sequence = atomic_load_explicit( &PublishedFrameSequence, std::memory_order_relaxed );
+	AcquisitionWorkingFrame.FrameNumber++;
+	detectChanges( &PublishedFrame, &AcquisitionWorkingFrame );
+
+	atomic_store_explicit( &PublishedFrameSequence, Sequence+1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	memcpy( &PublishedFrame, &AcquisitionWorkingFrame, sizeof(PublishedFrame) );
+	atomic_store_explicit( &PublishedFrameSequence, Sequence+2, std::memory_order_release );
+}
+
+/// This function copies the last published frame; the copy is never a mixture of two frames
+/// (the copying is repeated in the rare case when the writer interferes)
+/// @return the number of the frame
+uint64_t readAcquisitionFrame( AcquisitionFrame * FramePtr ){
+	uint64_t SequenceBefore, SequenceAfter;
+	do{
+		SequenceBefore = atomic_load_explicit( &PublishedFrameSequence, std::memory_order_acquire );
+		memcpy( FramePtr, &PublishedFrame, sizeof(PublishedFrame) );
+		std::atomic_thread_fence( std::memory_order_acquire );
+		SequenceAfter = atomic_load_explicit( &PublishedFrameSequence, std::memory_order_relaxed );
+	} while ((0 != (SequenceBefore & 1)) || (SequenceBefore != SequenceAfter));
+	return FramePtr->FrameNumber;
+}
+
+/// @return the percentage of cup readouts (cycles with the registers read) that did not differ from the previous ones
+/// (the skipped work)
+double getUnchangedCupReadoutsPercentage(void){
+	uint64_t AllReadouts = atomic_load_explicit( &CupReadoutsCounter, std::memory_order_relaxed );
+	if (0 == AllReadouts){
+		return 0.0;
+	}
+	return (100.0 * atomic_load_explicit( &UnchangedCupReadoutsCounter, std::memory_order_relaxed )) / (double)AllReadouts;
+}
+
+/// This function compares the new frame with the previous one and fills in the change masks,
+/// so the consumers (GUI, loggers, alarms) can skip the cups and fields that did not change
+static void detectChanges( const AcquisitionFrame * PreviousFramePtr, AcquisitionFrame * FramePtr ){
+	bool IsTransmissionChanged =
+			(0 != ((PreviousFramePtr->QualityFlags ^ FramePtr->QualityFlags) & FRAME_QUALITY_TRANSMISSION_CORRECT));
+	// the cycles in which only the coils were read would repeat the registers and inflate the statistics
+	bool IsRegistersReadout = (0 != (FramePtr->QualityFlags & FRAME_QUALITY_REGISTERS_UPDATED));
+
+	for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+		uint16_t ChangeMask = IsTransmissionChanged? CHANGE_MASK_TRANSMISSION : 0;
+		for (int J=0; J < MODBUS_INPUTS_PER_CUP; J++){
+			if (PreviousFramePtr->InputRegisters[Cup*MODBUS_INPUTS_PER_CUP+J] != FramePtr->InputRegisters[Cup*MODBUS_INPUTS_PER_CUP+J]){
+				ChangeMask |= CHANGE_MASK_REGISTER(J);
+			}
+		}
+		for (int J=0; J < MODBUS_COILS_PER_CUP; J++){
+			if (PreviousFramePtr->Coils[Cup*MODBUS_COILS_PER_CUP+J] != FramePtr->Coils[Cup*MODBUS_COILS_PER_CUP+J]){
+				ChangeMask |= CHANGE_MASK_COIL(J);
+			}
+		}
+		if (isDerivedDataChanged( &PreviousFramePtr->Derived[Cup], &FramePtr->Derived[Cup] )){
+			ChangeMask |= CHANGE_MASK_DERIVED;
+		}
+		FramePtr->CupChangeMask[Cup] = ChangeMask;
+		if (0 != ChangeMask){
+			FramePtr->CupLastChangeFrame[Cup] = FramePtr->FrameNumber;
+		}
+		if (IsRegistersReadout){
+			if (0 == ChangeMask){
+				atomic_fetch_add_explicit( &UnchangedCupReadoutsCounter, 1, std::memory_order_relaxed );
+			}
+			atomic_fetch_add_explicit( &CupReadoutsCounter, 1, std::memory_order_relaxed );
+		}
+	}
+}
+
+/// The integrated charge and time change with every sample, the trip rate of the shift with every frame;
+/// they count as changed only when the displayed text changes, so the frames with the same registers do not make
+/// the consumers of the mask do their work again
+static bool isDerivedDataChanged( const CupDerivedData * PreviousPtr, const CupDerivedData * DerivedPtr ){
+	return (0 != memcmp( PreviousPtr, DerivedPtr, offsetof(CupDerivedData, Charge) )) ||
+			(quantizeCharge( PreviousPtr->Charge ) != quantizeCharge( DerivedPtr->Charge )) ||
+			(quantizeValue( PreviousPtr->ChargeIntegrationTime, INTEGRATION_TIME_RESOLUTION ) !=
+			quantizeValue( DerivedPtr->ChargeIntegrationTime, INTEGRATION_TIME_RESOLUTION )) ||
+			(quantizeValue( PreviousPtr->ShiftBeamTripRate, BEAM_TRIP_RATE_RESOLUTION ) !=
+			quantizeValue( DerivedPtr->ShiftBeamTripRate, BEAM_TRIP_RATE_RESOLUTION ));
+}
+
+/// @return the value rounded as printed (to the nearest even multiple in the case of a tie)
+static double quantizeValue( double Value, double Resolution ){
+	return std::nearbyint( Value / Resolution ) * Resolution;
+}
+
+/// The charge is displayed in nC below 1 uC and in uC above
+static double quantizeCharge( double Charge ){
+	return quantizeValue( Charge, (fabs( Charge ) < 1.0)? CHARGE_RESOLUTION_BELOW_MICROCOULOMB : CHARGE_RESOLUTION );
+}
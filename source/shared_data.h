@@ -5,24 +5,107 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 
 #include "config.h"
 #include "modbus_addresses.h"
 
 //.................................................................................................
-// Global variables
+// Preprocessor directives
+//.................................................................................................
+
+#define FRAME_QUALITY_REGISTERS_VALID		0x01	// the registers have been read at least once
+#define FRAME_QUALITY_COILS_VALID			0x02	// the coils have been read at least once
+#define FRAME_QUALITY_REGISTERS_UPDATED		0x04	// the registers were read in the cycle that published the frame
+#define FRAME_QUALITY_COILS_UPDATED			0x08	// the coils were read in the cycle that published the frame
+#define FRAME_QUALITY_TRANSMISSION_CORRECT	0x10	// see isTransmissionCorrect()
+
+// bits of AcquisitionFrame::CupChangeMask[]
+#define CHANGE_MASK_REGISTER(Index)			(1u << (Index))							// Index < MODBUS_INPUTS_PER_CUP
+#define CHANGE_MASK_COIL(Index)				(1u << (MODBUS_INPUTS_PER_CUP+(Index)))	// Index < MODBUS_COILS_PER_CUP
+#define CHANGE_MASK_TRANSMISSION			(1u << (MODBUS_INPUTS_PER_CUP+MODBUS_COILS_PER_CUP))
+#define CHANGE_MASK_DERIVED					(1u << (MODBUS_INPUTS_PER_CUP+MODBUS_COILS_PER_CUP+1))	// see CupDerivedData
+#define CHANGE_MASK_ALL_REGISTERS			(CHANGE_MASK_REGISTER(MODBUS_INPUTS_PER_CUP)-1)
+static_assert( MODBUS_INPUTS_PER_CUP+MODBUS_COILS_PER_CUP+1 < 16 );
+
 //.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+/// Statistics of a channel over the last StatisticsWindowLength[] valid samples (one of the windows)
+struct ChannelStatistics {
+	float Mean;
+	float StandardDeviation;
+	float Minimum;
+	float Maximum;
+	uint32_t SamplesNumber;		// 0 means no statistics (e.g. the cup is removed)
+};
+
+/// Quantities computed from the readouts of a cup by the peripheral thread (see signal_processing.cpp);
+/// the structure contains no padding, so it can be compared with memcmp (up to Charge, see detectChanges())
+struct CupDerivedData {
+	float Currents[VISIBLE_VALUES_PER_DISC];	// uA; NaN if not available
+	float FilteredCurrents[VISIBLE_VALUES_PER_DISC];	// uA, after the filter defined in the configuration file;
+												// NaN while the cup is removed
+	ChannelStatistics Statistics[VISIBLE_VALUES_PER_DISC][STATISTICS_WINDOWS_MAX];	// SamplesNumber 0 if not configured
+	float Diagnostics[DIAGNOSTIC_VALUES_PER_DISC];	// the registers after the currents, scaled (see DiagnosticGain[]);
+													// NaN if not available
+	ChannelStatistics DiagnosticStatistics[DIAGNOSTIC_VALUES_PER_DISC][STATISTICS_WINDOWS_MAX];
+	uint32_t IsChargeIntegrated;		// 0 when the integrator is frozen (the cup is removed)
+	float TotalCurrent;					// uA; the sum of the filtered currents of the circle and the rings
+	float InnerToOuterRatio;			// inner circle / outer ring; NaN if the outer ring current is too small
+	float HaloFraction;					// outer ring / total; NaN if the total current is too small
+	float TransmissionFrom[CUPS_NUMBER];	// smoothed ratio of the total current of this cup to that of the upstream cup;
+										// NaN if not configured or not valid (e.g. one of the cups is removed)
+	uint32_t BeamTripsNumber;			// beam trips detected since the start of the application (see beam_trips.cpp)
+	uint32_t ShiftBeamTripsNumber;		// beam trips in the current shift
+	uint32_t IsBeamTripped;				// 1 while the total current is below the trip threshold
+	uint32_t ActiveAlarmsMask;			// bit J is set while Alarms[J] (a rule of this cup) is active (see alarms.cpp)
+	// the quantities growing with time, compared at the resolution of the display
+	float Charge;						// uC delivered to the cup since the insertion (or the reset)
+	float ChargeIntegrationTime;		// s; the time covered by the integration (gaps and invalid samples excluded)
+	float ShiftBeamTripRate;			// beam trips per hour in the current shift (per one hour during its first hour)
+};
 
-extern std::atomic<uint16_t> ModbusInputRegisters[MODBUS_INPUTS_NUMBER];
+/// A complete and consistent picture of the slave, published by the peripheral thread once per cycle
+struct AcquisitionFrame {
+	uint64_t FrameNumber;
+	std::chrono::high_resolution_clock::time_point RegistersTime;
+	std::chrono::high_resolution_clock::time_point CoilsTime;
+	uint16_t InputRegisters[MODBUS_INPUTS_NUMBER];
+	bool Coils[MODBUS_COILS_NUMBER];
+	uint8_t QualityFlags;
+	uint16_t CupChangeMask[CUPS_NUMBER];		// what has changed since the previous frame
+	uint64_t CupLastChangeFrame[CUPS_NUMBER];	// FrameNumber of the last frame with non-zero CupChangeMask[]
+	CupDerivedData Derived[CUPS_NUMBER];
+};
+
+//.................................................................................................
+// Global variables
+//.................................................................................................
 
-extern std::atomic<bool> ModbusCoilsReadout[MODBUS_COILS_NUMBER];
+extern AcquisitionFrame AcquisitionWorkingFrame;
 
 extern std::atomic<bool> ModbusCoilRequestedValue[CUPS_NUMBER];
 
 extern std::atomic<bool> ModbusCoilChangeReqest[CUPS_NUMBER];
 
-extern std::chrono::high_resolution_clock::time_point CupInsertionOrRemovalStartTime[CUPS_NUMBER];
+extern std::atomic<std::chrono::high_resolution_clock::time_point> CupInsertionOrRemovalStartTime[CUPS_NUMBER];
 
 extern std::atomic<bool> DisplayLimitSwitchError[CUPS_NUMBER];
 
+extern std::atomic<bool> ChargeResetRequest[CUPS_NUMBER];
+
+//.................................................................................................
+// Function prototypes
+//.................................................................................................
+
+void initializeSharedData(void);
+
+void publishAcquisitionFrame(void);
+
+uint64_t readAcquisitionFrame( AcquisitionFrame * FramePtr );
+
+double getUnchangedCupReadoutsPercentage(void);
+
 #endif // SOURCE_SHARED_DATA_H_
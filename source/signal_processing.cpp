@@ -0,0 +1,557 @@
+/// @file signal_processing.cpp
+///
+/// Processing of the readouts in the peripheral thread: conversion to currents, filters, statistics
+/// the charge counters, the beam focus metrics and the transmission between the cups;
+/// the results are stored in AcquisitionFrame::Derived[] before the frame is published.
+/// All the buffers are static, so the processing never allocates memory.
+
+#include <cmath>
+#include <limits>
+#include <cassert>
+
+#include "signal_processing.h"
+#include "current_conversion.h"
+#include "settings_file.h"
+#include "auto_zero.h"
+#include "beam_trips.h"
+#include "alarms.h"
+#include "actuator_timing.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define STATISTICS_BUFFER_SIZE		STATISTICS_WINDOW_MAX
+
+#define CHARGE_INTEGRATION_MAX_GAP	1000	// milliseconds; longer intervals between samples are not integrated
+
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+/// @brief Sliding window statistics with O(1) cost per sample
+/// Mean and variance are updated with Welford's method (adding the new sample and removing the oldest one);
+/// they are recomputed from the window once per window length to stop the rounding errors from accumulating.
+/// Minimum and maximum are kept in monotonic queues (ascending for the minimum, descending for the maximum).
+struct SlidingStatistics {
+	int WindowLength;			// samples; one of StatisticsWindowLength[]
+	float Samples[STATISTICS_BUFFER_SIZE];
+	uint64_t SamplesCounter;	// all samples added since the reset
+	int SamplesNumber;			// samples in the window
+	double Mean;
+	double SquaredDeviations;	// sum of squared deviations from the mean
+	int SamplesToRecalculation;
+
+	uint64_t MinimumQueue[STATISTICS_BUFFER_SIZE];	// sample numbers (SamplesCounter)
+	int MinimumQueueFront, MinimumQueueLength;
+	uint64_t MaximumQueue[STATISTICS_BUFFER_SIZE];
+	int MaximumQueueFront, MaximumQueueLength;
+};
+
+/// The state of the filter of one current (the filter type and parameters are common to the cup)
+struct CurrentFilter {
+	float Samples[FILTER_WINDOW_MAX];		// the last samples in the order of arrival
+	float SortedSamples[FILTER_WINDOW_MAX];	// the same samples in ascending order (median only)
+	int SamplesNumber;
+	int NextIndex;
+	double Sum;								// moving average only
+	int SamplesToRecalculation;
+	float Output;							// NaN until the first valid sample
+};
+
+/// The integrator of the total current of a cup (the sum of the currents of the circle and the rings)
+struct ChargeIntegrator {
+	double Charge;				// uC
+	double IntegrationTime;		// s
+	bool IsRunning;
+	bool WasCupInserted;
+	bool IsPreviousSampleValid;
+	double PreviousCurrent;		// uA
+	std::chrono::high_resolution_clock::time_point PreviousTime;
+};
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+static SlidingStatistics CurrentStatistics[CUPS_NUMBER][VISIBLE_VALUES_PER_DISC][STATISTICS_WINDOWS_MAX];
+
+static CurrentFilter CurrentFilters[CUPS_NUMBER][VISIBLE_VALUES_PER_DISC];
+
+static SlidingStatistics DiagnosticStatistics[CUPS_NUMBER][DIAGNOSTIC_VALUES_PER_DISC][STATISTICS_WINDOWS_MAX];
+
+static ChargeIntegrator ChargeIntegrators[CUPS_NUMBER];
+
+/// The smoothed transmission from the upstream cup [U] to the downstream cup [D]; NaN when the smoothing restarts
+static double SmoothedTransmission[CUPS_NUMBER][CUPS_NUMBER];
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static void resetStatistics( SlidingStatistics * StatisticsPtr );
+
+static void resetChannelStatistics( SlidingStatistics * StatisticsPtr );
+
+static void addSampleToChannelStatistics( SlidingStatistics * StatisticsPtr, float Sample, ChannelStatistics * ResultPtr );
+
+static void addSampleToStatistics( SlidingStatistics * StatisticsPtr, float Sample );
+
+static void recalculateStatistics( SlidingStatistics * StatisticsPtr );
+
+static void getStatistics( const SlidingStatistics * StatisticsPtr, ChannelStatistics * ResultPtr );
+
+static void resetFilter( CurrentFilter * FilterPtr );
+
+static float filterSample( int CupIndex, CurrentFilter * FilterPtr, float Sample );
+
+static void resetChargeIntegrator( ChargeIntegrator * IntegratorPtr );
+
+static void integrateCharge( ChargeIntegrator * IntegratorPtr, const AcquisitionFrame * FramePtr, int CupIndex );
+
+static void calculateFocusMetrics( CupDerivedData * DerivedPtr );
+
+static void calculateTransmissions( AcquisitionFrame * FramePtr );
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+void initializeSignalProcessing(void){
+	for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+		for (int J=0; J < VISIBLE_VALUES_PER_DISC; J++){
+			for (int W=0; W < STATISTICS_WINDOWS_MAX; W++){
+				CurrentStatistics[Cup][J][W].WindowLength = StatisticsWindowLength[W];
+			}
+			resetChannelStatistics( CurrentStatistics[Cup][J] );
+			resetFilter( &CurrentFilters[Cup][J] );
+		}
+		for (int J=0; J < DIAGNOSTIC_VALUES_PER_DISC; J++){
+			for (int W=0; W < STATISTICS_WINDOWS_MAX; W++){
+				DiagnosticStatistics[Cup][J][W].WindowLength = StatisticsWindowLength[W];
+			}
+			resetChannelStatistics( DiagnosticStatistics[Cup][J] );
+		}
+		resetChargeIntegrator( &ChargeIntegrators[Cup] );
+		ChargeIntegrators[Cup].IsRunning = false;
+		ChargeIntegrators[Cup].WasCupInserted = false;
+		for (int J=0; J < CUPS_NUMBER; J++){
+			SmoothedTransmission[Cup][J] = std::numeric_limits<double>::quiet_NaN();
+		}
+	}
+}
+
+/// This function is called by the peripheral thread before the frame is published
+void processAcquisitionFrame( AcquisitionFrame * FramePtr ){
+	measureActuatorTravel( FramePtr );
+
+	if (0 == (FramePtr->QualityFlags & FRAME_QUALITY_REGISTERS_UPDATED)){
+		evaluateAlarms( FramePtr );		// the rules on the coils
+		return;
+	}
+
+	processAutoZero( FramePtr );
+
+	for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+		CupDerivedData * DerivedPtr = &FramePtr->Derived[Cup];
+		bool IsCupInserted = FramePtr->Coils[COIL_OFFSET_IS_SWITCH_PRESSED + Cup*MODBUS_COILS_PER_CUP];
+
+		convertRegistersToCurrents( Cup, &FramePtr->InputRegisters[Cup*MODBUS_INPUTS_PER_CUP], DerivedPtr->Currents,
+				VISIBLE_VALUES_PER_DISC );
+
+		for (int J=0; J < VISIBLE_VALUES_PER_DISC; J++){
+			if (!IsCupInserted){
+				// the filter starts from the first sample after the insertion
+				resetChannelStatistics( CurrentStatistics[Cup][J] );
+				resetFilter( &CurrentFilters[Cup][J] );
+				addSampleToChannelStatistics( CurrentStatistics[Cup][J], std::numeric_limits<float>::quiet_NaN(),
+						DerivedPtr->Statistics[J] );
+				DerivedPtr->FilteredCurrents[J] = std::numeric_limits<float>::quiet_NaN();
+				continue;
+			}
+			addSampleToChannelStatistics( CurrentStatistics[Cup][J], DerivedPtr->Currents[J], DerivedPtr->Statistics[J] );
+			DerivedPtr->FilteredCurrents[J] = filterSample( Cup, &CurrentFilters[Cup][J], DerivedPtr->Currents[J] );
+		}
+
+		// the diagnostic channels do not depend on the position of the cup, so their statistics are not reset;
+		// the register values 0x8000 and above mean "N/A", as for the currents
+		for (int J=0; J < DIAGNOSTIC_VALUES_PER_DISC; J++){
+			uint16_t RegisterValue = FramePtr->InputRegisters[Cup*MODBUS_INPUTS_PER_CUP + VISIBLE_VALUES_PER_DISC + J];
+			DerivedPtr->Diagnostics[J] = (RegisterValue < CONVERSION_TABLE_SIZE)?
+					(float)(DiagnosticGain[Cup][J] * RegisterValue + DiagnosticOffset[Cup][J]) : std::numeric_limits<float>::quiet_NaN();
+			addSampleToChannelStatistics( DiagnosticStatistics[Cup][J], DerivedPtr->Diagnostics[J],
+					DerivedPtr->DiagnosticStatistics[J] );
+		}
+
+		integrateCharge( &ChargeIntegrators[Cup], FramePtr, Cup );
+		DerivedPtr->Charge = (float)ChargeIntegrators[Cup].Charge;
+		DerivedPtr->ChargeIntegrationTime = (float)ChargeIntegrators[Cup].IntegrationTime;
+		DerivedPtr->IsChargeIntegrated = ChargeIntegrators[Cup].IsRunning? 1 : 0;
+
+		calculateFocusMetrics( DerivedPtr );
+	}
+
+	detectBeamTrips( FramePtr );
+	calculateTransmissions( FramePtr );
+	evaluateAlarms( FramePtr );
+}
+
+/// The channels of a cup are numbered as its registers: the currents first, then the diagnostic channels
+/// @return the current in uA (before the filter) or the scaled diagnostic value
+float getChannelValue( const AcquisitionFrame * FramePtr, int CupIndex, int Channel ){
+	assert( CupIndex < CUPS_NUMBER );
+	assert( Channel < VALUES_PER_DISC );
+	if (Channel < VISIBLE_VALUES_PER_DISC){
+		return FramePtr->Derived[CupIndex].Currents[Channel];
+	}
+	return FramePtr->Derived[CupIndex].Diagnostics[Channel - VISIBLE_VALUES_PER_DISC];
+}
+
+/// @param Window index of StatisticsWindowLength[]
+const ChannelStatistics * getChannelStatistics( const AcquisitionFrame * FramePtr, int CupIndex, int Channel, int Window ){
+	assert( CupIndex < CUPS_NUMBER );
+	assert( Channel < VALUES_PER_DISC );
+	assert( Window < STATISTICS_WINDOWS_MAX );
+	if (Channel < VISIBLE_VALUES_PER_DISC){
+		return &FramePtr->Derived[CupIndex].Statistics[Channel][Window];
+	}
+	return &FramePtr->Derived[CupIndex].DiagnosticStatistics[Channel - VISIBLE_VALUES_PER_DISC][Window];
+}
+
+/// The windows of a channel (StatisticsWindowsNumber of the array) are reset together
+static void resetChannelStatistics( SlidingStatistics * StatisticsPtr ){
+	for (int W=0; W < StatisticsWindowsNumber; W++){
+		resetStatistics( &StatisticsPtr[W] );
+	}
+}
+
+/// The sample enters every window of the channel unless it is invalid (NaN); the results of the windows that are
+/// not configured have SamplesNumber 0
+static void addSampleToChannelStatistics( SlidingStatistics * StatisticsPtr, float Sample, ChannelStatistics * ResultPtr ){
+	for (int W=0; W < STATISTICS_WINDOWS_MAX; W++){
+		if (W >= StatisticsWindowsNumber){
+			ResultPtr[W] = ChannelStatistics();
+			continue;
+		}
+		if (!std::isnan( Sample )){
+			addSampleToStatistics( &StatisticsPtr[W], Sample );
+		}
+		getStatistics( &StatisticsPtr[W], &ResultPtr[W] );
+	}
+}
+
+static void resetStatistics( SlidingStatistics * StatisticsPtr ){
+	StatisticsPtr->SamplesCounter = 0;
+	StatisticsPtr->SamplesNumber = 0;
+	StatisticsPtr->Mean = 0.0;
+	StatisticsPtr->SquaredDeviations = 0.0;
+	StatisticsPtr->SamplesToRecalculation = StatisticsPtr->WindowLength;
+	StatisticsPtr->MinimumQueueFront = 0;
+	StatisticsPtr->MinimumQueueLength = 0;
+	StatisticsPtr->MaximumQueueFront = 0;
+	StatisticsPtr->MaximumQueueLength = 0;
+}
+
+static void addSampleToStatistics( SlidingStatistics * StatisticsPtr, float Sample ){
+	assert( StatisticsPtr->WindowLength <= STATISTICS_BUFFER_SIZE );
+	uint64_t SampleNumber = StatisticsPtr->SamplesCounter;
+	int NewIndex = (int)(SampleNumber % STATISTICS_BUFFER_SIZE);
+
+	// the oldest sample leaves the window
+	if (StatisticsPtr->SamplesNumber == StatisticsPtr->WindowLength){
+		double OldSample = StatisticsPtr->Samples[(SampleNumber - StatisticsPtr->WindowLength) % STATISTICS_BUFFER_SIZE];
+		StatisticsPtr->SamplesNumber--;
+		if (0 == StatisticsPtr->SamplesNumber){
+			StatisticsPtr->Mean = 0.0;
+			StatisticsPtr->SquaredDeviations = 0.0;
+		}
+		else{
+			double Delta = OldSample - StatisticsPtr->Mean;
+			StatisticsPtr->Mean -= Delta / StatisticsPtr->SamplesNumber;
+			StatisticsPtr->SquaredDeviations -= Delta * (OldSample - StatisticsPtr->Mean);
+		}
+	}
+
+	// the new sample
+	StatisticsPtr->Samples[NewIndex] = Sample;
+	StatisticsPtr->SamplesNumber++;
+	double Delta = Sample - StatisticsPtr->Mean;
+	StatisticsPtr->Mean += Delta / StatisticsPtr->SamplesNumber;
+	StatisticsPtr->SquaredDeviations += Delta * (Sample - StatisticsPtr->Mean);
+	StatisticsPtr->SamplesCounter++;
+
+	StatisticsPtr->SamplesToRecalculation--;
+	if (StatisticsPtr->SamplesToRecalculation <= 0){
+		recalculateStatistics( StatisticsPtr );
+		StatisticsPtr->SamplesToRecalculation = StatisticsPtr->WindowLength;
+	}
+
+	// monotonic queues; the sample numbers that left the window are removed from the front
+	uint64_t OldestSampleNumber = StatisticsPtr->SamplesCounter - StatisticsPtr->SamplesNumber;
+
+	while ((StatisticsPtr->MinimumQueueLength > 0) &&
+			(StatisticsPtr->MinimumQueue[StatisticsPtr->MinimumQueueFront] < OldestSampleNumber)){
+		StatisticsPtr->MinimumQueueFront = (StatisticsPtr->MinimumQueueFront + 1) % STATISTICS_BUFFER_SIZE;
+		StatisticsPtr->MinimumQueueLength--;
+	}
+	while ((StatisticsPtr->MinimumQueueLength > 0) &&
+			(StatisticsPtr->Samples[StatisticsPtr->MinimumQueue[(StatisticsPtr->MinimumQueueFront + StatisticsPtr->MinimumQueueLength - 1) % STATISTICS_BUFFER_SIZE] % STATISTICS_BUFFER_SIZE] >= Sample)){
+		StatisticsPtr->MinimumQueueLength--;
+	}
+	StatisticsPtr->MinimumQueue[(StatisticsPtr->MinimumQueueFront + StatisticsPtr->MinimumQueueLength) % STATISTICS_BUFFER_SIZE] = SampleNumber;
+	StatisticsPtr->MinimumQueueLength++;
+
+	while ((StatisticsPtr->MaximumQueueLength > 0) &&
+			(StatisticsPtr->MaximumQueue[StatisticsPtr->MaximumQueueFront] < OldestSampleNumber)){
+		StatisticsPtr->MaximumQueueFront = (StatisticsPtr->MaximumQueueFront + 1) % STATISTICS_BUFFER_SIZE;
+		StatisticsPtr->MaximumQueueLength--;
+	}
+	while ((StatisticsPtr->MaximumQueueLength > 0) &&
+			(StatisticsPtr->Samples[StatisticsPtr->MaximumQueue[(StatisticsPtr->MaximumQueueFront + StatisticsPtr->MaximumQueueLength - 1) % STATISTICS_BUFFER_SIZE] % STATISTICS_BUFFER_SIZE] <= Sample)){
+		StatisticsPtr->MaximumQueueLength--;
+	}
+	StatisticsPtr->MaximumQueue[(StatisticsPtr->MaximumQueueFront + StatisticsPtr->MaximumQueueLength) % STATISTICS_BUFFER_SIZE] = SampleNumber;
+	StatisticsPtr->MaximumQueueLength++;
+}
+
+/// Two-pass calculation of the mean and the squared deviations over the whole window
+static void recalculateStatistics( SlidingStatistics * StatisticsPtr ){
+	double Sum = 0.0;
+	uint64_t FirstSample = StatisticsPtr->SamplesCounter - StatisticsPtr->SamplesNumber;
+	for (int J=0; J < StatisticsPtr->SamplesNumber; J++){
+		Sum += StatisticsPtr->Samples[(FirstSample + J) % STATISTICS_BUFFER_SIZE];
+	}
+	double Mean = Sum / StatisticsPtr->SamplesNumber;
+	double SquaredDeviations = 0.0;
+	for (int J=0; J < StatisticsPtr->SamplesNumber; J++){
+		double Deviation = StatisticsPtr->Samples[(FirstSample + J) % STATISTICS_BUFFER_SIZE] - Mean;
+		SquaredDeviations += Deviation * Deviation;
+	}
+	StatisticsPtr->Mean = Mean;
+	StatisticsPtr->SquaredDeviations = SquaredDeviations;
+}
+
+static void getStatistics( const SlidingStatistics * StatisticsPtr, ChannelStatistics * ResultPtr ){
+	ResultPtr->SamplesNumber = StatisticsPtr->SamplesNumber;
+	if (0 == StatisticsPtr->SamplesNumber){
+		ResultPtr->Mean = 0.0f;
+		ResultPtr->StandardDeviation = 0.0f;
+		ResultPtr->Minimum = 0.0f;
+		ResultPtr->Maximum = 0.0f;
+		return;
+	}
+	ResultPtr->Mean = (float)StatisticsPtr->Mean;
+	if ((StatisticsPtr->SamplesNumber > 1) && (StatisticsPtr->SquaredDeviations > 0.0)){
+		ResultPtr->StandardDeviation = (float)sqrt( StatisticsPtr->SquaredDeviations / (StatisticsPtr->SamplesNumber - 1) );
+	}
+	else{
+		ResultPtr->StandardDeviation = 0.0f;
+	}
+	ResultPtr->Minimum = StatisticsPtr->Samples[StatisticsPtr->MinimumQueue[StatisticsPtr->MinimumQueueFront] % STATISTICS_BUFFER_SIZE];
+	ResultPtr->Maximum = StatisticsPtr->Samples[StatisticsPtr->MaximumQueue[StatisticsPtr->MaximumQueueFront] % STATISTICS_BUFFER_SIZE];
+}
+
+static void resetFilter( CurrentFilter * FilterPtr ){
+	FilterPtr->SamplesNumber = 0;
+	FilterPtr->NextIndex = 0;
+	FilterPtr->Sum = 0.0;
+	FilterPtr->SamplesToRecalculation = FILTER_WINDOW_MAX;
+	FilterPtr->Output = std::numeric_limits<float>::quiet_NaN();
+}
+
+/// This function passes a sample through the filter of the cup; invalid samples (NaN) do not enter the filter
+/// @return the filtered value; NaN if the input sample is invalid or the filter has not received any valid sample yet
+static float filterSample( int CupIndex, CurrentFilter * FilterPtr, float Sample ){
+	assert( CupIndex < CUPS_NUMBER );
+	if (std::isnan( Sample )){
+		return Sample;
+	}
+
+	if (FilterTypes::EXPONENTIAL == FilterType[CupIndex]){
+		if (std::isnan( FilterPtr->Output )){
+			FilterPtr->Output = Sample;
+		}
+		else{
+			FilterPtr->Output += (float)FilterCoefficient[CupIndex] * (Sample - FilterPtr->Output);
+		}
+	}
+	else if ((FilterTypes::MOVING_AVERAGE == FilterType[CupIndex]) || (FilterTypes::MEDIAN == FilterType[CupIndex])){
+		int Length = FilterLength[CupIndex];
+		assert( Length <= FILTER_WINDOW_MAX );
+		bool IsWindowFull = (FilterPtr->SamplesNumber == Length);
+		float OldSample = FilterPtr->Samples[FilterPtr->NextIndex];
+
+		FilterPtr->Samples[FilterPtr->NextIndex] = Sample;
+		FilterPtr->NextIndex = (FilterPtr->NextIndex + 1) % Length;
+
+		if (FilterTypes::MOVING_AVERAGE == FilterType[CupIndex]){
+			FilterPtr->Sum += Sample;
+			if (IsWindowFull){
+				FilterPtr->Sum -= OldSample;
+			}
+			else{
+				FilterPtr->SamplesNumber++;
+			}
+			FilterPtr->SamplesToRecalculation--;
+			if (FilterPtr->SamplesToRecalculation <= 0){
+				// the running sum is recalculated from time to time to stop the rounding errors from accumulating
+				FilterPtr->Sum = 0.0;
+				for (int J=0; J < FilterPtr->SamplesNumber; J++){
+					FilterPtr->Sum += FilterPtr->Samples[J];
+				}
+				FilterPtr->SamplesToRecalculation = FILTER_WINDOW_MAX;
+			}
+			FilterPtr->Output = (float)(FilterPtr->Sum / FilterPtr->SamplesNumber);
+		}
+		else{
+			// the sorted copy of the window: the oldest sample is removed and the new one inserted in place
+			int Position;
+			if (IsWindowFull){
+				Position = 0;
+				while (FilterPtr->SortedSamples[Position] != OldSample){
+					Position++;
+				}
+				for (; Position < FilterPtr->SamplesNumber-1; Position++){
+					FilterPtr->SortedSamples[Position] = FilterPtr->SortedSamples[Position+1];
+				}
+			}
+			else{
+				FilterPtr->SamplesNumber++;
+			}
+			Position = FilterPtr->SamplesNumber-1;
+			while ((Position > 0) && (FilterPtr->SortedSamples[Position-1] > Sample)){
+				FilterPtr->SortedSamples[Position] = FilterPtr->SortedSamples[Position-1];
+				Position--;
+			}
+			FilterPtr->SortedSamples[Position] = Sample;
+
+			int Middle = FilterPtr->SamplesNumber / 2;
+			if (0 != (FilterPtr->SamplesNumber & 1)){
+				FilterPtr->Output = FilterPtr->SortedSamples[Middle];
+			}
+			else{
+				FilterPtr->Output = 0.5f * (FilterPtr->SortedSamples[Middle-1] + FilterPtr->SortedSamples[Middle]);
+			}
+		}
+	}
+	else{
+		FilterPtr->Output = Sample;
+	}
+	return FilterPtr->Output;
+}
+
+static void resetChargeIntegrator( ChargeIntegrator * IntegratorPtr ){
+	IntegratorPtr->Charge = 0.0;
+	IntegratorPtr->IntegrationTime = 0.0;
+	IntegratorPtr->IsPreviousSampleValid = false;
+}
+
+/// @brief The total current of the cup is integrated with the trapezoidal rule using the times of the readouts
+/// The integration starts from zero when the cup is inserted (the limit switch coil goes on) and freezes when the cup
+/// is removed. An interval is integrated only if both ends are valid samples and it is not longer
+/// than CHARGE_INTEGRATION_MAX_GAP, so transmission breaks and N/A values neither add nor lose charge by guesswork.
+static void integrateCharge( ChargeIntegrator * IntegratorPtr, const AcquisitionFrame * FramePtr, int CupIndex ){
+	assert( CupIndex < CUPS_NUMBER );
+	const CupDerivedData * DerivedPtr = &FramePtr->Derived[CupIndex];
+	bool IsCupInserted = FramePtr->Coils[COIL_OFFSET_IS_SWITCH_PRESSED + CupIndex*MODBUS_COILS_PER_CUP];
+
+	if (IsCupInserted && !IntegratorPtr->WasCupInserted){
+		resetChargeIntegrator( IntegratorPtr );
+		IntegratorPtr->IsRunning = true;
+	}
+	if (!IsCupInserted){
+		IntegratorPtr->IsRunning = false;
+		IntegratorPtr->IsPreviousSampleValid = false;
+	}
+	IntegratorPtr->WasCupInserted = IsCupInserted;
+
+	if (atomic_load_explicit( &ChargeResetRequest[CupIndex], std::memory_order_acquire )){
+		atomic_store_explicit( &ChargeResetRequest[CupIndex], false, std::memory_order_release );
+		resetChargeIntegrator( IntegratorPtr );
+	}
+
+	if (!IntegratorPtr->IsRunning){
+		return;
+	}
+
+	double TotalCurrent = 0.0;
+	bool IsSampleValid = true;
+	for (int J=0; J < VISIBLE_VALUES_PER_DISC; J++){
+		if (std::isnan( DerivedPtr->Currents[J] )){
+			IsSampleValid = false;
+		}
+		else{
+			TotalCurrent += DerivedPtr->Currents[J];
+		}
+	}
+
+	if (IsSampleValid && IntegratorPtr->IsPreviousSampleValid){
+		double TimeStep = std::chrono::duration<double>(FramePtr->RegistersTime - IntegratorPtr->PreviousTime).count();
+		if ((TimeStep > 0.0) && (TimeStep <= 0.001 * CHARGE_INTEGRATION_MAX_GAP)){
+			IntegratorPtr->Charge += 0.5 * (TotalCurrent + IntegratorPtr->PreviousCurrent) * TimeStep;
+			IntegratorPtr->IntegrationTime += TimeStep;
+		}
+	}
+	IntegratorPtr->IsPreviousSampleValid = IsSampleValid;
+	IntegratorPtr->PreviousCurrent = TotalCurrent;
+	IntegratorPtr->PreviousTime = FramePtr->RegistersTime;
+}
+
+/// @brief The beam focus is judged from the distribution of the current between the disc segments
+/// A well focused beam hits the inner circle: InnerToOuterRatio is high and HaloFraction is close to zero.
+/// The filtered currents are used, so the metrics are as steady as the displayed values.
+static void calculateFocusMetrics( CupDerivedData * DerivedPtr ){
+	const float NotANumber = std::numeric_limits<float>::quiet_NaN();
+	float OuterRing = DerivedPtr->FilteredCurrents[CURRENT_OF_OUTER_RING];
+	float MiddleRing = DerivedPtr->FilteredCurrents[CURRENT_OF_MIDDLE_RING];
+	float InnerCircle = DerivedPtr->FilteredCurrents[CURRENT_OF_INNER_CIRCLE];
+
+	DerivedPtr->TotalCurrent = OuterRing + MiddleRing + InnerCircle;	// NaN if any of them is NaN
+	if (std::isnan( DerivedPtr->TotalCurrent )){
+		DerivedPtr->InnerToOuterRatio = NotANumber;
+		DerivedPtr->HaloFraction = NotANumber;
+		return;
+	}
+	DerivedPtr->InnerToOuterRatio = (fabs( OuterRing ) >= FOCUS_MINIMUM_CURRENT)? InnerCircle / OuterRing : NotANumber;
+	DerivedPtr->HaloFraction = (fabs( DerivedPtr->TotalCurrent ) >= FOCUS_MINIMUM_CURRENT)? OuterRing / DerivedPtr->TotalCurrent : NotANumber;
+}
+
+/// @brief The transmission along the beamline is the ratio of the total currents of two cups
+/// All the cups are read in the same Modbus frame, so the currents of both cups have the same timestamp.
+/// The ratio is valid only when both cups are inserted and the upstream current is not negligible;
+/// otherwise it is NaN and the smoothing starts anew with the next valid ratio.
+static void calculateTransmissions( AcquisitionFrame * FramePtr ){
+	const double SmoothingCoefficient = 1.0 / TransmissionSmoothing;
+
+	for (int Downstream=0; Downstream < CUPS_NUMBER; Downstream++){
+		for (int Upstream=0; Upstream < CUPS_NUMBER; Upstream++){
+			float * ResultPtr = &FramePtr->Derived[Downstream].TransmissionFrom[Upstream];
+			double * SmoothedPtr = &SmoothedTransmission[Upstream][Downstream];
+			*ResultPtr = std::numeric_limits<float>::quiet_NaN();
+			if (!IsTransmissionMeasured[Upstream][Downstream]){
+				continue;
+			}
+
+			double UpstreamCurrent = FramePtr->Derived[Upstream].TotalCurrent;
+			double DownstreamCurrent = FramePtr->Derived[Downstream].TotalCurrent;
+			bool IsValid = FramePtr->Coils[COIL_OFFSET_IS_SWITCH_PRESSED + Upstream*MODBUS_COILS_PER_CUP] &&
+					FramePtr->Coils[COIL_OFFSET_IS_SWITCH_PRESSED + Downstream*MODBUS_COILS_PER_CUP] &&
+					!std::isnan( UpstreamCurrent ) && !std::isnan( DownstreamCurrent ) &&
+					(fabs( UpstreamCurrent ) >= FOCUS_MINIMUM_CURRENT);
+			if (!IsValid){
+				*SmoothedPtr = std::numeric_limits<double>::quiet_NaN();
+				continue;
+			}
+
+			double Ratio = DownstreamCurrent / UpstreamCurrent;
+			if (std::isnan( *SmoothedPtr )){
+				*SmoothedPtr = Ratio;
+			}
+			else{
+				*SmoothedPtr += SmoothingCoefficient * (Ratio - *SmoothedPtr);
+			}
+			*ResultPtr = (float)*SmoothedPtr;
+		}
+	}
+}
@@ -0,0 +1,27 @@
+/// @file signal_processing.h
+
+#ifndef SOURCE_SIGNAL_PROCESSING_H_
+#define SOURCE_SIGNAL_PROCESSING_H_
+
+#include "config.h"
+#include "shared_data.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define FOCUS_MINIMUM_CURRENT		0.01	// uA; the focus and transmission ratios are not calculated for smaller denominators
+
+//.................................................................................................
+// Function prototypes
+//.................................................................................................
+
+void initializeSignalProcessing(void);
+
+void processAcquisitionFrame( AcquisitionFrame * FramePtr );
+
+float getChannelValue( const AcquisitionFrame * FramePtr, int CupIndex, int Channel );
+
+const ChannelStatistics * getChannelStatistics( const AcquisitionFrame * FramePtr, int CupIndex, int Channel, int Window );
+
+#endif // SOURCE_SIGNAL_PROCESSING_H_
@@ -0,0 +1,433 @@
+/// @file spectral_analysis.cpp
+///
+/// Spectrum of the beam current (the sum of the currents of the circle and the rings of each cup), used to find
+/// the sources of the ripple. A thread of its own takes the newest frames with registers from the history,
+/// resamples them to a uniform grid (the readouts are not exactly periodic), and averages the amplitude spectra
+/// of the windowed segments (Welch's method, 50% overlap). The peripheral thread is involved only in the burst
+/// mode, in which it reads the registers back-to-back to raise the sampling frequency (see startBurstMode).
+/// The spectrum is written to a CSV file; the GUI thread shows the strongest peaks of each cup.
+
+#include <cmath>
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+#include "spectral_analysis.h"
+#include "peripheral_thread.h"
+#include "history_buffer.h"
+#include "settings_file.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define SPECTRUM_THREAD_LOOP_DURATION		PERIPHERAL_THREAD_LOOP_DURATION	// milliseconds
+#define SPECTRUM_SAMPLES_MAX				32768	// limited also by the capacity of the history
+#define SPECTRUM_LENGTH_MIN					16
+#define SPECTRUM_MAXIMUM_GAP				1000	// milliseconds; the samples before a longer gap are not used
+#define SPECTRUM_BURST_TIMEOUT				2000	// milliseconds over BurstDuration
+#define SPECTRUM_PEAKS_NUMBER				3
+#define SPECTRUM_REPORT_SIZE				800
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+enum class SpectrumStates
+{
+	IDLE,
+	REQUESTED,		// the GUI thread has requested the spectrum
+	COMPUTING,		// the spectrum thread waits for the end of the burst mode or computes the spectrum
+	COMPLETED,		// the report is ready; the GUI thread shows it
+};
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+static std::thread SpectrumThread;
+
+static std::atomic<bool> CloseSpectrumFlag;
+
+static std::atomic<SpectrumStates> SpectrumState( SpectrumStates::IDLE );
+
+/// Written by the GUI thread before SpectrumState becomes REQUESTED
+static bool IsBurstModeRequested;
+
+/// Written by the spectrum thread before SpectrumState becomes COMPLETED
+static char SpectrumReport[SPECTRUM_REPORT_SIZE];
+
+/// These variables are used by the spectrum thread only
+static AcquisitionFrame SpectrumFrame;
+static double SampleTimes[SPECTRUM_SAMPLES_MAX];		// s, relative to the oldest sample
+static float SampleValues[CUPS_NUMBER][SPECTRUM_SAMPLES_MAX];
+static bool IsCupValid[CUPS_NUMBER];
+static double UniformValues[SPECTRUM_SAMPLES_MAX];
+static double WindowValues[SPECTRUM_LENGTH_MAX];
+static double SegmentReal[SPECTRUM_LENGTH_MAX];
+static double SegmentImaginary[SPECTRUM_LENGTH_MAX];
+static double Amplitudes[CUPS_NUMBER][SPECTRUM_LENGTH_MAX/2+1];
+static double StandardDeviations[CUPS_NUMBER];
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static void spectrumThreadHandler(void);
+
+static int collectSamples( bool IsBurst, std::chrono::high_resolution_clock::time_point BurstStart );
+
+static void computeSpectrum( int Number );
+
+static double computeCupSpectrum( int Cup, int SamplesNumber, int Length, int SegmentsNumber );
+
+static void computeWindow( int Length );
+
+static void transformFourier( double * RealPtr, double * ImaginaryPtr, int Length );
+
+static std::string writeSpectrumFile( int Length, double SamplingFrequency );
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+void spectralAnalysisStart(void){
+	atomic_store_explicit( &CloseSpectrumFlag, false, std::memory_order_release );
+	SpectrumThread = std::thread(spectrumThreadHandler);
+}
+
+/// This function is called by FLTK onMainWindowCloseCallback event handler
+void spectralAnalysisExit(void){
+	atomic_store_explicit( &CloseSpectrumFlag, true, std::memory_order_release );
+	if (SpectrumThread.joinable()){
+		SpectrumThread.join();
+	}
+}
+
+/// This function is called by the GUI thread (menu)
+/// @return false if the previous spectrum is not finished yet
+bool requestSpectrum( bool IsBurstRequested ){
+	if (SpectrumStates::IDLE != atomic_load_explicit( &SpectrumState, std::memory_order_acquire )){
+		return false;
+	}
+	IsBurstModeRequested = IsBurstRequested;
+	atomic_store_explicit( &SpectrumState, SpectrumStates::REQUESTED, std::memory_order_release );
+	return true;
+}
+
+bool isSpectrumInProgress(void){
+	SpectrumStates State = atomic_load_explicit( &SpectrumState, std::memory_order_acquire );
+	return (SpectrumStates::REQUESTED == State) || (SpectrumStates::COMPUTING == State);
+}
+
+/// This function is called by the GUI thread in each refresh
+/// @return true if the spectrum has just been completed; the report is copied to ReportPtr
+bool finishSpectrum( char * ReportPtr, size_t ReportSize ){
+	if (SpectrumStates::COMPLETED != atomic_load_explicit( &SpectrumState, std::memory_order_acquire )){
+		return false;
+	}
+	snprintf( ReportPtr, ReportSize, "%s", SpectrumReport );
+	atomic_store_explicit( &SpectrumState, SpectrumStates::IDLE, std::memory_order_release );
+	return true;
+}
+
+static void spectrumThreadHandler(void){
+	while (!atomic_load_explicit( &CloseSpectrumFlag, std::memory_order_acquire )){
+		if (SpectrumStates::REQUESTED == atomic_load_explicit( &SpectrumState, std::memory_order_acquire )){
+			atomic_store_explicit( &SpectrumState, SpectrumStates::COMPUTING, std::memory_order_release );
+			bool IsBurst = IsBurstModeRequested;
+			std::chrono::high_resolution_clock::time_point BurstStart = std::chrono::high_resolution_clock::now();
+			if (IsBurst){
+				startBurstMode( BurstDuration );
+				while (isBurstModeActive() && !atomic_load_explicit( &CloseSpectrumFlag, std::memory_order_acquire ) &&
+						(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - BurstStart).count()
+								< BurstDuration + SPECTRUM_BURST_TIMEOUT))
+				{
+					std::this_thread::sleep_for( std::chrono::milliseconds( SPECTRUM_THREAD_LOOP_DURATION ));
+				}
+			}
+			computeSpectrum( collectSamples( IsBurst, BurstStart ));
+			atomic_store_explicit( &SpectrumState, SpectrumStates::COMPLETED, std::memory_order_release );
+		}
+		std::this_thread::sleep_for( std::chrono::milliseconds( SPECTRUM_THREAD_LOOP_DURATION ));
+	}
+}
+
+/// The samples are taken from the newest frame with registers backwards, until the number needed for the spectrum,
+/// a gap in the readouts, the beginning of the burst mode or the oldest frame in the history
+/// @return the number of samples (in chronological order in SampleTimes[] and SampleValues[][])
+static int collectSamples( bool IsBurst, std::chrono::high_resolution_clock::time_point BurstStart ){
+	int Needed = std::min( SpectrumLength + (SpectrumSegments-1) * (SpectrumLength/2), SPECTRUM_SAMPLES_MAX );
+	if (IsBurst){
+		Needed = SPECTRUM_SAMPLES_MAX;
+	}
+	for (int Cup=0; Cup < CUPS_NUMBER; Cup++){
+		IsCupValid[Cup] = (Cup < PHYSICALLY_INSTALLED_CUPS);
+	}
+
+	std::chrono::high_resolution_clock::time_point NewestTime, PreviousTime;
+	int Number = 0;
+	uint64_t FrameIndex = getHistoryFramesNumber();
+	while ((FrameIndex > 0) && (Number < Needed)){
+		FrameIndex--;
+		if (!readHistoryFrame( FrameIndex, &SpectrumFrame )){
+			break;
+		}
+		if (0 == (SpectrumFrame.QualityFlags & FRAME_QUALITY_REGISTERS_UPDATED)){
+			continue;
+		}
+		if (IsBurst && (SpectrumFrame.RegistersTime < BurstStart)){
+			break;
+		}
+		if (0 == Number){
+			NewestTime = SpectrumFrame.RegistersTime;
+		}
+		else if (std::chrono::duration_cast<std::chrono::milliseconds>(PreviousTime - SpectrumFrame.RegistersTime).count() > SPECTRUM_MAXIMUM_GAP){
+			break;
+		}
+		PreviousTime = SpectrumFrame.RegistersTime;
+
+		// temporarily the newest sample first and the times relative to the newest sample
+		SampleTimes[Number] = std::chrono::duration<double>(SpectrumFrame.RegistersTime - NewestTime).count();
+		for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+			float Sum = 0.0f;
+			for (int Channel=0; Channel < VISIBLE_VALUES_PER_DISC; Channel++){
+				Sum += SpectrumFrame.Derived[Cup].Currents[Channel];
+			}
+			if (std::isnan( Sum )){
+				IsCupValid[Cup] = false;	// the cup is removed or the readouts are invalid
+			}
+			SampleValues[Cup][Number] = Sum;
+		}
+		Number++;
+	}
+
+	// chronological order
+	std::reverse( SampleTimes, SampleTimes + Number );
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		std::reverse( SampleValues[Cup], SampleValues[Cup] + Number );
+	}
+	for (int J=Number-1; J >= 0; J--){
+		SampleTimes[J] -= SampleTimes[0];
+	}
+	return Number;
+}
+
+/// @param Number the number of samples collected by collectSamples()
+/// The report contains the sampling frequency, the resolution and the strongest peaks of each cup
+static void computeSpectrum( int Number ){
+	int Length = SpectrumLength;
+	while ((Length > Number) && (Length > SPECTRUM_LENGTH_MIN)){
+		Length /= 2;
+	}
+	if ((Number < SPECTRUM_LENGTH_MIN) || (SampleTimes[Number-1] <= 0.0)){
+		snprintf( SpectrumReport, sizeof(SpectrumReport), "Widmo: za mało odczytów (%d)", Number );
+		return;
+	}
+	int SegmentsNumber = std::min( SpectrumSegments, 1 + (Number - Length) / (Length/2) );
+	int Used = Length + (SegmentsNumber-1) * (Length/2);
+	double SamplingFrequency = (Number-1) / SampleTimes[Number-1];
+
+	computeWindow( Length );
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		if (IsCupValid[Cup]){
+			StandardDeviations[Cup] = computeCupSpectrum( Cup, Number, Length, SegmentsNumber );
+		}
+	}
+	std::string FilePath = writeSpectrumFile( Length, SamplingFrequency );
+
+	static const char * WindowNames[] = {"prostokątne", "hann", "blackman"};
+	int Position = snprintf( SpectrumReport, sizeof(SpectrumReport),
+			"Widmo sumy prądów: %d próbek, %d segment(y/ów), okno %s\n"
+			"Próbkowanie %.2f Hz (%.1f s), rozdzielczość %.4f Hz\n",
+			Length, SegmentsNumber, WindowNames[(int)SpectrumWindow], SamplingFrequency,
+			(Used-1) / SamplingFrequency, SamplingFrequency / Length );
+	for (int Cup=0; (Cup < PHYSICALLY_INSTALLED_CUPS) && (Position < (int)sizeof(SpectrumReport)); Cup++){
+		if (!IsCupValid[Cup]){
+			Position += snprintf( SpectrumReport + Position, sizeof(SpectrumReport) - Position,
+					"\n%s: brak ważnych odczytów", CupDescriptionPtr[Cup] );
+			continue;
+		}
+		// the local maxima, the strongest first
+		int Peaks[SPECTRUM_PEAKS_NUMBER];
+		int PeaksNumber = 0;
+		for (int K=1; K < Length/2; K++){
+			if ((Amplitudes[Cup][K] > Amplitudes[Cup][K-1]) && (Amplitudes[Cup][K] >= Amplitudes[Cup][K+1])){
+				int Position2 = PeaksNumber;
+				while ((Position2 > 0) && (Amplitudes[Cup][Peaks[Position2-1]] < Amplitudes[Cup][K])){
+					if (Position2 < SPECTRUM_PEAKS_NUMBER){
+						Peaks[Position2] = Peaks[Position2-1];
+					}
+					Position2--;
+				}
+				if (Position2 < SPECTRUM_PEAKS_NUMBER){
+					Peaks[Position2] = K;
+					PeaksNumber = std::min( PeaksNumber+1, SPECTRUM_PEAKS_NUMBER );
+				}
+			}
+		}
+		Position += snprintf( SpectrumReport + Position, sizeof(SpectrumReport) - Position,
+				"\n%s: tętnienia %.3g uA RMS;", CupDescriptionPtr[Cup], StandardDeviations[Cup] );
+		for (int J=0; (J < PeaksNumber) && (Position < (int)sizeof(SpectrumReport)); J++){
+			Position += snprintf( SpectrumReport + Position, sizeof(SpectrumReport) - Position,
+					" %.3f Hz: %.3g uA;", Peaks[J] * SamplingFrequency / Length, Amplitudes[Cup][Peaks[J]] );
+		}
+	}
+	if (Position < (int)sizeof(SpectrumReport)){
+		snprintf( SpectrumReport + Position, sizeof(SpectrumReport) - Position, "\n\n%s",
+				FilePath.empty()? "Nie można zapisać widma" : FilePath.c_str() );
+	}
+	if (VerboseMode){
+		std::cout << SpectrumReport << std::endl;
+	}
+}
+
+/// The samples are resampled to the uniform grid by the linear interpolation; the amplitude spectrum (uA)
+/// is the square root of the mean power of the segments, so that a sine of amplitude A gives a peak of about A
+/// @return the standard deviation of the resampled signal (uA)
+static double computeCupSpectrum( int Cup, int SamplesNumber, int Length, int SegmentsNumber ){
+	double Step = SampleTimes[SamplesNumber-1] / (SamplesNumber-1);
+	int Source = 0;
+	double Sum = 0.0, SquaresSum = 0.0;
+	for (int J=0; J < SamplesNumber; J++){
+		double Time = J * Step;
+		while ((Source < SamplesNumber-2) && (SampleTimes[Source+1] < Time)){
+			Source++;
+		}
+		double Interval = SampleTimes[Source+1] - SampleTimes[Source];
+		double Fraction = (Interval > 0.0)? std::min( 1.0, std::max( 0.0, (Time - SampleTimes[Source]) / Interval )) : 0.0;
+		UniformValues[J] = SampleValues[Cup][Source] + Fraction * (SampleValues[Cup][Source+1] - SampleValues[Cup][Source]);
+		Sum += UniformValues[J];
+		SquaresSum += UniformValues[J] * UniformValues[J];
+	}
+	double Mean = Sum / SamplesNumber;
+	double Variance = std::max( 0.0, SquaresSum / SamplesNumber - Mean * Mean );
+
+	double WindowSum = 0.0;
+	for (int J=0; J < Length; J++){
+		WindowSum += WindowValues[J];
+	}
+	for (int K=0; K <= Length/2; K++){
+		Amplitudes[Cup][K] = 0.0;
+	}
+	int First = SamplesNumber - (Length + (SegmentsNumber-1) * (Length/2));	// the newest samples are used
+	for (int Segment=0; Segment < SegmentsNumber; Segment++){
+		const double * SegmentPtr = &UniformValues[First + Segment * (Length/2)];
+		double SegmentMean = 0.0;
+		for (int J=0; J < Length; J++){
+			SegmentMean += SegmentPtr[J];
+		}
+		SegmentMean /= Length;
+		for (int J=0; J < Length; J++){
+			SegmentReal[J] = (SegmentPtr[J] - SegmentMean) * WindowValues[J];
+			SegmentImaginary[J] = 0.0;
+		}
+		transformFourier( SegmentReal, SegmentImaginary, Length );
+		for (int K=0; K <= Length/2; K++){
+			Amplitudes[Cup][K] += SegmentReal[K] * SegmentReal[K] + SegmentImaginary[K] * SegmentImaginary[K];
+		}
+	}
+	for (int K=0; K <= Length/2; K++){
+		double Scale = ((0 == K) || (Length/2 == K))? 1.0 : 2.0;
+		Amplitudes[Cup][K] = Scale * sqrt( Amplitudes[Cup][K] / SegmentsNumber ) / WindowSum;
+	}
+	return sqrt( Variance );
+}
+
+static void computeWindow( int Length ){
+	for (int J=0; J < Length; J++){
+		double Phase = 2.0 * M_PI * J / Length;
+		switch (SpectrumWindow){
+		case SpectrumWindows::RECTANGULAR:
+			WindowValues[J] = 1.0;
+			break;
+		case SpectrumWindows::HANN:
+			WindowValues[J] = 0.5 - 0.5 * cos( Phase );
+			break;
+		case SpectrumWindows::BLACKMAN:
+			WindowValues[J] = 0.42 - 0.5 * cos( Phase ) + 0.08 * cos( 2.0 * Phase );
+			break;
+		}
+	}
+}
+
+/// The iterative radix-2 FFT (in place); Length is a power of 2
+static void transformFourier( double * RealPtr, double * ImaginaryPtr, int Length ){
+	for (int J=1, Reversed=0; J < Length; J++){
+		int Bit = Length >> 1;
+		for (; 0 != (Reversed & Bit); Bit >>= 1){
+			Reversed ^= Bit;
+		}
+		Reversed ^= Bit;
+		if (J < Reversed){
+			std::swap( RealPtr[J], RealPtr[Reversed] );
+			std::swap( ImaginaryPtr[J], ImaginaryPtr[Reversed] );
+		}
+	}
+	for (int Span=2; Span <= Length; Span <<= 1){
+		double Angle = -2.0 * M_PI / Span;
+		double StepReal = cos( Angle ), StepImaginary = sin( Angle );
+		for (int Start=0; Start < Length; Start += Span){
+			double TwiddleReal = 1.0, TwiddleImaginary = 0.0;
+			for (int J=0; J < Span/2; J++){
+				double * ARealPtr = &RealPtr[Start+J];
+				double * AImaginaryPtr = &ImaginaryPtr[Start+J];
+				double * BRealPtr = &RealPtr[Start+J+Span/2];
+				double * BImaginaryPtr = &ImaginaryPtr[Start+J+Span/2];
+				double ProductReal = *BRealPtr * TwiddleReal - *BImaginaryPtr * TwiddleImaginary;
+				double ProductImaginary = *BRealPtr * TwiddleImaginary + *BImaginaryPtr * TwiddleReal;
+				*BRealPtr = *ARealPtr - ProductReal;
+				*BImaginaryPtr = *AImaginaryPtr - ProductImaginary;
+				*ARealPtr += ProductReal;
+				*AImaginaryPtr += ProductImaginary;
+				double NextReal = TwiddleReal * StepReal - TwiddleImaginary * StepImaginary;
+				TwiddleImaginary = TwiddleReal * StepImaginary + TwiddleImaginary * StepReal;
+				TwiddleReal = NextReal;
+			}
+		}
+	}
+}
+
+/// The spectrum file is named after the time of the computation: Widmo_YYYY-MM-DD_HH-MM-SS.csv
+/// @return the path of the file or an empty string on failure
+static std::string writeSpectrumFile( int Length, double SamplingFrequency ){
+	time_t Seconds = time( nullptr );
+	struct tm LocalTime;
+	localtime_r( &Seconds, &LocalTime );
+	char TimeText[40];
+	strftime( TimeText, sizeof(TimeText), "%Y-%m-%d_%H-%M-%S", &LocalTime );
+
+	std::string FilePath = ThisApplicationDirectory + "/Widmo_" + TimeText + ".csv";
+	FILE * SpectrumFile = fopen( FilePath.c_str(), "w" );
+	if (nullptr == SpectrumFile){
+		std::cout << "Nie można utworzyć pliku: " << FilePath << std::endl;
+		return std::string();
+	}
+	fprintf( SpectrumFile, "f [Hz]" );
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		fprintf( SpectrumFile, ";K%d [uA]", Cup+1 );
+	}
+	fprintf( SpectrumFile, "\n" );
+	for (int K=0; K <= Length/2; K++){
+		fprintf( SpectrumFile, "%.6g", K * SamplingFrequency / Length );
+		for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+			if (IsCupValid[Cup]){
+				fprintf( SpectrumFile, ";%.6g", Amplitudes[Cup][K] );
+			}
+			else{
+				fprintf( SpectrumFile, ";" );
+			}
+		}
+		fprintf( SpectrumFile, "\n" );
+	}
+	if (0 != fclose( SpectrumFile )){
+		std::cout << "Błąd zapisu pliku: " << FilePath << std::endl;
+		return std::string();
+	}
+	return FilePath;
+}
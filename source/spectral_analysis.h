@@ -0,0 +1,24 @@
+/// @file spectral_analysis.h
+
+#ifndef SOURCE_SPECTRAL_ANALYSIS_H_
+#define SOURCE_SPECTRAL_ANALYSIS_H_
+
+#include <cstddef>
+
+#include "config.h"
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+void spectralAnalysisStart(void);
+
+void spectralAnalysisExit(void);
+
+bool requestSpectrum( bool IsBurstRequested );
+
+bool isSpectrumInProgress(void);
+
+bool finishSpectrum( char * ReportPtr, size_t ReportSize );
+
+#endif // SOURCE_SPECTRAL_ANALYSIS_H_
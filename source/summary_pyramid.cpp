@@ -0,0 +1,527 @@
+/// @file summary_pyramid.cpp
+///
+/// The pyramid of summary tiles of a recording: the level 0 summarises the frames of each second, each next level
+/// summarises SUMMARY_LEVEL_FACTOR tiles of the level below, up to 512 s. The recordings are rotated every hour,
+/// so a level of wider tiles would hold one partial tile per file; the tiles wider than the highest level are merged
+/// from it by the query, over all the files of the range. Each level is a sidecar file of SummaryTile records sorted
+/// by time, appended by the recorder thread together with the chunks of the recording (the tiles are aligned to
+/// multiples of their width, so they never overlap; the files are written through the disk writer). A query of any
+/// time range reads the coarsest level that still gives the requested number of tiles, so the cost depends on
+/// the number of tiles (the width of the screen), not on the number of frames. The tiles not written yet (the tiles
+/// in progress, or all the tiles of the higher levels after a crash) are made up from the level below. A query of
+/// the recording directory joins the tiles of the consecutive recordings (a tile may begin in one file and end
+/// in the next one) and reads only the files of the range.
+
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "summary_pyramid.h"
+#include "disk_writer.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+static_assert( SUMMARY_PENDING_TILES_MAX*sizeof(SummaryTile) <= DISK_WRITER_BUFFER_SIZE );
+
+#define SUMMARY_FILE_TIME_FORMAT			"%Y-%m-%d_%H-%M-%S"	// local time, as in the names of the recording files
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+/// A level of the pyramid mapped into memory for a query
+struct MappedSummaryLevel {
+	const SummaryTile * TilesPtr;
+	size_t TilesNumber;
+	size_t MappedSize;
+};
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static void openTile( SummaryPyramid * PyramidPtr, int Level, int64_t StartTime );
+
+static void completeTile( SummaryPyramid * PyramidPtr, int Level );
+
+static void writePendingTiles( SummaryPyramid * PyramidPtr, int Level );
+
+static bool mapSummaryLevel( const std::string & RecordingFilePath, int Level, MappedSummaryLevel * MappingPtr );
+
+static void collectTiles( const std::string & RecordingFilePath, int Level, int64_t FromTime, int64_t ToTime,
+		int64_t FirstTileTime, int64_t TileWidth, int TilesNumber, SummaryTile * TilesPtr );
+
+static int prepareTiles( int64_t StartTime, int64_t EndTime, int TilesNumberMax, SummaryTile * TilesPtr, int * LevelPtr,
+		int64_t * TileWidthPtr );
+
+static void listSummarisedRecordings( const std::string & DirectoryPath, std::vector<std::string> * FilePathsPtr,
+		std::vector<int64_t> * StartTimesPtr );
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+/// This function is called when a new recording file is created (or an old one is compacted); the tiles accumulated
+/// so far are written to the new files. The compaction writes the temporary files (left by an abandoned compaction
+/// or not), which replace the old summaries only when complete.
+/// @return false if the files cannot be created (the recording goes on without the pyramid)
+bool openSummaryPyramid( SummaryPyramid * PyramidPtr, const std::string & RecordingFilePath ){
+	SummaryLevel * LevelsPtr = PyramidPtr->Levels;
+	PyramidPtr->IsFailed = false;
+	for (int Level=0; Level < SUMMARY_LEVELS_NUMBER; Level++){
+		LevelsPtr[Level].LastTileStartTime = INT64_MIN;
+		std::string FilePath = getSummaryFilePath( RecordingFilePath, Level );
+		int Flags = O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC;
+		if (PyramidPtr->IsWrittenDirectly){
+			FilePath += SUMMARY_TEMPORARY_EXTENSION;
+			Flags = O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC;
+		}
+		LevelsPtr[Level].File = open( FilePath.c_str(), Flags, 0644 );
+		if (LevelsPtr[Level].File < 0){
+			std::cout << "Nie można utworzyć pliku: " << FilePath << " (" << strerror( errno ) << ")" << std::endl;
+			for (int J=0; J < Level; J++){
+				close( LevelsPtr[J].File );
+				LevelsPtr[J].File = -1;
+			}
+			if (PyramidPtr->IsWrittenDirectly){
+				discardSummaryPyramid( RecordingFilePath );
+			}
+			return false;
+		}
+	}
+	return true;
+}
+
+/// This function is called for each frame, in the order of time
+void addFrameToSummaryPyramid( SummaryPyramid * PyramidPtr, const RecordedFrame * FramePtr ){
+	SummaryLevel * LevelPtr = &PyramidPtr->Levels[0];
+	int64_t StartTime = FramePtr->RegistersTime - FramePtr->RegistersTime % SUMMARY_BASE_TILE_WIDTH;
+	if (LevelPtr->IsTileOpen && (StartTime != LevelPtr->Tile.StartTime)){
+		if (StartTime < LevelPtr->Tile.StartTime){
+			StartTime = LevelPtr->Tile.StartTime;	// the clock has been set back; the tiles must not overlap
+		}
+		else{
+			completeTile( PyramidPtr, 0 );
+		}
+	}
+	if (!LevelPtr->IsTileOpen){
+		openTile( PyramidPtr, 0, StartTime );
+	}
+
+	SummaryTile * TilePtr = &LevelPtr->Tile;
+	if ((0 != (FramePtr->QualityFlags & FRAME_QUALITY_REGISTERS_UPDATED)) && (0 != (FramePtr->QualityFlags & FRAME_QUALITY_REGISTERS_VALID))){
+		for (int J=0; J < MODBUS_INPUTS_NUMBER; J++){
+			uint16_t Value = FramePtr->InputRegisters[J];
+			TilePtr->Minimum[J] = std::min( TilePtr->Minimum[J], Value );
+			TilePtr->Maximum[J] = std::max( TilePtr->Maximum[J], Value );
+			PyramidPtr->RegisterSums[J] += Value;
+		}
+		TilePtr->ReadoutsNumber++;
+	}
+	if ((0 != (FramePtr->QualityFlags & FRAME_QUALITY_COILS_UPDATED)) && (0 != (FramePtr->QualityFlags & FRAME_QUALITY_COILS_VALID))){
+		TilePtr->CoilsAny |= FramePtr->Coils;
+		TilePtr->CoilsAll &= FramePtr->Coils;
+		TilePtr->CoilsReadoutsNumber++;
+	}
+}
+
+/// This function is called after each chunk written; when the recording file is closed, the tiles in progress are
+/// completed (they cover the rest of the recording) and the files are closed
+void flushSummaryPyramid( SummaryPyramid * PyramidPtr, bool IsClosing ){
+	SummaryLevel * LevelsPtr = PyramidPtr->Levels;
+	if (IsClosing){
+		for (int Level=0; Level < SUMMARY_LEVELS_NUMBER; Level++){
+			if (LevelsPtr[Level].IsTileOpen){
+				completeTile( PyramidPtr, Level );
+			}
+		}
+	}
+	for (int Level=0; Level < SUMMARY_LEVELS_NUMBER; Level++){
+		writePendingTiles( PyramidPtr, Level );
+		while (IsClosing && (LevelsPtr[Level].File >= 0) && (0 != LevelsPtr[Level].PendingTilesNumber)){
+			std::this_thread::sleep_for( std::chrono::milliseconds( PERIPHERAL_THREAD_LOOP_DURATION ));
+			writePendingTiles( PyramidPtr, Level );		// the last tiles wait for a free buffer
+		}
+		if (IsClosing && (LevelsPtr[Level].File >= 0)){
+			if (PyramidPtr->IsWrittenDirectly){
+				bool IsSynchronised = (0 == fdatasync( LevelsPtr[Level].File ));
+				if ((0 != close( LevelsPtr[Level].File )) || !IsSynchronised){
+					std::cout << "Błąd zapisu podsumowań zapisu (" << strerror( errno ) << ")" << std::endl;
+					PyramidPtr->IsFailed = true;
+				}
+			}
+			else{
+				closeDiskFile( LevelsPtr[Level].File );
+			}
+			LevelsPtr[Level].File = -1;
+		}
+	}
+}
+
+/// This function is called after the directly written pyramid has been flushed and closed; the temporary files
+/// replace the summaries of the recording (each level at once, by rename()) and the directory is synchronised
+/// @return false if any tile has been lost or any step has failed (the temporary files are deleted)
+bool commitSummaryPyramid( SummaryPyramid * PyramidPtr, const std::string & RecordingFilePath ){
+	for (int Level=0; (Level < SUMMARY_LEVELS_NUMBER) && !PyramidPtr->IsFailed; Level++){
+		std::string FilePath = getSummaryFilePath( RecordingFilePath, Level );
+		if (0 != rename( (FilePath + SUMMARY_TEMPORARY_EXTENSION).c_str(), FilePath.c_str() )){
+			std::cout << "Nie można zastąpić pliku: " << FilePath << " (" << strerror( errno ) << ")" << std::endl;
+			PyramidPtr->IsFailed = true;
+		}
+	}
+	if (PyramidPtr->IsFailed){
+		discardSummaryPyramid( RecordingFilePath );
+		return false;
+	}
+
+	std::string DirectoryPath = RecordingFilePath.substr( 0, RecordingFilePath.rfind( '/' ) + 1 );
+	int Directory = open( DirectoryPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+	if ((Directory < 0) || (0 != fsync( Directory ))){
+		std::cout << "Nie można zsynchronizować katalogu: " << DirectoryPath << " (" << strerror( errno ) << ")" << std::endl;
+		if (Directory >= 0){
+			close( Directory );
+		}
+		return false;
+	}
+	close( Directory );
+	return true;
+}
+
+/// The temporary files of the compaction are deleted (the old summaries of the recording are left as they are)
+void discardSummaryPyramid( const std::string & RecordingFilePath ){
+	for (int Level=0; Level < SUMMARY_LEVELS_NUMBER; Level++){
+		unlink( (getSummaryFilePath( RecordingFilePath, Level ) + SUMMARY_TEMPORARY_EXTENSION).c_str() );
+	}
+}
+
+/// @return ns
+int64_t getSummaryTileWidth( int Level ){
+	int64_t Width = SUMMARY_BASE_TILE_WIDTH;
+	for (int J=0; J < Level; J++){
+		Width *= SUMMARY_LEVEL_FACTOR;
+	}
+	return Width;
+}
+
+/// Zapis_<date>_<time>.rec -> Zapis_<date>_<time>.sum<Level>
+std::string getSummaryFilePath( const std::string & RecordingFilePath, int Level ){
+	return getRecordingSidecarPath( RecordingFilePath, (SUMMARY_FILE_EXTENSION + std::to_string( Level )).c_str() );
+}
+
+/// This function reads the summary of the range [StartTime; EndTime) of a recording as consecutive tiles of equal width,
+/// the narrowest that fit in TilesNumberMax; the tiles without frames have ReadoutsNumber and CoilsReadoutsNumber
+/// equal to 0
+/// @param TilesPtr at least TilesNumberMax tiles
+/// @param TileWidthPtr ns
+/// @return the number of tiles; the first one contains StartTime
+int readSummaryTiles( const std::string & RecordingFilePath, int64_t StartTime, int64_t EndTime, int TilesNumberMax,
+		SummaryTile * TilesPtr, int64_t * TileWidthPtr )
+{
+	int Level;
+	int TilesNumber = prepareTiles( StartTime, EndTime, TilesNumberMax, TilesPtr, &Level, TileWidthPtr );
+	if (TilesNumber > 0){
+		collectTiles( RecordingFilePath, Level, TilesPtr[0].StartTime, TilesPtr[0].StartTime + TilesNumber*(*TileWidthPtr),
+				TilesPtr[0].StartTime, *TileWidthPtr, TilesNumber, TilesPtr );
+	}
+	return TilesNumber;
+}
+
+/// As readSummaryTiles(), but over all the recordings of the directory: the tiles of the consecutive files are joined.
+/// A file is read only up to the start of the next one, so the levels below are read only for the tiles not written
+/// yet (of the file being recorded).
+int readRecordingSummaries( const std::string & DirectoryPath, int64_t StartTime, int64_t EndTime, int TilesNumberMax,
+		SummaryTile * TilesPtr, int64_t * TileWidthPtr )
+{
+	int Level;
+	int TilesNumber = prepareTiles( StartTime, EndTime, TilesNumberMax, TilesPtr, &Level, TileWidthPtr );
+	if (0 == TilesNumber){
+		return 0;
+	}
+	int64_t FirstTileTime = TilesPtr[0].StartTime;
+	EndTime = FirstTileTime + TilesNumber*(*TileWidthPtr);
+	std::vector<std::string> FilePaths;
+	std::vector<int64_t> StartTimes;
+	listSummarisedRecordings( DirectoryPath, &FilePaths, &StartTimes );
+	for (size_t J=0; J < FilePaths.size(); J++){
+		// the name has the time of the first frame in whole seconds: the last frames of the previous file may be
+		// in the same second
+		int64_t FileEndTime = (J+1 < FilePaths.size())? StartTimes[J+1] + SUMMARY_BASE_TILE_WIDTH : INT64_MAX;
+		if ((StartTimes[J] >= EndTime) || (FileEndTime <= FirstTileTime)){
+			continue;
+		}
+		collectTiles( FilePaths[J], Level, FirstTileTime, std::min( EndTime, FileEndTime ), FirstTileTime, *TileWidthPtr,
+				TilesNumber, TilesPtr );
+	}
+	return TilesNumber;
+}
+
+/// Both tiles must be complete (with the means, not the sums); the start time of the destination is not changed
+void mergeSummaryTile( SummaryTile * DestinationPtr, const SummaryTile * SourcePtr ){
+	if (0 != SourcePtr->ReadoutsNumber){
+		if (0 == DestinationPtr->ReadoutsNumber){
+			memcpy( DestinationPtr->Minimum, SourcePtr->Minimum, sizeof(DestinationPtr->Minimum) );
+			memcpy( DestinationPtr->Maximum, SourcePtr->Maximum, sizeof(DestinationPtr->Maximum) );
+			memcpy( DestinationPtr->Mean, SourcePtr->Mean, sizeof(DestinationPtr->Mean) );
+		}
+		else{
+			double Total = (double)DestinationPtr->ReadoutsNumber + SourcePtr->ReadoutsNumber;
+			for (int J=0; J < MODBUS_INPUTS_NUMBER; J++){
+				DestinationPtr->Minimum[J] = std::min( DestinationPtr->Minimum[J], SourcePtr->Minimum[J] );
+				DestinationPtr->Maximum[J] = std::max( DestinationPtr->Maximum[J], SourcePtr->Maximum[J] );
+				DestinationPtr->Mean[J] = (float)(((double)DestinationPtr->Mean[J]*DestinationPtr->ReadoutsNumber +
+						(double)SourcePtr->Mean[J]*SourcePtr->ReadoutsNumber) / Total);
+			}
+		}
+		DestinationPtr->ReadoutsNumber += SourcePtr->ReadoutsNumber;
+	}
+	if (0 != SourcePtr->CoilsReadoutsNumber){
+		if (0 == DestinationPtr->CoilsReadoutsNumber){
+			DestinationPtr->CoilsAny = SourcePtr->CoilsAny;
+			DestinationPtr->CoilsAll = SourcePtr->CoilsAll;
+		}
+		else{
+			DestinationPtr->CoilsAny |= SourcePtr->CoilsAny;
+			DestinationPtr->CoilsAll &= SourcePtr->CoilsAll;
+		}
+		DestinationPtr->CoilsReadoutsNumber += SourcePtr->CoilsReadoutsNumber;
+	}
+}
+
+/// The start times of the tiles of a file must grow (see mapSummaryLevel()); after the clock has been set back,
+/// the frames go to the tile after the last one completed
+static void openTile( SummaryPyramid * PyramidPtr, int Level, int64_t StartTime ){
+	if (StartTime <= PyramidPtr->Levels[Level].LastTileStartTime){
+		StartTime = PyramidPtr->Levels[Level].LastTileStartTime + getSummaryTileWidth( Level );
+	}
+	SummaryTile * TilePtr = &PyramidPtr->Levels[Level].Tile;
+	memset( TilePtr, 0, sizeof(SummaryTile) );
+	TilePtr->StartTime = StartTime;
+	if (0 == Level){
+		for (int J=0; J < MODBUS_INPUTS_NUMBER; J++){
+			TilePtr->Minimum[J] = UINT16_MAX;
+			PyramidPtr->RegisterSums[J] = 0.0;
+		}
+		TilePtr->CoilsAll = UINT16_MAX;
+	}
+	PyramidPtr->Levels[Level].IsTileOpen = true;
+}
+
+/// The completed tile is queued for writing and merged into the tile of the level above
+static void completeTile( SummaryPyramid * PyramidPtr, int Level ){
+	SummaryLevel * LevelPtr = &PyramidPtr->Levels[Level];
+	SummaryTile * TilePtr = &LevelPtr->Tile;
+	LevelPtr->IsTileOpen = false;
+	LevelPtr->LastTileStartTime = TilePtr->StartTime;
+	if (0 == Level){
+		for (int J=0; J < MODBUS_INPUTS_NUMBER; J++){
+			if (0 == TilePtr->ReadoutsNumber){
+				TilePtr->Minimum[J] = 0;
+				TilePtr->Mean[J] = NAN;
+			}
+			else{
+				TilePtr->Mean[J] = (float)(PyramidPtr->RegisterSums[J] / TilePtr->ReadoutsNumber);
+			}
+		}
+		if (0 == TilePtr->CoilsReadoutsNumber){
+			TilePtr->CoilsAll = 0;
+		}
+	}
+
+	if (SUMMARY_PENDING_TILES_MAX == LevelPtr->PendingTilesNumber){
+		writePendingTiles( PyramidPtr, Level );
+		if (0 != LevelPtr->PendingTilesNumber){
+			PyramidPtr->IsFailed = true;
+		}
+		LevelPtr->PendingTilesNumber = 0;		// dropped if the file is not open or the disk writer has no buffers
+	}
+	LevelPtr->PendingTiles[LevelPtr->PendingTilesNumber++] = *TilePtr;
+
+	if (Level+1 < SUMMARY_LEVELS_NUMBER){
+		SummaryLevel * UpperPtr = &PyramidPtr->Levels[Level+1];
+		int64_t UpperWidth = getSummaryTileWidth( Level+1 );
+		int64_t StartTime = TilePtr->StartTime - TilePtr->StartTime % UpperWidth;
+		if (UpperPtr->IsTileOpen && (StartTime > UpperPtr->Tile.StartTime)){
+			completeTile( PyramidPtr, Level+1 );
+		}
+		if (!UpperPtr->IsTileOpen){
+			openTile( PyramidPtr, Level+1, StartTime );
+		}
+		mergeSummaryTile( &UpperPtr->Tile, TilePtr );
+	}
+}
+
+/// The tiles stay pending if the disk writer has no free buffer (they are written after the next chunk)
+static void writePendingTiles( SummaryPyramid * PyramidPtr, int Level ){
+	SummaryLevel * LevelPtr = &PyramidPtr->Levels[Level];
+	if ((LevelPtr->File < 0) || (0 == LevelPtr->PendingTilesNumber)){
+		return;
+	}
+	size_t Size = LevelPtr->PendingTilesNumber * sizeof(SummaryTile);
+	if (!PyramidPtr->IsWrittenDirectly){
+		if (copyToDisk( LevelPtr->File, LevelPtr->PendingTiles, Size, 0, DISK_WRITE_NOT_REPORTED )){
+			LevelPtr->PendingTilesNumber = 0;
+		}
+		return;
+	}
+	const uint8_t * BytePtr = reinterpret_cast<const uint8_t *>(LevelPtr->PendingTiles);
+	while (Size > 0){
+		ssize_t Written = write( LevelPtr->File, BytePtr, Size );
+		if (Written < 0){
+			if (EINTR == errno){
+				continue;
+			}
+			std::cout << "Błąd zapisu podsumowań zapisu (" << strerror( errno ) << ")" << std::endl;
+			close( LevelPtr->File );
+			LevelPtr->File = -1;
+			PyramidPtr->IsFailed = true;
+			break;
+		}
+		BytePtr += Written;
+		Size -= (size_t)Written;
+	}
+	LevelPtr->PendingTilesNumber = 0;
+}
+
+/// The records after the last one in the order of time (e.g. zeroed by a crash) are ignored
+/// @return false if the level has no tiles
+static bool mapSummaryLevel( const std::string & RecordingFilePath, int Level, MappedSummaryLevel * MappingPtr ){
+	int File = open( getSummaryFilePath( RecordingFilePath, Level ).c_str(), O_RDONLY | O_CLOEXEC );
+	if (File < 0){
+		return false;
+	}
+	struct stat Status;
+	if ((0 != fstat( File, &Status )) || ((size_t)Status.st_size < sizeof(SummaryTile))){
+		close( File );
+		return false;
+	}
+	MappingPtr->MappedSize = (size_t)Status.st_size;
+	void * AddressPtr = mmap( nullptr, MappingPtr->MappedSize, PROT_READ, MAP_SHARED, File, 0 );
+	close( File );
+	if (MAP_FAILED == AddressPtr){
+		return false;
+	}
+	MappingPtr->TilesPtr = static_cast<const SummaryTile *>(AddressPtr);
+	MappingPtr->TilesNumber = MappingPtr->MappedSize / sizeof(SummaryTile);
+	while ((MappingPtr->TilesNumber > 1) &&
+			(MappingPtr->TilesPtr[MappingPtr->TilesNumber-1].StartTime <= MappingPtr->TilesPtr[MappingPtr->TilesNumber-2].StartTime))
+	{
+		MappingPtr->TilesNumber--;
+	}
+	return true;
+}
+
+/// The tiles of the level starting in [FromTime; ToTime) are merged into the output tiles; the rest of the range
+/// not covered by the level is taken from the level below
+static void collectTiles( const std::string & RecordingFilePath, int Level, int64_t FromTime, int64_t ToTime,
+		int64_t FirstTileTime, int64_t TileWidth, int TilesNumber, SummaryTile * TilesPtr )
+{
+	int64_t LevelWidth = getSummaryTileWidth( Level );
+	int64_t CoveredTime = FromTime;
+	MappedSummaryLevel Mapping;
+	if (mapSummaryLevel( RecordingFilePath, Level, &Mapping )){
+		// the first tile not earlier than FromTime (binary search)
+		size_t Low = 0;
+		size_t High = Mapping.TilesNumber;
+		while (Low < High){
+			size_t Middle = Low + (High - Low)/2;
+			if (Mapping.TilesPtr[Middle].StartTime < FromTime){
+				Low = Middle + 1;
+			}
+			else{
+				High = Middle;
+			}
+		}
+		for (size_t J = Low; (J < Mapping.TilesNumber) && (Mapping.TilesPtr[J].StartTime < ToTime); J++){
+			int Index = (int)((Mapping.TilesPtr[J].StartTime - FirstTileTime) / TileWidth);
+			if ((Index >= 0) && (Index < TilesNumber)){
+				mergeSummaryTile( &TilesPtr[Index], &Mapping.TilesPtr[J] );
+			}
+			CoveredTime = Mapping.TilesPtr[J].StartTime + LevelWidth;
+		}
+		munmap( const_cast<SummaryTile *>(Mapping.TilesPtr), Mapping.MappedSize );
+	}
+	if ((CoveredTime < ToTime) && (Level > 0)){
+		collectTiles( RecordingFilePath, Level-1, CoveredTime, ToTime, FirstTileTime, TileWidth, TilesNumber, TilesPtr );
+	}
+}
+
+/// The tiles are SUMMARY_LEVEL_FACTOR times wider than the ones of the level below, also beyond the highest level,
+/// whose tiles are then merged; if even the widest tiles do not fit in TilesNumberMax, the range is shortened
+/// @param TilesPtr the tiles are emptied and given their start times
+/// @param LevelPtr the level to be read
+/// @return the number of tiles
+static int prepareTiles( int64_t StartTime, int64_t EndTime, int TilesNumberMax, SummaryTile * TilesPtr, int * LevelPtr,
+		int64_t * TileWidthPtr )
+{
+	if ((EndTime <= StartTime) || (TilesNumberMax <= 0)){
+		return 0;
+	}
+	int Level = 0;
+	int64_t TileWidth = SUMMARY_BASE_TILE_WIDTH;
+	int64_t FirstTileTime = StartTime - StartTime % TileWidth;
+	while (((EndTime - 1 - FirstTileTime) / TileWidth + 1 > TilesNumberMax) && (TileWidth <= INT64_MAX / SUMMARY_LEVEL_FACTOR)){
+		Level = std::min( Level + 1, SUMMARY_LEVELS_NUMBER-1 );
+		TileWidth *= SUMMARY_LEVEL_FACTOR;
+		FirstTileTime = StartTime - StartTime % TileWidth;
+	}
+	int TilesNumber = (int)std::min<int64_t>( (EndTime - 1 - FirstTileTime) / TileWidth + 1, TilesNumberMax );
+	for (int J=0; J < TilesNumber; J++){
+		memset( &TilesPtr[J], 0, sizeof(SummaryTile) );
+		TilesPtr[J].StartTime = FirstTileTime + J*TileWidth;
+	}
+	*LevelPtr = Level;
+	*TileWidthPtr = TileWidth;
+	return TilesNumber;
+}
+
+/// The recordings are identified by the path of their .rec file (which may be already deleted, see retention.cpp)
+/// @param FilePathsPtr the recordings with the summaries, in the order of time (of their names)
+/// @param StartTimesPtr ns since 1970-01-01 UTC; the times of the names
+static void listSummarisedRecordings( const std::string & DirectoryPath, std::vector<std::string> * FilePathsPtr,
+		std::vector<int64_t> * StartTimesPtr )
+{
+	DIR * DirectoryPtr = opendir( DirectoryPath.c_str() );
+	if (nullptr == DirectoryPtr){
+		return;
+	}
+	const std::string Extension = SUMMARY_FILE_EXTENSION "0";
+	size_t PrefixLength = sizeof(RECORDING_FILE_PREFIX) - 1;
+	while (struct dirent * EntryPtr = readdir( DirectoryPtr )){
+		std::string Name = EntryPtr->d_name;
+		if ((Name.size() > PrefixLength + Extension.size()) && (0 == Name.compare( 0, PrefixLength, RECORDING_FILE_PREFIX )) &&
+				(0 == Name.compare( Name.size() - Extension.size(), Extension.size(), Extension )))
+		{
+			FilePathsPtr->push_back( DirectoryPath + "/" + Name.substr( 0, Name.size() - Extension.size() ) +
+					RECORDING_FILE_EXTENSION );
+		}
+	}
+	closedir( DirectoryPtr );
+	std::sort( FilePathsPtr->begin(), FilePathsPtr->end() );
+
+	size_t NameOffset = DirectoryPath.size() + 1 + PrefixLength;
+	for (const std::string & FilePath : *FilePathsPtr){
+		struct tm LocalTime;
+		memset( &LocalTime, 0, sizeof(LocalTime) );
+		int64_t StartTime = INT64_MIN;		// a file of an unknown time is read for any range
+		if (nullptr != strptime( FilePath.c_str() + NameOffset, SUMMARY_FILE_TIME_FORMAT, &LocalTime )){
+			LocalTime.tm_isdst = -1;
+			time_t Seconds = mktime( &LocalTime );
+			if ((time_t)-1 != Seconds){
+				StartTime = (int64_t)Seconds * 1000000000;
+			}
+		}
+		StartTimesPtr->push_back( StartTime );
+	}
+}
@@ -0,0 +1,86 @@
+/// @file summary_pyramid.h
+
+#ifndef SOURCE_SUMMARY_PYRAMID_H_
+#define SOURCE_SUMMARY_PYRAMID_H_
+
+#include <string>
+#include <cstdint>
+
+#include "config.h"
+#include "recording_format.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define SUMMARY_LEVELS_NUMBER				4		// 1 s, 8 s, 64 s, 512 s; a file of an hour has 8 tiles
+													// of the highest level, the wider tiles are merged from them
+#define SUMMARY_LEVEL_FACTOR				8		// the tiles of a level cover so many tiles of the level below
+#define SUMMARY_BASE_TILE_WIDTH				1000000000LL	// ns; the width of the tiles of the level 0
+#define SUMMARY_FILE_EXTENSION				".sum"	// followed by the level: Zapis_<date>_<time>.sum0
+#define SUMMARY_TEMPORARY_EXTENSION			".tmp"	// the levels being rebuilt: Zapis_<date>_<time>.sum0.tmp
+#define SUMMARY_PENDING_TILES_MAX			64		// the tiles waiting for the next chunk to be written (or for a buffer)
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+/// The summary of the frames of a recording in a time interval [StartTime; StartTime + width of the tile);
+/// the registers are summarised over the readouts of the registers, the coils over the readouts of the coils
+struct SummaryTile {
+	int64_t StartTime;					// ns since 1970-01-01 UTC; a multiple of the width of the tile
+	uint32_t ReadoutsNumber;			// the count of the register readouts; 0 means no values
+	uint32_t CoilsReadoutsNumber;
+	uint16_t CoilsAny;					// bit J is set if Coils[J] was on at least once
+	uint16_t CoilsAll;					// bit J is set if Coils[J] was on all the time
+	uint16_t Minimum[MODBUS_INPUTS_NUMBER];
+	uint16_t Maximum[MODBUS_INPUTS_NUMBER];
+	float Mean[MODBUS_INPUTS_NUMBER];
+};
+
+/// The state of a level of the pyramid being built
+struct SummaryLevel {
+	int File = -1;
+	bool IsTileOpen;
+	int64_t LastTileStartTime = INT64_MIN;	// the tile completed last since the files were opened
+	SummaryTile Tile;					// the tile in progress; the level 0 keeps the sums in RegisterSums[]
+	int PendingTilesNumber;
+	SummaryTile PendingTiles[SUMMARY_PENDING_TILES_MAX];
+};
+
+/// The pyramid being built: by the recorder thread, along with the recording (written through the disk writer),
+/// or by the compaction of an old recording (written directly, to the temporary files, see commitSummaryPyramid())
+struct SummaryPyramid {
+	SummaryLevel Levels[SUMMARY_LEVELS_NUMBER];
+	double RegisterSums[MODBUS_INPUTS_NUMBER];
+	bool IsWrittenDirectly;
+	bool IsFailed;						// a tile has been lost: a write, a synchronisation or a close has failed
+};
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+bool openSummaryPyramid( SummaryPyramid * PyramidPtr, const std::string & RecordingFilePath );
+
+void addFrameToSummaryPyramid( SummaryPyramid * PyramidPtr, const RecordedFrame * FramePtr );
+
+void flushSummaryPyramid( SummaryPyramid * PyramidPtr, bool IsClosing );
+
+bool commitSummaryPyramid( SummaryPyramid * PyramidPtr, const std::string & RecordingFilePath );
+
+void discardSummaryPyramid( const std::string & RecordingFilePath );
+
+int64_t getSummaryTileWidth( int Level );
+
+std::string getSummaryFilePath( const std::string & RecordingFilePath, int Level );
+
+int readSummaryTiles( const std::string & RecordingFilePath, int64_t StartTime, int64_t EndTime, int TilesNumberMax,
+		SummaryTile * TilesPtr, int64_t * TileWidthPtr );
+
+int readRecordingSummaries( const std::string & DirectoryPath, int64_t StartTime, int64_t EndTime, int TilesNumberMax,
+		SummaryTile * TilesPtr, int64_t * TileWidthPtr );
+
+void mergeSummaryTile( SummaryTile * DestinationPtr, const SummaryTile * SourcePtr );
+
+#endif // SOURCE_SUMMARY_PYRAMID_H_
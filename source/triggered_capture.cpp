@@ -0,0 +1,322 @@
+/// @file triggered_capture.cpp
+///
+/// Triggered capture: a thread of its own reads the history with its own cursor and checks the trigger
+/// conditions on every frame. When a trigger fires, the frames of the pre-trigger window are taken from the
+/// history and written to a snapshot file (CSV), followed by the frames of the post-trigger window as they arrive.
+/// A trigger that fires during a capture does not start another one; it is noted in the file being written
+/// and counted (shown in the status line), so the operator knows that an event was not captured on its own.
+/// The peripheral thread is not involved at all: it only appends the frames to the history, as always.
+
+#include <cmath>
+#include <ctime>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <iostream>
+
+#include "triggered_capture.h"
+#include "history_buffer.h"
+#include "signal_processing.h"
+#include "settings_file.h"
+
+//.................................................................................................
+// Preprocessor directives
+//.................................................................................................
+
+#define CAPTURE_THREAD_LOOP_DURATION	PERIPHERAL_THREAD_LOOP_DURATION	// milliseconds
+#define CAPTURE_FILE_BUFFER_SIZE		(1 << 16)
+
+//.................................................................................................
+// Definitions of types
+//.................................................................................................
+
+/// The previous value of the signal observed by a trigger
+struct TriggerState {
+	bool IsPreviousValueValid;
+	double PreviousValue;
+	std::chrono::high_resolution_clock::time_point PreviousTime;
+};
+
+//.................................................................................................
+// Local variables
+//.................................................................................................
+
+static std::thread CaptureThread;
+
+static std::atomic<bool> CloseCaptureFlag;
+
+static std::atomic<bool> ManualTriggerRequest;
+
+static std::atomic<bool> IsCapturing;
+
+/// The triggers that fired during a capture since the start; written by the capture thread
+static std::atomic<uint64_t> MissedTriggersNumber;
+
+/// These variables are used by the capture thread only
+static TriggerState TriggerStates[TRIGGERS_MAX];
+static FILE * CaptureFile;
+static std::chrono::high_resolution_clock::time_point TriggerTime;
+static AcquisitionFrame CaptureFrame;
+
+//.................................................................................................
+// Local function prototypes
+//.................................................................................................
+
+static void captureThreadHandler(void);
+
+static int checkTriggers( const AcquisitionFrame * FramePtr );
+
+static bool openCaptureFile( int TriggerIndex );
+
+static void writeCaptureFrame( const AcquisitionFrame * FramePtr );
+
+static void noteMissedTrigger( int TriggerIndex );
+
+static void closeCaptureFile(void);
+
+//.................................................................................................
+// Function definitions
+//.................................................................................................
+
+void triggeredCaptureStart(void){
+	atomic_store_explicit( &CloseCaptureFlag, false, std::memory_order_release );
+	CaptureThread = std::thread(captureThreadHandler);
+}
+
+/// This function is called by FLTK onMainWindowCloseCallback event handler; the capture in progress is
+/// closed with the frames collected so far
+void triggeredCaptureExit(void){
+	atomic_store_explicit( &CloseCaptureFlag, true, std::memory_order_release );
+	if (CaptureThread.joinable()){
+		CaptureThread.join();
+	}
+}
+
+/// This function is called by the GUI thread (menu); the capture starts as if a trigger fired on the newest frame
+void requestManualTrigger(void){
+	atomic_store_explicit( &ManualTriggerRequest, true, std::memory_order_release );
+}
+
+bool isCaptureInProgress(void){
+	return atomic_load_explicit( &IsCapturing, std::memory_order_acquire );
+}
+
+/// This function is called by the GUI thread
+uint64_t getMissedTriggersNumber(void){
+	return atomic_load_explicit( &MissedTriggersNumber, std::memory_order_relaxed );
+}
+
+static void captureThreadHandler(void){
+	HistoryCursor Cursor;
+	initializeHistoryCursor( &Cursor, false );
+	for (int J=0; J < TRIGGERS_MAX; J++){
+		TriggerStates[J].IsPreviousValueValid = false;
+	}
+
+	while (!atomic_load_explicit( &CloseCaptureFlag, std::memory_order_acquire )){
+		while (readFromHistory( &Cursor, &CaptureFrame )){
+			uint64_t FrameIndex = Cursor.NextFrameIndex - 1;
+
+			// the triggers are evaluated on every frame, so they do not fire on stale values after a capture
+			int TriggerIndex = checkTriggers( &CaptureFrame );
+			if (atomic_exchange_explicit( &ManualTriggerRequest, false, std::memory_order_acq_rel )){
+				TriggerIndex = TRIGGERS_MAX;
+			}
+
+			if (nullptr != CaptureFile){
+				if (TriggerIndex >= 0){
+					noteMissedTrigger( TriggerIndex );
+				}
+				writeCaptureFrame( &CaptureFrame );
+				std::chrono::milliseconds Elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+						CaptureFrame.RegistersTime - TriggerTime );
+				if (Elapsed.count() >= PostTriggerDuration){
+					closeCaptureFile();
+				}
+			}
+			else if (TriggerIndex >= 0){
+				TriggerTime = CaptureFrame.RegistersTime;
+				if (openCaptureFile( TriggerIndex )){
+					// the pre-trigger window: the oldest frame still in the history and not older than the window
+					uint64_t FirstIndex = FrameIndex;
+					while (FirstIndex > 0){
+						if (!readHistoryFrame( FirstIndex-1, &CaptureFrame )){
+							break;
+						}
+						if (std::chrono::duration_cast<std::chrono::milliseconds>(TriggerTime - CaptureFrame.RegistersTime).count() > PreTriggerDuration){
+							break;
+						}
+						FirstIndex--;
+					}
+					for (uint64_t Index = FirstIndex; Index <= FrameIndex; Index++){
+						if (readHistoryFrame( Index, &CaptureFrame )){
+							writeCaptureFrame( &CaptureFrame );
+						}
+					}
+					if (0 == PostTriggerDuration){
+						closeCaptureFile();
+					}
+				}
+			}
+		}
+		std::this_thread::sleep_for( std::chrono::milliseconds( CAPTURE_THREAD_LOOP_DURATION ));
+	}
+	closeCaptureFile();
+}
+
+/// @return the index of the first trigger that fires on this frame or -1
+static int checkTriggers( const AcquisitionFrame * FramePtr ){
+	int FiredTrigger = -1;
+	for (int J=0; J < TriggersNumber; J++){
+		const TriggerDefinition * TriggerPtr = &Triggers[J];
+		TriggerState * StatePtr = &TriggerStates[J];
+		bool IsCoilTrigger = (TriggerPtr->Type >= TriggerTypes::COIL_RISING_EDGE);
+		uint8_t UpdatedFlag = IsCoilTrigger? FRAME_QUALITY_COILS_UPDATED : FRAME_QUALITY_REGISTERS_UPDATED;
+		if (0 == (FramePtr->QualityFlags & UpdatedFlag)){
+			continue;
+		}
+
+		double Value;
+		std::chrono::high_resolution_clock::time_point Time;
+		if (IsCoilTrigger){
+			Value = FramePtr->Coils[TriggerPtr->CupIndex*MODBUS_COILS_PER_CUP + TriggerPtr->Channel]? 1.0 : 0.0;
+			Time = FramePtr->CoilsTime;
+		}
+		else{
+			Value = getChannelValue( FramePtr, TriggerPtr->CupIndex, TriggerPtr->Channel );
+			Time = FramePtr->RegistersTime;
+		}
+		if (std::isnan( Value )){
+			StatePtr->IsPreviousValueValid = false;
+			continue;
+		}
+
+		if (StatePtr->IsPreviousValueValid){
+			double Previous = StatePtr->PreviousValue;
+			double TimeStep = std::chrono::duration<double>(Time - StatePtr->PreviousTime).count();
+			bool IsFired = false;
+			switch (TriggerPtr->Type){
+			case TriggerTypes::RISING_THRESHOLD:
+				IsFired = (Previous < TriggerPtr->Level) && (Value >= TriggerPtr->Level);
+				break;
+			case TriggerTypes::FALLING_THRESHOLD:
+				IsFired = (Previous > TriggerPtr->Level) && (Value <= TriggerPtr->Level);
+				break;
+			case TriggerTypes::RISING_SLOPE:
+				IsFired = (TimeStep > 0.0) && ((Value - Previous) >= TriggerPtr->Level * TimeStep);
+				break;
+			case TriggerTypes::FALLING_SLOPE:
+				IsFired = (TimeStep > 0.0) && ((Previous - Value) >= TriggerPtr->Level * TimeStep);
+				break;
+			case TriggerTypes::COIL_RISING_EDGE:
+				IsFired = (Previous < Value);
+				break;
+			case TriggerTypes::COIL_FALLING_EDGE:
+				IsFired = (Previous > Value);
+				break;
+			case TriggerTypes::COIL_ANY_EDGE:
+				IsFired = (Previous != Value);
+				break;
+			}
+			if (IsFired && (FiredTrigger < 0)){
+				FiredTrigger = J;
+			}
+		}
+		StatePtr->IsPreviousValueValid = true;
+		StatePtr->PreviousValue = Value;
+		StatePtr->PreviousTime = Time;
+	}
+	return FiredTrigger;
+}
+
+/// The snapshot file is named after the time of the trigger: Przechwycenie_YYYY-MM-DD_HH-MM-SS.mmm.csv
+/// @param TriggerIndex index in Triggers[] or TRIGGERS_MAX for the manual trigger
+static bool openCaptureFile( int TriggerIndex ){
+	std::chrono::system_clock::time_point SystemTime = std::chrono::system_clock::now() +
+			std::chrono::duration_cast<std::chrono::system_clock::duration>(TriggerTime - std::chrono::high_resolution_clock::now());
+	time_t Seconds = std::chrono::system_clock::to_time_t( SystemTime );
+	struct tm LocalTime;
+	localtime_r( &Seconds, &LocalTime );
+	char TimeText[40];
+	size_t Length = strftime( TimeText, sizeof(TimeText), "%Y-%m-%d_%H-%M-%S", &LocalTime );
+	snprintf( TimeText + Length, sizeof(TimeText) - Length, ".%03d",
+			(int)(std::chrono::duration_cast<std::chrono::milliseconds>(SystemTime.time_since_epoch()).count() % 1000) );
+
+	std::string FilePath = ThisApplicationDirectory + "/Przechwycenie_" + TimeText + ".csv";
+	CaptureFile = fopen( FilePath.c_str(), "w" );
+	if (nullptr == CaptureFile){
+		std::cout << "Nie można utworzyć pliku: " << FilePath << std::endl;
+		return false;
+	}
+	setvbuf( CaptureFile, nullptr, _IOFBF, CAPTURE_FILE_BUFFER_SIZE );
+	atomic_store_explicit( &IsCapturing, true, std::memory_order_release );
+
+	fprintf( CaptureFile, "# Przechwycenie %s\n", TimeText );
+	if (TriggerIndex < TriggersNumber){
+		const TriggerDefinition * TriggerPtr = &Triggers[TriggerIndex];
+		fprintf( CaptureFile, "# Wyzwalacz %d: kubek %d, %s %d, typ %d, poziom %g\n", TriggerIndex+1, TriggerPtr->CupIndex+1,
+				(TriggerPtr->Type >= TriggerTypes::COIL_RISING_EDGE)? "cewka" : "kanał", TriggerPtr->Channel+1,
+				(int)TriggerPtr->Type, TriggerPtr->Level );
+	}
+	else{
+		fprintf( CaptureFile, "# Wyzwalacz ręczny\n" );
+	}
+	fprintf( CaptureFile, "# Okno przed: %d ms, po: %d ms\n", PreTriggerDuration, PostTriggerDuration );
+	fprintf( CaptureFile, "t [s];ramka;jakość" );
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		for (int Channel=0; Channel < VALUES_PER_DISC; Channel++){
+			fprintf( CaptureFile, ";K%d %s [%s]", Cup+1, ChannelName[Cup][Channel], ChannelUnit[Cup][Channel] );
+		}
+		for (int Coil=0; Coil < MODBUS_COILS_PER_CUP; Coil++){
+			fprintf( CaptureFile, ";K%d cewka %d", Cup+1, Coil+1 );
+		}
+	}
+	fprintf( CaptureFile, "\n" );
+
+	if (VerboseMode){
+		std::cout << "Przechwytywanie do pliku: " << FilePath << std::endl;
+	}
+	return true;
+}
+
+/// The time is relative to the trigger; the values are the currents (before the filter) and the scaled diagnostic channels
+static void writeCaptureFrame( const AcquisitionFrame * FramePtr ){
+	fprintf( CaptureFile, "%.6f;%llu;%u", std::chrono::duration<double>(FramePtr->RegistersTime - TriggerTime).count(),
+			(unsigned long long)FramePtr->FrameNumber, (unsigned)FramePtr->QualityFlags );
+	for (int Cup=0; Cup < PHYSICALLY_INSTALLED_CUPS; Cup++){
+		for (int Channel=0; Channel < VALUES_PER_DISC; Channel++){
+			fprintf( CaptureFile, ";%.6g", (double)getChannelValue( FramePtr, Cup, Channel ));
+		}
+		for (int Coil=0; Coil < MODBUS_COILS_PER_CUP; Coil++){
+			fprintf( CaptureFile, ";%d", FramePtr->Coils[Cup*MODBUS_COILS_PER_CUP + Coil]? 1 : 0 );
+		}
+	}
+	fprintf( CaptureFile, "\n" );
+}
+
+/// The comment line precedes the frame on which the trigger fired
+static void noteMissedTrigger( int TriggerIndex ){
+	atomic_fetch_add_explicit( &MissedTriggersNumber, (uint64_t)1, std::memory_order_relaxed );
+	double Time = std::chrono::duration<double>(CaptureFrame.RegistersTime - TriggerTime).count();
+	if (TriggerIndex < TriggersNumber){
+		fprintf( CaptureFile, "# Pominięty wyzwalacz %d w chwili %.6f s\n", TriggerIndex+1, Time );
+	}
+	else{
+		fprintf( CaptureFile, "# Pominięty wyzwalacz ręczny w chwili %.6f s\n", Time );
+	}
+	if (VerboseMode){
+		std::cout << "Wyzwalacz w trakcie przechwytywania (pominięty)" << std::endl;
+	}
+}
+
+static void closeCaptureFile(void){
+	if (nullptr != CaptureFile){
+		fclose( CaptureFile );
+		CaptureFile = nullptr;
+		atomic_store_explicit( &IsCapturing, false, std::memory_order_release );
+		if (VerboseMode){
+			std::cout << "Koniec przechwytywania" << std::endl;
+		}
+	}
+}
@@ -0,0 +1,22 @@
+/// @file triggered_capture.h
+
+#ifndef SOURCE_TRIGGERED_CAPTURE_H_
+#define SOURCE_TRIGGERED_CAPTURE_H_
+
+#include "config.h"
+
+//.................................................................................................
+// Global function prototypes
+//.................................................................................................
+
+void triggeredCaptureStart(void);
+
+void triggeredCaptureExit(void);
+
+void requestManualTrigger(void);
+
+bool isCaptureInProgress(void);
+
+uint64_t getMissedTriggersNumber(void);
+
+#endif // SOURCE_TRIGGERED_CAPTURE_H_